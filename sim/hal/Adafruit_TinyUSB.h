@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+
+// ======================================================
+// USB-MIDI устройства в симуляторе
+// ======================================================
+// writePacket кладёт пакет в IN FIFO (64 байта, как CFG_TUD_MIDI_TX_BUFSIZE),
+// хост забирает его раз в sim_usb_set_poll() мкс; readPacket берёт
+// пакеты, которые сценарий прислал от хоста (sim_usb_host_packet).
+
+class Adafruit_USBD_MIDI {
+public:
+  void setCables(uint8_t) {}
+  bool setCableName(uint8_t, const char *) { return true; }
+  bool begin() { return true; }
+  bool writePacket(const uint8_t packet[4]);
+  bool readPacket(uint8_t packet[4]);
+};
+
+struct Adafruit_USBD_Device {
+  bool mounted();
+  void detach() {}
+  void attach() {}
+};
+extern Adafruit_USBD_Device TinyUSBDevice;
+
+bool tud_mounted();
@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ======================================================
+// Arduino-ядро для симулятора (env:native)
+// ======================================================
+// Ровно то, чем пользуется прошивка: Print/Stream, Serial, время,
+// пара заглушек GPIO и rp2040. Время — виртуальные часы sim_hal.h.
+
+typedef unsigned int uint;
+
+#define HIGH   1
+#define LOW    0
+#define INPUT  0
+#define OUTPUT 1
+
+#define CHANGE  2   // PinStatus: фронты для attachInterrupt()
+#define FALLING 3
+#define RISING  4
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n);
+
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t println(const char *s = "") { return print(s) + print('\n'); }
+  int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+
+  // без ожидания: в симуляторе данные либо уже пришли, либо нет
+  size_t readBytes(char *buf, size_t n);
+  size_t readBytes(uint8_t *buf, size_t n) { return readBytes((char *)buf, n); }
+};
+
+// WebSerial: вывод — в stdout, ввод — строки команд от сценария
+class SimSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  explicit operator bool() const { return true; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t n) override;
+  int available() override;
+  int read() override;
+};
+extern SimSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+static inline void pinMode(int, int) {}
+static inline void digitalWrite(int, int) {}
+static inline int digitalRead(int) { return LOW; }
+
+// Прерывание по фронту вывода (IO_IRQ_BANK0): фронт, случившийся
+// до attachInterrupt(), сбрасывается — как в arduino-pico
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(int pin, void (*callback)(), int mode);
+void detachInterrupt(int pin);
+
+void noInterrupts();
+void interrupts();
+
+// Ожидание другого ядра: в симуляторе ядра по очереди — отдаём проход core1
+void tight_loop_contents();
+
+struct RP2040 {
+  void idleOtherCore() {}
+  void resumeOtherCore() {}
+  int getTotalHeap() { return 256 * 1024; }
+  uint32_t getCycleCount();   // наносекунды хоста (см. hardware/clocks.h)
+};
+extern RP2040 rp2040;
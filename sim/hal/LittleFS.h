@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include <memory>
+
+// ======================================================
+// LittleFS симулятора — каталог хоста (sim_fs_set_root)
+// ======================================================
+
+class File : public Stream {
+public:
+  File() {}
+  explicit File(FILE *f) : f_(f, fclose) {}
+  explicit operator bool() const { return (bool)f_; }
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t n) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t n);
+  size_t size();
+  void close() { f_.reset(); }
+
+private:
+  std::shared_ptr<FILE> f_;
+};
+
+class FS {
+public:
+  bool begin();
+  bool exists(const char *path);
+  File open(const char *path, const char *mode);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+};
+extern FS LittleFS;
+
+void sim_fs_set_root(const char *dir);
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+// Частота "процессора" симулятора: такт rp2040.getCycleCount() — 1 нс
+// времени хоста, так что замеры BENCH выходят сразу в наносекундах
+enum clock_index { clk_sys = 5 };
+
+static inline uint32_t clock_get_hz(enum clock_index) { return 1000000000u; }
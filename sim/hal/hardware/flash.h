@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Flash — массив в RAM хоста; XIP-адрес = адрес в массиве.
+// Программирование, как у NOR, только сбрасывает биты.
+#define FLASH_PAGE_SIZE   (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define SIM_FLASH_SIZE    (2u * 1024 * 1024)
+
+extern uint8_t sim_flash[SIM_FLASH_SIZE];
+#define XIP_BASE ((uintptr_t)sim_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
@@ -0,0 +1,28 @@
+#pragma once
+#include <Arduino.h>
+
+// Функции выводов симулятору не важны: линии привязаны к периферии
+enum gpio_function {
+  GPIO_FUNC_SPI = 1,
+  GPIO_FUNC_UART = 2,
+  GPIO_FUNC_PIO0 = 6,
+  GPIO_FUNC_PIO1 = 7,
+  GPIO_FUNC_SIO = 5
+};
+
+#define GPIO_OVERRIDE_NORMAL 0
+#define GPIO_OVERRIDE_INVERT 1
+
+#define GPIO_IN  false
+#define GPIO_OUT true
+
+static inline void gpio_set_function(uint, enum gpio_function) {}
+static inline void gpio_set_inover(uint, uint) {}
+static inline void gpio_init(uint) {}
+static inline void gpio_set_dir(uint, bool) {}
+static inline void gpio_pull_up(uint) {}
+
+// SIO: выход — в модель устройства (CS# CH376S), вход — от неё (INT#),
+// не подключённый вывод читается как 1 (подтяжка)
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+// Номера линий — как в RP2040 (hardware/regs/intctrl.h)
+#define TIMER_IRQ_0 0
+#define TIMER_IRQ_1 1
+#define TIMER_IRQ_2 2
+#define TIMER_IRQ_3 3
+#define PIO0_IRQ_0 7
+#define PIO0_IRQ_1 8
+#define PIO1_IRQ_0 9
+#define PIO1_IRQ_1 10
+#define IO_IRQ_BANK0 13
+#define UART0_IRQ  20
+#define UART1_IRQ  21
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(unsigned num, irq_handler_t handler);
+void irq_add_shared_handler(unsigned num, irq_handler_t handler, uint8_t order_priority);
+void irq_set_enabled(unsigned num, bool enabled);
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+// ======================================================
+// PIO симулятора: state machine — столбцы бит на группе выводов
+// ======================================================
+// Программа не исполняется: SM берёт слово из TX FIFO и держит его
+// на выводах один бит линии (midi_multi_tx), на выводах TRS байты
+// разбирают приёмники 8N1. Как у RP2040, по 4 SM на блок; лишняя SM
+// выдаётся с предупреждением — на железе pio_claim_unused_sm(…, true)
+// паникует.
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio0, sim_pio1;
+#define pio0 (&sim_pio0)
+#define pio1 (&sim_pio1)
+
+#define SIM_PIO_SM_MAX 8   // 4 настоящих + запас для конфигураций, которых на железе нет
+
+typedef struct pio_program {
+  const uint16_t *instructions;
+  uint8_t length;
+  int8_t origin;
+} pio_program_t;
+
+// Источники прерывания — как в hardware/pio.h SDK
+enum pio_interrupt_source {
+  pis_sm0_rx_fifo_not_empty = 0,
+  pis_sm0_tx_fifo_not_full = 4,
+  pis_interrupt0 = 8
+};
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+
+/**
+ * @brief Настроить SM как передатчик: выводы (маска от базы), скорость
+ *        линии, глубина TX FIFO (вызывает *_program_init из .pio.h симулятора)
+ */
+void sim_pio_sm_init(PIO pio, uint sm, uint pinBase, uint32_t pinMask, uint baud, uint fifoDepth);
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// SPI0 симулятора: на шине одно устройство — модель CH376S
+// (sim_ch376s.cpp); байты идут без хода часов
+typedef struct spi_inst spi_inst_t;
+extern spi_inst_t *const sim_spi0;
+#define spi0 sim_spi0
+
+static inline unsigned int spi_init(spi_inst_t *, unsigned int baudrate) { return baudrate; }
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// SOF_RD — номер кадра USB по виртуальным часам (кадр = 1 мс)
+struct SimSofReg {
+  operator uint32_t() const;
+};
+
+typedef struct {
+  SimSofReg sof_rd;
+} usb_hw_t;
+
+extern usb_hw_t sim_usb_hw;
+#define usb_hw (&sim_usb_hw)
+
+#define USB_SOF_RD_BITS 0x000007ffu
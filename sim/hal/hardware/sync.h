@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+
+// Прерывания в симуляторе не вложенные: запрет просто откладывает
+// их вызов до restore_interrupts()
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t status);
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+// Таймер — виртуальные часы симулятора (sim_hal.h)
+uint64_t time_us_64();
+uint32_t time_us_32();
+
+// Аппаратные будильники (4, как в RP2040): колбэк — из TIMER_IRQ_n
+// на ядре, вызвавшем hardware_alarm_set_callback()
+typedef uint64_t absolute_time_t;
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+
+typedef void (*hardware_alarm_callback_t)(unsigned int alarm_num);
+
+int hardware_alarm_claim_unused(bool required);
+void hardware_alarm_set_callback(unsigned int alarm_num, hardware_alarm_callback_t callback);
+// true — время уже прошло, будильник не взведён (как в pico-sdk)
+bool hardware_alarm_set_target(unsigned int alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(unsigned int alarm_num);
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include "hardware/gpio.h"
+
+// ======================================================
+// UART (PL011) симулятора: FIFO выключен, как в прошивке —
+// по одному регистру-защёлке на приём и на передачу
+// ======================================================
+// Регистры с побочным эффектом (DR, FR, RIS, MIS) — прокси:
+// чтение DR снимает принятый байт, запись DR кладёт байт в передатчик.
+
+struct SimUartReg {
+  operator uint32_t() const;
+  SimUartReg &operator=(uint32_t v);
+};
+
+typedef struct {
+  SimUartReg dr;
+  SimUartReg fr;
+  SimUartReg ris;
+  SimUartReg mis;
+  volatile uint32_t imsc;
+} uart_hw_t;
+
+typedef struct uart_inst uart_inst_t;
+extern uart_hw_t sim_uart_hw[2];
+#define uart0 ((uart_inst_t *)&sim_uart_hw[0])
+#define uart1 ((uart_inst_t *)&sim_uart_hw[1])
+
+typedef enum { UART_PARITY_NONE, UART_PARITY_EVEN, UART_PARITY_ODD } uart_parity_t;
+
+#define UART_UARTDR_OE_BITS     0x00000800u
+#define UART_UARTDR_BE_BITS     0x00000400u
+#define UART_UARTDR_PE_BITS     0x00000200u
+#define UART_UARTDR_FE_BITS     0x00000100u
+#define UART_UARTFR_TXFF_BITS   0x00000020u
+#define UART_UARTFR_RXFE_BITS   0x00000010u
+#define UART_UARTIMSC_RTIM_BITS 0x00000040u
+#define UART_UARTIMSC_TXIM_BITS 0x00000020u
+#define UART_UARTIMSC_RXIM_BITS 0x00000010u
+#define UART_UARTMIS_RTMIS_BITS 0x00000040u
+#define UART_UARTMIS_TXMIS_BITS 0x00000020u
+#define UART_UARTMIS_RXMIS_BITS 0x00000010u
+
+static inline uart_hw_t *uart_get_hw(uart_inst_t *uart) {
+  return (uart_hw_t *)uart;
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+bool uart_is_enabled(uart_inst_t *uart);
+static inline void uart_set_hw_flow(uart_inst_t *, bool, bool) {}
+static inline void uart_set_format(uart_inst_t *, uint, uint, uart_parity_t) {}
+static inline void uart_set_fifo_enabled(uart_inst_t *, bool) {}
+
+// hardware/address_mapped.h; запись в IMSC может сразу поднять прерывание
+void hw_set_bits(volatile uint32_t *addr, uint32_t mask);
+void hw_clear_bits(volatile uint32_t *addr, uint32_t mask);
@@ -0,0 +1,11 @@
+#pragma once
+
+// Куча хоста к RP2040 отношения не имеет: MEM в симуляторе — нули
+struct mallinfo {
+  int arena, ordblks, smblks, hblks, hblkhd, usmblks, fsmblks, uordblks, fordblks, keepcost;
+};
+
+static inline struct mallinfo mallinfo() {
+  struct mallinfo mi = {};
+  return mi;
+}
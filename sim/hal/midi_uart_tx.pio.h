@@ -0,0 +1,16 @@
+#pragma once
+#include "hardware/pio.h"
+
+// Вместо вывода pioasm для midi_uart_tx.pio: та же функция
+// инициализации, SM симулятора — столбцы бит на выводах pin_mask
+
+static const uint16_t midi_multi_tx_program_instructions[] = {0};
+
+static const struct pio_program midi_multi_tx_program = {
+  midi_multi_tx_program_instructions, 1, -1
+};
+
+static inline void midi_multi_tx_program_init(PIO pio, uint sm, uint, uint pin_base,
+                                              uint32_t pin_mask, uint baud) {
+  sim_pio_sm_init(pio, sm, pin_base, pin_mask, baud, 8);   // PIO_FIFO_JOIN_TX — 8 слов
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+
+// ======================================================
+// Управление симулятором: виртуальные часы и транспорты
+// ======================================================
+// Всё однопоточно и детерминировано: время идёт только через
+// sim_advance(), прерывания вызываются, когда их условие выполнено
+// (запись байта, освобождение FIFO, включение источника), и никогда
+// внутри save_and_disable_interrupts().
+//
+// Выходы отдаются колбэку: DIN и TRS — по байту в момент, когда он
+// целиком ушёл в линию (конец стоп-бита), USB — пакетом из 4 байт
+// в момент, когда его забрал хост.
+
+#define SIM_SINK_USB 0   // как индексы DEST_*: 0 — USB, 1 — DIN, 2–11 — TRS A–J
+#define SIM_SINK_DIN 1
+
+typedef void (*SimWireFn)(uint8_t sink, const uint8_t *data, uint8_t len, uint64_t t);
+typedef void (*SimCoreFn)();
+
+void sim_reset();
+uint64_t sim_now();
+
+/**
+ * @brief Продвинуть часы до t, по пути отработав линии и прерывания
+ */
+void sim_advance(uint64_t t);
+
+void sim_set_wire(SimWireFn fn);
+
+/**
+ * @brief Проход другого ядра — его зовёт tight_loop_contents()
+ *        (ядро, которое ждёт, даёт поработать второму)
+ */
+void sim_set_other_core(SimCoreFn fn);
+
+// --- MIDI IN (UART1 RX): байт приходит в линию целиком к моменту t ---
+void sim_uart_rx(uint8_t b, uint64_t t);
+
+// --- USB-MIDI от хоста: пакет 4 байта (кабель << 4 | CIN, 3 байта) ---
+void sim_usb_host_packet(const uint8_t pkt[4]);
+void sim_usb_set_mounted(bool on);
+void sim_usb_set_poll(uint32_t us);   // как часто хост забирает IN (по умолчанию 1 мс)
+
+// --- Клавиатура за моделью CH376S (SPI0, INT# на GP7) ---
+// После sim_reset() подключена boot-клавиатура; драйвер (ch376s.cpp)
+// находит её как на плате: сброс шины, дескрипторы, IN-токены.
+// maxPacket больше 8 — клавиатура NKRO (отчёт битовой картой).
+void sim_kbd_plug(bool on, uint8_t maxPacket = 8);
+// отчёт HID: уйдёт в ответ на IN-токен драйвера (очередь в модели)
+void sim_hid_report(const uint8_t *report, uint8_t len);
+// следующий спад INT# не защёлкнется в IRQ (потерянный фронт)
+void sim_kbd_lose_edge();
+// свой дескриптор отчёта клавиатуры (nullptr — обычный), со следующего подключения
+void sim_kbd_report_desc(const uint8_t *desc, uint16_t len);
+uint8_t sim_kbd_protocol();           // 0 — драйвер перевёл клавиатуру в boot protocol
+
+// --- WebSerial: строка команды (с \n) во входной буфер Serial ---
+void sim_serial_input(const char *line);
+void sim_serial_set_echo(bool on);    // false — вывод прошивки не печатать
+
+// ======================================================
+// Прошивка целиком (sim_main.cpp) — для сценария и тестов
+// ======================================================
+// setup() и setup1() без тестового аккорда; дальше проходы core1
+// (каждые -p мкс) и core0 (раз в 1 мс), как loop1() и loop()
+void sim_firmware_setup();
+void sim_run_until(uint64_t t);
+
+// ======================================================
+// Для моделей устройств (sim_ch376s.cpp)
+// ======================================================
+typedef void (*SimPinFn)(uint8_t pin, bool level);
+void sim_gpio_on_output(SimPinFn fn);   // прошивка сменила уровень выхода (gpio_put)
+// устройство ведёт вход; edge = false — перепад без защёлки фронта
+void sim_gpio_drive(uint8_t pin, bool level, bool edge = true);
+void sim_ch376s_reset();                // из sim_reset()
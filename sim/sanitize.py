@@ -0,0 +1,5 @@
+# Санитайзеры для env:native_asan: флаги нужны и компилятору, и компоновщику
+Import("env")
+
+flags = ["-fsanitize=address,undefined", "-fno-omit-frame-pointer"]
+env.Append(CCFLAGS=flags, LINKFLAGS=flags)
@@ -0,0 +1,150 @@
+#include "sim_hal.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdarg.h>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+
+// ======================================================
+// Print / Stream
+// ======================================================
+size_t Print::write(const uint8_t *buf, size_t n) {
+  size_t k = 0;
+  while (n--) k += write(*buf++);
+  return k;
+}
+
+int Print::printf(const char *fmt, ...) {
+  char small[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(small, sizeof(small), fmt, ap);
+  va_end(ap);
+  if (n < 0) return n;
+  if ((size_t)n < sizeof(small)) return (int)write((const uint8_t *)small, n);
+
+  std::string big(n + 1, '\0');
+  va_start(ap, fmt);
+  vsnprintf(&big[0], big.size(), fmt, ap);
+  va_end(ap);
+  return (int)write((const uint8_t *)big.data(), n);
+}
+
+size_t Stream::readBytes(char *buf, size_t n) {
+  size_t k = 0;
+  for (int c; k < n && (c = read()) >= 0; k++) buf[k] = (char)c;
+  return k;
+}
+
+// ======================================================
+// Serial: вывод прошивки → stdout, ввод — от сценария
+// ======================================================
+SimSerial Serial;
+RP2040 rp2040;
+
+// такт — реальное время хоста: BENCH меряет код прошивки, а не часы сценария
+uint32_t RP2040::getCycleCount() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+
+static std::string serialIn;
+static size_t serialPos = 0;
+static bool serialEcho = true;
+
+void sim_serial_input(const char *line) {
+  if (serialPos == serialIn.size()) {
+    serialIn.clear();
+    serialPos = 0;
+  }
+  serialIn += line;
+}
+
+void sim_serial_set_echo(bool on) { serialEcho = on; }
+
+size_t SimSerial::write(uint8_t c) {
+  if (serialEcho) fputc(c, stdout);
+  return 1;
+}
+
+size_t SimSerial::write(const uint8_t *buf, size_t n) {
+  if (serialEcho) fwrite(buf, 1, n, stdout);
+  return n;
+}
+
+int SimSerial::available() {
+  return (int)(serialIn.size() - serialPos);
+}
+
+int SimSerial::read() {
+  return serialPos < serialIn.size() ? (uint8_t)serialIn[serialPos++] : -1;
+}
+
+// ======================================================
+// LittleFS → каталог хоста
+// ======================================================
+FS LittleFS;
+static std::string fsRoot = ".pio/sim_fs";
+
+void sim_fs_set_root(const char *dir) { fsRoot = dir; }
+
+static std::string host_path(const char *path) {
+  return fsRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+bool FS::begin() {
+  // как mkdir -p: LittleFS на пустой flash тоже просто форматируется
+  for (size_t i = 1; i <= fsRoot.size(); i++)
+    if (i == fsRoot.size() || fsRoot[i] == '/') mkdir(fsRoot.substr(0, i).c_str(), 0755);
+  struct stat st;
+  return stat(fsRoot.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FS::exists(const char *path) {
+  struct stat st;
+  return stat(host_path(path).c_str(), &st) == 0;
+}
+
+File FS::open(const char *path, const char *mode) {
+  const char *m = (mode[0] == 'w') ? "wb" : (mode[0] == 'a') ? "ab" : "rb";
+  FILE *f = fopen(host_path(path).c_str(), m);
+  return f ? File(f) : File();
+}
+
+bool FS::remove(const char *path) {
+  return ::remove(host_path(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+size_t File::write(uint8_t c) {
+  return f_ && fputc(c, f_.get()) != EOF ? 1 : 0;
+}
+
+size_t File::write(const uint8_t *buf, size_t n) {
+  return f_ ? fwrite(buf, 1, n, f_.get()) : 0;
+}
+
+int File::read() {
+  return f_ ? fgetc(f_.get()) : -1;
+}
+
+int File::read(uint8_t *buf, size_t n) {
+  return f_ ? (int)fread(buf, 1, n, f_.get()) : -1;
+}
+
+int File::available() {
+  if (!f_) return 0;
+  long pos = ftell(f_.get());
+  return (int)(size() - (size_t)pos);
+}
+
+size_t File::size() {
+  if (!f_) return 0;
+  struct stat st;
+  return fstat(fileno(f_.get()), &st) == 0 ? (size_t)st.st_size : 0;
+}
@@ -0,0 +1,395 @@
+#include "sim_hal.h"
+#include <Arduino.h>
+#include "hardware/spi.h"
+#include <deque>
+#include <vector>
+
+// ======================================================
+// Модель CH376S (SPI0, CS# GP1, INT# GP7) и клавиатура за ним
+// ======================================================
+// Ровно то, чем пользуется ch376s.cpp: команды по SPI, статус
+// прерывания, буфер данных на 64 байта, управляющие передачи на EP0
+// и IN-токены на interrupt-эндпоинт клавиатуры. Чип отвечает сразу,
+// без хода часов; IN без отчёта — NAK, пока сценарий не даст отчёт
+// (SET_RETRY 0x83: повторы делает сам чип, INT# — только с данными).
+// INT# держится низким, пока прошивка не прочтёт статус.
+
+#define CH_CS_PIN  1
+#define CH_INT_PIN 7
+
+#define CMD_RESET_ALL     0x05
+#define CMD_CHECK_EXIST   0x06
+#define CMD_SET_RETRY     0x0B
+#define CMD_SET_USB_MODE  0x15
+#define CMD_GET_STATUS    0x22
+#define CMD_RD_USB_DATA0  0x27
+#define CMD_WR_HOST_DATA  0x2C
+#define CMD_GET_DESCR     0x46
+#define CMD_AUTO_SETUP    0x4D
+#define CMD_ISSUE_TKN_X   0x4E
+
+#define CMD_RET_SUCCESS     0x51
+#define USB_INT_SUCCESS     0x14
+#define USB_INT_CONNECT     0x15
+#define USB_INT_DISCONNECT  0x16
+#define USB_INT_STALL       0x2E   // 0x20 | PID STALL
+
+#define USB_PID_OUT   0x01
+#define USB_PID_IN    0x09
+#define USB_PID_SETUP 0x0D
+
+#define KBD_EP        1
+#define KBD_IFACE     2     // мышь (0) и vendor (1) впереди: дескриптор > 64 байт
+#define EP0_SIZE      8
+
+// --- Клавиатура ---
+struct SimKeyboard {
+  bool plugged = true;
+  uint8_t maxPacket = 8;
+  uint8_t protocol = 1;   // 0 — boot, 1 — report (после сброса)
+  std::vector<uint8_t> device, config, report;   // дескрипторы
+  std::vector<uint8_t> custom;                   // свой дескриптор отчёта (тест)
+  std::deque<std::vector<uint8_t>> reports;      // ждут IN-токена
+  bool loseEdge = false;
+};
+
+// --- Чип ---
+struct SimChip {
+  bool selected;        // CS# опущен
+  bool inCmd;           // после спада CS# ждём код команды
+  uint8_t cmd;
+  uint8_t argc;         // принято байт параметров
+  uint8_t args[2];
+  uint8_t rdPos;        // RD_USB_DATA0: 0 — длина, дальше данные
+  bool host;            // режим хоста (SET_USB_MODE 6/7)
+  bool announced;       // CONNECT этого подключения уже выдан
+  uint8_t status;       // статус прерывания (GET_STATUS)
+  bool irq;             // INT# опущен
+  bool deferred;        // INT# опустится, когда поднимут CS#
+  uint8_t buf[64];      // данные для RD_USB_DATA0
+  uint8_t len;
+  uint8_t hostData[64]; // WR_HOST_DATA
+  uint8_t hostLen;
+  bool inPending;       // IN на клавиатуру ждёт отчёта (NAK)
+  std::vector<uint8_t> ctrl;   // IN-стадия управляющей передачи
+  size_t ctrlPos;
+};
+
+static SimKeyboard kbd;
+static SimChip chip;
+
+// ======================================================
+// Дескрипторы
+// ======================================================
+static const uint8_t bootReportDesc[] = {
+  0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,               // Generic Desktop / Keyboard
+  0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00,   // модификаторы E0–E7
+  0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+  0x95, 0x01, 0x75, 0x08, 0x81, 0x01,               // резерв
+  0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01,   // светодиоды (OUT)
+  0x29, 0x05, 0x91, 0x02, 0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+  0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65,   // 6 кодов клавиш
+  0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+  0xC0
+};
+
+// NKRO: байт модификаторов и битовая карта кодов 0…(maxPacket-1)*8-1
+static std::vector<uint8_t> nkro_report_desc(uint8_t maxPacket) {
+  uint16_t bits = (uint16_t)((maxPacket - 1) * 8);
+  if (bits > 256) bits = 256;
+  std::vector<uint8_t> d = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00,
+    0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x19, 0x00, 0x2A, (uint8_t)(bits - 1), (uint8_t)((bits - 1) >> 8),
+    0x75, 0x01, 0x96, (uint8_t)bits, (uint8_t)(bits >> 8), 0x81, 0x02,
+    0xC0
+  };
+  return d;
+}
+
+static const uint8_t mouseReportDesc[] = {
+  0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+  0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01,
+  0x95, 0x03, 0x75, 0x01, 0x81, 0x02, 0x95, 0x01, 0x75, 0x05, 0x81, 0x01,
+  0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F,
+  0x75, 0x08, 0x95, 0x02, 0x81, 0x06, 0xC0, 0xC0
+};
+
+static void build_descriptors() {
+  bool boot = kbd.maxPacket <= 8;
+  if (!kbd.custom.empty()) kbd.report = kbd.custom;
+  else if (boot) kbd.report.assign(bootReportDesc, bootReportDesc + sizeof(bootReportDesc));
+  else kbd.report = nkro_report_desc(kbd.maxPacket);
+  kbd.device = {18, 0x01, 0x10, 0x01, 0, 0, 0, EP0_SIZE, 0x34, 0x12, 0x78, 0x56, 0, 1, 1, 2, 0, 1};
+  uint16_t rl = (uint16_t)kbd.report.size();
+  kbd.config = {
+    9, 0x02, 96, 0, 3, 1, 0, 0xA0, 50,                         // конфигурация, 3 интерфейса
+    9, 0x04, 0, 0, 1, 0x03, 1, 2, 0,                           // мышь (boot)
+    9, 0x21, 0x11, 0x01, 0, 1, 0x22, sizeof(mouseReportDesc), 0,
+    7, 0x05, 0x82, 0x03, 4, 0, 10,
+    9, 0x04, 1, 0, 4, 0xFF, 0, 0, 0,                           // vendor: 4 bulk
+    7, 0x05, 0x03, 0x02, 64, 0, 0,
+    7, 0x05, 0x83, 0x02, 64, 0, 0,
+    7, 0x05, 0x04, 0x02, 64, 0, 0,
+    7, 0x05, 0x84, 0x02, 64, 0, 0,
+    9, 0x04, KBD_IFACE, 0, 1, 0x03, (uint8_t)(boot ? 1 : 0), 1, 0,   // клавиатура
+    9, 0x21, 0x11, 0x01, 0, 1, 0x22, (uint8_t)rl, (uint8_t)(rl >> 8),
+    7, 0x05, 0x80 | KBD_EP, 0x03, kbd.maxPacket, 0, 10         // interrupt IN
+  };
+}
+
+// ======================================================
+// INT#
+// ======================================================
+// Команда завершается после подъёма CS#: до этого INT# не трогаем
+static void int_raise(uint8_t status) {
+  chip.status = status;
+  if (chip.selected) {
+    chip.deferred = true;
+    return;
+  }
+  if (chip.irq) return;
+  chip.irq = true;
+  sim_gpio_drive(CH_INT_PIN, false, !kbd.loseEdge);
+  kbd.loseEdge = false;
+}
+
+static void int_clear() {
+  chip.irq = false;
+  sim_gpio_drive(CH_INT_PIN, true);
+}
+
+// IN на клавиатуру: отчёт из очереди, если он есть и статус прочитан
+static void in_complete() {
+  if (!chip.inPending || chip.irq || kbd.reports.empty()) return;
+  const std::vector<uint8_t> &r = kbd.reports.front();
+  chip.len = (uint8_t)std::min<size_t>(r.size(), kbd.maxPacket);
+  memcpy(chip.buf, r.data(), chip.len);
+  kbd.reports.pop_front();
+  chip.inPending = false;
+  int_raise(USB_INT_SUCCESS);
+}
+
+// ======================================================
+// USB: управляющие передачи и токены
+// ======================================================
+static const std::vector<uint8_t> mouseDesc(mouseReportDesc, mouseReportDesc + sizeof(mouseReportDesc));
+
+static bool setup_request(const uint8_t *p) {
+  uint8_t type = p[0], req = p[1];
+  uint16_t value = (uint16_t)(p[2] | p[3] << 8);
+  uint16_t length = (uint16_t)(p[6] | p[7] << 8);
+  chip.ctrl.clear();
+  chip.ctrlPos = 0;
+
+  if ((type == 0x80 || type == 0x81) && req == 0x06) {        // GET_DESCRIPTOR
+    const std::vector<uint8_t> *d = nullptr;
+    switch (value >> 8) {
+      case 0x01: d = &kbd.device; break;
+      case 0x02: d = &kbd.config; break;
+      case 0x22:
+        if (p[4] == KBD_IFACE) d = &kbd.report;
+        else if (p[4] == 0) d = &mouseDesc;
+        break;
+    }
+    if (!d) return false;
+    chip.ctrl.assign(d->begin(), d->begin() + std::min<size_t>(d->size(), length));
+    return true;
+  }
+  if (type == 0x21 && req == 0x0B) {                          // SET_PROTOCOL
+    if (p[4] == KBD_IFACE) kbd.protocol = (uint8_t)value;
+    return true;
+  }
+  return (type == 0x21 && req == 0x0A) || (type == 0x00 && req == 0x09);   // SET_IDLE, SET_CONFIGURATION
+}
+
+static void token(uint8_t epPid) {
+  uint8_t ep = epPid >> 4, pid = epPid & 0x0F;
+  chip.len = 0;
+  if (!kbd.plugged) {
+    int_raise(USB_INT_DISCONNECT);
+    return;
+  }
+  if (ep == 0) {
+    if (pid == USB_PID_SETUP) {
+      int_raise(chip.hostLen == 8 && setup_request(chip.hostData) ? USB_INT_SUCCESS : USB_INT_STALL);
+    } else if (pid == USB_PID_IN) {
+      chip.len = (uint8_t)std::min<size_t>(EP0_SIZE, chip.ctrl.size() - chip.ctrlPos);
+      memcpy(chip.buf, chip.ctrl.data() + chip.ctrlPos, chip.len);
+      chip.ctrlPos += chip.len;
+      int_raise(USB_INT_SUCCESS);
+    } else {
+      int_raise(USB_INT_SUCCESS);   // OUT: статус-стадия
+    }
+    return;
+  }
+  if (ep == KBD_EP && pid == USB_PID_IN) {
+    chip.inPending = true;
+    in_complete();
+    return;
+  }
+  int_raise(USB_INT_STALL);
+}
+
+// Дескриптор через CMD_GET_DESCR: в буфер чипа — не больше 64 байт
+static void get_descr(uint8_t type) {
+  const std::vector<uint8_t> &d = (type == 1) ? kbd.device : kbd.config;
+  if (!kbd.plugged || type < 1 || type > 2) {
+    int_raise(USB_INT_STALL);
+    return;
+  }
+  chip.len = (uint8_t)std::min<size_t>(d.size(), sizeof(chip.buf));
+  memcpy(chip.buf, d.data(), chip.len);
+  int_raise(USB_INT_SUCCESS);
+}
+
+// ======================================================
+// SPI: код команды после спада CS#, затем параметры или ответ
+// ======================================================
+static void chip_reset() {
+  std::vector<uint8_t> ctrl;
+  chip.ctrl.swap(ctrl);
+  chip = SimChip{};
+  int_clear();
+}
+
+static void command_start() {
+  switch (chip.cmd) {
+    case CMD_RESET_ALL: chip_reset(); break;
+    case CMD_AUTO_SETUP: int_raise(kbd.plugged ? USB_INT_SUCCESS : USB_INT_DISCONNECT); break;
+    case CMD_GET_STATUS: break;
+    case CMD_RD_USB_DATA0: chip.rdPos = 0; break;
+    case CMD_WR_HOST_DATA: chip.hostLen = 0; break;
+  }
+}
+
+static void set_mode(uint8_t mode) {
+  chip.host = (mode == 0x06 || mode == 0x07);
+  if (mode == 0x06 && kbd.plugged && !chip.announced) {
+    chip.announced = true;
+    int_raise(USB_INT_CONNECT);
+  }
+}
+
+static uint8_t xfer(uint8_t mosi) {
+  if (chip.inCmd) {
+    chip.inCmd = false;
+    chip.cmd = mosi;
+    chip.argc = 0;
+    command_start();
+    return 0xFF;
+  }
+
+  switch (chip.cmd) {
+    case CMD_CHECK_EXIST:
+      if (chip.argc++ == 0) chip.args[0] = mosi;
+      else return (uint8_t)~chip.args[0];
+      break;
+    case CMD_SET_USB_MODE:
+      if (chip.argc++ == 0) set_mode(mosi);
+      else return CMD_RET_SUCCESS;
+      break;
+    case CMD_GET_STATUS: {
+      uint8_t s = chip.status;
+      int_clear();
+      return s;
+    }
+    case CMD_RD_USB_DATA0: {
+      uint8_t pos = chip.rdPos++;
+      if (pos == 0) return chip.len;
+      return (pos <= chip.len) ? chip.buf[pos - 1] : 0xFF;
+    }
+    case CMD_WR_HOST_DATA:
+      if (chip.argc++ == 0) chip.args[0] = mosi;
+      else if (chip.hostLen < chip.args[0] && chip.hostLen < sizeof(chip.hostData))
+        chip.hostData[chip.hostLen++] = mosi;
+      break;
+    case CMD_GET_DESCR:
+      if (chip.argc++ == 0) get_descr(mosi);
+      break;
+    case CMD_ISSUE_TKN_X:
+      if (chip.argc < 2) chip.args[chip.argc++] = mosi;
+      if (chip.argc == 2) {
+        chip.argc++;
+        token(chip.args[1]);
+      }
+      break;
+  }
+  return 0xFF;
+}
+
+static void on_pin(uint8_t pin, bool level) {
+  if (pin != CH_CS_PIN) return;
+  chip.selected = !level;
+  chip.inCmd = !level;
+  if (level && chip.deferred) {
+    chip.deferred = false;
+    int_raise(chip.status);
+  }
+}
+
+struct spi_inst {};
+static spi_inst simSpi0;
+spi_inst_t *const sim_spi0 = &simSpi0;
+
+int spi_write_blocking(spi_inst_t *, const uint8_t *src, size_t len) {
+  for (size_t i = 0; i < len; i++) xfer(src[i]);
+  return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+  for (size_t i = 0; i < len; i++) dst[i] = xfer(repeated_tx_data);
+  return (int)len;
+}
+
+// ======================================================
+// Сценарий
+// ======================================================
+void sim_ch376s_reset() {
+  kbd = SimKeyboard{};
+  build_descriptors();
+  chip_reset();
+  sim_gpio_on_output(on_pin);
+}
+
+void sim_kbd_plug(bool on, uint8_t maxPacket) {
+  if (on) {
+    if (kbd.plugged) sim_kbd_plug(false, 0);   // другая клавиатура — переподключение
+    kbd.plugged = true;
+    kbd.maxPacket = maxPacket ? maxPacket : 8;
+    kbd.protocol = 1;
+    build_descriptors();
+    if (chip.host && !chip.announced) {
+      chip.announced = true;
+      int_raise(USB_INT_CONNECT);
+    }
+    return;
+  }
+  kbd.plugged = false;
+  kbd.reports.clear();
+  chip.inPending = false;
+  if (chip.announced) {
+    chip.announced = false;
+    int_raise(USB_INT_DISCONNECT);
+  }
+}
+
+void sim_hid_report(const uint8_t *report, uint8_t len) {
+  if (!kbd.plugged) return;
+  kbd.reports.emplace_back(report, report + len);
+  in_complete();
+}
+
+void sim_kbd_report_desc(const uint8_t *desc, uint16_t len) {
+  kbd.custom.assign(desc, desc + (desc ? len : 0));
+  build_descriptors();
+}
+
+uint8_t sim_kbd_protocol() {
+  return kbd.protocol;
+}
+
+void sim_kbd_lose_edge() {
+  kbd.loseEdge = true;
+}
@@ -0,0 +1,631 @@
+#include "sim_hal.h"
+#include <Arduino.h>
+#include <Adafruit_TinyUSB.h>
+#include "hardware/pio.h"
+#include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/flash.h"
+#include "hardware/structs/usb.h"
+#include "hardware/gpio.h"
+#include <deque>
+#include <array>
+
+// ======================================================
+// Часы и ядра
+// ======================================================
+static uint64_t now = 0;
+static SimWireFn wireFn = nullptr;
+static SimCoreFn otherCore = nullptr;
+
+uint64_t sim_now() { return now; }
+uint64_t time_us_64() { return now; }
+uint32_t time_us_32() { return (uint32_t)now; }
+unsigned long millis() { return (unsigned long)(now / 1000); }
+unsigned long micros() { return (unsigned long)now; }
+
+void delay(unsigned long ms) { sim_advance(now + (uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned int us) { sim_advance(now + us); }
+
+void sim_set_wire(SimWireFn fn) { wireFn = fn; }
+void sim_set_other_core(SimCoreFn fn) { otherCore = fn; }
+
+void tight_loop_contents() {
+  if (otherCore) otherCore();
+}
+
+static inline void emit(uint8_t sink, const uint8_t *data, uint8_t len) {
+  if (wireFn) wireFn(sink, data, len, now);
+}
+
+// ======================================================
+// Прерывания: линии NVIC и обработчики
+// ======================================================
+#define SIM_IRQ_LINES   32
+#define SIM_IRQ_SHARED  4
+#define SIM_IRQ_SPIN    256   // вызовов подряд, после которых линия считается "залипшей"
+
+struct IrqLine {
+  irq_handler_t handlers[SIM_IRQ_SHARED];
+  uint8_t count;
+  bool enabled;
+};
+static IrqLine irqLines[SIM_IRQ_LINES];
+static uint32_t irqMasked = 0;   // PRIMASK: 1 — прерывания запрещены
+static bool inIrq = false;       // обработчики не вложены (один приоритет)
+
+static bool irq_asserted(unsigned num);
+
+// Вызвать обработчики всех поднятых линий, пока они не опустятся
+static void irq_poll() {
+  if (irqMasked || inIrq) return;
+  inIrq = true;
+  for (int spin = 0; spin < SIM_IRQ_SPIN; spin++) {
+    bool any = false;
+    for (unsigned num = 0; num < SIM_IRQ_LINES; num++) {
+      IrqLine &l = irqLines[num];
+      if (!l.enabled || !l.count || !irq_asserted(num)) continue;
+      for (uint8_t i = 0; i < l.count; i++) l.handlers[i]();
+      any = true;
+    }
+    if (!any) {
+      inIrq = false;
+      return;
+    }
+  }
+  fprintf(stderr, "[SIM] ⚠️ IRQ stuck: handler does not clear its source\n");
+  inIrq = false;
+}
+
+void irq_set_exclusive_handler(unsigned num, irq_handler_t handler) {
+  irqLines[num].handlers[0] = handler;
+  irqLines[num].count = 1;
+}
+
+void irq_add_shared_handler(unsigned num, irq_handler_t handler, uint8_t) {
+  IrqLine &l = irqLines[num];
+  if (l.count < SIM_IRQ_SHARED) l.handlers[l.count++] = handler;
+}
+
+void irq_set_enabled(unsigned num, bool enabled) {
+  irqLines[num].enabled = enabled;
+  irq_poll();
+}
+
+uint32_t save_and_disable_interrupts() {
+  uint32_t s = irqMasked;
+  irqMasked = 1;
+  return s;
+}
+
+void restore_interrupts(uint32_t status) {
+  irqMasked = status;
+  irq_poll();
+}
+
+void noInterrupts() { irqMasked = 1; }
+void interrupts() { restore_interrupts(0); }
+
+void hw_set_bits(volatile uint32_t *addr, uint32_t mask) {
+  *addr |= mask;
+  irq_poll();
+}
+
+void hw_clear_bits(volatile uint32_t *addr, uint32_t mask) {
+  *addr &= ~mask;
+}
+
+// ======================================================
+// UART: защёлки приёма и передачи + сдвиговый регистр TX
+// ======================================================
+#define SIM_NEVER UINT64_MAX
+
+struct SimUart {
+  bool enabled;
+  uint32_t byteUs;          // 10 бит (8N1) при заданной скорости
+  bool rxFull;
+  uint32_t rx;              // байт + флаги ошибок (как DR)
+  bool rxOverrun;           // пока защёлка была полна, пришёл байт
+  std::deque<std::pair<uint64_t, uint8_t>> rxLine;   // байты в линии: конец стоп-бита
+  bool holdFull;
+  uint8_t hold;
+  bool busy;
+  uint8_t shift;
+  uint64_t shiftEnd;
+};
+static SimUart uarts[2];
+uart_hw_t sim_uart_hw[2];
+
+static inline int uart_index(const void *reg) {
+  return (const uint8_t *)reg >= (const uint8_t *)&sim_uart_hw[1] ? 1 : 0;
+}
+
+static inline uint8_t uart_sink(int i) {
+  return i == 1 ? SIM_SINK_DIN : 0xFF;   // UART0 в прошивке не используется
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+  SimUart &u = uarts[uart_index(uart)];
+  u.enabled = true;
+  u.byteUs = 10000000u / baudrate;
+  return baudrate;
+}
+
+bool uart_is_enabled(uart_inst_t *uart) {
+  return uarts[uart_index(uart)].enabled;
+}
+
+static void uart_tx(SimUart &u, uint8_t b) {
+  if (!u.busy) {
+    u.busy = true;
+    u.shift = b;
+    u.shiftEnd = now + u.byteUs;
+  } else if (!u.holdFull) {
+    u.hold = b;
+    u.holdFull = true;
+  }
+  // защёлка полна — байт теряется, как у PL011 без FIFO
+}
+
+SimUartReg::operator uint32_t() const {
+  int i = uart_index(this);
+  SimUart &u = uarts[i];
+  const uart_hw_t &hw = sim_uart_hw[i];
+
+  if (this == &hw.dr) {
+    if (!u.rxFull) return 0;
+    u.rxFull = false;
+    return u.rx;
+  }
+  if (this == &hw.fr)
+    return (u.rxFull ? 0 : UART_UARTFR_RXFE_BITS) | (u.holdFull ? UART_UARTFR_TXFF_BITS : 0);
+
+  uint32_t ris = (u.rxFull ? UART_UARTMIS_RXMIS_BITS : 0) | (u.holdFull ? 0 : UART_UARTMIS_TXMIS_BITS);
+  return (this == &hw.mis) ? (ris & hw.imsc) : ris;
+}
+
+SimUartReg &SimUartReg::operator=(uint32_t v) {
+  int i = uart_index(this);
+  if (this == &sim_uart_hw[i].dr) uart_tx(uarts[i], (uint8_t)v);
+  return *this;
+}
+
+void sim_uart_rx(uint8_t b, uint64_t t) {
+  SimUart &u = uarts[1];
+  if (!u.rxLine.empty() && t < u.rxLine.back().first) t = u.rxLine.back().first;
+  if (t < now) t = now;
+  u.rxLine.push_back({t, b});
+}
+
+static uint64_t uart_next(const SimUart &u) {
+  uint64_t t = u.busy ? u.shiftEnd : SIM_NEVER;
+  if (!u.rxLine.empty() && u.rxLine.front().first < t) t = u.rxLine.front().first;
+  return t;
+}
+
+static void uart_step(int i) {
+  SimUart &u = uarts[i];
+  while (!u.rxLine.empty() && u.rxLine.front().first == now) {
+    if (u.rxFull) {
+      u.rxOverrun = true;
+    } else {
+      u.rx = u.rxLine.front().second | (u.rxOverrun ? UART_UARTDR_OE_BITS : 0);
+      u.rxOverrun = false;
+      u.rxFull = true;
+    }
+    u.rxLine.pop_front();
+  }
+  if (u.busy && u.shiftEnd == now) {
+    emit(uart_sink(i), &u.shift, 1);
+    if (u.holdFull) {
+      u.shift = u.hold;
+      u.holdFull = false;
+      u.shiftEnd = now + u.byteUs;
+    } else {
+      u.busy = false;
+    }
+  }
+}
+
+static bool uart_asserted(int i) {
+  uint32_t ris = (uarts[i].rxFull ? UART_UARTMIS_RXMIS_BITS : 0)
+               | (uarts[i].holdFull ? 0 : UART_UARTMIS_TXMIS_BITS);
+  return ris & sim_uart_hw[i].imsc;
+}
+
+// ======================================================
+// PIO: state machine — столбцы бит на выводах (midi_multi_tx)
+// ======================================================
+// Слово из TX FIFO держится на выводах один бит линии. На выводах TRS
+// стоят приёмники 8N1, как у подключённых устройств: байт выдаётся в
+// конце стоп-бита. FIFO опустел посреди байта — на железе SM стоит,
+// бит растягивается и кадр портится: предупреждение.
+// Выводы TRS A–J — как midi_tx_pins в midi_output.cpp
+static const uint trsPins[10] = {6, 8, 10, 12, 14, 16, 18, 20, 22, 26};
+
+struct SimSm {
+  uint32_t pinBase;
+  uint32_t pinMask;         // выводы SM относительно базы
+  uint32_t bitUs;
+  uint8_t depth;            // 4, с PIO_FIFO_JOIN_TX — 8
+  uint32_t fifo[8];
+  uint8_t head, level;
+  bool busy;
+  uint32_t col;             // столбец на выводах
+  uint64_t colEnd;
+  int8_t rxBit[10];         // приёмник TRS: -1 — ждёт старт, 0–7 — бит данных, 8 — стоп
+  uint8_t rxByte[10];
+  bool underrun;            // предупреждение уже было
+};
+
+struct pio_hw {
+  SimSm sm[SIM_PIO_SM_MAX];
+  uint8_t claimed;          // выдано SM
+  uint32_t inte0;           // биты pio_interrupt_source
+};
+pio_hw_t sim_pio0, sim_pio1;
+
+uint pio_add_program(PIO, const pio_program_t *) {
+  return 0;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+  if (pio->claimed >= SIM_PIO_SM_MAX || (pio->claimed >= 4 && !required)) return -1;
+  if (pio->claimed == 4)
+    fprintf(stderr, "[SIM] ⚠️ pio%d: state machine #5 — RP2040 has 4 per block, "
+                    "pio_claim_unused_sm() panics on hardware\n", pio == pio0 ? 0 : 1);
+  return pio->claimed++;
+}
+
+void sim_pio_sm_init(PIO pio, uint sm, uint pinBase, uint32_t pinMask, uint baud, uint fifoDepth) {
+  SimSm &s = pio->sm[sm];
+  s = SimSm{};
+  s.pinBase = pinBase;
+  s.pinMask = pinMask;
+  s.bitUs = 1000000u / baud;
+  s.depth = fifoDepth;
+  for (int8_t &b : s.rxBit) b = -1;
+}
+
+static void sm_start(SimSm &s) {
+  if (s.busy || !s.level) return;
+  s.col = s.fifo[s.head];
+  s.head = (s.head + 1) % s.depth;
+  s.level--;
+  s.busy = true;
+  s.colEnd = now + s.bitUs;
+}
+
+// Столбец отстоял бит: приёмники TRS сэмплируют линию
+static void sm_sample(PIO pio, SimSm &s) {
+  bool midByte = false;
+  for (uint8_t i = 0; i < 10; i++) {
+    uint32_t off = trsPins[i] - s.pinBase;
+    if (trsPins[i] < s.pinBase || off >= 32 || !(s.pinMask & (1u << off))) continue;
+    bool bit = (s.col >> off) & 1;
+    int8_t &st = s.rxBit[i];
+    if (st < 0) {
+      if (!bit) {                       // старт-бит
+        st = 0;
+        s.rxByte[i] = 0;
+      }
+    } else if (st < 8) {
+      s.rxByte[i] |= (uint8_t)bit << st;
+      st++;
+    } else {
+      if (bit) emit(2 + i, &s.rxByte[i], 1);
+      else fprintf(stderr, "[SIM] ⚠️ TRS %c: framing error (stop bit 0)\n", 'A' + i);
+      st = -1;
+    }
+    midByte |= st >= 0;
+  }
+  if (midByte && !s.level && !s.underrun) {
+    s.underrun = true;
+    fprintf(stderr, "[SIM] ⚠️ pio%d: TX FIFO empty mid-frame — on hardware the bit stretches\n",
+            pio == pio0 ? 0 : 1);
+  }
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+  SimSm &s = pio->sm[sm];
+  if (s.level == s.depth) return;   // переполнение FIFO — слово теряется (TXOVER)
+  s.fifo[(s.head + s.level) % s.depth] = data;
+  s.level++;
+  sm_start(s);
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) {
+  return pio->sm[sm].level == pio->sm[sm].depth;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) {
+  return pio->sm[sm].level;
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+  if (enabled) pio->inte0 |= 1u << source;
+  else         pio->inte0 &= ~(1u << source);
+  irq_poll();
+}
+
+static bool pio_asserted(const pio_hw_t &pio) {
+  for (uint8_t sm = 0; sm < pio.claimed; sm++)
+    if ((pio.inte0 & (1u << (pis_sm0_tx_fifo_not_full + sm))) && pio.sm[sm].level < pio.sm[sm].depth)
+      return true;
+  return false;
+}
+
+static uint64_t pio_next(const pio_hw_t &pio) {
+  uint64_t t = SIM_NEVER;
+  for (uint8_t sm = 0; sm < pio.claimed; sm++)
+    if (pio.sm[sm].busy && pio.sm[sm].colEnd < t) t = pio.sm[sm].colEnd;
+  return t;
+}
+
+static void pio_step(pio_hw_t &pio) {
+  for (uint8_t sm = 0; sm < pio.claimed; sm++) {
+    SimSm &s = pio.sm[sm];
+    if (!s.busy || s.colEnd != now) continue;
+    s.busy = false;
+    sm_sample(&pio, s);
+    sm_start(s);
+  }
+}
+
+// ======================================================
+// USB-MIDI: IN FIFO устройства и опрос хоста
+// ======================================================
+#define SIM_USB_FIFO_PACKETS 16   // 64 байта
+
+typedef std::array<uint8_t, 4> UsbPacket;
+static std::deque<UsbPacket> usbFromHost;
+static std::deque<UsbPacket> usbToHost;
+static bool usbMounted = true;
+static uint32_t usbPollUs = 1000;
+static uint64_t usbNextPoll = 0;
+Adafruit_USBD_Device TinyUSBDevice;
+usb_hw_t sim_usb_hw;
+
+bool tud_mounted() { return usbMounted; }
+bool Adafruit_USBD_Device::mounted() { return usbMounted; }
+void sim_usb_set_mounted(bool on) { usbMounted = on; }
+void sim_usb_set_poll(uint32_t us) { usbPollUs = us ? us : 1; }
+
+SimSofReg::operator uint32_t() const {
+  return (uint32_t)(now / 1000) & USB_SOF_RD_BITS;
+}
+
+bool Adafruit_USBD_MIDI::writePacket(const uint8_t packet[4]) {
+  if (!usbMounted || usbToHost.size() >= SIM_USB_FIFO_PACKETS) return false;
+  usbToHost.push_back({packet[0], packet[1], packet[2], packet[3]});
+  return true;
+}
+
+bool Adafruit_USBD_MIDI::readPacket(uint8_t packet[4]) {
+  if (usbFromHost.empty()) return false;
+  memcpy(packet, usbFromHost.front().data(), 4);
+  usbFromHost.pop_front();
+  return true;
+}
+
+void sim_usb_host_packet(const uint8_t pkt[4]) {
+  usbFromHost.push_back({pkt[0], pkt[1], pkt[2], pkt[3]});
+}
+
+static void usb_step() {
+  if (usbNextPoll != now) return;
+  for (const UsbPacket &p : usbToHost) emit(SIM_SINK_USB, p.data(), 4);
+  usbToHost.clear();
+  usbNextPoll = now + usbPollUs;
+}
+
+// ======================================================
+// GPIO: выводы SIO и прерывание по фронту (IO_IRQ_BANK0)
+// ======================================================
+#define SIM_GPIO_PINS 30
+
+static uint32_t gpioOut = 0;           // уровни, выставленные прошивкой
+static uint32_t gpioIn = ~0u;          // уровни от моделей устройств (подтяжка — 1)
+static uint32_t gpioEdges = 0;         // защёлкнутые фронты (INTR)
+static uint8_t gpioMode[SIM_GPIO_PINS];   // 0 — прерывание выключено, иначе CHANGE/FALLING/RISING
+static void (*gpioFn[SIM_GPIO_PINS])();
+static SimPinFn gpioOutFn = nullptr;
+
+void gpio_put(uint gpio, bool value) {
+  uint32_t bit = 1u << gpio;
+  if (!(gpioOut & bit) == !value) return;
+  gpioOut ^= bit;
+  if (gpioOutFn) gpioOutFn((uint8_t)gpio, value);
+}
+
+bool gpio_get(uint gpio) {
+  return (gpioIn >> gpio) & 1;
+}
+
+void sim_gpio_on_output(SimPinFn fn) { gpioOutFn = fn; }
+
+void sim_gpio_drive(uint8_t pin, bool level, bool edge) {
+  uint32_t bit = 1u << pin;
+  if (!(gpioIn & bit) == !level) return;
+  gpioIn ^= bit;
+  uint8_t m = gpioMode[pin];
+  if (!edge || !(m == CHANGE || (m == FALLING && !level) || (m == RISING && level))) return;
+  gpioEdges |= bit;
+  irq_poll();
+}
+
+// arduino-pico: фронт снимается до вызова обработчика
+static void gpio_irq() {
+  while (gpioEdges) {
+    uint8_t pin = (uint8_t)__builtin_ctz(gpioEdges);
+    gpioEdges &= ~(1u << pin);
+    if (gpioFn[pin]) gpioFn[pin]();
+  }
+}
+
+void attachInterrupt(int pin, void (*callback)(), int mode) {
+  gpioFn[pin] = callback;
+  gpioMode[pin] = (uint8_t)mode;
+  gpioEdges &= ~(1u << pin);   // старый фронт — не событие (gpio_set_irq_enabled)
+  irq_set_exclusive_handler(IO_IRQ_BANK0, gpio_irq);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void detachInterrupt(int pin) {
+  gpioMode[pin] = 0;
+  gpioFn[pin] = nullptr;
+  gpioEdges &= ~(1u << pin);
+}
+
+// ======================================================
+// Flash: NOR в RAM хоста
+// ======================================================
+alignas(FLASH_SECTOR_SIZE) uint8_t sim_flash[SIM_FLASH_SIZE];
+
+// Символы компоновщика arduino-pico: LittleFS — сразу за концом
+// массива (её роль играет каталог хоста), прошивка — первые 64 КБ
+static_assert(SIM_FLASH_SIZE == 0x200000, "keep the asm below in sync");
+__asm__(".globl _FS_start\n"
+        ".set _FS_start, sim_flash + 0x200000\n"
+        ".globl __flash_binary_end\n"
+        ".set __flash_binary_end, sim_flash + 0x10000\n");
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  if (flash_offs + count <= SIM_FLASH_SIZE) memset(sim_flash + flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+  if (flash_offs + count > SIM_FLASH_SIZE) return;
+  for (size_t i = 0; i < count; i++) sim_flash[flash_offs + i] &= data[i];
+}
+
+// ======================================================
+// Будильники таймера: колбэк — обработчик TIMER_IRQ_n
+// ======================================================
+#define SIM_ALARMS 4
+
+struct SimAlarm {
+  bool claimed;
+  bool armed;
+  bool fired;               // линия IRQ поднята, обработчик ещё не отработал
+  uint64_t target;
+  hardware_alarm_callback_t cb;
+};
+static SimAlarm alarms[SIM_ALARMS];
+
+template <unsigned N>
+static void alarm_irq() {
+  alarms[N].fired = false;
+  if (alarms[N].cb) alarms[N].cb(N);
+}
+static const irq_handler_t alarmIrqs[SIM_ALARMS] = {alarm_irq<0>, alarm_irq<1>, alarm_irq<2>, alarm_irq<3>};
+
+int hardware_alarm_claim_unused(bool required) {
+  for (unsigned i = 0; i < SIM_ALARMS; i++)
+    if (!alarms[i].claimed) {
+      alarms[i].claimed = true;
+      return (int)i;
+    }
+  if (required) fprintf(stderr, "[SIM] ⚠️ no free hardware alarm — panic on hardware\n");
+  return -1;
+}
+
+void hardware_alarm_set_callback(unsigned int alarm_num, hardware_alarm_callback_t callback) {
+  alarms[alarm_num].cb = callback;
+  irq_set_exclusive_handler(TIMER_IRQ_0 + alarm_num, alarmIrqs[alarm_num]);
+  irq_set_enabled(TIMER_IRQ_0 + alarm_num, callback != nullptr);
+}
+
+bool hardware_alarm_set_target(unsigned int alarm_num, absolute_time_t t) {
+  SimAlarm &a = alarms[alarm_num];
+  if (t <= now) {
+    a.armed = false;
+    return true;
+  }
+  a.armed = true;
+  a.target = t;
+  return false;
+}
+
+void hardware_alarm_cancel(unsigned int alarm_num) {
+  alarms[alarm_num].armed = false;
+}
+
+static uint64_t alarm_next() {
+  uint64_t t = SIM_NEVER;
+  for (const SimAlarm &a : alarms)
+    if (a.armed && a.target < t) t = a.target;
+  return t;
+}
+
+static void alarm_step() {
+  for (SimAlarm &a : alarms)
+    if (a.armed && a.target == now) {
+      a.armed = false;
+      a.fired = true;
+    }
+}
+
+// ======================================================
+// Ход времени
+// ======================================================
+static bool irq_asserted(unsigned num) {
+  switch (num) {
+    case TIMER_IRQ_0:
+    case TIMER_IRQ_1:
+    case TIMER_IRQ_2:
+    case TIMER_IRQ_3: return alarms[num - TIMER_IRQ_0].fired;
+    case UART0_IRQ:  return uart_asserted(0);
+    case UART1_IRQ:  return uart_asserted(1);
+    case PIO0_IRQ_0: return pio_asserted(sim_pio0);
+    case PIO1_IRQ_0: return pio_asserted(sim_pio1);
+    case IO_IRQ_BANK0: return gpioEdges != 0;
+    default:         return false;
+  }
+}
+
+void sim_advance(uint64_t t) {
+  for (;;) {
+    uint64_t next = usbNextPoll;
+    for (const SimUart &u : uarts) next = std::min(next, uart_next(u));
+    next = std::min(next, pio_next(sim_pio0));
+    next = std::min(next, pio_next(sim_pio1));
+    next = std::min(next, alarm_next());
+    if (next > t) break;
+
+    now = next;
+    uart_step(0);
+    uart_step(1);
+    pio_step(sim_pio0);
+    pio_step(sim_pio1);
+    usb_step();
+    alarm_step();
+    irq_poll();
+  }
+  if (t > now) now = t;
+}
+
+void sim_reset() {
+  now = 0;
+  irqMasked = 0;
+  inIrq = false;
+  for (IrqLine &l : irqLines) l = IrqLine{};
+  for (SimAlarm &a : alarms) a = SimAlarm{};
+  for (SimUart &u : uarts) u = SimUart{};
+  for (uart_hw_t &hw : sim_uart_hw) hw.imsc = 0;
+  sim_pio0 = pio_hw_t{};
+  sim_pio1 = pio_hw_t{};
+  usbFromHost.clear();
+  usbToHost.clear();
+  usbMounted = true;
+  usbNextPoll = usbPollUs;
+  gpioOut = 0;
+  gpioIn = ~0u;
+  gpioEdges = 0;
+  memset(gpioMode, 0, sizeof(gpioMode));
+  memset(gpioFn, 0, sizeof(gpioFn));
+  gpioOutFn = nullptr;
+  memset(sim_flash, 0xFF, sizeof(sim_flash));
+  sim_ch376s_reset();
+}
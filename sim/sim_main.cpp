@@ -0,0 +1,294 @@
+#include "sim_hal.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unistd.h>
+#include <algorithm>
+#include "ch376s.h"
+#include "midi_input.h"
+#include "midi_output.h"
+#include "midi_parser.h"
+#include "keymap.h"
+#include "hid_report.h"
+#include "webserial.h"
+#include "config_manager.h"
+#include "stats.h"
+#include "bench.h"
+#include "capture.h"
+#include "midi_clock.h"
+#include "scheduler.h"
+#include "note_state.h"
+
+// ======================================================
+// Симулятор маршрутизатора: сценарий → прошивка → лог выходов
+// ======================================================
+// Сценарий — текст, одно событие на строку (# — комментарий):
+//
+//   <t> din <hex…>        байты на MIDI IN, подряд на 31250 бод
+//   <t> usb <hex×4>       пакет USB-MIDI от хоста (кабель<<4 | CIN, 3 байта)
+//   <t> hid <hex…>        отчёт клавиатуры (8 байт boot, NKRO — после kbd)
+//   <t> kbd <N>           клавиатура за CH376S: 0 — отключить, иначе
+//                         подключить с interrupt IN на N байт (> 8 — NKRO)
+//   <t> cmd <текст>       команда WebSerial (GET_CONFIG, STATS…)
+//   <t> end               просто дожить до t
+//
+// t — мкс от конца инициализации, "+N" — через N мкс после прошлого
+// события. В stdout — вывод прошивки и по строке на сообщение выхода:
+//
+//   <t>  <выход>  <hex…>  (время последнего байта сообщения в линии)
+//
+// Сборка и запуск:
+//   pio run -e native
+//   .pio/build/native/program [-q] [-p мкс] [-u мкс] [-d каталог] [-t мкс] [файл|-]
+//   .pio/build/native/program -b <нагрузка|all> [-n событий] [-d каталог]
+//
+//   -q  без вывода прошивки      -p  проход core1 (10 мкс)
+//   -u  опрос USB хостом (1000)  -d  каталог LittleFS (.pio/sim_fs)
+//   -t  сколько жить после последнего события (20000 мкс)
+//   -b  бенчмарк вместо сценария (bench.h): по строке JSON на нагрузку
+//
+// Модульные тесты (test/, Unity) собираются с этими же файлами, но со
+// своим main: pio test -e native
+
+#define SIM_MIDI_BYTE_US 320   // 10 бит при 31250 бод
+#define SIM_T0_PERIOD_US 8000  // НОК такта колеса (64 мкс) и кадра USB (1000 мкс)
+#define SIM_T0_PHASE_US  2000  // фаза нуля сценария в этом периоде
+
+static uint32_t passUs = 10;       // проход core1 (на RP2040 — единицы мкс)
+static uint64_t t0 = 0;            // конец setup: ноль времени сценария
+static uint64_t core0Next = 0;
+static bool inCore1 = false;       // tight_loop_contents() зовёт само core1 (BENCH)
+
+// ======================================================
+// Ядра: те же задачи, что loop() и loop1() в main.cpp
+// ======================================================
+static void core1_pass() {
+  inCore1 = true;
+  stats_loop_mark();
+  routes_ack();
+  midi_out_task();
+  midi_in_task();
+  midi_in_usb_task();
+  keymap_task();
+  capture_replay_task();
+  midi_clock_task();
+  notes_task();
+  sched_task();
+  midi_out_flush();
+  bench_core1_task();
+  inCore1 = false;
+}
+
+static void core0_pass() {
+  webserial_task();
+  ch376s_task();
+  preset_task();
+  bench_task();
+  capture_task();
+  midi_out_test_task();
+}
+
+// core0 ждёт core1 (tight_loop_contents): один проход core1;
+// ждёт само core1 (BENCH ждёт выходы) — только ход часов и IRQ
+static void other_core() {
+  if (!inCore1) core1_pass();
+  sim_advance(sim_now() + passUs);
+}
+
+void sim_run_until(uint64_t t) {
+  while (sim_now() < t) {
+    core1_pass();
+    if (sim_now() >= core0Next) {
+      core0_pass();
+      core0Next = sim_now() + 1000;   // delay(LOOP_INTERVAL_MS)
+    }
+    sim_advance(std::min(t, sim_now() + passUs));
+  }
+}
+
+void sim_firmware_setup() {
+  sim_set_other_core(other_core);
+  // порядок как в setup() и setup1(); тестовый аккорд не играем
+  setup_config();
+  setup_midi_usb();
+  setup_ch376s();
+  setup_webserial();
+  setup_midi_output();
+  setup_midi_input();
+  setup_midi_clock();
+  setup_scheduler();
+  ch376s_task();   // клавиатура модели CH376S: сброс шины, дескрипторы, первый IN
+  // ноль сценария — в постоянной фазе такта колеса (64 мкс) и опроса USB
+  // (1 мс): времена лога не зависят от того, сколько шло подключение
+  uint64_t t = sim_now() + SIM_T0_PHASE_US - sim_now() % SIM_T0_PERIOD_US;
+  if (t < sim_now()) t += SIM_T0_PERIOD_US;
+  sim_advance(t);
+  t0 = core0Next = sim_now();
+}
+
+#ifndef PIO_UNIT_TESTING   // тесты (pio test) — свой main, см. test/
+
+// ======================================================
+// Лог выходов: байты линий собираются тем же парсером, что и вход
+// ======================================================
+static MidiParser wireParsers[DEST_COUNT];
+static uint8_t wireSinks[DEST_COUNT];
+
+static void print_msg(const char *name, const uint8_t *data, uint16_t len, uint32_t ts) {
+  printf("%10lu  %-6s", (unsigned long)ts, name);
+  for (uint16_t i = 0; i < len; i++) printf(" %02x", data[i]);
+  printf("\n");
+}
+
+static void on_wire_event(const MidiEvent &ev, void *ctx) {
+  uint8_t data[3];
+  uint8_t n = midi_word_bytes(ev.word, data);
+  print_msg(route_sink_name(*(const uint8_t *)ctx), data, n, ev.ts);
+}
+
+static void on_wire_sysex(const MidiWord *words, uint8_t count, uint8_t flags, uint32_t ts, void *ctx) {
+  uint8_t data[MIDI_SYSEX_CHUNK];
+  uint16_t len = 0;
+  for (uint8_t i = 0; i < count; i++) len += midi_word_bytes(words[i], data + len);
+  if ((flags & SYSEX_ABORT) && len) len--;   // F7 добавил парсер — в линии его нет
+  print_msg(route_sink_name(*(const uint8_t *)ctx), data, len, ts);
+}
+
+static void on_wire(uint8_t sink, const uint8_t *data, uint8_t len, uint64_t t) {
+  uint32_t ts = (uint32_t)(t - t0);
+  if (sink == SIM_SINK_USB && len == 4) {
+    char name[8];
+    snprintf(name, sizeof(name), "USB:%u", data[0] >> 4);
+    print_msg(name, data + 1, midi_word_len(data[0]), ts);
+  } else if (sink < DEST_COUNT) {
+    midi_parser_feed(wireParsers[sink], data[0], ts);
+  }
+}
+
+// ======================================================
+// Сценарий
+// ======================================================
+static int parse_hex(char *s, uint8_t *out, int max) {
+  int n = 0;
+  for (char *tok = strtok(s, " \t\r\n"); tok && n < max; tok = strtok(nullptr, " \t\r\n"))
+    out[n++] = (uint8_t)strtoul(tok, nullptr, 16);
+  return n;
+}
+
+static bool run_line(char *line, uint64_t &last, int lineNo) {
+  char *hash = strchr(line, '#');
+  if (hash) *hash = '\0';
+
+  char at[24], kind[8];
+  int used = 0;
+  if (sscanf(line, " %23s %7s %n", at, kind, &used) < 2) {
+    for (char *p = line; *p; p++)
+      if (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        fprintf(stderr, "[SIM] line %d: expected '<t> <kind> ...'\n", lineNo);
+        return false;
+      }
+    return true;   // пустая строка
+  }
+
+  uint64_t t = (at[0] == '+') ? last + strtoull(at + 1, nullptr, 10) : strtoull(at, nullptr, 10);
+  if (t < last) t = last;
+  last = t;
+  sim_run_until(t0 + t);
+
+  char *rest = line + used;
+  uint8_t buf[HID_REPORT_MAX];
+  if (strcmp(kind, "din") == 0) {
+    int n = parse_hex(rest, buf, sizeof(buf));
+    for (int i = 0; i < n; i++) sim_uart_rx(buf[i], sim_now() + (uint64_t)(i + 1) * SIM_MIDI_BYTE_US);
+  } else if (strcmp(kind, "usb") == 0) {
+    if (parse_hex(rest, buf, 4) != 4) {
+      fprintf(stderr, "[SIM] line %d: usb needs 4 bytes\n", lineNo);
+      return false;
+    }
+    sim_usb_host_packet(buf);
+  } else if (strcmp(kind, "hid") == 0) {
+    sim_hid_report(buf, (uint8_t)parse_hex(rest, buf, sizeof(buf)));
+  } else if (strcmp(kind, "kbd") == 0) {
+    unsigned long n = strtoul(rest, nullptr, 10);
+    sim_kbd_plug(n != 0, (uint8_t)std::min<unsigned long>(n, HID_REPORT_MAX));
+  } else if (strcmp(kind, "cmd") == 0) {
+    rest[strcspn(rest, "\r\n")] = '\0';
+    sim_serial_input(rest);
+    sim_serial_input("\n");
+  } else if (strcmp(kind, "end") != 0) {
+    fprintf(stderr, "[SIM] line %d: unknown event '%s'\n", lineNo, kind);
+    return false;
+  }
+  return true;
+}
+
+static int run_bench(const char *name, uint16_t events) {
+  uint8_t only = (strcmp(name, "all") == 0) ? (uint8_t)BENCH_COUNT : bench_find(name);
+  if (only == BENCH_COUNT && strcmp(name, "all") != 0) {
+    fprintf(stderr, "[SIM] unknown bench '%s'\n", name);
+    return 2;
+  }
+  sim_set_wire(nullptr);   // байты в линии считает сама прошивка
+  inCore1 = true;
+  routes_ack();   // таблица, опубликованная setup_config()
+  for (uint8_t w = 0; w < BENCH_COUNT; w++) {
+    if (only != BENCH_COUNT && only != w) continue;
+    BenchResult r;
+    sim_serial_set_echo(false);
+    bench_run(w, events, r);
+    sim_serial_set_echo(true);
+    bench_print(Serial, r);
+  }
+  fflush(stdout);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  uint64_t tail = 20000;   // после последнего события — дать линиям опустеть
+  const char *bench = nullptr;
+  uint16_t benchEvents = BENCH_MAX_EVENTS;
+  int opt;
+  while ((opt = getopt(argc, argv, "qp:u:d:t:b:n:")) != -1) {
+    switch (opt) {
+      case 'q': sim_serial_set_echo(false); break;
+      case 'p': passUs = std::max(1, atoi(optarg)); break;
+      case 'u': sim_usb_set_poll((uint32_t)atoi(optarg)); break;
+      case 'd': sim_fs_set_root(optarg); break;
+      case 't': tail = strtoull(optarg, nullptr, 10); break;
+      case 'b': bench = optarg; break;
+      case 'n': benchEvents = (uint16_t)std::min(atoi(optarg), BENCH_MAX_EVENTS); break;
+      default:
+        fprintf(stderr, "usage: %s [-q] [-p pass_us] [-u usb_poll_us] [-d fs_dir] [-t tail_us] [script|-]\n"
+                        "       %s -b <workload|all> [-n events] [-d fs_dir]\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+  FILE *in = bench ? nullptr : (optind < argc && strcmp(argv[optind], "-") != 0) ? fopen(argv[optind], "r") : stdin;
+  if (!bench && !in) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  sim_reset();
+  sim_set_wire(on_wire);
+  for (uint8_t i = 0; i < DEST_COUNT; i++) {
+    wireSinks[i] = i;
+    midi_parser_init(wireParsers[i], on_wire_event, on_wire_sysex, &wireSinks[i]);
+  }
+
+  if (bench) sim_serial_set_echo(false);
+  sim_firmware_setup();
+  if (bench) return run_bench(bench, benchEvents);
+
+  char line[1024];
+  uint64_t last = 0;
+  bool ok = true;
+  for (int lineNo = 1; ok && fgets(line, sizeof(line), in); lineNo++)
+    ok = run_line(line, last, lineNo);
+  sim_run_until(t0 + last + tail);
+
+  if (in != stdin) fclose(in);
+  fflush(stdout);
+  return ok ? 0 : 1;
+}
+
+#endif  // PIO_UNIT_TESTING
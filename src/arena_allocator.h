@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <ArduinoJson.h>
+
+// ======================================================
+// Арена для ArduinoJson: статический буфер вместо кучи
+// ======================================================
+// Используется только на время разбора/сборки JSON, после чего
+// reset() освобождает всё разом. deallocate() ничего не делает;
+// reallocate() растит последний блок на месте (так растёт пул
+// ArduinoJson), иначе копирует.
+
+class ArenaAllocator : public ArduinoJson::Allocator {
+public:
+  ArenaAllocator(uint8_t *buf, size_t size) : buf_(buf), size_(size) {}
+
+  void *allocate(size_t n) override {
+    size_t need = align(sizeof(size_t) + n);
+    if (used_ + need > size_) return nullptr;
+    uint8_t *blk = buf_ + used_;
+    memcpy(blk, &n, sizeof(size_t));
+    last_ = blk;
+    used_ += need;
+    if (used_ > peak_) peak_ = used_;
+    return blk + sizeof(size_t);
+  }
+
+  void deallocate(void *) override {}
+
+  void *reallocate(void *p, size_t n) override {
+    if (!p) return allocate(n);
+    uint8_t *blk = (uint8_t *)p - sizeof(size_t);
+    size_t old;
+    memcpy(&old, blk, sizeof(size_t));
+
+    if (blk == last_) {                  // последний блок — меняем размер на месте
+      size_t start = blk - buf_;
+      size_t need = align(sizeof(size_t) + n);
+      if (start + need > size_) return nullptr;
+      memcpy(blk, &n, sizeof(size_t));
+      used_ = start + need;
+      if (used_ > peak_) peak_ = used_;
+      return p;
+    }
+
+    void *q = allocate(n);
+    if (q) memcpy(q, p, old < n ? old : n);
+    return q;
+  }
+
+  void reset() { used_ = 0; last_ = nullptr; }
+  size_t used() const { return used_; }
+  size_t peak() const { return peak_; }
+  size_t capacity() const { return size_; }
+
+private:
+  static size_t align(size_t n) { return (n + 7) & ~(size_t)7; }
+
+  uint8_t *buf_;
+  size_t size_;
+  size_t used_ = 0;
+  size_t peak_ = 0;
+  uint8_t *last_ = nullptr;
+};
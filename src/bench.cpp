@@ -0,0 +1,319 @@
+#include "bench.h"
+#include "midi_input.h"
+#include "midi_output.h"
+#include "midi_queue.h"
+#include "bitslice.h"
+#include "keymap.h"
+#include "config_manager.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+#define BENCH_SEED       0x4D494449u   // "MIDI"
+#define BENCH_DRAIN_US   200000        // выход не пустеет — дальше с потерями
+#define BENCH_WIRE_BPS   3125          // байт/с на MIDI IN (31250 бод, 10 бит)
+#define BENCH_HID_PER_S  1000          // событий клавиатуры: опрос 1 мс
+
+static const char *const benchNames[BENCH_COUNT] = {
+  "chords", "cc", "clock", "sysex", "mixed", "keys", "slice"
+};
+
+const char *bench_name(uint8_t workload) {
+  return workload < BENCH_COUNT ? benchNames[workload] : "?";
+}
+
+uint8_t bench_find(const char *name) {
+  for (uint8_t i = 0; i < BENCH_COUNT; i++)
+    if (strcmp(name, benchNames[i]) == 0) return i;
+  return BENCH_COUNT;
+}
+
+// ======================================================
+// Генераторы нагрузок: событие i → байты (детерминированно)
+// ======================================================
+struct BenchGen {
+  uint8_t workload;
+  uint32_t i;       // номер события
+  uint32_t rng;     // xorshift32
+  uint8_t root;     // аккорд: тоника
+  uint8_t held[6];  // клавиши: нажатые коды
+  uint8_t codes[256];   // клавиши, у которых есть маршрут
+  uint16_t nCodes;
+};
+
+static inline uint32_t gen_rand(BenchGen &g) {
+  g.rng ^= g.rng << 13;
+  g.rng ^= g.rng >> 17;
+  g.rng ^= g.rng << 5;
+  return g.rng;
+}
+
+static uint8_t gen_chords(BenchGen &g, uint8_t *out) {
+  static const uint8_t shape[4] = {0, 4, 7, 12};
+  uint8_t k = g.i % 8;             // 4 NoteOn, затем 4 NoteOn с нулевой скоростью
+  uint8_t n = 0;
+  if (k == 0) {
+    g.root = 36 + gen_rand(g) % 48;
+    out[n++] = 0x90;                // дальше по аккорду — running status
+  }
+  out[n++] = g.root + shape[k % 4];
+  out[n++] = (k < 4) ? 64 + gen_rand(g) % 64 : 0;
+  return n;
+}
+
+static uint8_t gen_cc(BenchGen &g, uint8_t *out) {
+  uint8_t step = g.i % 256;
+  uint8_t n = 0;
+  if (g.i % 128 == 0) out[n++] = 0xB0;
+  out[n++] = (g.i / 256) % 2 ? 74 : 1;
+  out[n++] = step < 128 ? step : 255 - step;
+  return n;
+}
+
+static uint8_t gen_clock(BenchGen &g, uint8_t *out) {
+  out[0] = (g.i == 0) ? 0xFA : 0xF8;
+  return 1;
+}
+
+static uint8_t gen_sysex(BenchGen &g, uint8_t *out) {
+  out[0] = 0xF0;
+  out[1] = 0x7D;                    // некоммерческий ID
+  for (uint8_t n = 2; n < BENCH_MSG_MAX - 1; n++) out[n] = gen_rand(g) & 0x7F;
+  out[BENCH_MSG_MAX - 1] = 0xF7;
+  return BENCH_MSG_MAX;
+}
+
+static uint8_t gen_mixed(BenchGen &g, uint8_t *out) {
+  static const uint8_t types[6] = {0x90, 0x80, 0xB0, 0xE0, 0xD0, 0xA0};
+  uint32_t r = gen_rand(g);
+  uint8_t st = types[r % 6] | ((r >> 4) & 0x0F);
+  uint8_t msg[3] = {st, (uint8_t)((r >> 8) & 0x7F), (uint8_t)((r >> 16) & 0x7F)};
+  uint8_t len = ((st & 0xF0) == 0xD0) ? 2 : 3;
+
+  // realtime может прийти между любыми байтами сообщения
+  uint8_t n = 0;
+  uint8_t at = (r >> 24) % (len + 1);
+  for (uint8_t k = 0; k <= len; k++) {
+    if (k == at && (r & 0x30000000u) == 0) out[n++] = 0xF8;
+    if (k == at && (r & 0xF0000000u) == 0xF0000000u) out[n++] = 0xFE;
+    if (k < len) out[n++] = msg[k];
+  }
+  return n;
+}
+
+// клавиши: 6 нажатий разных кодов с маршрутом, затем 6 отпусканий
+static void gen_keys_init(BenchGen &g) {
+  const RouteTable *t = active_routes();
+  for (uint16_t c = 0; c < 256; c++)
+    if (t->keys[c].type != ROUTE_NONE && t->keys[c].dest) g.codes[g.nCodes++] = (uint8_t)c;
+  if (g.nCodes < 6) {   // без маршрутов — просто буквы и цифры
+    g.nCodes = 36;
+    for (uint8_t c = 0; c < 36; c++) g.codes[c] = 0x04 + c;
+  }
+}
+
+static uint8_t gen_keys(BenchGen &g, uint8_t *out) {
+  uint8_t k = g.i % 12;
+  if (k < 6) {
+    uint8_t code;
+    bool dup;
+    do {
+      code = g.codes[gen_rand(g) % g.nCodes];
+      dup = false;
+      for (uint8_t j = 0; j < k; j++) dup |= (g.held[j] == code);
+    } while (dup);
+    g.held[k] = code;
+    out[1] = 1;
+  } else {
+    out[1] = 0;
+  }
+  out[0] = g.held[k % 6];
+  return 2;
+}
+
+// кадр TRS: 10 случайных байт и маска портов, у которых байт есть
+static uint8_t gen_slice(BenchGen &g, uint8_t *out) {
+  for (uint8_t n = 0; n < 10; n++) out[n] = (uint8_t)gen_rand(g);
+  uint16_t active = (g.i % 4 == 0) ? 0x3FF : gen_rand(g) & 0x3FF;   // каждый 4-й — все порты
+  out[10] = (uint8_t)active;
+  out[11] = (uint8_t)(active >> 8);
+  return 12;
+}
+
+static void gen_init(BenchGen &g, uint8_t workload) {
+  memset(&g, 0, sizeof(g));
+  g.workload = workload;
+  g.rng = BENCH_SEED;
+  if (workload == BENCH_KEYS) gen_keys_init(g);
+}
+
+static uint8_t gen_next(BenchGen &g, uint8_t *out) {
+  uint8_t n = 0;
+  switch (g.workload) {
+    case BENCH_CHORDS:   n = gen_chords(g, out); break;
+    case BENCH_CC_SWEEP: n = gen_cc(g, out); break;
+    case BENCH_CLOCK:    n = gen_clock(g, out); break;
+    case BENCH_SYSEX:    n = gen_sysex(g, out); break;
+    case BENCH_MIXED:    n = gen_mixed(g, out); break;
+    case BENCH_KEYS:     n = gen_keys(g, out); break;
+    case BENCH_SLICE:    n = gen_slice(g, out); break;
+  }
+  g.i++;
+  return n;
+}
+
+// ======================================================
+// Прогон
+// ======================================================
+static uint32_t samples[BENCH_MAX_EVENTS];
+
+// Ждать (вне замера), пока в выходах есть место на ещё один кусок
+// SysEx (48 байт → 16 сообщений) и пустая realtime-полоса: иначе потери
+// сделают байты в линии зависящими от скорости процессора
+static void wait_room(uint16_t maxDepth) {
+  uint64_t until = time_us_64() + BENCH_DRAIN_US;
+  for (;;) {
+    midi_out_flush();
+    UsbOutStats usb;
+    midi_out_get_usb_stats(usb);
+    if ((midi_out_backlog() <= maxDepth && midi_out_rt_backlog() == 0 && usb.pending == 0) ||
+        time_us_64() >= until)
+      return;
+    tight_loop_contents();
+  }
+}
+
+// накладные расходы пары чтений счётчика — вычитаются из замеров
+static uint32_t timer_overhead() {
+  uint32_t best = UINT32_MAX;
+  for (uint8_t k = 0; k < 16; k++) {
+    uint32_t c0 = rp2040.getCycleCount();
+    uint32_t dt = rp2040.getCycleCount() - c0;
+    if (dt < best) best = dt;
+  }
+  return best;
+}
+
+static inline uint32_t cycles_to_ns(uint64_t cycles, uint32_t hz) {
+  return (uint32_t)(cycles * 1000000000ull / hz);
+}
+
+void bench_run(uint8_t workload, uint16_t events, BenchResult &r) {
+  r = BenchResult{};
+  r.workload = workload;
+  if (workload >= BENCH_COUNT) return;
+  if (events == 0 || events > BENCH_MAX_EVENTS) events = BENCH_MAX_EVENTS;
+
+  const uint16_t roomDepth = MIDI_QUEUE_SIZE - 17;
+  wait_room(0);
+  uint32_t wire0[DEST_COUNT], drops0 = 0;
+  for (uint8_t s = 0; s < DEST_COUNT; s++) {
+    wire0[s] = midi_out_get_wire_bytes(s);
+    drops0 += midi_out_get_drops(s);
+  }
+
+  uint32_t overhead = timer_overhead();
+  uint64_t total = 0;
+  static BenchGen g;   // стек core1 — 4 КБ
+  gen_init(g, workload);
+  uint8_t buf[BENCH_MSG_MAX];
+
+  for (uint16_t e = 0; e < events; e++) {
+    uint8_t n = gen_next(g, buf);
+    uint32_t cost = 0;
+    if (workload == BENCH_SLICE) {
+      uint32_t cols[BITSLICE_COLS];
+      uint16_t active = buf[10] | buf[11] << 8;
+      uint32_t c0 = rp2040.getCycleCount();
+      midi_out_frame(buf, active, cols);
+      uint32_t dt = rp2040.getCycleCount() - c0;
+      cost = dt > overhead ? dt - overhead : 0;
+    } else if (workload == BENCH_KEYS) {
+      wait_room(roomDepth);
+      uint32_t ts = (uint32_t)time_us_64();
+      uint32_t c0 = rp2040.getCycleCount();
+      handle_hid_code(buf[0], buf[1] != 0, ts);
+      uint32_t dt = rp2040.getCycleCount() - c0;
+      cost = dt > overhead ? dt - overhead : 0;
+    } else {
+      // по байту: между байтами выходы могут опустеть (вне замера)
+      for (uint8_t k = 0; k < n; k++) {
+        wait_room(roomDepth);
+        uint32_t ts = (uint32_t)time_us_64();
+        uint32_t c0 = rp2040.getCycleCount();
+        process_midi_input(buf[k], ts);
+        uint32_t dt = rp2040.getCycleCount() - c0;
+        cost += dt > overhead ? dt - overhead : 0;
+      }
+      r.bytesIn += n;
+    }
+    samples[e] = cost;
+    total += cost;
+  }
+  wait_room(0);
+
+  uint32_t hz = clock_get_hz(clk_sys);
+  std::sort(samples, samples + events);
+  r.events = events;
+  r.perSec = total ? (uint32_t)((uint64_t)events * hz / total) : 0;
+  r.needPerSec = (workload == BENCH_KEYS)  ? BENCH_HID_PER_S
+               : (workload == BENCH_CLOCK) ? 300 * 24 / 60
+               : (workload == BENCH_SLICE) ? BENCH_WIRE_BPS
+               : (uint32_t)((uint64_t)BENCH_WIRE_BPS * events / r.bytesIn);
+  r.p50Ns = cycles_to_ns(samples[events / 2], hz);
+  r.p99Ns = cycles_to_ns(samples[(uint32_t)events * 99 / 100], hz);
+  r.maxNs = cycles_to_ns(samples[events - 1], hz);
+  for (uint8_t s = 0; s < DEST_COUNT; s++) {
+    r.wire[s] = midi_out_get_wire_bytes(s) - wire0[s];
+    r.drops += midi_out_get_drops(s);
+  }
+  r.drops -= drops0;
+}
+
+void bench_print(Print &out, const BenchResult &r) {
+  out.printf("{\"bench\":\"%s\",\"events\":%u,\"bytes_in\":%lu,\"per_s\":%lu,\"need_per_s\":%lu,"
+             "\"ns\":{\"p50\":%lu,\"p99\":%lu,\"max\":%lu},\"wire\":[",
+             bench_name(r.workload), r.events, (unsigned long)r.bytesIn,
+             (unsigned long)r.perSec, (unsigned long)r.needPerSec,
+             (unsigned long)r.p50Ns, (unsigned long)r.p99Ns, (unsigned long)r.maxNs);
+  for (uint8_t s = 0; s < DEST_COUNT; s++)
+    out.printf("%s%lu", s ? "," : "", (unsigned long)r.wire[s]);
+  out.printf("],\"drops\":%lu}\n", (unsigned long)r.drops);
+}
+
+// ======================================================
+// Запуск с core0: запрос → core1 → результаты обратно
+// ======================================================
+enum BenchState : uint8_t { BENCH_IDLE = 0, BENCH_REQUESTED, BENCH_RUNNING, BENCH_DONE };
+
+static std::atomic<uint8_t> benchState{BENCH_IDLE};
+static uint8_t reqWorkload;
+static uint16_t reqEvents;
+static BenchResult results[BENCH_COUNT];
+static uint8_t resultCount;
+
+bool bench_request(uint8_t workload, uint16_t events) {
+  if (benchState.load(std::memory_order_acquire) != BENCH_IDLE) return false;
+  reqWorkload = workload;
+  reqEvents = events;
+  benchState.store(BENCH_REQUESTED, std::memory_order_release);
+  return true;
+}
+
+void bench_core1_task() {
+  if (benchState.load(std::memory_order_acquire) != BENCH_REQUESTED) return;
+  benchState.store(BENCH_RUNNING, std::memory_order_relaxed);
+  resultCount = 0;
+  for (uint8_t w = 0; w < BENCH_COUNT; w++)
+    if (reqWorkload == BENCH_COUNT || reqWorkload == w)
+      bench_run(w, reqEvents, results[resultCount++]);
+  benchState.store(BENCH_DONE, std::memory_order_release);
+}
+
+void bench_task() {
+  if (benchState.load(std::memory_order_acquire) != BENCH_DONE) return;
+  for (uint8_t i = 0; i < resultCount; i++) bench_print(Serial, results[i]);
+  benchState.store(BENCH_IDLE, std::memory_order_release);
+}
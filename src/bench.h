@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+#include "route_table.h"
+
+// ======================================================
+// Бенчмарк парсера, маршрутизации и кодировщиков выходов
+// ======================================================
+// Синтетические нагрузки (фиксированный seed — одинаковые байты на
+// плате и в симуляторе) подаются в process_midi_input() / handle_hid_code()
+// на core1, нагрузка slice — в сборку кадра TRS (midi_out_frame, без
+// выхода в линию). Каждое событие замеряется счётчиком тактов: p50/p99 стоимости
+// и события в секунду. Между событиями (вне замера) выходы успевают
+// опустеть настолько, чтобы ничего не терялось, — поэтому байты в линии
+// по выходам детерминированы и сравниваются точно.
+//
+// Таблицы маршрутов — текущие: результат зависит от конфигурации и
+// SET_ENCODING (у тестового стенда они должны быть одинаковыми).
+
+#define BENCH_MAX_EVENTS 1024   // событий на нагрузку (сэмплы стоимости в RAM)
+#define BENCH_MSG_MAX    128    // самое длинное событие — дамп SysEx
+
+enum BenchWorkload : uint8_t {
+  BENCH_CHORDS = 0,   // аккорды по 4 ноты, running status
+  BENCH_CC_SWEEP,     // CC 1/74 вверх-вниз по 0–127
+  BENCH_CLOCK,        // Start + MIDI Clock (300 BPM — 120 в секунду)
+  BENCH_SYSEX,        // дампы SysEx по 128 байт
+  BENCH_MIXED,        // все канальные типы, F8/FE внутри сообщений
+  BENCH_KEYS,         // клавиатура: до 6 нажатых, затем отпускание
+  BENCH_SLICE,        // кадр TRS: байты 10 портов → столбцы бит (bitslice.h)
+  BENCH_COUNT
+};
+
+struct BenchResult {
+  uint8_t workload;
+  uint16_t events;
+  uint32_t bytesIn;             // байт MIDI IN (для KEYS и SLICE — 0)
+  uint32_t perSec;              // событий в секунду по чистому времени
+  uint32_t needPerSec;          // сколько нужно: вход на 31250 бод / опрос 1 мс / кадр на байт линии
+  uint32_t p50Ns, p99Ns, maxNs; // стоимость одного события
+  uint32_t wire[DEST_COUNT];    // байт в линию по выходам (USB — 4 на пакет)
+  uint32_t drops;               // потеряно выходами за прогон
+};
+
+const char *bench_name(uint8_t workload);
+
+/**
+ * @brief Нагрузка по имени ("chords", "cc", …)
+ * @return BENCH_COUNT, если имя не найдено
+ */
+uint8_t bench_find(const char *name);
+
+/**
+ * @brief Прогнать нагрузку (только core1 — как loop1)
+ *
+ * Блокирует core1 на время прогона: живой вход ждёт в кольцах.
+ */
+void bench_run(uint8_t workload, uint16_t events, BenchResult &r);
+
+/**
+ * @brief Строка JSON с результатом
+ */
+void bench_print(Print &out, const BenchResult &r);
+
+// Межъядерный запуск: команда BENCH (core0) → прогон (core1) → печать (core0)
+bool bench_request(uint8_t workload, uint16_t events);   // core0; BENCH_COUNT — все
+void bench_core1_task();                                  // core1
+void bench_task();                                        // core0
@@ -0,0 +1,85 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// ======================================================
+// Бит-слайсинг: байты портов → столбцы бит для одной state machine
+// ======================================================
+// Все TRS-выходы идут с одной SM (midi_multi_tx в midi_uart_tx.pio):
+// раз в бит (32 мкс на 31250 бод) она выставляет слово на все выводы
+// разом. Кадр — 10 таких слов, по байту на порт в ногу:
+//
+//   столбец 0     старт-бит: 0 у портов с байтом, 1 у молчащих
+//   столбцы 1–8   биты данных, младший первым (молчащие — 1)
+//   столбец 9     стоп-бит: 1 у всех
+//
+// Бит порта в слове — его вывод относительно базы (выводы не обязаны
+// идти подряд: чужие выводы между ними SM не трогает, их функция — не PIO).
+//
+// Транспонирование — по 8 портов: байты группы как матрица 8×8 бит
+// в uint64, три шага обмена (Hacker's Delight, 7-3), затем строка
+// матрицы (бит b у 8 портов) раскладывается по выводам таблицей spread.
+
+#define BITSLICE_COLS      10   // старт + 8 данных + стоп
+#define BITSLICE_PORTS_MAX 16
+#define BITSLICE_GROUPS    (BITSLICE_PORTS_MAX / 8)
+
+struct BitSlicer {
+  uint8_t ports;
+  uint32_t pinsMask;                          // выводы всех портов (бит — вывод − база)
+  uint32_t spread[BITSLICE_GROUPS][256];      // 8 бит группы → биты выводов
+};
+
+/**
+ * @brief Таблицы раскладки по выводам
+ * @param pinOffsets вывод порта относительно базы (0–31)
+ */
+static inline void bitslice_init(BitSlicer &s, const uint8_t *pinOffsets, uint8_t ports) {
+  memset(&s, 0, sizeof(s));
+  s.ports = ports < BITSLICE_PORTS_MAX ? ports : BITSLICE_PORTS_MAX;
+  for (uint8_t p = 0; p < s.ports; p++) s.pinsMask |= 1u << pinOffsets[p];
+  for (uint8_t g = 0; g < BITSLICE_GROUPS; g++)
+    for (uint16_t v = 0; v < 256; v++)
+      for (uint8_t k = 0; k < 8 && g * 8 + k < s.ports; k++)
+        if (v & (1u << k)) s.spread[g][v] |= 1u << pinOffsets[g * 8 + k];
+}
+
+// Транспонирование 8×8: бит j байта i ↔ бит i байта j
+static inline uint64_t bitslice_transpose8(uint64_t x) {
+  uint64_t t;
+  t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAull; x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull; x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull; x ^= t ^ (t << 28);
+  return x;
+}
+
+/**
+ * @brief Кадр из байтов портов
+ *
+ * @param bytes байт на порт (bytes[p] читается только для активных)
+ * @param active маска портов, у которых есть байт
+ * @param cols BITSLICE_COLS слов для TX FIFO state machine
+ */
+static inline void bitslice_frame(const BitSlicer &s, const uint8_t *bytes, uint16_t active,
+                                  uint32_t *cols) {
+  uint32_t data[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  uint32_t activePins = 0;
+  for (uint8_t g = 0; g * 8 < s.ports; g++) {
+    uint8_t act = (uint8_t)(active >> (g * 8));
+    if (!act) {                                 // вся группа молчит — линия в 1
+      for (uint8_t b = 0; b < 8; b++) data[b] |= s.spread[g][0xFF];
+      continue;
+    }
+    uint64_t x = 0;
+    for (uint8_t k = 0; k < 8 && g * 8 + k < s.ports; k++) {
+      uint8_t v = (act & (1u << k)) ? bytes[g * 8 + k] : 0xFF;
+      x |= (uint64_t)v << (8 * k);
+    }
+    x = bitslice_transpose8(x);                 // байт b — бит b у порта k в бите k
+    for (uint8_t b = 0; b < 8; b++) data[b] |= s.spread[g][(uint8_t)(x >> (8 * b))];
+    activePins |= s.spread[g][act];
+  }
+  cols[0] = s.pinsMask & ~activePins;
+  for (uint8_t b = 0; b < 8; b++) cols[1 + b] = data[b];
+  cols[9] = s.pinsMask;
+}
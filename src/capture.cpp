@@ -0,0 +1,350 @@
+#include "capture.h"
+#include "midi_input.h"
+#include "midi_parser.h"
+#include "keymap.h"
+#include "spsc_queue.h"
+#include "hardware/timer.h"
+#include <LittleFS.h>
+#include <atomic>
+#include <string.h>
+
+#define CAPTURE_MASK     (CAPTURE_ENTRIES - 1)
+#define CAPTURE_MARGIN   (MIDI_SYSEX_CHUNK / CAPTURE_DATA)   // записей в одном событии
+#define BLOCK_ENTRIES    (CAPTURE_LOG_BLOCK / sizeof(CaptureEntry))
+#define REPLAY_BUDGET    16     // записей за проход core1 (FAST)
+
+static_assert(sizeof(CaptureEntry) == 16, "CaptureEntry must pack 256 per log block");
+
+static const char *const logFiles[2] = {"/capture0.bin", "/capture1.bin"};
+
+CaptureOpen captureOpen;
+
+// ======================================================
+// Кольцо (пишет core1)
+// ======================================================
+static CaptureEntry ring[CAPTURE_ENTRIES];
+static std::atomic<uint32_t> ringHead{0};   // записей всего; пишет core1
+static volatile bool frozen = false;        // пишет core0
+
+static uint8_t openSrc;
+static uint8_t openLen;
+static uint32_t openTs;
+static uint8_t openData[MIDI_SYSEX_CHUNK];
+
+void capture_open(uint8_t src, const uint8_t *data, uint8_t len, uint32_t ts) {
+  if (frozen || captureOpen.open || !len) return;
+  if (len > MIDI_SYSEX_CHUNK) len = MIDI_SYSEX_CHUNK;
+  openSrc = src;
+  openLen = len;
+  openTs = ts;
+  memcpy(openData, data, len);
+  captureOpen.dest = 0;
+  captureOpen.open = true;
+}
+
+void capture_cancel() {
+  captureOpen.open = false;
+}
+
+void capture_close() {
+  if (!captureOpen.open) return;
+  captureOpen.open = false;
+
+  // длинный кусок SysEx — несколько записей подряд
+  uint32_t h = ringHead.load(std::memory_order_relaxed);
+  for (uint8_t off = 0; off < openLen; off += CAPTURE_DATA) {
+    CaptureEntry &e = ring[h++ & CAPTURE_MASK];
+    e.ts = openTs;
+    e.dest = captureOpen.dest;
+    e.src = off ? (openSrc | CAPTURE_CONT) : openSrc;
+    e.len = (openLen - off < CAPTURE_DATA) ? openLen - off : CAPTURE_DATA;
+    memcpy(e.data, openData + off, e.len);
+  }
+  ringHead.store(h, std::memory_order_release);
+}
+
+// ======================================================
+// Чтение кольца (core0)
+// ======================================================
+static uint32_t clearFrom = 0;
+
+// Самая старая запись, которую core1 не перепишет прямо сейчас
+static uint32_t ring_oldest(uint32_t head, bool sinceClear) {
+  uint32_t from = (head > CAPTURE_ENTRIES - CAPTURE_MARGIN) ? head - (CAPTURE_ENTRIES - CAPTURE_MARGIN) : 0;
+  return (sinceClear && clearFrom > from) ? clearFrom : from;
+}
+
+// Копия записи; false — пока копировали, core1 её переписал
+static bool ring_read(uint32_t seq, CaptureEntry &e) {
+  e = ring[seq & CAPTURE_MASK];
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return ringHead.load(std::memory_order_acquire) - seq <= CAPTURE_ENTRIES - CAPTURE_MARGIN;
+}
+
+void capture_freeze(bool on) {
+  frozen = on;
+}
+
+void capture_clear() {
+  clearFrom = ringHead.load(std::memory_order_acquire);
+}
+
+static const char *src_name(uint8_t src) {
+  switch (src & ~CAPTURE_CONT) {
+    case SRC_DIN:  return "din";
+    case SRC_USB:  return "usb";
+    case SRC_KEYS: return "keys";
+  }
+  return "?";
+}
+
+void capture_dump(Print &out) {
+  frozen = true;
+  uint32_t h = ringHead.load(std::memory_order_acquire);
+  uint32_t from = ring_oldest(h, true);
+  out.printf("{\"capture\":{\"head\":%lu,\"events\":[", (unsigned long)h);
+
+  // [время, источник, маска выходов, "байты"]; продолжения SysEx — в те же байты
+  bool inEvent = false;
+  for (uint32_t s = from; s != h; s++) {
+    CaptureEntry e;
+    if (!ring_read(s, e)) continue;
+    if (!(e.src & CAPTURE_CONT) || !inEvent) {
+      if (inEvent) out.print("\"],");
+      out.printf("[%lu,\"%s\",%u,\"", (unsigned long)e.ts, src_name(e.src), e.dest);
+      inEvent = true;
+    }
+    for (uint8_t k = 0; k < e.len; k++) out.printf("%02x", e.data[k]);
+  }
+  if (inEvent) out.print("\"]");
+  out.println("]}}");
+}
+
+// ======================================================
+// Лог во flash (core0): целые блоки, два сегмента по кругу
+// ======================================================
+static CaptureEntry block[BLOCK_ENTRIES];
+static uint16_t blockFill = 0;
+static File logFile;
+static bool streaming = false;
+static uint8_t segment = 0;
+static uint16_t segBlocks = 0;
+static uint32_t segSeq = 0;
+static uint32_t logTail = 0;
+static uint32_t logged = 0;
+static uint32_t lost = 0;
+
+// номер сегмента из заголовка; 0 — файла нет
+static uint32_t segment_seq(uint8_t seg) {
+  File f = LittleFS.open(logFiles[seg], "r");
+  CaptureEntry e;
+  if (!f || f.read((uint8_t *)&e, sizeof(e)) != sizeof(e) || e.src != CAPTURE_SEGMENT) return 0;
+  uint32_t seq;
+  memcpy(&seq, e.data, sizeof(seq));
+  return seq;
+}
+
+static void segment_start() {
+  logFile = LittleFS.open(logFiles[segment], "w");
+  segBlocks = 0;
+  CaptureEntry &hdr = block[0];
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.src = CAPTURE_SEGMENT;
+  hdr.len = sizeof(segSeq);
+  memcpy(hdr.data, &segSeq, sizeof(segSeq));
+  blockFill = 1;
+}
+
+static void block_write() {
+  // неполный блок (остановка лога) добиваем пустыми записями
+  memset(&block[blockFill], 0, (BLOCK_ENTRIES - blockFill) * sizeof(CaptureEntry));
+  logFile.write((const uint8_t *)block, sizeof(block));
+  blockFill = 0;
+  if (++segBlocks < CAPTURE_LOG_BLOCKS) return;
+  logFile.close();
+  segment ^= 1;
+  segSeq++;
+  segment_start();
+}
+
+bool capture_stream(bool on) {
+  if (on == streaming) return true;
+  if (!on) {
+    if (blockFill) block_write();
+    logFile.close();
+    streaming = false;
+    return true;
+  }
+  // переписываем старший по возрасту сегмент
+  uint32_t s0 = segment_seq(0), s1 = segment_seq(1);
+  segment = (s0 <= s1) ? 0 : 1;
+  segSeq = (s0 > s1 ? s0 : s1) + 1;
+  segment_start();
+  if (!logFile) return false;
+  logTail = ringHead.load(std::memory_order_acquire);
+  streaming = true;
+  return true;
+}
+
+// За проход — не больше одного блока: core0 тоже не должен надолго замирать
+static void log_pump() {
+  uint32_t h = ringHead.load(std::memory_order_acquire);
+  uint32_t from = ring_oldest(h, false);
+  if ((int32_t)(from - logTail) > 0) {
+    lost += from - logTail;
+    logTail = from;
+  }
+  while (logTail != h) {
+    CaptureEntry e;
+    if (!ring_read(logTail++, e)) {
+      lost++;
+      continue;
+    }
+    block[blockFill++] = e;
+    logged++;
+    if (blockFill == BLOCK_ENTRIES) {
+      block_write();
+      return;
+    }
+  }
+}
+
+// ======================================================
+// Повтор: core0 подаёт записи, core1 играет их в исходном темпе
+// ======================================================
+enum ReplayState : uint8_t { REPLAY_IDLE = 0, REPLAY_FEED, REPLAY_LAST, REPLAY_DONE };
+
+static std::atomic<uint8_t> replayState{REPLAY_IDLE};
+static SpscQueue<CaptureEntry, 64> replayQueue;
+static bool replayFast = false;
+static bool replayFromLog = false;
+static uint32_t replaySeq, replayEnd;   // кольцо
+static File replayFile;                  // лог
+static uint8_t replaySegs[2];
+static uint8_t replaySegCount, replaySegPos;
+
+bool capture_replay(bool fromLog, bool fast) {
+  if (replayState.load(std::memory_order_acquire) != REPLAY_IDLE) return false;
+  if (fromLog) {
+    if (streaming) capture_stream(false);
+    uint32_t s0 = segment_seq(0), s1 = segment_seq(1);
+    replaySegCount = 0;
+    if (s0 && (!s1 || s0 < s1)) replaySegs[replaySegCount++] = 0;
+    if (s1) replaySegs[replaySegCount++] = 1;
+    if (s0 && s1 && s1 < s0) replaySegs[replaySegCount++] = 0;
+    if (!replaySegCount) return false;
+    replaySegPos = 0;
+    replayFile = LittleFS.open(logFiles[replaySegs[0]], "r");
+  } else {
+    replayEnd = ringHead.load(std::memory_order_acquire);
+    replaySeq = ring_oldest(replayEnd, true);
+  }
+  frozen = true;   // повтор не пишем поверх записанного
+  replayFromLog = fromLog;
+  replayFast = fast;
+  replayState.store(REPLAY_FEED, std::memory_order_release);
+  return true;
+}
+
+static bool replay_next(CaptureEntry &e) {
+  if (!replayFromLog) {
+    while (replaySeq != replayEnd)
+      if (ring_read(replaySeq++, e)) return true;
+    return false;
+  }
+  for (;;) {
+    if (replayFile && replayFile.read((uint8_t *)&e, sizeof(e)) == sizeof(e)) {
+      if (e.len && e.src != CAPTURE_SEGMENT) return true;
+      continue;   // заполнитель или заголовок
+    }
+    replayFile.close();
+    if (++replaySegPos >= replaySegCount) return false;
+    replayFile = LittleFS.open(logFiles[replaySegs[replaySegPos]], "r");
+  }
+}
+
+static void replay_pump() {
+  CaptureEntry e;
+  while (replayQueue.size() < 64) {
+    if (!replay_next(e)) {
+      replayState.store(REPLAY_LAST, std::memory_order_release);
+      return;
+    }
+    replayQueue.push(e);
+  }
+}
+
+static void replay_entry(const CaptureEntry &e, uint32_t now) {
+  switch (e.src & ~CAPTURE_CONT) {
+    case SRC_DIN:
+      for (uint8_t k = 0; k < e.len; k++) process_midi_input(e.data[k], now);
+      break;
+    case SRC_USB:
+      if (e.len == 4) {
+        MidiWord w;
+        memcpy(&w, e.data, 4);
+        midi_in_replay_usb(w, now);
+      }
+      break;
+    case SRC_KEYS:
+      if (e.data[0]) handle_hid_code(e.data[0], e.data[1] != 0, now);
+      else keymap_all_notes_off(now);
+      break;
+  }
+}
+
+void capture_replay_task() {
+  static CaptureEntry next;
+  static bool hasNext = false;
+  static bool started = false;
+  static uint32_t shift;   // исходное время → текущее
+
+  uint8_t state = replayState.load(std::memory_order_acquire);
+  if (state != REPLAY_FEED && state != REPLAY_LAST) return;
+
+  for (uint8_t n = 0; n < REPLAY_BUDGET; n++) {
+    if (!hasNext) {
+      if (!replayQueue.pop(next)) {
+        if (state == REPLAY_LAST) {
+          started = false;
+          replayState.store(REPLAY_DONE, std::memory_order_release);
+        }
+        return;
+      }
+      hasNext = true;
+    }
+    uint32_t now = (uint32_t)time_us_64();
+    if (!replayFast) {
+      if (!started) {
+        shift = now - next.ts;
+        started = true;
+      }
+      if ((int32_t)(next.ts + shift - now) > 0) return;
+    }
+    replay_entry(next, now);
+    hasNext = false;
+  }
+}
+
+void capture_task() {
+  if (streaming) log_pump();
+
+  uint8_t state = replayState.load(std::memory_order_acquire);
+  if (state == REPLAY_FEED) {
+    replay_pump();
+  } else if (state == REPLAY_DONE) {
+    replayState.store(REPLAY_IDLE, std::memory_order_release);
+    Serial.println("{\"ok\":\"replay_done\"}");
+  }
+}
+
+void capture_get_stats(CaptureStats &st) {
+  uint32_t h = ringHead.load(std::memory_order_acquire);
+  st.recorded = h - clearFrom;
+  st.logged = logged;
+  st.lost = lost;
+  st.segment = segment;
+  st.frozen = frozen;
+  st.streaming = streaming;
+  st.replaying = replayState.load(std::memory_order_acquire) != REPLAY_IDLE;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+#include "stats.h"
+
+// ======================================================
+// Запись входящих событий: кольцо в RAM, лог во flash, повтор
+// ======================================================
+// core1 пишет каждое событие на входе маршрутизатора (DIN, USB, клавиши)
+// со временем прихода и маской выходов, куда оно в итоге ушло. Запись —
+// копия нескольких байт в кольцо без блокировок; core0 только читает.
+//
+// Лог во flash (CAPTURE STREAM ON) ведёт core0: записи собираются
+// в блок 4 КБ и дописываются в файл целыми блоками; два файла по
+// CAPTURE_LOG_BLOCKS блоков сменяют друг друга (кольцо из двух сегментов).
+// core1 flash не ждёт никогда — не успевший core0 только теряет записи.
+//
+// Повтор (CAPTURE REPLAY) подаёт записи обратно на вход: DIN — через
+// process_midi_input(), USB — как пакет от хоста, клавиши — через
+// handle_hid_code(), с исходными интервалами (или подряд — FAST).
+
+#define CAPTURE_ENTRIES     512    // записей в кольце (степень двойки)
+#define CAPTURE_DATA        8      // байт данных в записи
+#define CAPTURE_LOG_BLOCK   4096   // блок LittleFS
+#define CAPTURE_LOG_BLOCKS  16     // блоков в сегменте лога (64 КБ)
+
+#define CAPTURE_CONT     0x80   // src: продолжение SysEx из прошлой записи
+#define CAPTURE_SEGMENT  0xFF   // src: заголовок сегмента лога (data — номер)
+
+// 16 байт: ровно 256 записей в блоке лога
+struct CaptureEntry {
+  uint32_t ts;      // время прихода, мкс (младшие 32 бита time_us_64)
+  uint16_t dest;    // маска DEST_*, куда событие ушло (0 — никуда)
+  uint8_t src;      // StatsSource | CAPTURE_CONT
+  uint8_t len;      // байт в data (0 — заполнитель до конца блока)
+  uint8_t data[CAPTURE_DATA];   // DIN — сообщение, USB — пакет, клавиши — код и нажатие
+};
+
+// Открытое событие core1: выходы отмечают себя, пока оно не закрыто
+struct CaptureOpen {
+  bool open;
+  uint16_t dest;
+};
+extern CaptureOpen captureOpen;
+
+/**
+ * @brief Выход получил сообщение открытого события (из диспетчера)
+ */
+static inline void capture_sink(uint8_t sink) {
+  if (captureOpen.open) captureOpen.dest |= 1u << sink;
+}
+
+/**
+ * @brief Начать запись события (core1); SysEx — до MIDI_SYSEX_CHUNK байт
+ */
+void capture_open(uint8_t src, const uint8_t *data, uint8_t len, uint32_t ts);
+
+/**
+ * @brief Закончить запись: маска выходов известна, запись видна core0
+ */
+void capture_close();
+void capture_cancel();   // событие не состоялось (выход был полон — повторят)
+
+// --- core0 ---
+struct CaptureStats {
+  uint32_t recorded;   // записей с последнего CLEAR
+  uint32_t logged;     // записей ушло в лог
+  uint32_t lost;       // лог не успел за кольцом
+  uint8_t segment;     // текущий файл лога (0/1)
+  bool frozen;
+  bool streaming;
+  bool replaying;
+};
+
+void capture_freeze(bool on);
+void capture_clear();
+void capture_get_stats(CaptureStats &st);
+
+/**
+ * @brief Напечатать кольцо одной строкой JSON (замораживает запись)
+ */
+void capture_dump(Print &out);
+
+bool capture_stream(bool on);
+
+/**
+ * @brief Запустить повтор кольца или лога
+ * @return false — повтор уже идёт или лога нет
+ */
+bool capture_replay(bool fromLog, bool fast);
+
+void capture_task();          // core0: лог и подача записей на повтор
+void capture_replay_task();   // core1: повтор в исходном темпе
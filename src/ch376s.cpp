@@ -1,64 +1,426 @@
-#pragma once
-#include <stdint.h>
-
-// ======================================================
-// ИНИЦИАЛИЗАЦИЯ И ОСНОВНЫЕ ФУНКЦИИ
-// ======================================================
-
-/**
- * @brief Инициализация всех MIDI интерфейсов:
- *  - USB (TinyUSB)
- *  - DIN MIDI (UART1 TX)
- *  - 10 TRS MIDI OUT через PIO
- */
-void setup_midi_output();
-
-/**
- * @brief Отправить произвольное MIDI сообщение через USB
- */
-void send_midi_usb(uint8_t status, uint8_t data1, uint8_t data2);
-
-/**
- * @brief Отправить MIDI сообщение через DIN (UART1 TX)
- */
-void send_midi_uart(uint8_t status, uint8_t data1, uint8_t data2);
-
-/**
- * @brief Отправить MIDI сообщение на один из 10 TRS портов (через PIO)
- * 
- * @param port индекс TRS-порта (0–9)
- */
-void send_midi_pio(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2);
-
-// ======================================================
-// ДОПОЛНИТЕЛЬНЫЕ УТИЛИТЫ
-// ======================================================
-
-/**
- * @brief Отправить NoteOn на все интерфейсы и порты
- */
-void noteOn_all(uint8_t note, uint8_t vel);
-
-/**
- * @brief Отправить NoteOff на все интерфейсы и порты
- */
-void noteOff_all(uint8_t note);
-
-/**
- * @brief Отправить Control Change на все интерфейсы
- * 
- * @param cc Номер контроллера (0–127)
- * @param val Значение (0–127)
- * @param ch MIDI канал (1–16)
- */
-void cc_all(uint8_t cc, uint8_t val, uint8_t ch = 1);
-
-/**
- * @brief Отправить Program Change на все интерфейсы
- */
-void programChange_all(uint8_t prog, uint8_t ch = 1);
-
-/**
- * @brief Тестовая функция — посылает аккорд C мажор на все выходы
- */
-void test_midi_outputs();
\ No newline at end of file
+#include "ch376s.h"
+#include "hid_report.h"
+#include "keymap.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+// ======================================================
+// Подключение CH376S (режим SPI)
+// ======================================================
+#define CH_SPI      spi0
+#define CH_MISO_PIN 0
+#define CH_CS_PIN   1
+#define CH_SCK_PIN  2
+#define CH_MOSI_PIN 3
+#define CH_INT_PIN  7          // INT# — низкий уровень, пока есть событие
+#define CH_SPI_HZ   4000000
+
+// --- Команды CH376 ---
+#define CMD_RESET_ALL     0x05
+#define CMD_CHECK_EXIST   0x06
+#define CMD_SET_RETRY     0x0B
+#define CMD_SET_USB_MODE  0x15
+#define CMD_GET_STATUS    0x22
+#define CMD_RD_USB_DATA0  0x27
+#define CMD_WR_HOST_DATA  0x2C
+#define CMD_AUTO_SETUP    0x4D
+#define CMD_ISSUE_TKN_X   0x4E
+
+// --- Ответы и статусы прерывания ---
+#define CMD_RET_SUCCESS     0x51
+#define USB_INT_SUCCESS     0x14
+#define USB_INT_CONNECT     0x15
+#define USB_INT_DISCONNECT  0x16
+
+#define USB_MODE_HOST       0x06   // хост, SOF включён
+#define USB_MODE_HOST_RESET 0x07   // хост, сброс шины
+#define USB_PID_OUT         0x01
+#define USB_PID_SETUP       0x0D
+#define USB_PID_IN          0x09
+#define RETRY_NAK_FOREVER   0x83   // NAK повторяет сам чип, INT# — только с данными
+#define CH_DESC_MAX         512    // самый длинный читаемый дескриптор
+
+// ======================================================
+// Состояние
+// ======================================================
+enum ChState : uint8_t {
+  CH_ABSENT,       // чип не ответил при старте
+  CH_WAIT_DEVICE,  // ждём подключения клавиатуры
+  CH_STREAM        // IN-токены в работе, отчёты читает IRQ
+};
+
+static ChState state = CH_ABSENT;
+static uint8_t kbdEp = 1;              // номер interrupt IN-эндпоинта
+static uint8_t kbdMaxPacket = HID_REPORT_SIZE;
+static HidLayout layout;               // где в отчёте клавиши (дескриптор или boot)
+static bool bootProtocol = true;       // дескриптор не разобран — boot protocol
+static volatile uint8_t toggle = 0;    // DATA0/DATA1 этого эндпоинта
+static volatile bool lost = false;     // IRQ увидел отключение
+static volatile bool swapped = false;  // ...и сразу новое подключение (CONNECT)
+static HidKeyBits lastKeys;            // нажатые клавиши по прошлому отчёту
+static bool faulted = false;           // сбой уже обработан, ждём годный отчёт
+static bool intLow = false;            // INT# был низким на прошлом проходе задачи
+static Ch376Stats stats;
+
+// ======================================================
+// SPI: команда — CS вниз, код, данные, CS вверх
+// ======================================================
+static inline void cs(bool active) {
+  gpio_put(CH_CS_PIN, !active);
+}
+
+static void cmd_begin(uint8_t cmd) {
+  cs(true);
+  spi_write_blocking(CH_SPI, &cmd, 1);
+  delayMicroseconds(2);    // чипу нужно ~1.5 мкс на разбор кода команды
+}
+
+static uint8_t rd() {
+  uint8_t b;
+  spi_read_blocking(CH_SPI, 0xFF, &b, 1);
+  return b;
+}
+
+static void wr(uint8_t b) {
+  spi_write_blocking(CH_SPI, &b, 1);
+}
+
+static uint8_t get_status() {
+  cmd_begin(CMD_GET_STATUS);
+  uint8_t s = rd();
+  cs(false);
+  return s;
+}
+
+static uint8_t read_data(uint8_t *buf, uint8_t max) {
+  cmd_begin(CMD_RD_USB_DATA0);
+  uint8_t len = rd();
+  for (uint8_t i = 0; i < len; i++) {
+    uint8_t b = rd();
+    if (i < max) buf[i] = b;
+  }
+  cs(false);
+  return len < max ? len : max;
+}
+
+static void issue_token(uint8_t ep, uint8_t pid, uint8_t tog) {
+  cmd_begin(CMD_ISSUE_TKN_X);
+  wr(tog ? 0xC0 : 0x00);    // бит 7 — toggle приёма, бит 6 — передачи
+  wr((uint8_t)((ep << 4) | pid));
+  cs(false);
+}
+
+// Ждём INT# и читаем статус (только при подключении, не в потоке)
+static uint8_t wait_int(uint32_t timeoutMs) {
+  unsigned long start = millis();
+  while (gpio_get(CH_INT_PIN)) {
+    if (millis() - start > timeoutMs) return 0;
+  }
+  return get_status();
+}
+
+// ======================================================
+// Управляющие передачи на EP0
+// ======================================================
+static bool control_setup(uint8_t reqType, uint8_t req, uint16_t value, uint16_t index, uint16_t length) {
+  const uint8_t setup[8] = {reqType, req, (uint8_t)value, (uint8_t)(value >> 8),
+                            (uint8_t)index, (uint8_t)(index >> 8), (uint8_t)length, (uint8_t)(length >> 8)};
+  cmd_begin(CMD_WR_HOST_DATA);
+  wr(sizeof(setup));
+  spi_write_blocking(CH_SPI, setup, sizeof(setup));
+  cs(false);
+
+  issue_token(0, USB_PID_SETUP, 0);
+  return wait_int(100) == USB_INT_SUCCESS;
+}
+
+// Без данных (SET_PROTOCOL, SET_IDLE)
+static bool control_out(uint8_t reqType, uint8_t req, uint16_t value, uint16_t index) {
+  if (!control_setup(reqType, req, value, index, 0)) return false;
+  issue_token(0, USB_PID_IN, 1);          // статус-стадия: пустой IN, DATA1
+  return wait_int(100) == USB_INT_SUCCESS;
+}
+
+// С данными от устройства (GET_DESCRIPTOR): пакеты по bMaxPacketSize0,
+// DATA1/DATA0 по очереди, конец — короткий пакет или len байт
+// @return сколько байт принято, -1 — ошибка передачи
+static int16_t control_in(uint8_t reqType, uint8_t req, uint16_t value, uint16_t index,
+                          uint8_t *buf, uint16_t len) {
+  if (!control_setup(reqType, req, value, index, len)) return -1;
+
+  uint16_t got = 0;
+  uint8_t tog = 1, packet = 0;
+  while (got < len) {
+    issue_token(0, USB_PID_IN, tog);
+    if (wait_int(100) != USB_INT_SUCCESS) return -1;
+    tog ^= 1;
+    uint16_t room = len - got;
+    uint8_t n = read_data(buf + got, room < 64 ? (uint8_t)room : 64);
+    got += n;
+    if (!packet) packet = n;
+    if (n == 0 || n < packet) break;
+  }
+
+  cmd_begin(CMD_WR_HOST_DATA);            // статус-стадия: пустой OUT, DATA1
+  wr(0);
+  cs(false);
+  issue_token(0, USB_PID_OUT, 1);
+  if (wait_int(100) != USB_INT_SUCCESS) return -1;
+  return (int16_t)got;
+}
+
+// ======================================================
+// Конфигурационный дескриптор → interrupt IN клавиатуры
+// ======================================================
+static uint8_t desc[CH_DESC_MAX];       // дескрипторы при подключении (core0)
+
+// Весь дескриптор (wTotalLength бывает больше 64 байт: составные
+// устройства, клавиатура — не первый интерфейс)
+static bool find_keyboard(uint8_t &ep, uint8_t &iface, uint8_t &maxPacket, uint16_t &reportLen) {
+  int16_t got = control_in(0x80, 0x06, 0x0200, 0, desc, sizeof(desc));   // GET_DESCRIPTOR: config
+  if (got < 9) return false;
+  const uint8_t *d = desc;
+  uint16_t len = (uint16_t)got;
+  bool inKeyboard = false;
+
+  for (uint16_t i = 0; i + 1 < len && d[i]; i += d[i]) {
+    uint8_t type = d[i + 1];
+    if (type == 0x04 && i + 7 < len) {     // интерфейс: HID / keyboard (boot или нет)
+      inKeyboard = d[i + 5] == 0x03 && d[i + 7] == 0x01;
+      if (inKeyboard) iface = d[i + 2];
+      reportLen = 0;
+    } else if (type == 0x21 && inKeyboard && i + 8 < len) {   // HID: длина дескриптора отчёта
+      if (d[i + 6] == 0x22) reportLen = (uint16_t)(d[i + 7] | d[i + 8] << 8);
+    } else if (type == 0x05 && inKeyboard && i + 4 < len) {
+      if ((d[i + 2] & 0x80) && (d[i + 3] & 0x03) == 0x03) {   // IN, interrupt
+        ep = d[i + 2] & 0x0F;
+        maxPacket = d[i + 4] < HID_REPORT_MAX ? d[i + 4] : HID_REPORT_MAX;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// ======================================================
+// IRQ по INT#: отчёт → события клавиш → core1
+// ======================================================
+static void post_key(uint8_t code, bool pressed, void *ctx) {
+  uint32_t ts = *(const uint32_t *)ctx;
+  if (keymap_post_hid(code, pressed, ts)) stats.events++;
+  else stats.dropped++;
+}
+
+// Ошибочный отчёт или транзакция: всё нажатое отпускаем и шлём
+// All Notes Off — один раз на сбой, до следующего годного отчёта
+static void report_error(uint32_t ts) {
+  if (faulted) return;
+  faulted = true;
+  static const HidKeyBits none = {};
+  hid_bits_diff(lastKeys, none, post_key, &ts);
+  lastKeys = none;
+  if (keymap_post_all_notes_off(ts)) stats.panics++;
+  else stats.dropped++;
+}
+
+static void ch376s_irq() {
+  if (gpio_get(CH_INT_PIN)) return;       // событие уже разобрал опрос из задачи
+  uint32_t ts = (uint32_t)time_us_64();
+  uint8_t s = get_status();
+
+  if (s == USB_INT_DISCONNECT || s == USB_INT_CONNECT) {
+    swapped = (s == USB_INT_CONNECT);    // статус прочитан — задача его уже не увидит
+    lost = true;
+    return;
+  }
+
+  if (s == USB_INT_SUCCESS) {
+    uint8_t report[HID_REPORT_MAX];
+    uint8_t len = read_data(report, kbdMaxPacket);
+    toggle ^= 1;
+    stats.reports++;
+
+    HidKeyBits keys;
+    switch (hid_report_bits(layout, report, len, keys)) {
+      case HID_REPORT_KEYS:
+        hid_bits_diff(lastKeys, keys, post_key, &ts);
+        lastKeys = keys;
+        faulted = false;
+        break;
+      case HID_REPORT_ERROR:
+        stats.rollover++;
+        report_error(ts);
+        break;
+      default:            // отчёт другого Report ID того же интерфейса
+        break;
+    }
+  } else {
+    stats.errors++;       // STALL/таймаут — повторяем токен
+    report_error(ts);
+  }
+
+  issue_token(kbdEp, USB_PID_IN, toggle);
+}
+
+// ======================================================
+// Подключение клавиатуры (core0, с ожиданиями — не в потоке)
+// ======================================================
+static void release_all() {
+  // всё, что было нажато, отпускаем — иначе ноты повиснут
+  static const HidKeyBits none = {};
+  uint32_t ts = (uint32_t)time_us_64();
+  hid_bits_diff(lastKeys, none, post_key, &ts);
+  lastKeys = none;
+}
+
+static bool set_usb_mode(uint8_t mode) {
+  cmd_begin(CMD_SET_USB_MODE);
+  wr(mode);
+  delayMicroseconds(20);
+  uint8_t r = rd();
+  cs(false);
+  return r == CMD_RET_SUCCESS;
+}
+
+static bool attach_keyboard() {
+  set_usb_mode(USB_MODE_HOST_RESET);
+  delay(15);
+  set_usb_mode(USB_MODE_HOST);
+  delay(100);                              // устройство поднимается после сброса
+
+  cmd_begin(CMD_AUTO_SETUP);               // адрес + SET_CONFIGURATION
+  cs(false);
+  if (wait_int(500) != USB_INT_SUCCESS) return false;
+
+  uint8_t iface = 0;
+  uint16_t reportLen = 0;
+  if (!find_keyboard(kbdEp, iface, kbdMaxPacket, reportLen)) return false;
+
+  // раскладку отчёта даёт его дескриптор (report protocol: NKRO, Report ID);
+  // не прочитали или не разобрали — boot protocol, 8 байт известного вида
+  int16_t got = -1;
+  if (reportLen && reportLen <= sizeof(desc))
+    got = control_in(0x81, 0x06, 0x2200, iface, desc, reportLen);   // GET_DESCRIPTOR: report
+  bootProtocol = got <= 0 || !hid_parse_report_desc(desc, (uint16_t)got, layout) ||
+                 layout.size + (layout.reportId ? 1 : 0) > kbdMaxPacket;
+  if (bootProtocol) {
+    hid_layout_boot(layout);
+    control_out(0x21, 0x0B, 0, iface);     // SET_PROTOCOL: boot
+  }
+  control_out(0x21, 0x0A, 0, iface);       // SET_IDLE: отчёт только при изменении
+
+  cmd_begin(CMD_SET_RETRY);
+  wr(0x25);
+  wr(RETRY_NAK_FOREVER);
+  cs(false);
+
+  memset(&lastKeys, 0, sizeof(lastKeys));
+  faulted = false;
+  toggle = 0;
+  lost = false;
+  intLow = false;
+  // IRQ — до первого токена: клавиатура может ответить сразу (клавиша
+  // уже нажата), и спад INT# до attachInterrupt() не защёлкнется
+  attachInterrupt(digitalPinToInterrupt(CH_INT_PIN), ch376s_irq, FALLING);
+  issue_token(kbdEp, USB_PID_IN, toggle);
+  return true;
+}
+
+// ======================================================
+// Инициализация
+// ======================================================
+void setup_ch376s() {
+  spi_init(CH_SPI, CH_SPI_HZ);
+  gpio_set_function(CH_MISO_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(CH_SCK_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(CH_MOSI_PIN, GPIO_FUNC_SPI);
+
+  gpio_init(CH_CS_PIN);
+  gpio_set_dir(CH_CS_PIN, GPIO_OUT);
+  cs(false);
+
+  gpio_init(CH_INT_PIN);
+  gpio_set_dir(CH_INT_PIN, GPIO_IN);
+  gpio_pull_up(CH_INT_PIN);
+
+  cmd_begin(CMD_RESET_ALL);
+  cs(false);
+  delay(50);
+
+  cmd_begin(CMD_CHECK_EXIST);
+  wr(0x57);
+  uint8_t echo = rd();
+  cs(false);
+  if (echo != (uint8_t)~0x57) {
+    Serial.println("[CH376S] ❌ Not found on SPI0");
+    return;
+  }
+
+  if (!set_usb_mode(USB_MODE_HOST)) {
+    Serial.println("[CH376S] ❌ Host mode failed");
+    return;
+  }
+  state = CH_WAIT_DEVICE;
+  Serial.println("[CH376S] ✅ USB host ready (SPI0, INT# GP7)");
+}
+
+// INT# низкий второй проход подряд — фронт потерян (шум, спад во время
+// detach/attach): разбираем событие сами, иначе поток IN-токенов встанет
+static void poll_int() {
+  bool low = !gpio_get(CH_INT_PIN);
+  if (!low || !intLow) {
+    intLow = low;
+    return;
+  }
+  intLow = false;
+  uint32_t s = save_and_disable_interrupts();
+  if (!gpio_get(CH_INT_PIN)) {
+    stats.polled++;
+    ch376s_irq();
+  }
+  restore_interrupts(s);
+}
+
+// ======================================================
+// Основная задача (core0): подключение/отключение устройства
+// ======================================================
+void ch376s_task() {
+  switch (state) {
+    case CH_WAIT_DEVICE:
+      if (!swapped) {
+        if (gpio_get(CH_INT_PIN)) return;  // INT# не опущен — ничего нового
+        if (get_status() != USB_INT_CONNECT) return;
+      }
+      swapped = false;
+      if (attach_keyboard()) {
+        state = CH_STREAM;
+        stats.connects++;
+        Serial.printf("[CH376S] ⌨️ Keyboard attached (EP%u, %s)\n", kbdEp,
+                      bootProtocol ? "boot" : layout.mapByte != HID_NONE ? "NKRO" : "report");
+      } else {
+        Serial.println("[CH376S] ⚠️ Device is not a keyboard");
+      }
+      break;
+
+    case CH_STREAM:
+      poll_int();
+      if (!lost) return;
+      detachInterrupt(digitalPinToInterrupt(CH_INT_PIN));
+      release_all();
+      state = CH_WAIT_DEVICE;
+      Serial.println("[CH376S] Keyboard detached");
+      break;
+
+    default:
+      break;
+  }
+}
+
+void ch376s_get_stats(Ch376Stats &st) {
+  st = stats;
+  st.attached = (state == CH_STREAM);
+  st.nkro = st.attached && layout.mapByte != HID_NONE;
+  st.boot = st.attached && bootProtocol;
+}
@@ -1,9 +1,25 @@
 #pragma once
 #include <Arduino.h>
 
-// Инициализация и опрос CH376S
+// Инициализация и опрос CH376S (USB-хост для HID-клавиатуры, SPI0)
 void setup_ch376s();
 void ch376s_task();
 
+// Счётчики клавиатуры
+struct Ch376Stats {
+  uint32_t reports;    // прочитано отчётов HID
+  uint32_t events;     // нажатий/отпусканий отправлено в core1
+  uint32_t dropped;    // очередь в core1 была полна
+  uint32_t rollover;   // отчёты-ошибки (ErrorRollOver: > 6 клавиш, POST fail)
+  uint32_t errors;     // неудачные IN-транзакции
+  uint32_t panics;     // сбоев, после которых отправлен All Notes Off
+  uint32_t connects;   // подключений клавиатуры
+  uint32_t polled;     // событий INT#, разобранных опросом (фронт потерян)
+  bool attached;
+  bool nkro;           // в отчёте битовая карта клавиш (NKRO)
+  bool boot;           // дескриптор отчёта не разобран — boot protocol
+};
+void ch376s_get_stats(Ch376Stats &st);
+
 // Включение отладочного вывода (необязательно)
-// #define DEBUG_CH376S
\ No newline at end of file
+// #define DEBUG_CH376S
@@ -1,7 +1,42 @@
 #include "config_manager.h"
+#include "arena_allocator.h"
+#include "preset_store.h"
 #include <LittleFS.h>
+#include <malloc.h>
+#include <atomic>
+#include "spsc_queue.h"
+#include "note_state.h"
+#include "hardware/timer.h"
 
-DynamicJsonDocument configDoc(8192);
+ConfigModel config;
+
+// --- Разбор JSON: арена живёт только на время импорта ---
+static uint8_t arenaBuf[CONFIG_ARENA_SIZE] __attribute__((aligned(8)));
+static ArenaAllocator arena(arenaBuf, sizeof(arenaBuf));
+static ConfigModel staging;     // сюда импортируем, в config — только при успехе
+
+// --- Двойной буфер таблицы маршрутов ---
+static RouteTable routeTables[2];
+static std::atomic<const RouteTable*> activeTable{&routeTables[0]};
+static std::atomic<uint32_t> publishEpoch{0};   // пишет core0
+static std::atomic<uint32_t> ackEpoch{0};       // пишет core1
+static std::atomic<bool> core1Reading{false};   // core1 начал проходы (читает таблицы)
+
+// --- Таблица, которой пользуется core1 ---
+// Обычно это последняя публикация core0, но Program Change может
+// переключить её прямо на core1. core0 видит её через core1InUse.
+static const RouteTable *core1Table = &routeTables[0];
+static uint32_t core1Epoch = 0;
+static std::atomic<const RouteTable*> core1InUse{&routeTables[0]};
+
+// --- Вызов пресетов по MIDI ---
+static SpscQueue<uint16_t, 8> recallQueue;       // core1 → core0 (номер пресета)
+static volatile uint8_t controlChannel = PRESET_CONTROL_CHANNEL;
+static PresetRecallStats recallStats;
+
+static void wait_routes_ack();
+static void publish_routes(const RouteTable *t);
+static void migrate_json_presets();
 
 // ======================================================
 // Инициализация и базовая загрузка конфигурации
@@ -21,33 +56,160 @@ void setup_config() {
     load_current();
   }
 
+  compile_routes();
   print_config_summary();
+
+  // --- Бинарные пресеты во flash (+ перенос старых /presetN.json) ---
+  if (preset_store_begin())
+    migrate_json_presets();
 }
 
 // ======================================================
-// Создание дефолтного JSON-конфига
+// Создание дефолтного конфига
 // ======================================================
 void create_default_config() {
-  configDoc.clear();
+  config_model_default(config);
+}
+
+// ======================================================
+// Импорт / экспорт JSON
+// ======================================================
+static DeserializationError import_json(Stream &in, ConfigModel &out) {
+  DeserializationError err;
+  {
+    JsonDocument doc(&arena);
+    err = deserializeJson(doc, in);
+    if (!err && !doc.is<JsonObject>())
+      err = DeserializationError::InvalidInput;
+    if (!err && !config_model_import(doc.as<JsonObjectConst>(), out))
+      err = DeserializationError::NoMemory;
+  }
+  arena.reset();
+  return err;
+}
+
+DeserializationError config_import(Stream &in) {
+  DeserializationError err = import_json(in, staging);
+  if (!err) config = staging;
+  return err;
+}
+
+// Маска назначений → "USB","A" (json) или USB+A (лог)
+static void print_ports(Print &out, uint16_t dest, bool json) {
+  bool first = true;
+  for (uint16_t m = dest; m; m &= m - 1) {
+    const char *name = route_sink_name(__builtin_ctz(m));
+    out.printf(json ? "%s\"%s\"" : "%s%s", first ? "" : (json ? "," : "+"), name);
+    first = false;
+  }
+}
+
+// Правило thru; поля "все каналы"/"все типы"/"без смены канала" опускаем
+static void export_thru_rule(Print &out, const ThruRule &r, bool first) {
+  out.printf("%s{\"in\":\"%s\"", first ? "" : ",", route_thru_input_name(r.in));
+  if (r.channels != 0xFFFF) {
+    out.print(",\"channels\":[");
+    bool f = true;
+    for (uint8_t ch = 0; ch < 16; ch++)
+      if (r.channels & (1u << ch)) { out.printf("%s%u", f ? "" : ",", ch + 1); f = false; }
+    out.print("]");
+  }
+  if (r.types != 0xFF) {
+    out.print(",\"types\":[");
+    bool f = true;
+    for (uint8_t t = 0; t < THRU_TYPES; t++)
+      if (r.types & (1u << t)) { out.printf("%s\"%s\"", f ? "" : ",", route_thru_type_name(t)); f = false; }
+    out.print("]");
+  }
+  out.print(",\"ports\":[");
+  print_ports(out, r.dest, true);
+  out.print("]");
+  if (r.remap) out.printf(",\"remap\":%u", r.remap);
+  if (r.curve) out.printf(",\"curve\":%u", r.curve);
+  out.print("}");
+}
 
-  // дефолтная карта клавиш (C4–E4)
-  JsonObject n1 = configDoc.createNestedObject("0x1D");
-  n1["type"] = "note";
-  n1["value"] = 60;
-  n1["port"] = "USB";
-  n1["channel"] = 1;
+// Кривая; поля, не нужные её типу, опускаем
+static void export_curve(Print &out, const CurveDef &c, bool first) {
+  out.printf("%s{\"type\":\"%s\"", first ? "" : ",", curve_type_name(c.type));
+  switch (c.type) {
+    case CURVE_FIXED:
+      out.printf(",\"value\":%u", c.min);
+      break;
+    case CURVE_USER:
+      out.print(",\"points\":[");
+      for (uint8_t i = 0; i < c.count; i++) out.printf("%s%u", i ? "," : "", c.points[i]);
+      out.print("]");
+      break;
+    case CURVE_EXP:
+      out.printf(",\"shape\":%d", c.shape);
+      // fallthrough
+    default:
+      out.printf(",\"min\":%u,\"max\":%u", c.min, c.max);
+      break;
+  }
+  if (c.flags & CURVE_FROM_RATE) out.print(",\"rate\":true");
+  out.print("}");
+}
+
+// Назначения одного слоя: "0x1D":{...},...; first — ещё ничего не выведено
+static void export_keys(Print &out, uint8_t layer, bool &first) {
+  for (uint16_t i = 0; i < config.count; i++) {
+    const KeyMapping &k = config.keys[i];
+    if (k.layer != layer) continue;
+    out.printf("%s\"0x%02X\":{\"type\":\"%s\",\"value\":%u,\"ports\":[",
+               first ? "" : ",", k.hid,
+               k.type == ROUTE_NOTE ? "note" : "cc", k.value);
+    print_ports(out, k.dest, true);
+    out.printf("],\"channel\":%u", k.channel);
+    if (k.curve) out.printf(",\"curve\":%u", k.curve);
+    out.print("}");
+    first = false;
+  }
+}
 
-  JsonObject n2 = configDoc.createNestedObject("0x1B");
-  n2["type"] = "note";
-  n2["value"] = 62;
-  n2["port"] = "USB";
-  n2["channel"] = 1;
+void config_export(Print &out) {
+  out.print("{");
+  bool first = true;
+  export_keys(out, LAYER_BASE, first);
 
-  JsonObject n3 = configDoc.createNestedObject("0x06");
-  n3["type"] = "note";
-  n3["value"] = 64;
-  n3["port"] = "USB";
-  n3["channel"] = 1;
+  // слои — вложенными объектами, только непустые
+  for (uint8_t layer = LAYER_BASE + 1; layer < KEY_LAYERS; layer++) {
+    bool used = false;
+    for (uint16_t i = 0; i < config.count && !used; i++)
+      used = config.keys[i].layer == layer;
+    if (!used) continue;
+    out.printf("%s\"%s\":{", first ? "" : ",", route_layer_name(layer));
+    bool firstKey = true;
+    export_keys(out, layer, firstKey);
+    out.print("}");
+    first = false;
+  }
+
+  if (config.curveCount) {
+    out.printf("%s\"curves\":[", first ? "" : ",");
+    for (uint16_t i = 0; i < config.curveCount; i++)
+      export_curve(out, config.curves[i], i == 0);
+    out.print("]");
+    first = false;
+  }
+
+  if (config.thruCount) {
+    out.printf("%s\"thru\":[", first ? "" : ",");
+    for (uint16_t i = 0; i < config.thruCount; i++)
+      export_thru_rule(out, config.thru[i], i == 0);
+    out.print("]");
+  }
+  out.print("}");
+}
+
+void config_get_mem(ConfigMemStats &st) {
+  struct mallinfo mi = mallinfo();
+  st.heapUsed = mi.uordblks;
+  st.heapPeak = mi.arena;
+  st.heapTotal = rp2040.getTotalHeap();
+  st.arenaPeak = arena.peak();
+  st.arenaSize = arena.capacity();
 }
 
 // ======================================================
@@ -59,7 +221,7 @@ void save_current() {
     Serial.println("[CONFIG] ❌ Save failed");
     return;
   }
-  serializeJson(configDoc, f);
+  config_export(f);
   f.close();
   Serial.println("[CONFIG] 💾 Saved current config");
 }
@@ -76,7 +238,7 @@ void load_current() {
     return;
   }
 
-  DeserializationError err = deserializeJson(configDoc, f);
+  DeserializationError err = config_import(f);
   f.close();
 
   if (err) {
@@ -89,80 +251,187 @@ void load_current() {
 }
 
 // ======================================================
-// Управление пресетами
+// Управление пресетами (бинарные образы во flash)
 // ======================================================
-void save_preset(uint8_t id) {
-  if (id < 1 || id > MAX_PRESETS) return;
-  String path = "/preset" + String(id) + ".json";
+static PresetImage presetBuild;   // сборка образа перед записью
 
-  File f = LittleFS.open(path, "w");
-  if (!f) {
+static bool write_preset(uint16_t id, const ConfigModel &model) {
+  char name[16];
+  snprintf(name, sizeof(name), "Preset %u", id);
+  preset_image_build(model, name, presetBuild);
+
+  // ядро MIDI может читать этот слот прямо сейчас — сначала уводим
+  // его на копию в RAM и ждём подтверждения
+  if (preset_store_contains(core1InUse.load(std::memory_order_acquire))) {
+    compile_routes();
+    wait_routes_ack();
+  }
+  return preset_store_write(id, presetBuild);
+}
+
+// Однократный перенос JSON-пресетов из LittleFS в пустые слоты
+static void migrate_json_presets() {
+  for (uint16_t id = 1; id <= MAX_PRESETS; id++) {
+    if (preset_store_get(id)) continue;
+
+    char path[24];
+    snprintf(path, sizeof(path), "/preset%u.json", id);
+    if (!LittleFS.exists(path)) continue;
+
+    File f = LittleFS.open(path, "r");
+    if (!f) continue;
+    DeserializationError err = import_json(f, staging);
+    f.close();
+
+    if (!err && write_preset(id, staging))
+      Serial.printf("[CONFIG] ➡️ Preset %d migrated from %s\n", id, path);
+  }
+}
+
+bool save_preset(uint16_t id) {
+  if (id < 1 || id > MAX_PRESETS) return false;
+
+  if (!write_preset(id, config)) {
     Serial.printf("[CONFIG] ❌ Preset %d save failed\n", id);
-    return;
+    return false;
   }
-  serializeJson(configDoc, f);
-  f.close();
-  Serial.printf("[CONFIG] 💾 Preset %d saved (%s)\n", id, path.c_str());
+  Serial.printf("[CONFIG] 💾 Preset %d saved (flash slot)\n", id);
+  return true;
 }
 
-void load_preset(uint8_t id) {
-  if (id < 1 || id > MAX_PRESETS) return;
-  String path = "/preset" + String(id) + ".json";
+bool load_preset(uint16_t id) {
+  if (id < 1 || id > MAX_PRESETS) return false;
+  uint32_t t0 = micros();
 
-  if (!LittleFS.exists(path)) {
+  const PresetImage *img = preset_store_get(id);
+  if (!img) {
     Serial.printf("[CONFIG] ⚠️ Preset %d missing. Ignored.\n", id);
-    return;
+    return false;
   }
 
-  File f = LittleFS.open(path, "r");
-  if (!f) {
-    Serial.printf("[CONFIG] ❌ Cannot open preset %d\n", id);
-    return;
+  // переключение — это только смена указателя на таблицу в XIP;
+  // модель копируется в RAM лишь для редактора (GET_CONFIG).
+  // NoteOff по новой таблице уйдут не туда — гасим то, что звучит
+  notes_post_release(DEST_ALL);
+  publish_routes(&img->routes);
+  config = img->model;
+
+  Serial.printf("[CONFIG] ✅ Preset %d loaded (%lu us)\n", id, (unsigned long)(micros() - t0));
+  return true;
+}
+
+// ======================================================
+// Вызов пресета по MIDI
+// ======================================================
+bool preset_recall(uint16_t id, uint32_t ts) {
+  const PresetImage *img = preset_store_get(id);
+  if (!img) {
+    recallStats.misses++;
+    return false;
   }
 
-  configDoc.clear();
-  DeserializationError err = deserializeJson(configDoc, f);
-  f.close();
+  core1Table = &img->routes;
+  core1InUse.store(core1Table, std::memory_order_release);
 
-  if (err) {
-    Serial.printf("[CONFIG] ⚠️ Error loading preset %d: %s\n", id, err.c_str());
-  } else {
-    Serial.printf("[CONFIG] ✅ Preset %d loaded\n", id);
-    save_current(); // обновляем активный
+  uint32_t lat = (uint32_t)time_us_64() - ts;
+  recallStats.count++;
+  recallStats.lastId = id;
+  recallStats.lastUs = lat;
+  if (lat > recallStats.maxUs) recallStats.maxUs = lat;
+
+  notes_release(DEST_ALL);   // как LOAD_PRESET
+
+  recallQueue.push(id);
+  return true;
+}
+
+void preset_task() {
+  uint16_t id;
+  while (recallQueue.pop(id)) {
+    const PresetImage *img = preset_store_get(id);
+    if (!img) continue;
+    config = img->model;   // редактор (GET_CONFIG) видит вызванный пресет
+    Serial.printf("[CONFIG] 🎛️ Preset %u recalled by MIDI (%lu us)\n",
+                  id, (unsigned long)recallStats.lastUs);
   }
 }
 
+void preset_set_control_channel(uint8_t ch) {
+  controlChannel = (ch <= 16) ? ch : 0;
+}
+
+uint8_t preset_get_control_channel() {
+  return controlChannel;
+}
+
+void preset_get_recall_stats(PresetRecallStats &st) {
+  st = recallStats;
+}
+
 // ======================================================
 // Вспомогательные функции
 // ======================================================
-KeyConfig get_key_config(const String &hid) {
-  KeyConfig k{};
-  if (configDoc.containsKey(hid)) {
-    JsonObject obj = configDoc[hid].as<JsonObject>();
-    k.type = obj["type"].as<String>();
-    k.value = obj["value"].as<int>();
-    k.port = obj["port"].as<String>();
-    k.channel = obj["channel"].as<int>();
-  } else {
-    // fallback
-    k.type = "note";
-    k.value = 60;
-    k.port = "USB";
-    k.channel = 1;
+const RouteTable *active_routes() {
+  return core1Table;
+}
+
+void routes_ack() {
+  // флаг — до первой загрузки таблицы (seq_cst, пара к publish_routes)
+  if (!core1Reading.load(std::memory_order_relaxed)) core1Reading.store(true);
+  uint32_t epoch = publishEpoch.load(std::memory_order_acquire);
+  if (epoch != core1Epoch) {
+    core1Epoch = epoch;
+    core1Table = activeTable.load(std::memory_order_acquire);
+    core1InUse.store(core1Table, std::memory_order_release);
   }
-  return k;
+  ackEpoch.store(epoch, std::memory_order_release);
+}
+
+const RouteTable *routes_in_use() {
+  return core1InUse.load(std::memory_order_acquire);
+}
+
+// core1 мог ещё не увидеть последнюю публикацию — тогда он может
+// читать прежнюю таблицу, а её сейчас перепишут. Ждём подтверждения
+// без таймаута (core1 крутится без пауз, так что это микросекунды).
+// Пока core1 не начал проходы (setup), он таблиц не читает — ждать нечего.
+static void wait_routes_ack() {
+  if (!core1Reading.load()) return;
+  uint32_t epoch = publishEpoch.load(std::memory_order_relaxed);
+  while (ackEpoch.load(std::memory_order_acquire) != epoch)
+    tight_loop_contents();
+}
+
+// Атомарная смена активной таблицы (RAM-буфер или образ в XIP)
+static void publish_routes(const RouteTable *t) {
+  activeTable.store(t);   // seq_cst: пара к флагу core1Reading (wait_routes_ack)
+  // пишет только core0 — обычный store, без RMW (у M0+ нет LDREX/STREX)
+  publishEpoch.store(publishEpoch.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void compile_routes() {
+  wait_routes_ack();
+
+  const RouteTable *cur = activeTable.load(std::memory_order_relaxed);
+  RouteTable *next = (cur == &routeTables[0]) ? &routeTables[1] : &routeTables[0];
+  route_table_compile(config, *next);
+
+  publish_routes(next);
 }
 
 void print_config_summary() {
   Serial.println("[CONFIG] Summary:");
-  for (JsonPair kv : configDoc.as<JsonObject>()) {
-    String key = kv.key().c_str();
-    JsonObject o = kv.value().as<JsonObject>();
-    Serial.printf("  HID %s → %s %d (Port %s, Ch %d)\n",
-                  key.c_str(),
-                  o["type"].as<const char*>(),
-                  o["value"].as<int>(),
-                  o["port"].as<const char*>(),
-                  o["channel"].as<int>());
-  }
-}
\ No newline at end of file
+  for (uint16_t i = 0; i < config.count; i++) {
+    const KeyMapping &k = config.keys[i];
+    Serial.printf("  HID 0x%02X%s%s → %s %d (Port ",
+                  k.hid, k.layer ? " +" : "", k.layer ? route_layer_name(k.layer) : "",
+                  k.type == ROUTE_NOTE ? "note" : "cc",
+                  k.value);
+    print_ports(Serial, k.dest, false);
+    Serial.printf(", Ch %d)\n", k.channel);
+  }
+  if (config.thruCount)
+    Serial.printf("  MIDI IN thru: %u rule(s)\n", config.thruCount);
+  if (config.curveCount)
+    Serial.printf("  Curves: %u\n", config.curveCount);
+}
@@ -1,27 +1,25 @@
 #pragma once
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include "config_model.h"
+#include "route_table.h"
 
 // ==========================
 // Конфигурация хранения
 // ==========================
-#define MAX_PRESETS 3
+#define PRESETS_PER_BANK 128     // Program Change 0–127
+#ifndef PRESET_BANKS
+#define PRESET_BANKS 1           // банков (Bank Select MSB); 1 МБ flash на банк
+#endif
+#define MAX_PRESETS (PRESETS_PER_BANK * PRESET_BANKS)
+#define PRESET_CONTROL_CHANNEL 16   // канал Bank Select / Program Change (0 — выкл)
 #define CONFIG_PATH "/config_current.json"
-
-// ==========================
-// Структура маппинга клавиши
-// ==========================
-struct KeyConfig {
-  String type;    // "note" или "cc"
-  int value;      // номер ноты или CC
-  String port;    // "USB", "DIN", "A"…"J"
-  int channel;    // MIDI-канал (1–16)
-};
+#define CONFIG_ARENA_SIZE (16 * 1024)   // буфер разбора JSON (не куча)
 
 // ==========================
 // Глобальные переменные
 // ==========================
-extern DynamicJsonDocument configDoc;
+extern ConfigModel config;      // текущая конфигурация (рабочая копия)
 
 // ==========================
 // Функции управления
@@ -30,7 +28,56 @@ void setup_config();
 void create_default_config();
 void save_current();
 void load_current();
-void save_preset(uint8_t id);
-void load_preset(uint8_t id);
+bool save_preset(uint16_t id);  // false — id вне 1–MAX_PRESETS или flash не записалась
+bool load_preset(uint16_t id);  // false — id вне диапазона или слот пуст
 void print_config_summary();
-KeyConfig get_key_config(const String &hid);
\ No newline at end of file
+void compile_routes();          // config → неактивный буфер → публикация
+
+// ==========================
+// Импорт / экспорт JSON
+// ==========================
+// Разбор идёт в статическую арену; при ошибке config не меняется.
+DeserializationError config_import(Stream &in);
+void config_export(Print &out);
+
+// ==========================
+// Память
+// ==========================
+struct ConfigMemStats {
+  size_t heapUsed;     // занято в куче сейчас
+  size_t heapPeak;     // максимум кучи (newlib не возвращает память системе)
+  size_t heapTotal;
+  size_t arenaPeak;    // максимум арены JSON
+  size_t arenaSize;
+};
+void config_get_mem(ConfigMemStats &st);
+
+// ==========================
+// Таблица маршрутов для ядра MIDI (core1)
+// ==========================
+// Двойной буфер: core0 компилирует в неактивную копию и атомарно
+// меняет указатель. core1 только читает указатель и раз в проход
+// подтверждает, что больше не держит старую копию — без блокировок.
+const RouteTable *active_routes();   // только core1
+void routes_ack();              // вызывать из core1 в начале каждого прохода
+const RouteTable *routes_in_use();   // любое ядро: таблица, которую сейчас читает core1
+
+// ==========================
+// Вызов пресета по MIDI (core1)
+// ==========================
+// Bank Select + Program Change на управляющем канале: core1 сам
+// переключает указатель на таблицу в XIP (O(1), без flash/FS),
+// а core0 потом лишь подтягивает модель для редактора.
+struct PresetRecallStats {
+  uint32_t count;
+  uint32_t misses;      // запрошен пустой слот
+  uint32_t lastUs;      // от прихода Program Change до смены таблицы
+  uint32_t maxUs;
+  uint16_t lastId;
+};
+
+bool preset_recall(uint16_t id, uint32_t ts);   // core1
+void preset_task();                             // core0: догоняет вызовы из core1
+void preset_set_control_channel(uint8_t ch);    // 1–16, 0 — выкл
+uint8_t preset_get_control_channel();
+void preset_get_recall_stats(PresetRecallStats &st);
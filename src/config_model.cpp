@@ -0,0 +1,148 @@
+#include "config_model.h"
+#include "route_table.h"
+#include "curve.h"
+#include <stdlib.h>
+#include <string.h>
+
+void config_model_default(ConfigModel &m) {
+  // дефолтная карта клавиш (C4–E4)
+  static const KeyMapping defaults[] = {
+    {0x1D, ROUTE_NOTE, 60, 1, DEST_USB, LAYER_BASE, 0},
+    {0x1B, ROUTE_NOTE, 62, 1, DEST_USB, LAYER_BASE, 0},
+    {0x06, ROUTE_NOTE, 64, 1, DEST_USB, LAYER_BASE, 0},
+  };
+  m.count = sizeof(defaults) / sizeof(defaults[0]);
+  memcpy(m.keys, defaults, sizeof(defaults));
+  m.thruCount = 0;   // thru без правил — всё на все выходы
+  m.curveCount = 0;
+}
+
+// "0x1D" → 0x1D; -1, если ключ не HID-код
+static int parse_hid(const char *key) {
+  if (!key || key[0] != '0' || (key[1] != 'x' && key[1] != 'X')) return -1;
+  char *end;
+  long v = strtol(key + 2, &end, 16);
+  if (end == key + 2 || *end != '\0' || v < 0 || v > 0xFF) return -1;
+  return (int)v;
+}
+
+// "ports":[...] → маска; без него — прежнее одиночное "port"
+static uint16_t parse_dest(JsonObjectConst o) {
+  JsonArrayConst ports = o["ports"].as<JsonArrayConst>();
+  if (ports.isNull())
+    return route_port_mask(o["port"].as<const char*>());
+
+  uint16_t dest = 0;
+  for (JsonVariantConst p : ports)
+    dest |= route_port_mask(p.as<const char*>());
+  return dest;
+}
+
+// "curve":n → номер кривой (0 — нет или вне диапазона)
+static uint8_t parse_curve_ref(JsonObjectConst o) {
+  int c = o["curve"] | 0;
+  return (c >= 1 && c <= MAX_CURVES) ? (uint8_t)c : 0;
+}
+
+static inline uint8_t clamp7(int v) {
+  return (uint8_t)(v < 0 ? 0 : v > 127 ? 127 : v);
+}
+
+// Кривая; пропущенные поля — полный диапазон 0–127
+static void parse_curve(JsonObjectConst o, CurveDef &c) {
+  memset(&c, 0, sizeof(c));
+  c.type = curve_type(o["type"].as<const char*>());
+  c.min = clamp7(o["min"] | 0);
+  c.max = clamp7(o["max"] | 127);
+  if (c.type == CURVE_FIXED) c.min = c.max = clamp7(o["value"] | 127);
+  int shape = o["shape"] | 3;
+  c.shape = (int8_t)(shape < -8 ? -8 : shape > 8 ? 8 : shape);
+  c.flags = (o["rate"] | false) ? CURVE_FROM_RATE : 0;
+
+  for (JsonVariantConst p : o["points"].as<JsonArrayConst>()) {
+    if (c.count >= CURVE_POINTS) break;
+    c.points[c.count++] = clamp7(p.as<int>());
+  }
+}
+
+static bool parse_curves(JsonArrayConst curves, ConfigModel &m) {
+  for (JsonObjectConst o : curves) {
+    if (m.curveCount >= MAX_CURVES) return false;
+    parse_curve(o, m.curves[m.curveCount++]);
+  }
+  return true;
+}
+
+// Правило матрицы thru; пропущенные поля — "все"
+static void parse_thru_rule(JsonObjectConst o, ThruRule &r) {
+  r.in = route_thru_input(o["in"].as<const char*>());
+
+  r.channels = 0xFFFF;
+  JsonArrayConst chs = o["channels"].as<JsonArrayConst>();
+  if (!chs.isNull()) {
+    r.channels = 0;
+    for (JsonVariantConst c : chs) {
+      int ch = c.as<int>();
+      if (ch >= 1 && ch <= 16) r.channels |= (uint16_t)(1u << (ch - 1));
+    }
+  }
+
+  r.types = 0xFF;
+  JsonArrayConst types = o["types"].as<JsonArrayConst>();
+  if (!types.isNull()) {
+    r.types = 0;
+    for (JsonVariantConst t : types)
+      r.types |= route_thru_type_mask(t.as<const char*>());
+  }
+
+  r.dest = parse_dest(o);
+  int remap = o["remap"] | 0;
+  r.remap = (remap >= 1 && remap <= 16) ? (uint8_t)remap : 0;
+  r.curve = parse_curve_ref(o);
+}
+
+static bool parse_thru(JsonArrayConst rules, ConfigModel &m) {
+  for (JsonObjectConst o : rules) {
+    if (m.thruCount >= MAX_THRU_RULES) return false;
+    parse_thru_rule(o, m.thru[m.thruCount++]);
+  }
+  return true;
+}
+
+// Назначения клавиш одного слоя: {"0x1D":{...},...}
+static bool parse_keys(JsonObjectConst obj, uint8_t layer, ConfigModel &m, uint16_t &layered) {
+  for (JsonPairConst kv : obj) {
+    int hid = parse_hid(kv.key().c_str());
+    if (hid < 0) continue;
+    if (m.count >= MAX_MAPPINGS) return false;
+    if (layer != LAYER_BASE && layered++ >= LAYER_POOL) return false;
+
+    JsonObjectConst o = kv.value().as<JsonObjectConst>();
+    const char *type = o["type"].as<const char*>();
+
+    KeyMapping &k = m.keys[m.count++];
+    k.hid = (uint8_t)hid;
+    k.type = (type && strcmp(type, "note") == 0) ? ROUTE_NOTE : ROUTE_CC;
+    k.value = (uint8_t)(o["value"].as<int>() & 0x7F);
+    k.channel = (uint8_t)o["channel"].as<int>();
+    k.dest = parse_dest(o);
+    k.layer = layer;
+    k.curve = parse_curve_ref(o);
+  }
+  return true;
+}
+
+bool config_model_import(JsonObjectConst obj, ConfigModel &m) {
+  m.count = 0;
+  m.thruCount = 0;
+  m.curveCount = 0;
+  uint16_t layered = 0;
+  bool ok = parse_thru(obj["thru"].as<JsonArrayConst>(), m);
+  ok = parse_curves(obj["curves"].as<JsonArrayConst>(), m) && ok;
+
+  for (uint8_t layer = LAYER_BASE; layer < KEY_LAYERS; layer++) {
+    JsonObjectConst keys = layer ? obj[route_layer_name(layer)].as<JsonObjectConst>() : obj;
+    if (!parse_keys(keys, layer, m, layered)) return false;
+  }
+  return ok;
+}
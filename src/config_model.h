@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// ======================================================
+// Модель конфигурации — единственный источник правды в RAM
+// ======================================================
+// Фиксированный массив без String и без кучи. JSON — только
+// формат импорта/экспорта (LittleFS, WebSerial).
+
+#define MAX_MAPPINGS 256   // записей на все слои вместе
+#define MAX_THRU_RULES 32  // правила матрицы MIDI IN → выходы
+#define MAX_CURVES 7       // кривых значений (номер 1–7, 0 — без кривой)
+#define CURVE_POINTS 16    // точек нарисованной кривой
+
+struct KeyMapping {
+  uint8_t hid;       // HID-код клавиши
+  uint8_t type;      // RouteType: ROUTE_NOTE / ROUTE_CC
+  uint8_t value;     // нота или номер CC (0 — "не задано", дефолтная карта)
+  uint8_t channel;   // MIDI-канал (1–16)
+  uint16_t dest;     // маска назначений DEST_* (0 — порт не распознан)
+  uint8_t layer;     // KeyLayer: LAYER_BASE / LAYER_SHIFT / LAYER_CTRL
+  uint8_t curve;     // кривая скорости / значения CC (1–MAX_CURVES, 0 — нет)
+};
+
+// Правило thru: (вход, каналы, типы) → назначения [+ смена канала].
+// Пустая маска dest блокирует выбранные сообщения.
+struct ThruRule {
+  uint8_t in;          // вход (THRU_IN_DIN / THRU_IN_USB)
+  uint8_t types;       // маска типов (бит THRU_*)
+  uint16_t channels;   // маска входных каналов (бит 0 — канал 1)
+  uint16_t dest;       // маска назначений DEST_*
+  uint8_t remap;       // выходной канал 1–16 (0 — без изменений)
+  uint8_t curve;       // кривая скорости / давления / CC (0 — без кривой)
+};
+
+// Кривая значения 0–127 → 0–127; компилируется в LUT (см. curve.h)
+struct CurveDef {
+  uint8_t type;        // CurveType
+  uint8_t min;         // выходной диапазон; fixed — само значение
+  uint8_t max;
+  int8_t shape;        // exp: крутизна -8…8 (> 0 — слабые нажатия тише)
+  uint8_t flags;       // CURVE_FROM_RATE: вход — скорость нажатий, а не 127
+  uint8_t count;       // user: точек в points (2–CURVE_POINTS)
+  uint8_t points[CURVE_POINTS];   // user: выход в равноотстоящих точках 0…127
+};
+
+struct ConfigModel {
+  uint16_t count;
+  KeyMapping keys[MAX_MAPPINGS];
+  uint16_t thruCount;
+  ThruRule thru[MAX_THRU_RULES];
+  uint16_t curveCount;
+  CurveDef curves[MAX_CURVES];
+};
+
+/**
+ * @brief Дефолтная конфигурация (C4–E4 на USB)
+ */
+void config_model_default(ConfigModel &m);
+
+/**
+ * @brief Импорт JSON-объекта вида {"0x1D":{"type":"note",...},...}
+ *
+ * Назначения — массив "ports":["USB","A",...]; старое поле
+ * "port":"A" (одно назначение) тоже принимается.
+ * Ключи "shift" и "ctrl" — объекты того же вида: слои, которые
+ * действуют, пока удерживается Shift или Ctrl (Ctrl главнее).
+ * Ключ "curves" — массив кривых, номер кривой — позиция с 1:
+ *   {"type":"linear"|"exp"|"invert"|"clamp"|"fixed"|"user",
+ *    "min":0,"max":127,"shape":3,"value":100,"points":[...],"rate":true}
+ * Назначение и правило thru ссылаются на неё полем "curve":1.
+ * Ключ "thru" — массив правил матрицы MIDI IN:
+ *   {"in":"DIN"|"USB","channels":[1,2],"types":["note","cc"],"ports":["A"],"remap":5}
+ * Пропущенные "channels"/"types" — все; "ports":[] — блокировка.
+ * Ключи, которые не разбираются как HID-код, пропускаются.
+ * @return false, если записей больше MAX_MAPPINGS, записей слоёв
+ *         больше LAYER_POOL, правил больше MAX_THRU_RULES или кривых
+ *         больше MAX_CURVES (лишние отброшены)
+ */
+bool config_model_import(JsonObjectConst obj, ConfigModel &m);
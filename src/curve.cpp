@@ -0,0 +1,64 @@
+#include "curve.h"
+#include <math.h>
+#include <string.h>
+
+static const char *typeNames[CURVE_TYPES] = {
+  "linear", "exp", "invert", "clamp", "fixed", "user"
+};
+
+const char *curve_type_name(uint8_t type) {
+  return (type < CURVE_TYPES) ? typeNames[type] : "";
+}
+
+uint8_t curve_type(const char *name) {
+  for (uint8_t t = 0; name && t < CURVE_TYPES; t++)
+    if (strcmp(name, typeNames[t]) == 0) return t;
+  return CURVE_LINEAR;
+}
+
+void curve_identity(uint8_t lut[CURVE_LUT_SIZE]) {
+  for (uint8_t v = 0; v < CURVE_LUT_SIZE; v++) lut[v] = v;
+}
+
+// a…b в точке x/127, с округлением (целочисленно — так же считает preset_tool.py)
+static inline uint8_t lerp(uint8_t a, uint8_t b, uint32_t x) {
+  return (uint8_t)((a * (127 - x) + b * x + 63) / 127);
+}
+
+void curve_build(const CurveDef &c, uint8_t lut[CURVE_LUT_SIZE]) {
+  uint8_t lo = c.min & 0x7F, hi = c.max & 0x7F;
+
+  for (uint32_t x = 0; x < CURVE_LUT_SIZE; x++) {
+    uint8_t y;
+    switch (c.type) {
+      case CURVE_EXP: {
+        if (!c.shape) { y = lerp(lo, hi, x); break; }
+        double k = c.shape / 2.0;
+        double f = (exp(k * x / 127.0) - 1.0) / (exp(k) - 1.0);
+        y = (uint8_t)(lo * (1.0 - f) + hi * f + 0.5);
+        break;
+      }
+      case CURVE_INVERT:
+        y = lerp(hi, lo, x);
+        break;
+      case CURVE_CLAMP:
+        y = (x < lo) ? lo : (x > hi) ? hi : (uint8_t)x;
+        break;
+      case CURVE_FIXED:
+        y = lo;
+        break;
+      case CURVE_USER: {
+        uint8_t n = (c.count >= 2 && c.count <= CURVE_POINTS) ? c.count : 2;
+        uint32_t pos = x * (n - 1);               // в долях 1/127 отрезка
+        uint8_t i = (uint8_t)(pos / 127);
+        if (i >= n - 1) { y = c.points[n - 1] & 0x7F; break; }
+        y = lerp(c.points[i] & 0x7F, c.points[i + 1] & 0x7F, pos - i * 127u);
+        break;
+      }
+      default:
+        y = lerp(lo, hi, x);
+        break;
+    }
+    lut[x] = y;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include "config_model.h"
+
+// ======================================================
+// Кривые значений: скорость, aftertouch, значение CC
+// ======================================================
+// Каждая кривая один раз (при компиляции таблицы маршрутов)
+// превращается в LUT на 128 байт; на горячем пути — одно чтение
+// lut[value]. LUT 0 — тождественная, поэтому "без кривой" не требует
+// отдельной ветки.
+
+#define CURVE_LUT_SIZE   128
+#define CURVE_FROM_RATE  0x01   // CurveDef.flags: вход — скорость нажатий
+
+enum CurveType : uint8_t {
+  CURVE_LINEAR = 0,   // min…max
+  CURVE_EXP,          // экспонента с крутизной shape
+  CURVE_INVERT,       // max…min
+  CURVE_CLAMP,        // значение как есть, но не ниже min и не выше max
+  CURVE_FIXED,        // всегда min
+  CURVE_USER,         // нарисованная: points, линейно между точками
+  CURVE_TYPES
+};
+
+/**
+ * @brief Построить LUT кривой (core0, при загрузке конфигурации)
+ */
+void curve_build(const CurveDef &c, uint8_t lut[CURVE_LUT_SIZE]);
+
+/**
+ * @brief Тождественная LUT (lut[v] == v)
+ */
+void curve_identity(uint8_t lut[CURVE_LUT_SIZE]);
+
+/**
+ * @brief Имя типа ("linear", "exp"...) и обратно
+ * @return curve_type(): CURVE_LINEAR, если имя не распознано
+ */
+const char *curve_type_name(uint8_t type);
+uint8_t curve_type(const char *name);
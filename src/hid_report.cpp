@@ -0,0 +1,155 @@
+#include "hid_report.h"
+#include <string.h>
+
+static inline void set_bit(HidKeyBits &b, uint8_t code) {
+  b.w[code >> 5] |= 1u << (code & 31);
+}
+
+// ======================================================
+// Дескриптор отчёта: короткие элементы (HID 1.11, 6.2.2)
+// ======================================================
+#define HID_PAGE_KEYBOARD 0x07
+#define HID_INPUT_CONST   0x01
+#define HID_INPUT_VAR     0x02
+
+void hid_layout_boot(HidLayout &out) {
+  out = {0, HID_REPORT_SIZE, 0, 2, HID_REPORT_SIZE - 2, HID_NONE, 0, 0};
+}
+
+// Поле Input на странице клавиатуры → раскладка; false — не разобрать
+static bool keyboard_field(HidLayout &l, uint16_t bit, uint8_t size, uint16_t count, uint16_t usage,
+                           uint32_t flags) {
+  if ((bit & 7) || (bit >> 3) >= HID_REPORT_MAX) return false;
+  uint8_t at = (uint8_t)(bit >> 3);
+  if (!(flags & HID_INPUT_VAR)) {               // массив кодов
+    if (size != 8 || l.keysByte != HID_NONE) return false;
+    l.keysByte = at;
+    l.keysCount = (uint8_t)count;
+    return true;
+  }
+  if (size != 1) return false;
+  if (usage == 0xE0 && count == 8 && l.modByte == HID_NONE) {
+    l.modByte = at;
+    return true;
+  }
+  if ((usage & 7) || usage > 0xFF || l.mapByte != HID_NONE) return false;
+  l.mapByte = at;
+  l.mapFirst = (uint8_t)usage;
+  l.mapCount = count < 0x100 - usage ? count : (uint16_t)(0x100 - usage);
+  return true;
+}
+
+bool hid_parse_report_desc(const uint8_t *desc, uint16_t len, HidLayout &out) {
+  out = {0, 0, HID_NONE, HID_NONE, 0, HID_NONE, 0, 0};
+  uint16_t page = 0, count = 0, usage = 0;
+  uint8_t size = 0, id = 0;
+  bool haveUsage = false;
+  uint16_t bit = 0;          // позиция во входном отчёте текущего Report ID
+  uint16_t kbdBits = 0;      // длина отчёта клавиатуры
+  bool found = false;        // поля клавиатуры уже есть (в отчёте out.reportId)
+
+  for (uint16_t i = 0; i < len;) {
+    uint8_t prefix = desc[i++];
+    if (prefix == 0xFE) {                        // длинный элемент — пропускаем
+      if (i + 1 >= len) return false;
+      i += 2 + desc[i];
+      continue;
+    }
+    uint8_t n = (prefix & 3) == 3 ? 4 : (prefix & 3);
+    if (i + n > len) return false;
+    uint32_t v = 0;
+    for (uint8_t k = 0; k < n; k++) v |= (uint32_t)desc[i + k] << (8 * k);
+    i += n;
+
+    switch (prefix & 0xFC) {
+      case 0x04: page = (uint16_t)v; break;                 // Usage Page
+      case 0x74: size = (uint8_t)v; break;                  // Report Size
+      case 0x94: count = (uint16_t)v; break;                // Report Count
+      case 0x84:                                            // Report ID
+        if (found && (uint8_t)v != out.reportId) i = len;   // отчёт клавиатуры кончился
+        id = (uint8_t)v;
+        bit = 0;
+        break;
+      case 0xA4: case 0xB4: return false;                   // Push/Pop
+      case 0x08:                                            // Usage
+        if (!haveUsage) usage = (uint16_t)v;
+        haveUsage = true;
+        break;
+      case 0x18: usage = (uint16_t)v; haveUsage = true; break;   // Usage Minimum
+      case 0x80:                                            // Input
+        if (page == HID_PAGE_KEYBOARD && !(v & HID_INPUT_CONST) && (!found || id == out.reportId)) {
+          if (!keyboard_field(out, bit, size, count, usage, v)) return false;
+          found = true;
+          out.reportId = id;
+        }
+        bit += (uint16_t)(size * count);
+        if (found && id == out.reportId) kbdBits = bit;
+        haveUsage = false;
+        break;
+      case 0x90: case 0xB0: case 0xA0: case 0xC0:           // Output, Feature, Collection
+        haveUsage = false;
+        break;
+    }
+  }
+
+  uint16_t bytes = (kbdBits + 7) >> 3;
+  if (!found || (out.keysByte == HID_NONE && out.mapByte == HID_NONE)) return false;
+  if (bytes + (out.reportId ? 1 : 0) > HID_REPORT_MAX) return false;
+  out.size = (uint8_t)bytes;
+  return true;
+}
+
+// ======================================================
+// Отчёт → битсет
+// ======================================================
+HidReportResult hid_report_bits(const HidLayout &l, const uint8_t *report, uint8_t len, HidKeyBits &out) {
+  if (l.reportId) {
+    if (!len || report[0] != l.reportId) return HID_REPORT_OTHER;
+    report++;
+    len--;
+  }
+  if (len < l.size) return HID_REPORT_ERROR;
+  memset(&out, 0, sizeof(out));
+
+  if (l.keysByte != HID_NONE) {
+    for (uint8_t i = 0; i < l.keysCount; i++) {
+      uint8_t code = report[l.keysByte + i];
+      if (code >= HID_ROLLOVER_ERR && code <= HID_ERR_LAST) return HID_REPORT_ERROR;
+      if (code) set_bit(out, code);
+    }
+  }
+
+  if (l.mapByte != HID_NONE) {
+    // байты карты ложатся в слова как есть (little-endian)
+    uint8_t *bytes = (uint8_t *)out.w;
+    uint8_t n = (uint8_t)((l.mapCount + 7) >> 3);
+    for (uint8_t i = 0; i < n; i++) {
+      uint8_t b = report[l.mapByte + i];
+      if (i == n - 1 && (l.mapCount & 7)) b &= (uint8_t)((1u << (l.mapCount & 7)) - 1);
+      bytes[(l.mapFirst >> 3) + i] |= b;
+    }
+    if (out.w[0] & 0xEu) return HID_REPORT_ERROR;   // биты ErrorRollOver…ErrorUndefined
+    out.w[0] &= ~1u;                                // 0x00 — не клавиша
+  }
+
+  // модификаторы — младший байт последнего слова (0xE0–0xE7)
+  if (l.modByte != HID_NONE) out.w[HID_KEY_WORDS - 1] |= (uint32_t)report[l.modByte];
+  return HID_REPORT_KEYS;
+}
+
+// Изменённые биты слова: set — нажатия (бит есть в cur) или отпускания
+static inline void emit(uint32_t changed, uint8_t word, bool pressed, HidKeyCallback cb, void *ctx) {
+  while (changed) {
+    uint8_t bit = (uint8_t)__builtin_ctz(changed);
+    cb((uint8_t)((word << 5) | bit), pressed, ctx);
+    changed &= changed - 1;
+  }
+}
+
+void hid_bits_diff(const HidKeyBits &prev, const HidKeyBits &cur, HidKeyCallback cb, void *ctx) {
+  for (uint8_t i = 0; i < HID_KEY_WORDS; i++)
+    emit((prev.w[i] ^ cur.w[i]) & prev.w[i], i, false, cb, ctx);
+  // нажатия — со старшего слова: модификаторы раньше клавиш
+  for (uint8_t i = HID_KEY_WORDS; i-- > 0;)
+    emit((prev.w[i] ^ cur.w[i]) & cur.w[i], i, true, cb, ctx);
+}
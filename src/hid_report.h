@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+
+// ======================================================
+// Разбор отчётов HID-клавиатуры: состояние как битсет на 256 кодов
+// ======================================================
+// Где в отчёте модификаторы и клавиши, говорит раскладка (HidLayout):
+// её даёт разбор дескриптора отчёта (report protocol) или boot protocol
+// (8 байт: [0] модификаторы, [1] резерв, [2–7] до 6 клавиш).
+// Клавиши бывают массивом кодов (как в boot) и битовой картой (NKRO:
+// бит n — HID-код first + n). Оба вида сводятся к одному битсету;
+// изменения между отчётами — XOR по словам и count-trailing-zeros,
+// без перебора списков.
+
+#define HID_REPORT_SIZE   8      // boot protocol
+#define HID_REPORT_MAX    64     // самый длинный принимаемый отчёт (NKRO)
+#define HID_KEY_WORDS     8      // 256 бит
+#define HID_ROLLOVER_ERR  0x01   // ErrorRollOver: нажато больше 6 клавиш
+#define HID_ERR_LAST      0x03   // 0x01–0x03 — коды ошибок, а не клавиши
+#define HID_NONE          0xFF   // поля нет в отчёте
+
+struct HidKeyBits {
+  uint32_t w[HID_KEY_WORDS];     // бит (code & 31) слова (code >> 5) — клавиша нажата
+};
+
+// Раскладка входного отчёта клавиатуры; смещения — в байтах после Report ID
+struct HidLayout {
+  uint8_t reportId;    // 0 — отчёты без Report ID
+  uint8_t size;        // байт данных в отчёте
+  uint8_t modByte;     // модификаторы (биты → HID 0xE0–0xE7) или HID_NONE
+  uint8_t keysByte;    // массив кодов клавиш или HID_NONE
+  uint8_t keysCount;
+  uint8_t mapByte;     // битовая карта или HID_NONE
+  uint8_t mapFirst;    // HID-код первого бита карты (кратен 8)
+  uint16_t mapCount;   // бит в карте
+};
+
+enum HidReportResult : uint8_t {
+  HID_REPORT_KEYS,     // out — нажатые клавиши
+  HID_REPORT_ERROR,    // ErrorRollOver/POST fail или отчёт короче раскладки
+  HID_REPORT_OTHER     // чужой Report ID (мультимедиа и т.п.) — пропустить
+};
+
+typedef void (*HidKeyCallback)(uint8_t code, bool pressed, void *ctx);
+
+/**
+ * @brief Раскладка boot protocol (8 байт, 6 кодов массивом)
+ */
+void hid_layout_boot(HidLayout &out);
+
+/**
+ * @brief Дескриптор отчёта → раскладка клавиатуры (Usage Page 0x07)
+ *
+ * Берётся первый входной отчёт с клавишами: модификаторы E0–E7,
+ * массив кодов по 8 бит и/или битовая карта. Поля не на границе байта,
+ * карта не с кратного 8 кода, отчёт длиннее HID_REPORT_MAX — отказ.
+ * @return false, если клавиатуры в дескрипторе нет или её не разобрать
+ *         (тогда — boot protocol)
+ */
+bool hid_parse_report_desc(const uint8_t *desc, uint16_t len, HidLayout &out);
+
+/**
+ * @brief Отчёт → битсет нажатых клавиш по раскладке
+ *
+ * Ошибка — коды 0x01–0x03 в массиве или их биты в карте
+ * (ErrorRollOver, POST fail); out тогда не определён.
+ */
+HidReportResult hid_report_bits(const HidLayout &l, const uint8_t *report, uint8_t len, HidKeyBits &out);
+
+/**
+ * @brief Вызвать cb на каждое изменение между prev и cur
+ *
+ * Сначала отпускания, потом нажатия (ноты не "залипают" при смене
+ * аккорда в одном отчёте). Нажатия модификаторов идут раньше нажатий
+ * клавиш того же отчёта — слой Shift/Ctrl применяется сразу.
+ */
+void hid_bits_diff(const HidKeyBits &prev, const HidKeyBits &cur, HidKeyCallback cb, void *ctx);
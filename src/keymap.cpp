@@ -1,80 +1,108 @@
 #include "keymap.h"
 #include "midi_output.h"
+#include "stats.h"
+#include "capture.h"
 #include "config_manager.h"
+#include "note_state.h"
+#include "spsc_queue.h"
+#include "hardware/timer.h"
 
-// --- простейшая таблица клавиш HID USB Keyboard Set 2 ---
-// (сканкоды клавиатуры, типичные для CH376S HID клавиатуры)
-struct {
-  uint8_t hid;
-  uint8_t note;
-} defaultMap[] = {
-  {0x1D, 60}, // Z -> C4
-  {0x1B, 62}, // X -> D4
-  {0x06, 64}, // C -> E4
-  {0x19, 65}, // V -> F4
-  {0x05, 67}, // B -> G4
-  {0x11, 69}, // N -> A4
-  {0x10, 71}, // M -> B4
-  {0x36, 72}, // , -> C5
-  {0x37, 74}, // . -> D5
-  {0x38, 76}  // / -> E5
+// События клавиш от core0 к core1 (со временем прихода — для замера задержки)
+struct HidEvent {
+  uint32_t ts;
+  uint8_t code;
+  bool pressed;
 };
+static SpscQueue<HidEvent, 64> hidQueue;
 
-bool prevState[256] = {false};
+// HID-код 0x00 — "нет события", клавишей не бывает: им передаём сбой
+#define HID_EVENT_NOTES_OFF 0x00
 
-// вспомогательная функция для поиска дефолтного маппинга
-uint8_t get_default_note(uint8_t hid) {
-  for (auto &m : defaultMap)
-    if (m.hid == hid)
-      return m.note;
-  return 0; // нет соответствия
+// --- Слои (core1) ---
+#define MOD_CTRL   0x11   // Left/Right Ctrl  (HID 0xE0, 0xE4)
+#define MOD_SHIFT  0x22   // Left/Right Shift (HID 0xE1, 0xE5)
+static uint8_t mods = 0;              // удерживаемые модификаторы, бит n — 0xE0+n
+static uint8_t pressedLayer[256];     // слой, в котором клавиша нажата
+
+// --- Скорость из интервала между нажатиями (core1) ---
+#define RATE_FAST_US  40000    // быстрее — скорость 127
+#define RATE_SLOW_US  500000   // медленнее — скорость 1
+static uint32_t lastPressTs = 0;
+
+static uint8_t rate_velocity(uint32_t dt) {
+  if (dt <= RATE_FAST_US) return 127;
+  if (dt >= RATE_SLOW_US) return 1;
+  return (uint8_t)(127 - (dt - RATE_FAST_US) * 126 / (RATE_SLOW_US - RATE_FAST_US));
+}
+
+static inline uint8_t current_layer() {
+  if (mods & MOD_CTRL) return LAYER_CTRL;
+  if (mods & MOD_SHIFT) return LAYER_SHIFT;
+  return LAYER_BASE;
 }
 
-void handle_hid_code(uint8_t hid_code) {
-  static unsigned long lastTime[256];
-  bool pressed = !prevState[hid_code];
-  prevState[hid_code] = !prevState[hid_code];
+bool keymap_post_hid(uint8_t hid_code, bool pressed, uint32_t ts) {
+  return hidQueue.push({ts, hid_code, pressed});
+}
+
+bool keymap_post_all_notes_off(uint32_t ts) {
+  return hidQueue.push({ts, HID_EVENT_NOTES_OFF, false});
+}
 
-  unsigned long now = millis();
-  if (now - lastTime[hid_code] < 5) return; // антидребезг
-  lastTime[hid_code] = now;
+void keymap_task() {
+  HidEvent ev;
+  while (hidQueue.pop(ev)) {
+    const uint8_t rec[2] = {ev.code, ev.pressed};
+    capture_open(SRC_KEYS, rec, 2, ev.ts);
+    if (ev.code == HID_EVENT_NOTES_OFF) {
+      keymap_all_notes_off(ev.ts);
+    } else {
+      stats_in(SRC_KEYS);
+      handle_hid_code(ev.code, ev.pressed, ev.ts);
+    }
+    capture_close();
+  }
+}
 
-  // найти конфигурацию в JSON
-  char keyHex[6];
-  sprintf(keyHex, "0x%02X", hid_code);
-  KeyConfig cfg = get_key_config(String(keyHex));
+void keymap_all_notes_off(uint32_t ts) {
+  mods = 0;
+  const RouteTable *t = active_routes();
+  for (uint8_t ch = 0; ch < 16; ch++) {
+    if (!t->notesOff[ch]) continue;
+    notes_release(t->notesOff[ch], 1u << ch);   // NoteOff звучащим — CC 123 слушают не все
+    send_midi_mask(t->notesOff[ch], midi_word_msg(USB_CABLE_ROUTER, 0xB0 | ch, 123, 0), ts);
+  }
+}
 
-  // если конфиг не найден, используем дефолтную карту
-  if (cfg.value == 0) {
-    cfg.type = "note";
-    cfg.value = get_default_note(hid_code);
-    cfg.port = "USB";
-    cfg.channel = 1;
+void handle_hid_code(uint8_t hid_code, bool pressed, uint32_t ts) {
+  // слой — по модификаторам на момент нажатия; сам модификатор
+  // ещё не учтён, его собственное нажатие идёт в прежнем слое
+  uint8_t layer = pressed ? current_layer() : pressedLayer[hid_code];
+  uint32_t dt = ts - lastPressTs;
+  if (pressed) pressedLayer[hid_code] = layer;
+  if (hid_code >= 0xE0 && hid_code <= 0xE7) {
+    uint8_t bit = 1u << (hid_code - 0xE0);
+    mods = pressed ? (mods | bit) : (mods & ~bit);
+  } else if (pressed) {
+    lastPressTs = ts;
   }
 
-  if (cfg.value == 0) return; // пропустить нераспознанные клавиши
+  // маршрут уже скомпилирован из JSON (см. route_table.h)
+  const RouteTable *t = active_routes();
+  const RouteEntry &r = route_key(*t, layer, hid_code);
+  if (r.type == ROUTE_NONE) return; // пропустить нераспознанные клавиши
 
-  uint8_t status = (cfg.type == "note")
+  uint8_t status = (r.type == ROUTE_NOTE)
                      ? (pressed ? 0x90 : 0x80)
                      : 0xB0;
+  status |= r.channel;
 
-  // выбор куда отправлять
-  if (cfg.port == "USB") {
-    send_midi_usb(status | ((cfg.channel - 1) & 0x0F),
-                  cfg.value,
-                  pressed ? 127 : 0);
-  }
-  else if (cfg.port == "DIN") {
-    send_midi_uart(status | ((cfg.channel - 1) & 0x0F),
-                   cfg.value,
-                   pressed ? 127 : 0);
-  }
-  else {
-    uint8_t portIndex = cfg.port[0] - 'A'; // A=0, B=1 ...
-    if (portIndex < 10)
-      send_midi_pio(portIndex,
-                    status | ((cfg.channel - 1) & 0x0F),
-                    cfg.value,
-                    pressed ? 127 : 0);
-  }
-}
\ No newline at end of file
+  // скорость / значение CC через LUT кривой (0 — тождественная)
+  uint8_t vel = pressed ? ((r.curve & ROUTE_CURVE_RATE) ? rate_velocity(dt) : 127) : 0;
+  vel = t->curves[r.curve & ROUTE_CURVE_MASK][vel];
+  if (r.type == ROUTE_NOTE)
+    vel = pressed ? (vel ? vel : 1) : 0;   // NoteOn 0 — это NoteOff
+
+  // веер по маске назначений: каждый выход — один раз
+  send_midi_mask(r.dest, midi_word_msg(USB_CABLE_ROUTER, status, r.value, vel), ts);
+}
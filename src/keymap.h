@@ -1,4 +1,16 @@
 #pragma once
 #include <Arduino.h>
 
-void handle_hid_code(uint8_t hid_code);
\ No newline at end of file
+// Нажатие/отпускание уже определено по отчёту HID (см. hid_report.h).
+// Удерживаемые Shift/Ctrl выбирают слой (см. route_table.h); отпускание
+// берёт слой, в котором клавиша была нажата.
+void handle_hid_code(uint8_t hid_code, bool pressed, uint32_t ts = 0);
+
+// NoteOff звучащим нотам и All Notes Off на всех каналах/выходах,
+// куда клавиши шлют ноты
+void keymap_all_notes_off(uint32_t ts = 0);
+
+// Межъядерная передача: CH376S (core0) → очередь → MIDI (core1)
+bool keymap_post_hid(uint8_t hid_code, bool pressed, uint32_t ts);   // core0
+bool keymap_post_all_notes_off(uint32_t ts);                         // core0
+void keymap_task();                       // core1
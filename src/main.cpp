@@ -5,6 +5,12 @@
 #include "keymap.h"
 #include "webserial.h"
 #include "config_manager.h"
+#include "stats.h"
+#include "bench.h"
+#include "capture.h"
+#include "midi_clock.h"
+#include "scheduler.h"
+#include "note_state.h"
 
 #include <Adafruit_TinyUSB.h>
 #include <LittleFS.h>
@@ -13,12 +19,16 @@
 // Глобальные настройки
 // ======================================================
 #define STATUS_LED 25
-#define LOOP_INTERVAL_MS 1  // 1мс — стабильный цикл
+#define LOOP_INTERVAL_MS 1  // 1мс — цикл core0 (core1 крутится без пауз)
 
 unsigned long lastMillis = 0;
 
+// Синхронизация старта ядер
+volatile bool core0_ready = false;
+volatile bool core1_ready = false;
+
 // ======================================================
-// Инициализация системы
+// Инициализация системы (core0: конфиг, FS, USB host, WebSerial)
 // ======================================================
 void setup() {
   pinMode(STATUS_LED, OUTPUT);
@@ -39,11 +49,8 @@ void setup() {
   // --- Конфигурация (JSON + пресеты) ---
   setup_config();
 
-  // --- MIDI OUTPUT (USB + UART + PIO) ---
-  setup_midi_output();
-
-  // --- MIDI INPUT (DIN/TRS IN) ---
-  setup_midi_input();
+  // --- USB MIDI (дескрипторы TinyUSB живут на core0) ---
+  setup_midi_usb();
 
   // --- CH376S (USB Keyboard) ---
   setup_ch376s();
@@ -51,25 +58,59 @@ void setup() {
   // --- WebSerial (через USB CDC) ---
   setup_webserial();
 
-  // --- Тестовый MIDI сигнал ---
-  test_midi_outputs();
+  // --- Отдаём управление MIDI ядру ---
+  core0_ready = true;
+  while (!core1_ready) delay(1);
 
   Serial.println("[SYSTEM] ✅ Initialization complete");
   digitalWrite(STATUS_LED, HIGH);
 }
 
 // ======================================================
-// Главный цикл
+// Инициализация MIDI ядра (core1: RX парсер и все выходы)
+// ======================================================
+void setup1() {
+  while (!core0_ready) tight_loop_contents();
+
+  // --- MIDI OUTPUT (UART + PIO), IRQ PIO на core1 ---
+  setup_midi_output();
+
+  // --- MIDI INPUT (DIN/TRS IN) ---
+  setup_midi_input();
+
+  // --- MIDI Clock: будильник генератора, его IRQ — на core1 ---
+  setup_midi_clock();
+
+  // --- Планировщик выходов: колесо таймеров на своём будильнике ---
+  setup_scheduler();
+
+  // --- Тестовый MIDI сигнал ---
+  test_midi_outputs();
+
+  core1_ready = true;
+}
+
+// ======================================================
+// Главный цикл core0 — всё, что может надолго задуматься
 // ======================================================
 void loop() {
-  // WebSerial (JSON обмен)
+  // WebSerial (JSON обмен, LittleFS)
   webserial_task();
 
-  // Опрос CH376S (HID клавиатура)
+  // Опрос CH376S (HID клавиатура) → очередь в core1
   ch376s_task();
 
-  // MIDI вход (DIN/TRS RX)
-  midi_in_task();
+  // Пресеты, вызванные по MIDI на core1 → модель для редактора
+  preset_task();
+
+  // Результаты BENCH, прогнанного на core1
+  bench_task();
+
+  // Запись событий: лог во flash, подача записей на повтор
+  capture_task();
+
+  // Итог тестового аккорда, сыгранного на core1
+  midi_out_test_task();
 
   // LED heartbeat
   if (millis() - lastMillis >= 500) {
@@ -80,6 +121,47 @@ void loop() {
   delay(LOOP_INTERVAL_MS);
 }
 
+// ======================================================
+// Главный цикл core1 — MIDI, без пауз и без блокировок
+// ======================================================
+void loop1() {
+  // время прохода (от прошлой отметки) — в гистограмму STATS
+  stats_loop_mark();
+
+  // подтверждаем, что видим актуальную таблицу маршрутов
+  routes_ack();
+
+  // настройки выходов с core0 (SET_POLICY…)
+  midi_out_task();
+
+  // MIDI вход (DIN/TRS RX)
+  midi_in_task();
+
+  // MIDI от хоста по USB (12 кабелей)
+  midi_in_usb_task();
+
+  // Клавиши из core0
+  keymap_task();
+
+  // повтор записи (CAPTURE REPLAY) — как ещё один вход
+  capture_replay_task();
+
+  // часы: команды core0, тики генератора для USB
+  midi_clock_task();
+
+  // сброс звучащих нот (PANIC, смена пресета, thru выкл.)
+  notes_task();
+
+  // отложенные события (компенсация, эхо), пока есть готовые
+  sched_task();
+
+  // всё, что накопил проход, — одной пачкой в USB
+  midi_out_flush();
+
+  // BENCH: синтетическая нагрузка по запросу с core0
+  bench_core1_task();
+}
+
 // ======================================================
 // Дополнительно: системные команды по Serial
 // ======================================================
@@ -90,7 +172,8 @@ void serialEvent() {
     cmd.trim();
 
     if (cmd == "test") {
-      test_midi_outputs();
+      // выходы — core1: serialEvent() идёт на core0
+      if (!midi_out_request_test()) Serial.println("[CMD] Busy, try again");
     } 
     else if (cmd == "thru on") {
       midi_in_set_thru(true);
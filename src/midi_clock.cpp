@@ -0,0 +1,403 @@
+#include "midi_clock.h"
+#include <Arduino.h>
+#include <string.h>
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "midi_output.h"
+#include "route_table.h"
+#include "capture.h"
+#include "spsc_queue.h"
+
+// ======================================================
+// Состояние движка
+// ======================================================
+// Время и период — в Q8 (1/256 мкс): 120.0 BPM = 20833.33 мкс на тик,
+// генератор не накапливает ошибку округления.
+// Всё ниже меняют поток core1 (с запретом IRQ) и будильник (в IRQ).
+#define Q8(us)       ((uint64_t)(us) << 8)
+#define CLOCK_NEVER  UINT64_MAX
+
+struct ClockPort {
+  uint8_t div = 1;
+  uint8_t mul = 1;
+  uint8_t count;          // ведущих тиков с начала цикла делителя
+  uint8_t subLeft;        // тиков выхода до конца цикла (mul > 1)
+  uint64_t subStepQ8;
+  uint64_t subNextQ8;
+  // статистика — пишет IRQ выхода
+  uint32_t ticks;
+  int32_t lastLat;
+  bool hasLat;
+  StatsHist jitter;
+};
+static ClockPort ports[DEST_COUNT];
+
+static uint8_t mode = CLOCK_THRU;
+static bool running = false;
+static uint16_t bpm10 = 1200;
+static uint16_t outDest = 0;                  // куда идут часы
+static uint8_t outCable = USB_CABLE_ROUTER;   // кабель USB для часов
+static uint64_t periodQ8 = 0;                 // период тика, 0 — неизвестен
+
+static bool haveIn = false;
+static uint64_t lastIn = 0;       // приход последнего входного тика, мкс
+static uint32_t inTicks = 0;
+static uint32_t outTicks = 0;
+static StatsHist inJitter;
+
+// --- Генератор (PLL, INTERNAL) ---
+static bool genOn = false;        // будильник генератора взведён
+static uint32_t genTicks = 0;     // PLL: номер последнего выданного тика
+static uint64_t genNextQ8 = 0;
+static uint64_t genLastQ8 = 0;    // время тика genTicks
+static uint64_t genPrevQ8 = 0;    // время тика genTicks - 1
+
+static int alarmNum = -1;
+static bool inAlarm = false;
+
+// USB не из IRQ: тики будильника ждут прохода core1
+struct UsbTick {
+  uint32_t ts;
+  uint8_t b;
+  uint8_t cable;
+};
+static SpscQueue<UsbTick, 32> usbTicks;
+
+// Команды core0 → core1
+enum ClockOp : uint8_t { OP_MODE, OP_BPM, OP_RATIO, OP_TRANSPORT, OP_RESET };
+struct ClockCmd {
+  uint8_t op;
+  uint8_t a;
+  uint8_t b;
+  uint16_t v;
+};
+static SpscQueue<ClockCmd, 16> cmdQueue;
+
+static const char *modeNames[] = {"thru", "pll", "internal"};
+
+const char *midi_clock_mode_name(uint8_t m) {
+  return m <= CLOCK_INTERNAL ? modeNames[m] : "";
+}
+
+// младшие 32 бита time_us_64() → полное время (ts — в прошлом)
+static inline uint64_t to64(uint32_t ts) {
+  uint64_t now = time_us_64();
+  return now - (uint32_t)((uint32_t)now - ts);
+}
+
+static inline uint64_t bpm_period(uint16_t b10) {
+  return (uint64_t)60000000ULL * 10 * 256 / ((uint32_t)b10 * CLOCK_PPQN);
+}
+
+// ======================================================
+// Выдача: realtime-полоса выхода или очередь USB
+// ======================================================
+static void emit(uint8_t sink, uint8_t b, uint32_t ref) {
+  if (inAlarm) stats_out_irq(sink);   // поток мог быть посреди своего инкремента
+  else stats_out(sink);
+  if (!inAlarm) capture_sink(sink);   // из IRQ открытое событие не наше
+  if (sink == 0) {
+    if (inAlarm) usbTicks.push({ref, b, outCable});
+    else send_midi_usb(midi_word(outCable, 0x0F, b, 0, 0), ref);
+    return;
+  }
+  send_midi_rt(sink, midi_word(outCable, 0x0F, b, 0, 0), ref);
+}
+
+// Ведущий тик: каждый выход — по своему div/mul
+static void master_tick(uint32_t ref) {
+  outTicks++;
+  midi_out_hold();   // тик на все TRS — одним кадром
+  for (uint16_t m = outDest; m; m &= m - 1) {
+    uint8_t s = __builtin_ctz(m);
+    ClockPort &p = ports[s];
+    if (!p.div) continue;
+    if (p.count == 0) {
+      for (; p.subLeft; p.subLeft--) emit(s, 0xF8, ref);   // темп вырос — долг сразу
+      emit(s, 0xF8, ref);
+      if (p.mul > 1 && periodQ8) {
+        p.subLeft = p.mul - 1;
+        p.subStepQ8 = periodQ8 * p.div / p.mul;
+        p.subNextQ8 = Q8(to64(ref)) + p.subStepQ8;
+      }
+    }
+    if (++p.count >= p.div) p.count = 0;
+  }
+  midi_out_release();
+}
+
+static void transport(uint8_t b, uint32_t ref) {
+  running = (b != 0xFC);
+  for (ClockPort &p : ports) {
+    p.subLeft = 0;
+    if (b == 0xFA) p.count = 0;   // Start: первый тик — на всех выходах
+  }
+  midi_out_hold();
+  for (uint16_t m = outDest; m; m &= m - 1) {
+    uint8_t s = __builtin_ctz(m);
+    if (ports[s].div) emit(s, b, ref);
+  }
+  midi_out_release();
+}
+
+// ======================================================
+// Период входа: сглаживание и джиттер
+// ======================================================
+// @return false — первый тик или пауза дольше CLOCK_LOST_US
+static bool track_period(uint64_t t) {
+  bool locked = haveIn && t - lastIn < CLOCK_LOST_US;
+  if (locked) {
+    uint64_t dQ8 = Q8(t - lastIn);
+    if (periodQ8) {
+      int64_t e = (int64_t)(dQ8 - periodQ8);
+      stats_hist_add(inJitter, (uint32_t)((e < 0 ? -e : e) >> 8));
+      periodQ8 += e / 8;
+    } else {
+      periodQ8 = dQ8;
+    }
+  }
+  lastIn = t;
+  haveIn = true;
+  inTicks++;
+  return locked;
+}
+
+// Поправка фазы PLL: генератор должен идти на CLOCK_PLL_DELAY_US за входом
+static inline int64_t pll_correction(uint64_t genQ8, uint64_t inUs) {
+  int64_t e = (int64_t)(genQ8 - Q8(inUs));
+  int64_t c = ((int64_t)Q8(CLOCK_PLL_DELAY_US) - e) / 4;
+  int64_t lim = (int64_t)(periodQ8 / 4);
+  return c > lim ? lim : (c < -lim ? -lim : c);
+}
+
+static void pll_input(uint64_t t) {
+  if (!track_period(t)) {                 // захват заново: фаза — от этого тика
+    genTicks = inTicks - 1;
+    genNextQ8 = Q8(t + CLOCK_PLL_DELAY_US);
+    genOn = true;
+    return;
+  }
+  if (genTicks >= inTicks) {              // генератор уже выдал этот тик
+    uint64_t g = (genTicks == inTicks) ? genLastQ8 : genPrevQ8;
+    genNextQ8 += pll_correction(g, t);
+    if (!genOn && genNextQ8 < Q8(t)) genNextQ8 = Q8(t);   // стоял, обогнав вход
+  } else {
+    for (; genTicks + 1 < inTicks; genTicks++)   // отстал больше чем на тик
+      master_tick((uint32_t)t);
+    if (!genOn) genNextQ8 = Q8(t + CLOCK_PLL_DELAY_US);  // период только что стал известен
+  }
+  genOn = true;
+}
+
+// Тик генератора по будильнику
+static void gen_tick() {
+  uint64_t g = genNextQ8;
+  if (mode == CLOCK_INTERNAL) {
+    master_tick((uint32_t)(g >> 8));
+    genNextQ8 = g + periodQ8;
+    if (genNextQ8 + periodQ8 < Q8(time_us_64())) genNextQ8 = Q8(time_us_64());   // IRQ долго стоял
+    return;
+  }
+
+  // PLL: впереди входа — не больше чем на тик (и ни на один, пока период неизвестен)
+  if (genTicks >= inTicks + (periodQ8 ? 1 : 0)) {
+    genOn = false;                        // ждём вход
+    return;
+  }
+  genTicks++;
+  genPrevQ8 = genLastQ8;
+  genLastQ8 = g;
+  master_tick((uint32_t)(g >> 8));
+  genNextQ8 = g + periodQ8;
+  if (genTicks == inTicks) genNextQ8 += pll_correction(g, lastIn);
+  if (!periodQ8) genOn = false;
+}
+
+// ======================================================
+// Будильник: генератор и тики между ведущими (mul > 1)
+// ======================================================
+static uint64_t next_deadline() {
+  uint64_t t = genOn ? genNextQ8 : CLOCK_NEVER;
+  for (const ClockPort &p : ports)
+    if (p.subLeft && p.subNextQ8 < t) t = p.subNextQ8;
+  return t;
+}
+
+// Выдать всё, что наступило, и взвести будильник (IRQ запрещены или в IRQ)
+static void clock_run() {
+  if (alarmNum < 0) return;
+  for (;;) {
+    uint64_t nowQ8 = Q8(time_us_64());
+    if (genOn && genNextQ8 <= nowQ8) gen_tick();
+    for (uint8_t s = 0; s < DEST_COUNT; s++) {
+      ClockPort &p = ports[s];
+      for (; p.subLeft && p.subNextQ8 <= nowQ8; p.subLeft--) {
+        emit(s, 0xF8, (uint32_t)(p.subNextQ8 >> 8));
+        p.subNextQ8 += p.subStepQ8;
+      }
+    }
+
+    uint64_t next = next_deadline();
+    if (next == CLOCK_NEVER) {
+      hardware_alarm_cancel(alarmNum);
+      return;
+    }
+    if (next <= nowQ8) continue;
+    if (!hardware_alarm_set_target(alarmNum, from_us_since_boot((next + 255) >> 8))) return;
+  }
+}
+
+static void clock_alarm(unsigned int) {
+  inAlarm = true;
+  clock_run();
+  inAlarm = false;
+}
+
+void setup_midi_clock() {
+  alarmNum = hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback(alarmNum, clock_alarm);
+  Serial.println("[CLOCK] Engine ready (thru)");
+}
+
+// ======================================================
+// Вход (core1)
+// ======================================================
+bool midi_clock_input(MidiWord w, uint32_t ts, uint16_t dest) {
+  uint8_t st = midi_word_status(w);
+  if (st != 0xF8 && (st < 0xFA || st > 0xFC)) return false;
+  if (mode == CLOCK_INTERNAL) return true;   // ведущие — мы, вход молчит
+
+  uint32_t irq = save_and_disable_interrupts();
+  outDest = dest;
+  outCable = midi_word_cable(w);
+  if (st != 0xF8) {
+    transport(st, ts);
+  } else if (mode == CLOCK_THRU) {
+    track_period(to64(ts));
+    master_tick(ts);
+  } else {
+    pll_input(to64(ts));
+  }
+  clock_run();
+  restore_interrupts(irq);
+  return true;
+}
+
+// ======================================================
+// Команды core0 и USB (core1)
+// ======================================================
+static void apply(const ClockCmd &c) {
+  switch (c.op) {
+    case OP_MODE:
+      mode = c.a;
+      haveIn = false;
+      periodQ8 = 0;
+      inTicks = genTicks = 0;
+      inJitter = StatsHist{};
+      genOn = false;
+      for (ClockPort &p : ports) p.count = p.subLeft = 0;
+      if (mode == CLOCK_INTERNAL) {
+        outDest = DEST_ALL;
+        outCable = USB_CABLE_ROUTER;
+        periodQ8 = bpm_period(bpm10);
+        genNextQ8 = Q8(time_us_64());
+        genOn = true;
+      }
+      break;
+    case OP_BPM:
+      bpm10 = c.v;
+      if (mode == CLOCK_INTERNAL) periodQ8 = bpm_period(bpm10);
+      break;
+    case OP_RATIO:
+      for (uint16_t m = c.v & DEST_ALL; m; m &= m - 1) {
+        ClockPort &p = ports[__builtin_ctz(m)];
+        p.div = c.a;
+        p.mul = c.b;
+        p.count = p.subLeft = 0;
+      }
+      break;
+    case OP_TRANSPORT:
+      if (mode == CLOCK_INTERNAL) transport(c.a, time_us_32());
+      break;
+    case OP_RESET:
+      inJitter = StatsHist{};
+      for (ClockPort &p : ports) {
+        p.ticks = 0;
+        p.hasLat = false;
+        p.jitter = StatsHist{};
+      }
+      break;
+  }
+}
+
+void midi_clock_task() {
+  ClockCmd c;
+  while (cmdQueue.pop(c)) {
+    uint32_t irq = save_and_disable_interrupts();
+    apply(c);
+    clock_run();
+    restore_interrupts(irq);
+  }
+
+  UsbTick u;
+  while (usbTicks.pop(u))
+    send_midi_usb(midi_word(u.cable, 0x0F, u.b, 0, 0), u.ts);
+}
+
+void midi_clock_on_wire(uint8_t sink, uint32_t ref) {
+  if (sink >= DEST_COUNT) return;
+  ClockPort &p = ports[sink];
+  int32_t lat = (int32_t)(time_us_32() - ref);
+  p.ticks++;
+  if (p.hasLat) {
+    int32_t d = lat - p.lastLat;
+    stats_hist_add(p.jitter, (uint32_t)(d < 0 ? -d : d));
+  }
+  p.lastLat = lat;
+  p.hasLat = true;
+}
+
+// ======================================================
+// core0
+// ======================================================
+bool midi_clock_set_mode(uint8_t m) {
+  return m <= CLOCK_INTERNAL && cmdQueue.push({OP_MODE, m, 0, 0});
+}
+
+bool midi_clock_set_bpm(uint16_t b10) {
+  if (b10 < CLOCK_BPM_MIN * 10 || b10 > CLOCK_BPM_MAX * 10) return false;
+  return cmdQueue.push({OP_BPM, 0, 0, b10});
+}
+
+bool midi_clock_set_ratio(uint16_t dest, uint8_t div, uint8_t mul) {
+  if (!dest || div > CLOCK_RATIO_MAX || mul > CLOCK_RATIO_MAX || (div && !mul)) return false;
+  return cmdQueue.push({OP_RATIO, div, mul, dest});
+}
+
+bool midi_clock_transport(uint8_t status) {
+  if (status < 0xFA || status > 0xFC) return false;
+  return cmdQueue.push({OP_TRANSPORT, status, 0, 0});
+}
+
+void midi_clock_reset_stats() {
+  cmdQueue.push({OP_RESET, 0, 0, 0});
+}
+
+void midi_clock_get_stats(ClockStats &st) {
+  st.mode = mode;
+  st.running = running;
+  st.bpm10 = bpm10;
+  st.periodUs = (uint32_t)(periodQ8 >> 8);
+  st.inTicks = inTicks;
+  st.outTicks = outTicks;
+  st.inJitter = inJitter;
+}
+
+void midi_clock_get_port(uint8_t sink, ClockPortStats &st) {
+  if (sink >= DEST_COUNT) return;
+  const ClockPort &p = ports[sink];
+  st.div = p.div;
+  st.mul = p.mul;
+  st.ticks = p.ticks;
+  st.jitter = p.jitter;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include "midi_word.h"
+#include "stats.h"
+
+// ======================================================
+// MIDI Clock: realtime-полоса, генератор, делители по портам
+// ======================================================
+// Clock (F8) и транспорт (FA Start, FB Continue, FC Stop) не идут
+// через матрицу и очереди: движок часов кладёт их прямо в realtime-
+// полосы выходов (send_midi_rt), и байт уходит в линию между
+// сообщениями, а не за ними.
+//
+// Режимы:
+//  - THRU     — входной F8 сразу на выходы (маска — ячейка "system"
+//               матрицы thru того входа, откуда пришли часы)
+//  - PLL      — свой генератор на аппаратном будильнике, подстроенный
+//               под вход: период — сглаженный интервал входа, фаза
+//               подтягивается к входу с постоянной задержкой
+//               CLOCK_PLL_DELAY_US. Число тиков на выходе равно числу
+//               тиков входа (генератор опережает вход не больше чем
+//               на тик и не отстаёт больше чем на тик)
+//  - INTERNAL — генератор с темпом CLOCK BPM; входные часы и транспорт
+//               игнорируются, Start/Stop — командой CLOCK
+//
+// У каждого выхода свой множитель/делитель: на div тиков ведущих
+// часов — mul тиков выхода, равномерно по периоду (тики между
+// ведущими ставит будильник). div = 0 — часы на выход не идут.
+// Start выравнивает фазу делителей: первый тик после Start — на всех.
+//
+// Джиттер выхода — разброс задержки "эталон → линия" от тика к тику
+// (|Δзадержки| = |интервал в линии − интервал эталона|). Эталон —
+// приход входного тика (THRU) или сетка генератора (PLL, INTERNAL).
+// Джиттер входа — |интервал входа − сглаженный период|.
+
+#define CLOCK_PPQN          24
+#define CLOCK_BPM_MIN       20
+#define CLOCK_BPM_MAX       300
+#define CLOCK_PLL_DELAY_US  2000     // запас генератора PLL за входом
+#define CLOCK_LOST_US       500000   // пауза входа — часы потеряны (< 5 BPM)
+#define CLOCK_RATIO_MAX     24       // div и mul — 0…24
+
+enum ClockMode : uint8_t {
+  CLOCK_THRU = 0,
+  CLOCK_PLL,
+  CLOCK_INTERNAL
+};
+
+/**
+ * @brief Инициализация (core1): будильник генератора, IRQ — на core1
+ */
+void setup_midi_clock();
+
+/**
+ * @brief Realtime со входа (core1, из handle_midi_event)
+ *
+ * @param dest маска выходов для часов этого входа (0 — thru выключен)
+ * @return false — не часы и не транспорт (F9, FD, FE, FF): дальше
+ *         через матрицу, как обычно
+ */
+bool midi_clock_input(MidiWord w, uint32_t ts, uint16_t dest);
+
+/**
+ * @brief Команды core0 и тики для USB (core1, до midi_out_flush)
+ */
+void midi_clock_task();
+
+/**
+ * @brief Байт F8 ушёл в линию выхода (IRQ выхода / отправка USB)
+ * @param ref эталонное время тика, мкс
+ */
+void midi_clock_on_wire(uint8_t sink, uint32_t ref);
+
+// --- core0: настройки уходят в core1 очередью команд ---
+bool midi_clock_set_mode(uint8_t mode);
+bool midi_clock_set_bpm(uint16_t bpm10);                       // темп × 10
+bool midi_clock_set_ratio(uint16_t dest, uint8_t div, uint8_t mul);
+bool midi_clock_transport(uint8_t status);                     // FA/FB/FC (INTERNAL)
+void midi_clock_reset_stats();
+
+struct ClockStats {
+  uint8_t mode;          // ClockMode
+  bool running;          // транспорт: после Start/Continue, до Stop
+  uint16_t bpm10;        // темп генератора INTERNAL × 10
+  uint32_t periodUs;     // текущий период тика (сглаженный вход или генератор), 0 — нет
+  uint32_t inTicks;      // тиков F8 со входа
+  uint32_t outTicks;     // ведущих тиков на выходы
+  StatsHist inJitter;    // |интервал входа − период|, мкс
+};
+
+struct ClockPortStats {
+  uint8_t div;
+  uint8_t mul;
+  uint32_t ticks;        // F8 ушло в линию
+  StatsHist jitter;      // |Δзадержки| тик к тику, мкс
+};
+
+void midi_clock_get_stats(ClockStats &st);
+void midi_clock_get_port(uint8_t sink, ClockPortStats &st);
+const char *midi_clock_mode_name(uint8_t mode);
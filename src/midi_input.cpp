@@ -1,156 +1,302 @@
 #include "midi_input.h"
 #include <Arduino.h>
+#include <atomic>
 #include "midi_output.h"
 #include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "spsc_queue.h"
+#include "midi_parser.h"
+#include "route_table.h"
+#include "stats.h"
+#include "capture.h"
+#include "midi_clock.h"
+#include "config_manager.h"
+#include "note_state.h"
 
 // ==============================
 // Настройки MIDI IN
 // ==============================
 #define MIDI_RX_PIN 5
 #define MIDI_BAUD 31250
+#define USB_IN_BUDGET 32   // пакетов USB за проход core1 (остальное — в следующий)
 
 // ------------------------------
 // Внутренние переменные
 // ------------------------------
-static uint8_t runningStatus = 0;   // Running Status поддержка
-static uint8_t data1 = 0;           // Буфер первого байта
-static bool waiting_data1 = false;  // Флаги состояния
-static bool waiting_data2 = false;
+static MidiParser parser;           // состояние парсера DIN IN
+static void on_parsed_event(const MidiEvent &ev, void *ctx);
+static void on_parsed_sysex(const MidiWord *words, uint8_t count, uint8_t flags, uint32_t ts, void *ctx);
 
-bool midiThruEnabled = true;        // Флаг разрешения MIDI Thru
+volatile bool midiThruEnabled = true; // Флаг MIDI Thru (пишет core0, читает core1)
+
+// --- Кольцо RX: байт + время прихода (заполняет IRQ UART1) ---
+struct RxByte {
+  uint32_t ts;      // time_us_64() (младшие 32 бита)
+  uint8_t b;
+};
+static SpscQueue<RxByte, 256> rxRing;
+static MidiInStats rxStats;
+static std::atomic<bool> resetRequest{false};   // ставит core0 (RESET), снимает midi_in_task
+
+// ======================================================
+// Инициализация MIDI входа
+// ======================================================
+// ======================================================
+// IRQ UART1: каждый байт сразу в кольцо со штампом времени
+// ======================================================
+static void midi_rx_irq() {
+  uart_hw_t *hw = uart_get_hw(uart1);
+  uint32_t now = (uint32_t)time_us_64();
+
+  while (!(hw->fr & UART_UARTFR_RXFE_BITS)) {
+    uint32_t dr = hw->dr;   // байт + флаги ошибок этого байта
+    if (dr & UART_UARTDR_OE_BITS) rxStats.uartOverruns++;
+    if (dr & UART_UARTDR_BE_BITS) { rxStats.breaks++; continue; }
+    if (dr & UART_UARTDR_FE_BITS) { rxStats.framingErrors++; continue; }
+
+    rxStats.bytes++;
+    if (!rxRing.push({now, (uint8_t)dr})) rxStats.ringOverruns++;
+  }
+
+  uint32_t depth = rxRing.size();
+  if (depth > rxStats.ringPeak) rxStats.ringPeak = (uint16_t)depth;
+}
 
 // ======================================================
 // Инициализация MIDI входа
 // ======================================================
 void setup_midi_input() {
-  uart_init(uart1, MIDI_BAUD);
+  if (!uart_is_enabled(uart1))           // UART1 мог поднять DIN TX
+    uart_init(uart1, MIDI_BAUD);
   gpio_set_function(MIDI_RX_PIN, GPIO_FUNC_UART);
   uart_set_hw_flow(uart1, false, false);
   uart_set_format(uart1, 8, 1, UART_PARITY_NONE);
 
   // MIDI использует инверсный сигнал (активный LOW)
-  uart_set_inverse(uart1, UART_INVERSE_RX);
+  gpio_set_inover(MIDI_RX_PIN, GPIO_OVERRIDE_INVERT);
 
-  Serial.println("[MIDI-IN] Initialized at 31250 baud");
+  // Без FIFO прерывание приходит на каждый байт — штамп времени
+  // точный, и нет таймаута RX FIFO (32 бита ≈ 1 мс на 31250)
+  uart_set_fifo_enabled(uart1, false);
+  midi_parser_init(parser, on_parsed_event, on_parsed_sysex, nullptr, USB_CABLE_DIN);
+  irq_add_shared_handler(UART1_IRQ, midi_rx_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(UART1_IRQ, true);
+  hw_set_bits(&uart_get_hw(uart1)->imsc, UART_UARTIMSC_RXIM_BITS | UART_UARTIMSC_RTIM_BITS);
+
+  Serial.println("[MIDI-IN] Initialized at 31250 baud (IRQ)");
 }
 
 // ======================================================
-// Основная задача — вызывать из loop()
+// Основная задача — вызывать из loop1()
 // ======================================================
 void midi_in_task() {
-  while (uart_is_readable(uart1)) {
-    uint8_t b = uart_getc(uart1);
-    process_midi_input(b);
+  if (resetRequest.exchange(false)) {
+    uint32_t irq = save_and_disable_interrupts();   // rxStats пишет и IRQ UART1
+    rxStats = MidiInStats{};
+    restore_interrupts(irq);
   }
+  RxByte rx;
+  while (rxRing.pop(rx))
+    process_midi_input(rx.b, rx.ts);
+}
+
+void midi_in_get_stats(MidiInStats &st) {
+  st = rxStats;
+  st.ringDepth = (uint16_t)rxRing.size();
+}
+
+void midi_in_reset_stats() {
+  resetRequest.store(true);
 }
 
 // ======================================================
-// Парсер входящего MIDI потока
+// Парсер входящего MIDI потока (см. midi_parser.h)
 // ======================================================
-void process_midi_input(uint8_t b) {
-  // Если пришёл статус-байт
-  if (b & 0x80) {
-    runningStatus = b;
-    waiting_data1 = true;
-    waiting_data2 = false;
-    return;
-  }
+static void on_parsed_event(const MidiEvent &ev, void *) {
+  stats_in(SRC_DIN);
+  uint8_t data[3];
+  capture_open(SRC_DIN, data, midi_word_bytes(ev.word, data), ev.ts);
+  handle_midi_event(ev.word, ev.ts);
+  capture_close();
+}
 
-  // Running Status — используем последний статус
-  if (runningStatus == 0)
-    return; // нет активного статуса
-
-  uint8_t type = runningStatus & 0xF0;
-
-  if (type == 0xC0 || type == 0xD0) {
-    // Одно-байтовые команды (Program Change / Channel Pressure)
-    handle_midi_event(runningStatus, b, 0);
-    waiting_data1 = false;
-    waiting_data2 = false;
-  } else {
-    // Двух-байтовые (Note, CC и т.д.)
-    if (waiting_data1) {
-      data1 = b;
-      waiting_data1 = false;
-      waiting_data2 = true;
-    } else if (waiting_data2) {
-      handle_midi_event(runningStatus, data1, b);
-      waiting_data1 = true;
-      waiting_data2 = false;
-    }
-  }
+// вход матрицы thru по кабелю слова
+static inline uint8_t thru_input(MidiWord w) {
+  return (midi_word_cable(w) == USB_CABLE_ROUTER) ? THRU_IN_USB : THRU_IN_DIN;
+}
+
+// Цепочка SysEx уходит теми же словами: кабель входа — кабель для хоста
+static void thru_sysex(const MidiWord *words, uint8_t count, uint32_t ts) {
+  if (!midiThruEnabled || !count) return;
+  uint16_t dest = THRU_DEST(active_routes()->thru[thru_input(words[0])][0][THRU_SYSTEM]);
+  midi_out_hold();   // кусок на все TRS — одними кадрами
+  for (uint16_t m = dest; m; m &= m - 1)
+    send_midi_words(__builtin_ctz(m), words, count, ts);
+  midi_out_release();
+}
+
+static void on_parsed_sysex(const MidiWord *words, uint8_t count, uint8_t flags, uint32_t ts, void *) {
+  uint8_t data[MIDI_SYSEX_CHUNK] = {};
+  uint8_t len = 0;
+  for (uint8_t i = 0; i < count; i++) len += midi_word_bytes(words[i], data + len);
+  if ((flags & SYSEX_ABORT) && len) len--;   // F7 добавил парсер, в линии его не было
+  capture_open(SRC_DIN, data, len, ts);
+  thru_sysex(words, count, ts);
+  capture_close();
+}
+
+void process_midi_input(uint8_t b, uint32_t ts) {
+  midi_parser_feed(parser, b, ts);
 }
 
 // ======================================================
 // Обработка MIDI события (Note, CC, PC...)
 // ======================================================
-void handle_midi_event(uint8_t st, uint8_t d1, uint8_t d2) {
+// Матрица thru (см. route_table.h): одна ячейка на (канал, тип) —
+// маска выходов и выходной канал; пустая маска — сообщение блокируется
+// Рядом — индекс LUT кривой для значения (скорость, давление, CC).
+static void thru(uint8_t in, uint8_t cable, uint8_t st, uint8_t d1, uint8_t d2, uint32_t ts) {
+  if (!midiThruEnabled) return;
+  const RouteTable *t = active_routes();
+  bool channel = st < 0xF0;
+  uint8_t ch = channel ? (st & 0x0F) : 0;
+  uint8_t type = route_thru_type(st, d2);
+  ThruCell c = t->thru[in][ch][type];
+
+  if (channel) {
+    st = (st & 0xF0) | THRU_CHANNEL(c);
+    const uint8_t *lut = t->curves[t->thruCurve[in][ch][type]];
+    if (type == THRU_PRESSURE) d1 = lut[d1 & 0x7F];
+    else d2 = lut[d2 & 0x7F];               // у типов без кривой LUT 0 — тождественная
+    if (type == THRU_NOTE_ON && !d2) d2 = 1; // кривая не превращает NoteOn в NoteOff
+  }
+  send_midi_mask(THRU_DEST(c), midi_word_msg(cable, st, d1, d2), ts);
+}
+
+void handle_midi_event(MidiWord w, uint32_t ts) {
+  uint8_t st = midi_word_status(w);
+  uint8_t d1 = midi_word_data1(w);
+  uint8_t d2 = midi_word_data2(w);
   uint8_t type = st & 0xF0;
   uint8_t ch = (st & 0x0F) + 1;
 
+  // ----- Часы и транспорт — движку часов, мимо матрицы и очередей -----
+  if (st >= 0xF8) {
+    uint16_t dest = midiThruEnabled ? THRU_DEST(active_routes()->thru[thru_input(w)][0][THRU_SYSTEM]) : 0;
+    if (midi_clock_input(w, ts, dest)) return;
+  }
+
   // ----- Отладка -----
 #ifdef DEBUG_MIDI
   Serial.printf("[MIDI-IN] 0x%02X %d %d (ch%d)\n", st, d1, d2, ch);
 #endif
 
-  // ----- Обработка -----
-  switch (type) {
-    case 0x90: // Note On
-      if (d2 > 0) {
-        if (midiThruEnabled) {
-          send_midi_usb(st, d1, d2);
-          send_midi_uart(st, d1, d2);
-          for (int i = 0; i < 10; i++) send_midi_pio(i, st, d1, d2);
-        }
-      } else {
-        if (midiThruEnabled) {
-          send_midi_usb(0x80 | ((ch - 1) & 0x0F), d1, 0);
-          send_midi_uart(0x80 | ((ch - 1) & 0x0F), d1, 0);
-          for (int i = 0; i < 10; i++) send_midi_pio(i, 0x80 | ((ch - 1) & 0x0F), d1, 0);
-        }
-      }
-      break;
+  // ----- Управляющий канал: Bank Select + Program Change → пресет -----
+  if (ch == preset_get_control_channel()) {
+    static uint8_t presetBank = 0;
+    if (type == 0xB0 && d1 == 0) {           // Bank Select MSB
+      presetBank = d2;
+      return;
+    }
+    if (type == 0xB0 && d1 == 123) {         // All Notes Off → PANIC на всех выходах
+      notes_release(DEST_ALL);
+      return;
+    }
+    if (type == 0xC0) {
+      if (presetBank < PRESET_BANKS)
+        preset_recall(presetBank * PRESETS_PER_BANK + d1 + 1, ts);
+      return;
+    }
+  }
 
-    case 0x80: // Note Off
-      if (midiThruEnabled) {
-        send_midi_usb(st, d1, d2);
-        send_midi_uart(st, d1, d2);
-        for (int i = 0; i < 10; i++) send_midi_pio(i, st, d1, d2);
-      }
-      break;
+  // ----- Нормализация -----
+  if (type == 0x90 && d2 == 0)                 // Note On vel 0 → Note Off
+    st = 0x80 | (st & 0x0F);
+  if (type == 0xC0 || type == 0xD0)            // 2-байтовые: второго байта нет
+    d2 = 0;
 
-    case 0xB0: // Control Change
-      if (midiThruEnabled) {
-        send_midi_usb(st, d1, d2);
-        send_midi_uart(st, d1, d2);
-        for (int i = 0; i < 10; i++) send_midi_pio(i, st, d1, d2);
-      }
-      break;
+  // System Common (F1–F6) и Realtime (F8–FF): длину знает выход
+  thru(thru_input(w), midi_word_cable(w), st, d1, d2, ts);
+}
 
-    case 0xC0: // Program Change
-    case 0xD0: // Channel Pressure
-      if (midiThruEnabled) {
-        send_midi_usb(st, d1, 0);
-        send_midi_uart(st, d1, 0);
-        for (int i = 0; i < 10; i++) send_midi_pio(i, st, d1, 0);
-      }
+// ======================================================
+// USB MIDI от хоста (core1)
+// ======================================================
+// Кабели 1–11 — прямо в порт с тем же номером, пакет как есть.
+// Кабель 0 — вход маршрутизатора (управляющий канал, матрица thru).
+static void usb_router_packet(MidiWord w, uint32_t ts) {
+  switch (midi_word_cin(w)) {
+    case 0x4:                                  // SysEx: начало/продолжение
+    case 0x6:                                  // конец SysEx, 2 / 3 байта
+    case 0x7:
+      thru_sysex(&w, 1, ts);
+      break;
+    case 0x5:                                  // 1 байт: конец SysEx или F6
+      if (midi_word_status(w) == 0xF7)
+        thru_sysex(&w, 1, ts);
+      else
+        handle_midi_event(w, ts);
+      break;
+    case 0x0:                                  // зарезервированы
+    case 0x1:
       break;
+    default:                                   // 0x2–0x3, 0x8–0xF: одно событие
+      handle_midi_event(w, ts);
+      break;
+  }
+}
+
+void midi_in_usb_task() {
+  // пакет, которому не хватило места в очереди порта: пока он не
+  // уйдёт, USB не читаем — хост ждёт (NAK), а не теряет данные
+  static MidiWord pending;
+  static uint32_t pendingTs;
+  static bool hasPending = false;
 
-    default:
-      // Прочие статусы (Pitch Bend, Aftertouch и т.п.)
-      if (midiThruEnabled) {
-        send_midi_usb(st, d1, d2);
-        send_midi_uart(st, d1, d2);
-        for (int i = 0; i < 10; i++) send_midi_pio(i, st, d1, d2);
+  for (uint8_t n = 0; n < USB_IN_BUDGET; n++) {
+    if (hasPending) {
+      capture_open(SRC_USB, (const uint8_t *)&pending, 4, pendingTs);
+      if (!send_midi_packet(pending, pendingTs)) {
+        capture_cancel();
+        rxStats.usbStalls++;
+        return;
       }
-      break;
+      capture_close();
+      hasPending = false;
+    }
+
+    MidiWord w;
+    if (!midi_usb_read_packet(w)) return;
+    uint32_t ts = (uint32_t)time_us_64();
+    rxStats.usbPackets++;
+    stats_in(SRC_USB);
+
+    capture_open(SRC_USB, (const uint8_t *)&w, 4, ts);
+    if (midi_word_cable(w) == USB_CABLE_ROUTER) {
+      usb_router_packet(w, ts);
+    } else if (!send_midi_packet(w, ts)) {
+      capture_cancel();   // запишется, когда уйдёт
+      pending = w;
+      pendingTs = ts;
+      hasPending = true;
+    }
+    capture_close();
   }
 }
 
+void midi_in_replay_usb(MidiWord w, uint32_t ts) {
+  if (midi_word_cable(w) == USB_CABLE_ROUTER) usb_router_packet(w, ts);
+  else send_midi_packet(w, ts);   // порт полон — пакет теряется, повтор не ждёт
+}
+
 // ======================================================
 // Дополнительные функции управления
 // ======================================================
 void midi_in_set_thru(bool enabled) {
+  if (midiThruEnabled && !enabled)
+    notes_post_release(DEST_ALL);   // NoteOff со входа больше не пройдут
   midiThruEnabled = enabled;
   Serial.printf("[MIDI-IN] Thru %s\n", enabled ? "enabled" : "disabled");
 }
@@ -1,7 +1,34 @@
 #pragma once
 #include <stdint.h>
+#include "route_table.h"
+#include "midi_word.h"
+
+// Счётчики приёма MIDI IN (IRQ UART1 → кольцо → парсер)
+struct MidiInStats {
+  uint32_t bytes;           // принято байт
+  uint32_t ringOverruns;    // кольцо RX было полно, байт потерян
+  uint32_t uartOverruns;    // аппаратное переполнение UART (OE)
+  uint32_t framingErrors;   // ошибки кадра (FE)
+  uint32_t breaks;          // break на линии (BE)
+  uint16_t ringPeak;        // максимальная глубина кольца
+  uint16_t ringDepth;       // текущая глубина кольца
+  uint32_t usbPackets;      // принято пакетов USB-MIDI
+  uint32_t usbStalls;       // проходы, когда порт был полон и USB ждал
+};
 
 void setup_midi_input();
 void midi_in_task();
-void process_midi_input(uint8_t b);
-void handle_midi_event(uint8_t st, uint8_t d1, uint8_t d2);
\ No newline at end of file
+void midi_in_get_stats(MidiInStats &st);
+void midi_in_reset_stats();   // core0: сбросит core1 в следующем midi_in_task()
+
+// ts — время прихода байта/события, мкс (младшие 32 бита time_us_64)
+void process_midi_input(uint8_t b, uint32_t ts);
+// вход матрицы thru — по кабелю слова: USB_CABLE_ROUTER — THRU_IN_USB, иначе DIN
+void handle_midi_event(MidiWord w, uint32_t ts);
+
+// USB MIDI от хоста: кабели 1–11 → порты, кабель 0 → маршрутизатор (core1)
+void midi_in_usb_task();
+// пакет от хоста в обход USB — повтор записи (capture.h)
+void midi_in_replay_usb(MidiWord w, uint32_t ts);
+void midi_in_set_thru(bool enabled);
+bool midi_in_get_thru();
\ No newline at end of file
@@ -3,7 +3,19 @@
 #include "Adafruit_TinyUSB.h"
 #include "hardware/pio.h"
 #include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/structs/usb.h"
 #include "midi_uart_tx.pio.h"
+#include "bitslice.h"
+#include "capture.h"
+#include "midi_clock.h"
+#include "scheduler.h"
+#include "note_state.h"
+#include "midi_queue.h"
+#include "route_table.h"
+#include "spsc_queue.h"
 
 // ======================================================
 // Конфигурация интерфейсов
@@ -12,48 +24,302 @@
 // --- USB MIDI ---
 Adafruit_USBD_MIDI usb_midi;
 
+// Пакеты USB-MIDI (4 байта, CIN) копятся здесь и уходят пачкой
+// в конце прохода диспетчера — 16 пакетов = один bulk-пакет 64 байта
+#define USB_BATCH_PACKETS 16
+
+struct UsbBatch {
+  MidiWord pkt[USB_BATCH_PACKETS];  // слово = пакет USB-MIDI
+  uint32_t ts[USB_BATCH_PACKETS];   // для замера задержки при отправке
+  uint8_t count;
+  uint8_t mode = USB_FLUSH_PASS;    // UsbFlushMode
+  uint16_t lastFrame;               // номер кадра USB последней отправки
+};
+static UsbBatch usb_out;
+static UsbOutStats usbStats;
+
 // --- DIN MIDI (UART1 TX) ---
 #define DIN_TX_PIN 4
 #define MIDI_BAUD 31250
 
-// --- 10 TRS MIDI OUT (PIO) ---
+// --- 10 TRS MIDI OUT (PIO): одна state machine на все порты ---
+// Выводы — в окне 32 от TRS_PIN_BASE; кадр по байту на порт (bitslice.h)
+#define TRS_PIN_BASE 6
 const uint midi_tx_pins[10] = {6,8,10,12,14,16,18,20,22,26};
-PIO pio_a = pio0;
-PIO pio_b = pio1;
-uint sm_ports[10];
+PIO pio_tx = pio0;
+uint sm_tx;
+static BitSlicer slicer;
+static uint32_t frame[BITSLICE_COLS];   // столбцы кадра для TX FIFO
+static uint8_t framePos = BITSLICE_COLS; // столбцов кадра уже отдано
+static volatile uint8_t trsHold = 0;     // веер идёт: кадр — когда байт будет у всех
+
+// --- Очереди TRS портов (опустошаются из IRQ "TX FIFO not full") ---
+// Realtime (F8–FF) идёт мимо очереди: своя короткая полоса, байт из
+// неё уходит в FIFO раньше следующего байта сообщения — даже посреди
+// сообщения или SysEx, как разрешает MIDI 1.0. Ждёт он только то, что
+// уже лежит в FIFO state machine / регистре UART.
+#define RT_LANE_SIZE 8   // степень двойки
+
+struct TxPort {
+  MidiQueue q;
+  MidiMsg cur;       // сообщение, которое сейчас уходит в FIFO
+  uint8_t len;       // байт в cur (по CIN)
+  uint8_t pos;       // сколько байт cur уже отправлено
+  uint8_t encoding = ENCODE_RUNNING;   // OutEncoding
+  uint8_t runStatus; // последний статус на линии (0 — нет running status)
+  uint32_t wireBytes;  // ушло байт в линию
+  uint32_t savedBytes; // опущено статус-байтов
+  uint8_t rt[RT_LANE_SIZE];        // realtime-полоса: байты F8–FF
+  uint32_t rtTs[RT_LANE_SIZE];     // время исходного события (эталон для часов)
+  volatile uint8_t rtHead;         // пишет продюсер (с запретом IRQ)
+  volatile uint8_t rtTail;         // пишет IRQ выхода
+  uint32_t rtDrops;                // полоса была полна
+  uint8_t sysex;                   // SysexChain: цепочка SysEx в очереди
+};
+static TxPort tx_ports[10];
+
+// Цепочка SysEx ставится в очередь кусками целиком: слово, выброшенное
+// из середины (или F0), дало бы на линии битый SysEx, а данные после
+// него приёмник принял бы за running status
+enum SysexChain : uint8_t {
+  SYSEX_IDLE = 0,   // цепочки нет
+  SYSEX_OPEN,       // F0 ушёл в очередь, ждём продолжения
+  SYSEX_SKIP        // кусок не влез: остаток цепочки выбрасываем
+};
+static TxPort din_port;    // DIN: та же очередь, опустошается IRQ UART1
+
+// --- Задержка вход → выход по каждому выходу (индекс = бит DEST_*) ---
+static LatencyStats latency[DEST_COUNT];
+
+static inline void note_latency(uint8_t sink, uint32_t ts) {
+  if (ts == 0) return;
+  uint32_t lat = (uint32_t)time_us_64() - ts;
+  latency[sink].last = lat;
+  stats_hist_add(latency[sink], lat);
+}
+
+// --- Байт realtime-полосы (IRQ выхода); false — полоса пуста ---
+static inline bool rt_take(TxPort &tp, uint8_t sink, uint8_t &b) {
+  uint8_t tail = tp.rtTail;
+  if (tail == tp.rtHead) return false;
+  b = tp.rt[tail & (RT_LANE_SIZE - 1)];
+  uint32_t ts = tp.rtTs[tail & (RT_LANE_SIZE - 1)];
+  tp.rtTail = tail + 1;
+  tp.wireBytes++;
+  note_latency(sink, ts);
+  if (b == 0xF8) midi_clock_on_wire(sink, ts);
+  return true;
+}
 
 // ======================================================
-// Инициализация USB, UART и PIO
+// Команды core0 → core1
 // ======================================================
-void setup_midi_output() {
-  // 1️⃣ USB MIDI
+// Очереди и кодер выходов принадлежат core1 (поток и его IRQ) —
+// настройки с WebSerial меняются только здесь, между проходами.
+enum OutOp : uint8_t { OP_POLICY, OP_ENCODING, OP_USB_FLUSH, OP_TEST, OP_RESET };
+enum ResetBits : uint8_t { RESET_QUEUE = 1, RESET_LATENCY = 2, RESET_USB = 4 };
+struct OutCmd {
+  uint8_t op;
+  uint8_t sink;
+  uint8_t v;
+};
+static SpscQueue<OutCmd, 16> cmdQueue;
+static SpscQueue<uint8_t, 4> testQueue;   // core1 → core0: аккорд сыгран, NoteOff на колесе
+
+static TxPort *sink_port(uint8_t sink);
+static void reset_stats(uint8_t what);
+
+static void apply(const OutCmd &c) {
+  if (c.op == OP_POLICY) {
+    tx_ports[c.sink].q.policy = c.v;
+  } else if (c.op == OP_ENCODING) {
+    // кодер работает в IRQ: новое кодирование начинается с полного статуса
+    TxPort *tp = sink_port(c.sink);
+    uint32_t irq = save_and_disable_interrupts();
+    tp->encoding = c.v;
+    tp->runStatus = 0;
+    restore_interrupts(irq);
+  } else if (c.op == OP_USB_FLUSH) {
+    usb_out.mode = c.v;
+  } else if (c.op == OP_TEST) {
+    test_midi_outputs();
+  } else if (c.op == OP_RESET) {
+    reset_stats(c.v);
+  }
+}
+
+void midi_out_task() {
+  OutCmd c;
+  while (cmdQueue.pop(c)) apply(c);
+}
+
+// ======================================================
+// Кодер линии: running status (вызывается из IRQ при взятии сообщения)
+// ======================================================
+// Статус опускается, если совпадает с последним ушедшим в линию.
+// Realtime (F8–FF) running status не сбрасывает, System Common и
+// SysEx (F0–F7) — сбрасывают; куски SysEx (без статуса) не трогаем.
+static inline void encode_msg(TxPort &tp) {
+  tp.pos = 0;
+  tp.len = midi_word_len(tp.cur.w);
+  uint8_t st = midi_word_status(tp.cur.w);
+
+  if (st >= 0x80 && st < 0xF0) {
+    if (tp.encoding == ENCODE_FULL) {
+      tp.runStatus = 0;
+    } else {
+      if (tp.encoding == ENCODE_RUNNING_NOTEON && (st & 0xF0) == 0x80) {
+        st = 0x90 | (st & 0x0F);   // NoteOff → NoteOn vel 0: тот же статус, что у нот
+        tp.cur.w = midi_word(midi_word_cable(tp.cur.w), 0x09, st, midi_word_data1(tp.cur.w), 0);
+      }
+      if (st == tp.runStatus) {
+        tp.pos = 1;
+        tp.savedBytes++;
+      } else {
+        tp.runStatus = st;
+      }
+    }
+  } else if (st >= 0xF0 && st < 0xF8) {
+    tp.runStatus = 0;
+  }
+  tp.wireBytes += tp.len - tp.pos;
+}
+
+static inline pio_interrupt_source tx_irq_source(uint sm) {
+  return (pio_interrupt_source)(pis_sm0_tx_fifo_not_full + sm);
+}
+
+// ======================================================
+// IRQ: очереди TRS → кадры → столбцы в FIFO state machine
+// ======================================================
+// Следующий байт порта в кадр: realtime-полоса, затем сообщение
+static inline bool port_take(uint8_t port, uint8_t &b) {
+  TxPort &tp = tx_ports[port];
+  if (rt_take(tp, 2 + port, b)) return true;
+  if (tp.pos >= tp.len) {
+    if (!midi_queue_pop(tp.q, tp.cur)) {
+      tp.len = 0;
+      tp.pos = 0;
+      return false;
+    }
+    encode_msg(tp);
+    note_latency(2 + port, tp.cur.ts);
+  }
+  b = midi_word_byte(tp.cur.w, tp.pos++);
+  return true;
+}
+
+static void drain_ports() {
+  while (!pio_sm_is_tx_fifo_full(pio_tx, sm_tx)) {
+    if (framePos == BITSLICE_COLS) {
+      uint8_t bytes[10];
+      uint16_t active = 0;
+      for (uint8_t i = 0; i < 10; i++)
+        if (port_take(i, bytes[i])) active |= 1u << i;
+      if (!active) {
+        // все очереди пусты — молчим, пока продюсер снова не включит IRQ
+        pio_set_irq0_source_enabled(pio_tx, tx_irq_source(sm_tx), false);
+        return;
+      }
+      bitslice_frame(slicer, bytes, active, frame);
+      framePos = 0;
+    }
+    pio_sm_put(pio_tx, sm_tx, frame[framePos++]);
+  }
+}
+
+// ======================================================
+// IRQ: DIN — FIFO UART выключен (см. setup_midi_input), так что
+// прерывание TX приходит на каждый освободившийся байт
+// ======================================================
+static void drain_din() {
+  uart_hw_t *hw = uart_get_hw(uart1);
+
+  while (!(hw->fr & UART_UARTFR_TXFF_BITS)) {
+    uint8_t rt;
+    if (rt_take(din_port, 1, rt)) {
+      hw->dr = rt;
+      continue;
+    }
+    if (din_port.pos >= din_port.len) {
+      if (!midi_queue_pop(din_port.q, din_port.cur)) {
+        din_port.len = 0;
+        din_port.pos = 0;
+        hw_clear_bits(&hw->imsc, UART_UARTIMSC_TXIM_BITS);
+        return;
+      }
+      encode_msg(din_port);
+      note_latency(1, din_port.cur.ts);
+    }
+    hw->dr = midi_word_byte(din_port.cur.w, din_port.pos++);
+  }
+  hw_set_bits(&hw->imsc, UART_UARTIMSC_TXIM_BITS);
+}
+
+static void din_tx_irq() {
+  if (uart_get_hw(uart1)->mis & UART_UARTMIS_TXMIS_BITS)
+    drain_din();
+}
+
+static void pio_tx_irq() {
+  drain_ports();
+}
+
+void midi_out_frame(const uint8_t *bytes, uint16_t active, uint32_t *cols) {
+  bitslice_frame(slicer, bytes, active, cols);
+}
+
+// ======================================================
+// Инициализация USB (core0)
+// ======================================================
+void setup_midi_usb() {
+  // по кабелю на физический порт — DAW видит 12 входов и 12 выходов
+  static const char *cableNames[USB_CABLES] = {
+    "Router", "DIN", "TRS A", "TRS B", "TRS C", "TRS D",
+    "TRS E", "TRS F", "TRS G", "TRS H", "TRS I", "TRS J"
+  };
+  usb_midi.setCables(USB_CABLES);
+  for (uint8_t i = 0; i < USB_CABLES; i++)
+    usb_midi.setCableName(i + 1, cableNames[i]);   // нумерация имён с 1
   usb_midi.begin();
-  Serial.println("[MIDI] USB interface ready");
 
-  // 2️⃣ UART1 (DIN)
+  // ядро уже подняло USB до setup() — переподключаемся с новым дескриптором
+  if (TinyUSBDevice.mounted()) {
+    TinyUSBDevice.detach();
+    delay(10);
+    TinyUSBDevice.attach();
+  }
+  Serial.println("[MIDI] USB interface ready (12 cables)");
+}
+
+// ======================================================
+// Инициализация UART и PIO (core1 — IRQ PIO обслуживает он)
+// ======================================================
+void setup_midi_output() {
+  // 1️⃣ UART1 (DIN)
   uart_init(uart1, MIDI_BAUD);
   gpio_set_function(DIN_TX_PIN, GPIO_FUNC_UART);
+  irq_add_shared_handler(UART1_IRQ, din_tx_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(UART1_IRQ, true);
   Serial.println("[MIDI] DIN TX on GP4");
 
-  // 3️⃣ PIO TX (10 TRS портов)
-  uint offset0 = pio_add_program(pio_a, &midi_uart_tx_program);
-  uint offset1 = pio_add_program(pio_b, &midi_uart_tx_program);
+  // 2️⃣ PIO TX: 10 TRS портов с одной state machine, pio1 — свободен
+  uint8_t pinOffsets[10];
+  uint32_t pinMask = 0;
+  for (uint8_t i = 0; i < 10; i++) {
+    pinOffsets[i] = midi_tx_pins[i] - TRS_PIN_BASE;
+    pinMask |= 1u << pinOffsets[i];
+  }
+  bitslice_init(slicer, pinOffsets, 10);
 
-  for (int i = 0; i < 10; i++) {
-    PIO pio = (i < 5) ? pio_a : pio_b;
-    uint sm = pio_claim_unused_sm(pio, true);
-    sm_ports[i] = sm;
+  uint offset = pio_add_program(pio_tx, &midi_multi_tx_program);
+  sm_tx = pio_claim_unused_sm(pio_tx, true);
+  midi_multi_tx_program_init(pio_tx, sm_tx, offset, TRS_PIN_BASE, pinMask, MIDI_BAUD);
 
-    midi_uart_tx_program_init(
-      pio,
-      sm,
-      (i < 5 ? offset0 : offset1),
-      midi_tx_pins[i],
-      MIDI_BAUD
-    );
-  }
+  irq_set_exclusive_handler(PIO0_IRQ_0, pio_tx_irq);
+  irq_set_enabled(PIO0_IRQ_0, true);
 
-  Serial.println("[MIDI] 10x TRS PIO ports initialized");
+  Serial.println("[MIDI] 10x TRS on one PIO state machine (bit-sliced)");
   Serial.println("[MIDI] Output system ready\n");
 }
 
@@ -62,29 +328,349 @@ void setup_midi_output() {
 // ======================================================
 
 // --- USB MIDI ---
-void send_midi_usb(uint8_t status, uint8_t data1, uint8_t data2) {
-  uint8_t msg[3] = {status, data1, data2};
-  usb_midi.write(msg, 3);
-  usb_midi.flush();
+// Отдать накопленные пакеты TinyUSB; что не влезло в FIFO — в следующий раз
+static void usb_batch_send() {
+  if (!tud_mounted()) {          // хоста нет — копить незачем
+    usb_out.count = 0;
+    return;
+  }
+
+  uint8_t sent = 0;
+  while (sent < usb_out.count && usb_midi.writePacket((const uint8_t *)&usb_out.pkt[sent])) {
+    note_latency(0, usb_out.ts[sent]);
+    if (midi_word_status(usb_out.pkt[sent]) == 0xF8) midi_clock_on_wire(0, usb_out.ts[sent]);
+    sent++;
+  }
+  if (!sent) return;
+
+  usbStats.packets += sent;
+  usbStats.flushes++;
+  if (sent > usbStats.maxBatch) usbStats.maxBatch = sent;
+
+  usb_out.count -= sent;
+  memmove(usb_out.pkt, &usb_out.pkt[sent], usb_out.count * sizeof(MidiWord));
+  memmove(usb_out.ts, &usb_out.ts[sent], usb_out.count * sizeof(uint32_t));
+}
+
+static void usb_batch_put(MidiWord w, uint32_t ts) {
+  if (usb_out.count == USB_BATCH_PACKETS) {
+    usbStats.fullFlushes++;
+    usb_batch_send();
+    if (usb_out.count == USB_BATCH_PACKETS) {   // FIFO TinyUSB тоже полон
+      usbStats.drops++;
+      return;
+    }
+  }
+  usb_out.pkt[usb_out.count] = w;
+  usb_out.ts[usb_out.count++] = ts;
+}
+
+void send_midi_usb(MidiWord w, uint32_t ts) {
+  usb_batch_put(w, ts);
+}
+
+void midi_out_flush() {
+  if (!usb_out.count) return;
+  if (usb_out.mode == USB_FLUSH_FRAME) {
+    // не чаще раза за кадр (1 мс), но полный буфер уходит сразу (usb_batch_put)
+    uint16_t frame = (uint16_t)(usb_hw->sof_rd & USB_SOF_RD_BITS);
+    if (frame == usb_out.lastFrame) return;
+    usb_out.lastFrame = frame;
+  }
+  usb_batch_send();
+}
+
+bool midi_out_set_usb_flush(uint8_t mode) {
+  if (mode > USB_FLUSH_FRAME) return false;
+  return cmdQueue.push({OP_USB_FLUSH, 0, mode});
+}
+
+void midi_out_get_usb_stats(UsbOutStats &st) {
+  st = usbStats;
+  st.pending = usb_out.count;
+  st.mode = usb_out.mode;
+}
+
+bool midi_out_reset_usb_stats() {
+  return cmdQueue.push({OP_RESET, 0, RESET_USB});
 }
 
 // --- DIN UART ---
-void send_midi_uart(uint8_t status, uint8_t data1, uint8_t data2) {
-  uart_putc_raw(uart1, status);
-  uart_putc_raw(uart1, data1);
-  uart_putc_raw(uart1, data2);
+// если передатчик простаивает — запускаем его сами
+static void din_kick() {
+  uint32_t irq = save_and_disable_interrupts();
+  drain_din();
+  restore_interrupts(irq);
+}
+
+void send_midi_uart(MidiWord w, uint32_t ts) {
+  MidiMsg m = {w, ts};
+  if (!midi_queue_push(din_port.q, m)) return;
+  din_kick();
+}
+
+// --- Разбудить IRQ TRS; глубина FIFO (столбцов) в этот момент — для STATS ---
+static inline void pio_kick(uint8_t port) {
+  stats_fifo(port, (uint8_t)pio_sm_get_tx_fifo_level(pio_tx, sm_tx));
+  if (!trsHold) pio_set_irq0_source_enabled(pio_tx, tx_irq_source(sm_tx), true);
+}
+
+// --- Разбудить опустошение очереди выхода (DIN или TRS) ---
+static void sink_kick(uint8_t sink) {
+  if (sink == 1)
+    din_kick();
+  else
+    pio_kick(sink - 2);
 }
 
 // --- TRS PIO port ---
-void send_midi_pio(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2) {
+void send_midi_pio(uint8_t port, MidiWord w, uint32_t ts) {
   if (port >= 10) return;
-  PIO pio = (port < 5) ? pio_a : pio_b;
-  uint sm = sm_ports[port];
+  MidiMsg m = {w, ts};
+
+  // Ставим в очередь и будим IRQ — без ожидания FIFO
+  if (midi_queue_push(tx_ports[port].q, m))
+    pio_kick(port);
+}
+
+// --- Realtime-полоса DIN/TRS; USB — обычный пакет в пачке ---
+bool send_midi_rt(uint8_t sink, MidiWord w, uint32_t ts) {
+  if (sink == 0) {
+    usb_batch_put(w, ts);
+    return true;
+  }
+  if (sink >= DEST_COUNT) return true;
+
+  TxPort &tp = (sink == 1) ? din_port : tx_ports[sink - 2];
+  uint32_t irq = save_and_disable_interrupts();   // продюсеры: поток core1 и будильник часов
+  uint8_t head = tp.rtHead;
+  bool ok = (uint8_t)(head - tp.rtTail) < RT_LANE_SIZE;
+  if (ok) {
+    tp.rt[head & (RT_LANE_SIZE - 1)] = midi_word_status(w);
+    tp.rtTs[head & (RT_LANE_SIZE - 1)] = ts;
+    tp.rtHead = head + 1;
+  } else {
+    tp.rtDrops++;
+  }
+  restore_interrupts(irq);
+  if (ok) sink_kick(sink);
+  return ok;
+}
 
-  // Отправляем байты в PIO FIFO
-  pio_sm_put_blocking(pio, sm, status);
-  pio_sm_put_blocking(pio, sm, data1);
-  pio_sm_put_blocking(pio, sm, data2);
+// --- Выход по индексу бита DEST_* ---
+void send_midi(uint8_t sink, MidiWord w, uint32_t ts) {
+  if (sink >= DEST_COUNT) return;
+  stats_out(sink);
+  capture_sink(sink);
+  notes_track(sink, w);
+  if (midi_word_cin(w) == 0x0F && sink != 0)   // realtime — мимо очереди
+    send_midi_rt(sink, w, ts);
+  else if (sink == 0)
+    send_midi_usb(w, ts);
+  else if (sink == 1)
+    send_midi_uart(w, ts);
+  else
+    send_midi_pio(sink - 2, w, ts);
+}
+
+// --- Веер на TRS: IRQ выключен, пока байт не ляжет во все очереди ---
+// Иначе первый порт уйдёт кадром один, а остальные будут ждать
+// следующего (ещё 320 мкс). Вложенность — счётчиком: IRQ core1 (часы)
+// может держать веер поверх потока, счётчик он вернёт как был.
+void midi_out_hold() {
+  if (trsHold++ == 0) pio_set_irq0_source_enabled(pio_tx, tx_irq_source(sm_tx), false);
+}
+
+void midi_out_release() {
+  if (--trsHold == 0) pio_set_irq0_source_enabled(pio_tx, tx_irq_source(sm_tx), true);
+}
+
+// --- Веер по маске: младший установленный бит → выход, бит гасим ---
+void send_midi_now(uint16_t dest, MidiWord w, uint32_t ts) {
+  bool trs = dest & (DEST_ALL & ~(DEST_USB | DEST_DIN));
+  if (trs) midi_out_hold();
+  for (; dest; dest &= dest - 1)
+    send_midi(__builtin_ctz(dest), w, ts);
+  if (trs) midi_out_release();
+}
+
+void send_midi_mask(uint16_t dest, MidiWord w, uint32_t ts) {
+  dest &= DEST_ALL;
+  if (__builtin_expect(dest & schedMask, 0)) dest = sched_output(dest, w);   // компенсация, эхо
+  send_midi_now(dest, w, ts);
+}
+
+// --- Цепочка слов (SysEx) на выход по индексу ---
+void send_midi_words(uint8_t sink, const MidiWord *words, uint8_t count, uint32_t ts) {
+  if (sink >= DEST_COUNT || !count) return;
+  if (midi_word_status(words[0]) == 0xF0) stats_out(sink);   // SysEx — одно сообщение на все куски
+  capture_sink(sink);
+  if (sink == 0) {
+    for (uint8_t i = 0; i < count; i++) usb_batch_put(words[i], ts);
+    return;
+  }
+
+  TxPort &tp = (sink == 1) ? din_port : tx_ports[sink - 2];
+  bool start = midi_word_status(words[0]) == 0xF0;
+  bool end = midi_word_cin(words[count - 1]) != MIDI_CIN_SYSEX;   // 0x5–0x7: с F7
+  if (!start && tp.sysex != SYSEX_OPEN) {   // хвост выброшенной цепочки
+    tp.q.drops += count;
+    if (end) tp.sysex = SYSEX_IDLE;
+    return;
+  }
+
+  // Кусок — только целиком, и ещё слот под F7, если следующий не влезет
+  if (midi_queue_room(tp.q) < count + (end ? 0 : 1)) {
+    tp.q.drops += count;
+    bool open = tp.sysex == SYSEX_OPEN;
+    tp.sysex = end ? SYSEX_IDLE : SYSEX_SKIP;
+    if (!open || !midi_queue_room(tp.q)) return;
+    midi_queue_push(tp.q, MidiMsg{midi_word(midi_word_cable(words[0]), MIDI_CIN_SYSEX_END1, 0xF7, 0, 0), ts});
+    sink_kick(sink);
+    return;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+    midi_queue_push(tp.q, MidiMsg{words[i], ts});
+  tp.sysex = end ? SYSEX_IDLE : SYSEX_OPEN;
+  sink_kick(sink);
+}
+
+// ======================================================
+// USB-MIDI от хоста
+// ======================================================
+bool midi_usb_read_packet(MidiWord &w) {
+  return usb_midi.readPacket((uint8_t *)&w);
+}
+
+bool send_midi_packet(MidiWord w, uint32_t ts) {
+  uint8_t sink = midi_word_cable(w);   // кабель = индекс выхода
+  if (sink == 0 || sink >= DEST_COUNT || midi_word_len(w) == 0) return true;   // не наш — пропускаем
+
+  if (midi_word_cin(w) == 0x0F) {             // realtime — в полосу порта
+    if (!send_midi_rt(sink, w, ts)) return false;
+    stats_out(sink);
+    capture_sink(sink);
+    return true;
+  }
+
+  TxPort &tp = (sink == 1) ? din_port : tx_ports[sink - 2];
+  if (midi_queue_depth(tp.q) >= MIDI_QUEUE_SIZE) return false;   // подождём IRQ
+
+  MidiMsg m = {w, ts};
+  if (midi_queue_push(tp.q, m)) sink_kick(sink);
+  stats_out(sink);
+  capture_sink(sink);
+  notes_track(sink, w);
+  return true;
+}
+
+// ======================================================
+// Очереди TRS: политика переполнения и статистика
+// ======================================================
+bool midi_out_set_policy(uint8_t port, uint8_t policy) {
+  if (port >= 10 || policy > OVERFLOW_COALESCE_CC) return false;
+  return cmdQueue.push({OP_POLICY, port, policy});
+}
+
+void midi_out_get_queue_stats(uint8_t port, MidiQueueStats &st) {
+  if (port >= 10) return;
+  const MidiQueue &q = tx_ports[port].q;
+  st.depth = midi_queue_depth(q);
+  st.highWater = q.highWater;
+  st.drops = q.drops;
+  st.coalesced = q.coalesced;
+  st.policy = q.policy;
+  st.wireBytes = tx_ports[port].wireBytes;
+  st.savedBytes = tx_ports[port].savedBytes;
+  st.encoding = tx_ports[port].encoding;
+}
+
+static TxPort *sink_port(uint8_t sink) {
+  if (sink == 1) return &din_port;
+  if (sink >= 2 && sink < DEST_COUNT) return &tx_ports[sink - 2];
+  return nullptr;   // USB — пакеты по 4 байта, running status нет
+}
+
+bool midi_out_set_encoding(uint8_t sink, uint8_t encoding) {
+  if (!sink_port(sink) || encoding > ENCODE_RUNNING_NOTEON) return false;
+  return cmdQueue.push({OP_ENCODING, sink, encoding});
+}
+
+uint8_t midi_out_get_encoding(uint8_t sink) {
+  TxPort *tp = sink_port(sink);
+  return tp ? tp->encoding : (uint8_t)ENCODE_FULL;
+}
+
+uint32_t midi_out_get_drops(uint8_t sink) {
+  if (sink == 0) return usbStats.drops;
+  TxPort *tp = sink_port(sink);
+  return tp ? tp->q.drops + tp->rtDrops : 0;
+}
+
+uint32_t midi_out_get_wire_bytes(uint8_t sink) {
+  if (sink == 0) return usbStats.packets * 4;
+  TxPort *tp = sink_port(sink);
+  return tp ? tp->wireBytes : 0;
+}
+
+uint16_t midi_out_backlog() {
+  uint16_t depth = midi_queue_depth(din_port.q);
+  for (auto &tp : tx_ports) {
+    uint16_t d = midi_queue_depth(tp.q);
+    if (d > depth) depth = d;
+  }
+  return depth;
+}
+
+uint8_t midi_out_rt_backlog() {
+  uint8_t depth = (uint8_t)(din_port.rtHead - din_port.rtTail);
+  for (auto &tp : tx_ports) {
+    uint8_t d = (uint8_t)(tp.rtHead - tp.rtTail);
+    if (d > depth) depth = d;
+  }
+  return depth;
+}
+
+uint16_t midi_out_room(uint8_t sink) {
+  if (sink == 0) return USB_BATCH_PACKETS - usb_out.count;
+  TxPort *tp = sink_port(sink);
+  return tp ? MIDI_QUEUE_SIZE - midi_queue_depth(tp->q) : 0;
+}
+
+void midi_out_get_latency(uint8_t sink, LatencyStats &st) {
+  if (sink < DEST_COUNT) st = latency[sink];
+}
+
+bool midi_out_reset_latency() {
+  return cmdQueue.push({OP_RESET, 0, RESET_LATENCY});
+}
+
+bool midi_out_reset_queue_stats() {
+  return cmdQueue.push({OP_RESET, 0, RESET_QUEUE});
+}
+
+// Счётчики пишут и поток core1, и IRQ выходов — сброс между ними,
+// с запретом прерываний (OP_RESET из midi_out_task)
+static void reset_port(TxPort &tp) {
+  tp.q.highWater = midi_queue_depth(tp.q);
+  tp.q.drops = 0;
+  tp.q.coalesced = 0;
+  tp.rtDrops = 0;
+  tp.wireBytes = 0;
+  tp.savedBytes = 0;
+}
+
+static void reset_stats(uint8_t what) {
+  uint32_t irq = save_and_disable_interrupts();
+  if (what & RESET_QUEUE) {
+    for (auto &tp : tx_ports) reset_port(tp);
+    reset_port(din_port);
+  }
+  if (what & RESET_LATENCY)
+    for (auto &l : latency) l = LatencyStats{};
+  if (what & RESET_USB) usbStats = UsbOutStats{};
+  restore_interrupts(irq);
 }
 
 // ======================================================
@@ -93,47 +679,51 @@ void send_midi_pio(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2) {
 
 // --- Отправить NoteOn на все порты ---
 void noteOn_all(uint8_t note, uint8_t vel) {
-  uint8_t st = 0x90;
-  send_midi_usb(st, note, vel);
-  send_midi_uart(st, note, vel);
-  for (int i = 0; i < 10; i++) send_midi_pio(i, st, note, vel);
+  send_midi_mask(DEST_ALL, midi_word_msg(USB_CABLE_ROUTER, 0x90, note, vel));
 }
 
 // --- Отправить NoteOff на все порты ---
 void noteOff_all(uint8_t note) {
-  uint8_t st = 0x80;
-  send_midi_usb(st, note, 0);
-  send_midi_uart(st, note, 0);
-  for (int i = 0; i < 10; i++) send_midi_pio(i, st, note, 0);
+  send_midi_mask(DEST_ALL, midi_word_msg(USB_CABLE_ROUTER, 0x80, note, 0));
 }
 
 // --- Отправить Control Change ---
-void cc_all(uint8_t cc, uint8_t val, uint8_t ch = 1) {
+void cc_all(uint8_t cc, uint8_t val, uint8_t ch) {
   uint8_t st = 0xB0 | ((ch - 1) & 0x0F);
-  send_midi_usb(st, cc, val);
-  send_midi_uart(st, cc, val);
-  for (int i = 0; i < 10; i++) send_midi_pio(i, st, cc, val);
+  send_midi_mask(DEST_ALL, midi_word_msg(USB_CABLE_ROUTER, st, cc, val));
 }
 
 // --- Program Change ---
-void programChange_all(uint8_t prog, uint8_t ch = 1) {
+void programChange_all(uint8_t prog, uint8_t ch) {
   uint8_t st = 0xC0 | ((ch - 1) & 0x0F);
-  send_midi_usb(st, prog, 0);
-  send_midi_uart(st, prog, 0);
-  for (int i = 0; i < 10; i++) send_midi_pio(i, st, prog, 0);
+  send_midi_mask(DEST_ALL, midi_word_msg(USB_CABLE_ROUTER, st, prog, 0));
 }
 
 // ======================================================
 // Тестовая функция
 // ======================================================
+bool midi_out_request_test() {
+  return cmdQueue.push({OP_TEST, 0, 0});
+}
+
+// Serial — на core0 (midi_out_test_task): USB CDC core1 не трогает
 void test_midi_outputs() {
-  Serial.println("[MIDI] Test: Sending C Major chord...");
   noteOn_all(60, 100);
   noteOn_all(64, 100);
   noteOn_all(67, 100);
-  delay(500);
-  noteOff_all(60);
-  noteOff_all(64);
-  noteOff_all(67);
-  Serial.println("[MIDI] Test complete.\n");
+  midi_out_flush();
+  // NoteOff — через 500 мс с колеса, core1 не стоит
+  static const uint8_t chord[] = {60, 64, 67};
+  uint8_t offs = 0;
+  for (uint8_t note : chord)
+    offs += sched_after(500000, DEST_ALL, midi_word_msg(USB_CABLE_ROUTER, 0x80, note, 0));
+  testQueue.push(offs);
+}
+
+void midi_out_test_task() {
+  uint8_t offs;
+  while (testQueue.pop(offs)) {
+    if (offs == 3) Serial.println("[MIDI] Test: C Major chord sent, NoteOff in 500 ms");
+    else Serial.printf("[MIDI] Test: C Major chord sent, %u of 3 NoteOff scheduled\n", offs);
+  }
 }
\ No newline at end of file
@@ -1,34 +1,299 @@
 #pragma once
 #include <stdint.h>
+#include "stats.h"
+#include "midi_word.h"
 
 // ======================================================
 // ИНИЦИАЛИЗАЦИЯ И ОСНОВНЫЕ ФУНКЦИИ
 // ======================================================
 
+// Виртуальные кабели USB-MIDI: номер совпадает с индексом бита DEST_*
+#define USB_CABLE_ROUTER   0          // клавиатура и маршрутизатор
+#define USB_CABLE_DIN      1          // DIN OUT / DIN IN
+#define USB_CABLE_PORT(n)  (2 + (n))  // TRS A–J
+#define USB_CABLES         12
+
+/**
+ * @brief Инициализация USB MIDI (TinyUSB, 12 кабелей) — вызывать на core0
+ */
+void setup_midi_usb();
+
 /**
- * @brief Инициализация всех MIDI интерфейсов:
- *  - USB (TinyUSB)
+ * @brief Инициализация выходов MIDI ядра (core1):
  *  - DIN MIDI (UART1 TX)
- *  - 10 TRS MIDI OUT через PIO
+ *  - 10 TRS MIDI OUT с одной state machine PIO (bitslice.h)
  */
 void setup_midi_output();
 
 /**
- * @brief Отправить произвольное MIDI сообщение через USB
+ * @brief Команды core0 для выходов (политика, кодирование…) — core1
+ *
+ * Вызывать в каждом проходе loop1().
+ */
+void midi_out_task();
+
+/**
+ * @brief Отправить MIDI сообщение через USB
+ *
+ * Слово и есть пакет USB-MIDI: уходит как есть, кабель (для хоста —
+ * источник) берётся из слова. Пакет копится в буфере до midi_out_flush().
  */
-void send_midi_usb(uint8_t status, uint8_t data1, uint8_t data2);
+void send_midi_usb(MidiWord w, uint32_t ts = 0);
 
 /**
  * @brief Отправить MIDI сообщение через DIN (UART1 TX)
+ *
+ * Не блокирует: очередь опустошается прерыванием TX UART1.
  */
-void send_midi_uart(uint8_t status, uint8_t data1, uint8_t data2);
+void send_midi_uart(MidiWord w, uint32_t ts = 0);
 
 /**
  * @brief Отправить MIDI сообщение на один из 10 TRS портов (через PIO)
+ *
+ * Не блокирует: сообщение ставится в очередь порта и уходит
+ * в FIFO state machine из прерывания.
  * 
  * @param port индекс TRS-порта (0–9)
+ * @param ts время прихода исходного события (мкс, 0 — не измерять задержку)
  */
-void send_midi_pio(uint8_t port, uint8_t status, uint8_t data1, uint8_t data2);
+void send_midi_pio(uint8_t port, MidiWord w, uint32_t ts = 0);
+
+/**
+ * @brief Realtime (F8–FF) на один выход в обход очереди
+ *
+ * DIN/TRS: байт встаёт в realtime-полосу порта и уходит в линию
+ * раньше следующего байта из очереди (между сообщениями или внутри
+ * них). USB: обычный пакет в пачке — только из потока core1.
+ * Можно звать из IRQ core1 (будильник часов) — для DIN/TRS.
+ * @return false, если полоса полна (байт потерян, счётчик drops)
+ */
+bool send_midi_rt(uint8_t sink, MidiWord w, uint32_t ts = 0);
+
+/**
+ * @brief Отправить MIDI сообщение на один выход по индексу
+ *
+ * Realtime (CIN 0xF) сам уходит в realtime-полосу (send_midi_rt).
+ * Ноты отмечаются в note_state.h.
+ * @param sink 0 — USB, 1 — DIN, 2–11 — TRS A–J (как биты DEST_*)
+ */
+void send_midi(uint8_t sink, MidiWord w, uint32_t ts = 0);
+
+/**
+ * @brief Разослать MIDI сообщение по маске назначений DEST_*
+ *
+ * Каждый выход из маски получает сообщение ровно один раз
+ * (обход установленных бит, без строк и поиска). Выходы с компенсацией
+ * задержки или эхом (scheduler.h) получают его с колеса таймеров.
+ */
+void send_midi_mask(uint16_t dest, MidiWord w, uint32_t ts = 0);
+
+/**
+ * @brief То же сразу, мимо планировщика (его отправка с колеса)
+ *
+ * Порты TRS получают байт в одном кадре state machine.
+ */
+void send_midi_now(uint16_t dest, MidiWord w, uint32_t ts = 0);
+
+/**
+ * @brief Веер на несколько TRS своим циклом: между hold и release
+ *        байты портов копятся и уйдут одним кадром (можно из IRQ core1)
+ */
+void midi_out_hold();
+void midi_out_release();
+
+/**
+ * @brief Собрать кадр TRS из байтов портов, как его собирает IRQ (BENCH)
+ *
+ * @param active маска портов TRS A–J (бит 0 — A), у которых есть байт
+ * @param cols BITSLICE_COLS столбцов (bitslice.h)
+ */
+void midi_out_frame(const uint8_t *bytes, uint16_t active, uint32_t *cols);
+
+/**
+ * @brief Отправить цепочку слов (кусок SysEx) на один выход
+ *
+ * В очередь DIN/TRS кусок встаёт целиком или не встаёт вовсе; не влез —
+ * остаток цепочки выбрасывается, а начатая на линии закрывается F7.
+ *
+ * @param sink 0 — USB, 1 — DIN, 2–11 — TRS A–J (как биты DEST_*)
+ */
+void send_midi_words(uint8_t sink, const MidiWord *words, uint8_t count, uint32_t ts = 0);
+
+// ======================================================
+// USB → ФИЗИЧЕСКИЕ ПОРТЫ
+// ======================================================
+
+/**
+ * @brief Прочитать пакет USB-MIDI от хоста (core1)
+ * @return false, если пакетов нет
+ */
+bool midi_usb_read_packet(MidiWord &w);
+
+/**
+ * @brief Пакет с кабеля 1–11 — прямо в очередь DIN/TRS этого кабеля
+ *
+ * Слово кладётся в очередь как есть (длина по CIN), без
+ * повторной сборки сообщения; SysEx идёт теми же пакетами.
+ * @return false, если очередь порта полна — пакет не принят, его
+ *         нужно предложить снова (хост ждёт, пока порт не освободится)
+ */
+bool send_midi_packet(MidiWord w, uint32_t ts);
+
+// ======================================================
+// USB: ПАКЕТНАЯ ОТПРАВКА
+// ======================================================
+
+/**
+ * @brief Отправить накопленные пакеты USB-MIDI (core1)
+ *
+ * Вызывать в конце каждого прохода диспетчера: всё, что породил
+ * проход (аккорд, веер по портам), уходит одной пачкой, а не
+ * отдельным USB-трансфером на каждое сообщение.
+ */
+void midi_out_flush();
+
+enum UsbFlushMode : uint8_t {
+  USB_FLUSH_PASS = 0,   // в конце каждого прохода — минимальная задержка
+  USB_FLUSH_FRAME       // не чаще раза за кадр USB (1 мс) — меньше трансферов
+};
+/**
+ * @brief Когда отдавать пачку USB (core0; применяет core1 в midi_out_task())
+ * @return false, если режим неверен или очередь команд полна
+ */
+bool midi_out_set_usb_flush(uint8_t mode);
+
+struct UsbOutStats {
+  uint32_t packets;      // отправлено пакетов (событий)
+  uint32_t flushes;      // пачек, отданных TinyUSB
+  uint32_t maxBatch;     // наибольшая пачка
+  uint32_t fullFlushes;  // отправок из-за полного буфера
+  uint32_t drops;        // потеряно: буфер и FIFO TinyUSB полны
+  uint8_t pending;       // в буфере сейчас
+  uint8_t mode;          // UsbFlushMode
+};
+void midi_out_get_usb_stats(UsbOutStats &st);
+
+/**
+ * @brief Сбросить счётчики USB (применяет core1 в midi_out_task)
+ * @return false — очередь команд полна
+ */
+bool midi_out_reset_usb_stats();
+
+// ======================================================
+// КОДЕР ПОСЛЕДОВАТЕЛЬНЫХ ВЫХОДОВ (DIN, TRS)
+// ======================================================
+
+/**
+ * @brief Как сообщения кладутся в линию 31250 бод
+ *
+ * Кодер работает при выдаче из очереди (в IRQ), поэтому знает,
+ * какой статус последним ушёл в линию именно этого порта.
+ */
+enum OutEncoding : uint8_t {
+  ENCODE_FULL = 0,          // статус-байт в каждом сообщении
+  ENCODE_RUNNING,           // running status (по умолчанию)
+  ENCODE_RUNNING_NOTEON     // + NoteOff → NoteOn vel 0 (больше совпадений статуса)
+};
+
+/**
+ * @brief Задать кодирование выхода (core0)
+ *
+ * Применяет core1 в midi_out_task(); running status порта при этом
+ * сбрасывается — следующее сообщение уйдёт со статус-байтом.
+ * @param sink 1 — DIN, 2–11 — TRS A–J (как биты DEST_*)
+ * @return false, если аргументы неверны или очередь команд полна
+ */
+bool midi_out_set_encoding(uint8_t sink, uint8_t encoding);
+uint8_t midi_out_get_encoding(uint8_t sink);
+
+// ======================================================
+// ОЧЕРЕДИ TRS ПОРТОВ
+// ======================================================
+
+/**
+ * @brief Состояние очереди одного TRS-порта
+ */
+struct MidiQueueStats {
+  uint16_t depth;       // сообщений в очереди сейчас
+  uint16_t highWater;   // максимальная глубина с момента сброса
+  uint32_t drops;       // отброшено при переполнении
+  uint32_t coalesced;   // слито CC (политика coalesce)
+  uint8_t policy;       // OverflowPolicy (midi_queue.h)
+  uint8_t encoding;     // OutEncoding
+  uint32_t wireBytes;   // байт ушло в линию
+  uint32_t savedBytes;  // статус-байтов опущено (running status)
+};
+
+/**
+ * @brief Задать политику переполнения очереди порта (core0)
+ *
+ * Применяет core1 в midi_out_task().
+ * @param port индекс TRS-порта (0–9)
+ * @param policy OVERFLOW_DROP_OLDEST / OVERFLOW_DROP_NEWEST / OVERFLOW_COALESCE_CC
+ * @return false, если аргументы неверны или очередь команд полна
+ */
+bool midi_out_set_policy(uint8_t port, uint8_t policy);
+
+/**
+ * @brief Получить статистику очереди порта
+ */
+void midi_out_get_queue_stats(uint8_t port, MidiQueueStats &st);
+
+/**
+ * @brief Потеряно сообщений на выходе: переполнение очереди DIN/TRS
+ *        или буфера USB
+ *
+ * @param sink 0 — USB, 1 — DIN, 2–11 — TRS A–J (как биты DEST_*)
+ */
+uint32_t midi_out_get_drops(uint8_t sink);
+
+/**
+ * @brief Байт ушло в линию: DIN/TRS — после кодировщика, USB — 4 на пакет
+ */
+uint32_t midi_out_get_wire_bytes(uint8_t sink);
+
+/**
+ * @brief Наибольшая глубина очереди среди DIN и TRS A–J
+ */
+uint16_t midi_out_backlog();
+uint8_t midi_out_rt_backlog();   // то же для realtime-полос
+
+/**
+ * @brief Свободно сообщений: очередь DIN/TRS, для USB — пачка до отправки
+ */
+uint16_t midi_out_room(uint8_t sink);
+
+/**
+ * @brief Сбросить счётчики потерь и high-water mark (применяет core1)
+ * @return false — очередь команд полна
+ */
+bool midi_out_reset_queue_stats();
+
+// ======================================================
+// ЗАДЕРЖКА ВХОД → ВЫХОД
+// ======================================================
+
+/**
+ * @brief Задержка от прихода события до ухода первого байта в выход, мкс
+ *
+ * count/max/sum и гистограмма по степеням двойки — см. stats.h
+ */
+struct LatencyStats : StatsHist {
+  uint32_t last;
+};
+
+/**
+ * @brief Получить статистику задержки выхода
+ *
+ * @param sink 0 — USB, 1 — DIN, 2–11 — TRS A–J (как биты DEST_*)
+ */
+void midi_out_get_latency(uint8_t sink, LatencyStats &st);
+
+/**
+ * @brief Сбросить статистику задержки (применяет core1)
+ * @return false — очередь команд полна
+ */
+bool midi_out_reset_latency();
 
 // ======================================================
 // ДОПОЛНИТЕЛЬНЫЕ УТИЛИТЫ
@@ -59,6 +324,19 @@ void cc_all(uint8_t cc, uint8_t val, uint8_t ch = 1);
 void programChange_all(uint8_t prog, uint8_t ch = 1);
 
 /**
- * @brief Тестовая функция — посылает аккорд C мажор на все выходы
+ * @brief Тестовая функция — посылает аккорд C мажор на все выходы (core1)
+ *
+ * Сама не печатает: итог забирает midi_out_test_task() на core0.
+ */
+void test_midi_outputs();
+
+/**
+ * @brief Итог тестового аккорда в Serial (core0, из loop())
+ */
+void midi_out_test_task();
+
+/**
+ * @brief То же по запросу с core0: аккорд сыграет core1 в midi_out_task()
+ * @return false, если очередь команд полна
  */
-void test_midi_outputs();
\ No newline at end of file
+bool midi_out_request_test();
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "midi_parser.h"
+
+// ======================================================
+// Таблицы длин
+// ======================================================
+// Channel Voice 0x80–0xE0 по старшему полубайту: байт данных
+static const uint8_t voiceData[8] = {
+  2, // 0x80 Note Off
+  2, // 0x90 Note On
+  2, // 0xA0 Poly Aftertouch
+  2, // 0xB0 Control Change
+  1, // 0xC0 Program Change
+  1, // 0xD0 Channel Pressure
+  2, // 0xE0 Pitch Bend
+  0  // 0xF0 — см. systemData
+};
+
+// System 0xF0–0xFF: байт данных (0xFF — не сообщение с данными)
+static const uint8_t systemData[16] = {
+  0xFF, // F0 SysEx start — отдельная ветка
+  1,    // F1 MTC Quarter Frame
+  2,    // F2 Song Position
+  1,    // F3 Song Select
+  0xFF, // F4 undefined
+  0xFF, // F5 undefined
+  0,    // F6 Tune Request
+  0xFF, // F7 SysEx end — отдельная ветка
+  0,    // F8 Clock
+  0,    // F9 undefined (realtime)
+  0,    // FA Start
+  0,    // FB Continue
+  0,    // FC Stop
+  0,    // FD undefined (realtime)
+  0,    // FE Active Sensing
+  0     // FF Reset
+};
+
+uint8_t midi_msg_len(uint8_t status) {
+  if (status < 0x80) return 0;
+  if (status < 0xF0) return 1 + voiceData[(status >> 4) & 0x07];
+  uint8_t n = systemData[status & 0x0F];
+  return (n == 0xFF) ? 0 : 1 + n;
+}
+
+// ======================================================
+// SysEx
+// ======================================================
+static void sysex_flush(MidiParser &p, uint8_t extraFlags, uint32_t ts) {
+  uint8_t flags = p.sysexFlags | extraFlags;
+  if ((p.sysexWords || flags) && p.onSysex)
+    p.onSysex(p.sysex, p.sysexWords, flags, ts, p.ctx);
+  p.sysexWords = 0;
+  p.sysexFill = 0;
+  p.sysexFlags = 0;
+}
+
+// Байт SysEx в цепочку слов: по 3 байта (CIN 0x4), F7 закрывает слово (0x5–0x7)
+static inline void sysex_put(MidiParser &p, uint8_t b, uint32_t ts) {
+  if (p.sysexFill == 0) {
+    if (p.sysexWords >= MIDI_SYSEX_WORDS) sysex_flush(p, 0, ts);
+    p.sysex[p.sysexWords++] = midi_word(p.cable, MIDI_CIN_SYSEX, 0, 0, 0);
+  }
+  MidiWord &w = p.sysex[p.sysexWords - 1];
+  w |= (MidiWord)b << (8 * (p.sysexFill + 1));
+  p.sysexFill++;
+  if (b == 0xF7)
+    w = (w & ~(MidiWord)0x0F) | (MidiWord)(MIDI_CIN_SYSEX + p.sysexFill);
+  if (b == 0xF7 || p.sysexFill == 3) p.sysexFill = 0;
+}
+
+static inline void emit(MidiParser &p, uint8_t st, uint8_t d1, uint8_t d2, uint32_t ts) {
+  if (!p.onEvent) return;
+  MidiEvent ev = {midi_word_msg(p.cable, st, d1, d2), ts};
+  p.onEvent(ev, p.ctx);
+}
+
+// ======================================================
+// Инициализация
+// ======================================================
+void midi_parser_init(MidiParser &p, MidiEventFn onEvent, MidiSysexFn onSysex, void *ctx,
+                      uint8_t cable) {
+  p.onEvent = onEvent;
+  p.cable = cable;
+  p.onSysex = onSysex;
+  p.ctx = ctx;
+  midi_parser_reset(p);
+}
+
+void midi_parser_reset(MidiParser &p) {
+  p.runningStatus = 0;
+  p.need = 0;
+  p.count = 0;
+  p.inSysex = false;
+  p.sysexFlags = 0;
+  p.sysexWords = 0;
+  p.sysexFill = 0;
+}
+
+// ======================================================
+// Разбор байта
+// ======================================================
+void midi_parser_feed(MidiParser &p, uint8_t b, uint32_t ts) {
+  // ----- Realtime: сразу наружу, состояние не трогаем -----
+  if (b >= 0xF8) {
+    emit(p, b, 0, 0, ts);
+    return;
+  }
+
+  // ----- Статус-байт -----
+  if (b & 0x80) {
+    if (p.inSysex) {
+      p.inSysex = false;
+      if (b == 0xF7) {
+        sysex_put(p, b, ts);
+        sysex_flush(p, SYSEX_END, ts);
+        return;
+      }
+      sysex_put(p, 0xF7, ts);          // SysEx оборван новым статусом: закрываем
+      sysex_flush(p, SYSEX_ABORT, ts); // сами, чтобы приёмники не зависли в нём
+    }
+
+    p.count = 0;
+
+    if (b == 0xF0) {
+      p.runningStatus = 0;
+      p.need = 0;
+      p.inSysex = true;
+      p.sysexWords = 0;
+      p.sysexFill = 0;
+      p.sysexFlags = SYSEX_START;
+      sysex_put(p, b, ts);
+      return;
+    }
+
+    if (b < 0xF0) {
+      p.runningStatus = b;
+      p.need = voiceData[(b >> 4) & 0x07];
+      return;
+    }
+
+    // System Common: running status сбрасывается
+    p.runningStatus = 0;
+    uint8_t n = systemData[b & 0x0F];
+    if (n == 0) {
+      emit(p, b, 0, 0, ts);       // F6 Tune Request
+      p.need = 0;
+    } else if (n == 0xFF) {
+      p.need = 0;                    // F4/F5/лишний F7 — игнор
+    } else {
+      p.data[0] = b;                 // статус System Common ждёт данных
+      p.need = n;
+    }
+    return;
+  }
+
+  // ----- Байт данных -----
+  if (p.inSysex) {
+    sysex_put(p, b, ts);
+    return;
+  }
+
+  if (p.need == 0) return;           // нет активного статуса
+
+  if (p.runningStatus) {
+    p.data[p.count++] = b;
+    if (p.count < p.need) return;
+    p.count = 0;                     // running status остаётся
+    emit(p, p.runningStatus, p.data[0], p.need > 1 ? p.data[1] : 0, ts);
+    return;
+  }
+
+  // System Common: data[0] хранит статус, данные — в data[1] и d2
+  if (p.count == 0) {
+    p.count = 1;
+    if (p.need == 1) {
+      emit(p, p.data[0], b, 0, ts);
+      p.need = 0;
+      p.count = 0;
+    } else {
+      p.data[1] = b;
+    }
+    return;
+  }
+
+  emit(p, p.data[0], p.data[1], b, ts);
+  p.need = 0;
+  p.count = 0;
+}
+
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include "midi_word.h"
+
+// ======================================================
+// Потоковый парсер MIDI 1.0 (без аллокаций, без Arduino)
+// ======================================================
+//  - длины сообщений берутся из таблицы по статус-байту
+//  - Realtime (F8–FF) выдаётся сразу и не ломает ни running
+//    status, ни недособранное сообщение, ни SysEx
+//  - System Common (F1–F6) сбрасывает running status
+//  - SysEx (F0…F7) отдаётся кусками фиксированного буфера
+//  - события и SysEx — слова MidiWord (midi_word.h) с кабелем входа
+
+#define MIDI_SYSEX_CHUNK 48                      // байт в одном куске SysEx
+#define MIDI_SYSEX_WORDS (MIDI_SYSEX_CHUNK / 3)  // слов в куске
+
+struct MidiEvent {
+  MidiWord word;      // сообщение (1–3 байта, длина — по CIN)
+  uint32_t ts;        // время прихода последнего байта, мкс
+};
+
+// Флаги куска SysEx
+#define SYSEX_START 0x01   // кусок начинается с F0
+#define SYSEX_END   0x02   // кусок заканчивается F7
+#define SYSEX_ABORT 0x04   // SysEx прерван статус-байтом: F7 в конце добавил парсер
+
+typedef void (*MidiEventFn)(const MidiEvent &ev, void *ctx);
+typedef void (*MidiSysexFn)(const MidiWord *words, uint8_t count, uint8_t flags, uint32_t ts, void *ctx);
+
+struct MidiParser {
+  uint8_t runningStatus;   // 0 — нет активного статуса
+  uint8_t need;            // сколько байт данных ждём
+  uint8_t count;           // сколько уже собрано
+  uint8_t data[2];
+  bool inSysex;
+  uint8_t sysexFlags;      // флаги для следующего куска
+  uint8_t sysexWords;      // слов в куске
+  uint8_t sysexFill;       // байт в последнем слове (0 — слово закрыто)
+  uint8_t cable;           // кабель в словах (вход, USB_CABLE_*)
+  MidiWord sysex[MIDI_SYSEX_WORDS];
+
+  MidiEventFn onEvent;
+  MidiSysexFn onSysex;
+  void *ctx;
+};
+
+/**
+ * @brief Полная длина сообщения по статус-байту (1–3, 0 — не сообщение)
+ *
+ * Для F0 возвращает 0 (SysEx переменной длины).
+ */
+uint8_t midi_msg_len(uint8_t status);
+
+/**
+ * @brief Инициализация; cable — кабель входа в выдаваемых словах
+ */
+void midi_parser_init(MidiParser &p, MidiEventFn onEvent, MidiSysexFn onSysex, void *ctx,
+                      uint8_t cable = 0);
+void midi_parser_reset(MidiParser &p);
+
+/**
+ * @brief Подать один байт потока
+ */
+void midi_parser_feed(MidiParser &p, uint8_t b, uint32_t ts);
+
@@ -0,0 +1,124 @@
+#pragma once
+#include <stdint.h>
+#include "midi_word.h"
+
+// ======================================================
+// Очередь исходящих MIDI сообщений одного порта
+// ======================================================
+// Один продюсер (основной код) и один потребитель (IRQ-обработчик
+// FIFO PIO). push/pop в обычном режиме не требуют блокировок:
+// head меняет только продюсер, tail — только потребитель.
+// Политики переполнения drop-oldest и coalesce-CC трогают чужие
+// индексы/слоты, поэтому выполняются с кратким запретом прерываний
+// (потребитель — IRQ на том же ядре).
+
+#ifdef ARDUINO
+#include "hardware/sync.h"
+#define MQ_LOCK()     uint32_t _mq_irq = save_and_disable_interrupts()
+#define MQ_UNLOCK()   restore_interrupts(_mq_irq)
+#else
+#define MQ_LOCK()     do {} while (0)
+#define MQ_UNLOCK()   do {} while (0)
+#endif
+
+#define MIDI_QUEUE_SIZE 64   // степень двойки
+
+struct MidiMsg {
+  MidiWord w;        // сообщение или звено SysEx (длина — по CIN)
+  uint32_t ts;       // время прихода исходного события, мкс (0 — нет)
+};
+
+enum OverflowPolicy : uint8_t {
+  OVERFLOW_DROP_OLDEST = 0,   // выбросить самое старое сообщение
+  OVERFLOW_DROP_NEWEST,       // выбросить новое сообщение
+  OVERFLOW_COALESCE_CC        // заменить значение ожидающего CC, иначе drop-newest
+};
+
+struct MidiQueue {
+  MidiMsg buf[MIDI_QUEUE_SIZE];
+  volatile uint16_t head;     // пишет продюсер
+  volatile uint16_t tail;     // пишет потребитель
+  uint8_t policy;             // OverflowPolicy
+  uint16_t highWater;         // максимальная глубина
+  uint32_t drops;             // потерянные сообщения
+  uint32_t coalesced;         // слитые CC
+};
+
+static inline uint16_t midi_queue_depth(const MidiQueue &q) {
+  return (uint16_t)(q.head - q.tail);
+}
+
+// Свободных слотов: у продюсера их может стать только больше
+static inline uint16_t midi_queue_room(const MidiQueue &q) {
+  return (uint16_t)(MIDI_QUEUE_SIZE - midi_queue_depth(q));
+}
+
+// --- Поиск ожидающего CC с тем же статусом и номером контроллера ---
+// CIN 0xB — только CC; сравниваются статус и номер (биты 8–23 слова)
+static inline bool midi_queue_coalesce(MidiQueue &q, const MidiMsg &m) {
+  if (midi_word_cin(m.w) != 0x0B) return false;
+
+  bool merged = false;
+  MQ_LOCK();
+  for (uint16_t i = q.tail; i != q.head; i++) {
+    MidiMsg &p = q.buf[i & (MIDI_QUEUE_SIZE - 1)];
+    if (midi_word_cin(p.w) == 0x0B && ((p.w ^ m.w) & 0x00FFFF00) == 0) {
+      p.w = (p.w & 0x00FFFFFF) | (m.w & 0xFF000000);
+      merged = true;
+      break;
+    }
+  }
+  MQ_UNLOCK();
+  return merged;
+}
+
+/**
+ * @brief Поставить сообщение в очередь (продюсер)
+ * @return false, если сообщение отброшено
+ */
+static inline bool midi_queue_push(MidiQueue &q, const MidiMsg &m) {
+  uint16_t head = q.head;
+
+  if ((uint16_t)(head - q.tail) >= MIDI_QUEUE_SIZE) {
+    switch (q.policy) {
+      case OVERFLOW_DROP_OLDEST: {
+        MQ_LOCK();
+        if ((uint16_t)(head - q.tail) >= MIDI_QUEUE_SIZE)
+          q.tail = q.tail + 1;
+        MQ_UNLOCK();
+        q.drops++;
+        break;
+      }
+      case OVERFLOW_COALESCE_CC:
+        if (midi_queue_coalesce(q, m)) {
+          q.coalesced++;
+          return true;
+        }
+        q.drops++;
+        return false;
+      default:
+        q.drops++;
+        return false;
+    }
+  }
+
+  q.buf[head & (MIDI_QUEUE_SIZE - 1)] = m;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  q.head = head + 1;
+
+  uint16_t depth = (uint16_t)(q.head - q.tail);
+  if (depth > q.highWater) q.highWater = depth;
+  return true;
+}
+
+/**
+ * @brief Забрать сообщение из очереди (потребитель)
+ */
+static inline bool midi_queue_pop(MidiQueue &q, MidiMsg &out) {
+  uint16_t tail = q.tail;
+  if (tail == q.head) return false;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  out = q.buf[tail & (MIDI_QUEUE_SIZE - 1)];
+  q.tail = tail + 1;
+  return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+
+// ======================================================
+// Событие MIDI одним 32-битным словом (формат пакета USB-MIDI)
+// ======================================================
+// Слово — это пакет USB-MIDI 1.0 в памяти little-endian:
+//
+//   биты  0–3   CIN    (Code Index Number: тип и длина сообщения)
+//   биты  4–7   кабель (вход-источник; для USB — номер кабеля)
+//   биты  8–15  статус / первый байт
+//   биты 16–23  байт 2
+//   биты 24–31  байт 3
+//
+// Кабель совпадает с индексом бита DEST_* (USB_CABLE_* в midi_output.h),
+// так что одно и то же слово — и источник события для матрицы thru,
+// и готовый пакет для хоста. Выровненное слово пишется одной командой:
+// через SPSC-очереди и между ядрами оно проходит без блокировок.
+//
+// SysEx идёт цепочкой слов: CIN 0x4 — три байта продолжения,
+// 0x5/0x6/0x7 — последнее слово с F7 (1/2/3 байта).
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "MidiWord = пакет USB-MIDI только на little-endian");
+
+typedef uint32_t MidiWord;
+
+#define MIDI_CIN_SYSEX      0x4   // SysEx: начало/продолжение, 3 байта
+#define MIDI_CIN_SYSEX_END1 0x5   // конец SysEx (1 байт) или System Common из 1 байта
+
+static inline MidiWord midi_word(uint8_t cable, uint8_t cin, uint8_t b0, uint8_t b1, uint8_t b2) {
+  return (MidiWord)((cable & 0x0F) << 4 | (cin & 0x0F)) | (MidiWord)b0 << 8 |
+         (MidiWord)b1 << 16 | (MidiWord)b2 << 24;
+}
+
+static inline uint8_t midi_word_cin(MidiWord w)    { return w & 0x0F; }
+static inline uint8_t midi_word_cable(MidiWord w)  { return (w >> 4) & 0x0F; }
+static inline uint8_t midi_word_status(MidiWord w) { return (uint8_t)(w >> 8); }
+static inline uint8_t midi_word_data1(MidiWord w)  { return (uint8_t)(w >> 16); }
+static inline uint8_t midi_word_data2(MidiWord w)  { return (uint8_t)(w >> 24); }
+
+// i-й байт сообщения (0–2)
+static inline uint8_t midi_word_byte(MidiWord w, uint8_t i) {
+  return (uint8_t)(w >> (8 * (i + 1)));
+}
+
+static inline MidiWord midi_word_set_cable(MidiWord w, uint8_t cable) {
+  return (w & ~(MidiWord)0xF0) | (MidiWord)(cable & 0x0F) << 4;
+}
+
+/**
+ * @brief Длина сообщения в слове по CIN (0 — зарезервированные CIN 0x0/0x1)
+ */
+static inline uint8_t midi_word_len(MidiWord w) {
+  static const uint8_t cinLen[16] = {0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1};
+  return cinLen[w & 0x0F];
+}
+
+/**
+ * @brief CIN по статус-байту (не SysEx)
+ *
+ * Канальные — старший полубайт; Realtime — 0xF; System Common —
+ * по длине (F1/F3 — 0x2, F2 — 0x3, F6 — 0x5).
+ */
+static inline uint8_t midi_cin(uint8_t status) {
+  if (status < 0xF0) return status >> 4;
+  if (status >= 0xF8) return 0x0F;
+  switch (status) {
+    case 0xF1:
+    case 0xF3: return 0x02;
+    case 0xF6: return MIDI_CIN_SYSEX_END1;
+    default:   return 0x03;
+  }
+}
+
+/**
+ * @brief Собрать слово из сообщения; байты за пределами длины обнуляются
+ */
+static inline MidiWord midi_word_msg(uint8_t cable, uint8_t st, uint8_t d1, uint8_t d2) {
+  uint8_t cin = midi_cin(st);
+  MidiWord w = midi_word(cable, cin, st, d1, d2);
+  static const MidiWord mask[4] = {0x000000FF, 0x0000FFFF, 0x00FFFFFF, 0xFFFFFFFF};
+  return w & mask[midi_word_len(w)];
+}
+
+/**
+ * @brief Байты сообщения из слова
+ * @return длина (0–3)
+ */
+static inline uint8_t midi_word_bytes(MidiWord w, uint8_t *out) {
+  uint8_t n = midi_word_len(w);
+  for (uint8_t i = 0; i < n; i++) out[i] = midi_word_byte(w, i);
+  return n;
+}
@@ -0,0 +1,123 @@
+#include "note_state.h"
+#include "midi_output.h"
+#include "route_table.h"
+#include "spsc_queue.h"
+#include "scheduler.h"
+
+// ======================================================
+// Состояние (пишет только core1; core0 читает для статистики)
+// ======================================================
+static uint32_t held[DEST_COUNT][16][4];   // бит — звучащая нота (3 КБ)
+static uint16_t usbCables[16];             // USB: кабели, где были NoteOn канала
+static uint16_t releaseCh[DEST_COUNT];     // каналы, которые ещё гасим
+static uint16_t releasing = 0;             // выходы со сбросом в работе
+
+static uint32_t releases = 0;
+static uint32_t noteOffs = 0;
+
+// Запросы сброса core0 → core1 (маска выходов)
+static SpscQueue<uint16_t, 8> reqQueue;
+
+void notes_update(uint8_t sink, MidiWord w) {
+  if (sink >= DEST_COUNT) return;
+  uint8_t ch = midi_word_status(w) & 0x0F;
+  uint8_t note = midi_word_data1(w) & 0x7F;
+  uint32_t bit = 1u << (note & 31);
+  uint32_t &word = held[sink][ch][note >> 5];
+  if (midi_word_cin(w) == 0x9 && midi_word_data2(w)) {
+    word |= bit;
+    if (sink == 0) usbCables[ch] |= 1u << midi_word_cable(w);
+  } else {
+    word &= ~bit;
+  }
+}
+
+// ======================================================
+// Сброс
+// ======================================================
+
+// --- NoteOff на звучащие ноты, пока в выходах есть место ---
+static void release_step() {
+  midi_out_hold();   // порты TRS гасятся в ногу
+  for (uint16_t m = releasing; m; m &= m - 1) {
+    uint8_t s = __builtin_ctz(m);
+    uint16_t room = midi_out_room(s);
+    if (s != 0) room = (room > NOTES_SPARE) ? room - NOTES_SPARE : 0;   // USB: пачка уходит в конце прохода
+
+    while (releaseCh[s]) {
+      uint8_t ch = __builtin_ctz(releaseCh[s]);
+      uint16_t cables = (s == 0 && usbCables[ch]) ? usbCables[ch] : 1u << USB_CABLE_ROUTER;
+      uint8_t need = __builtin_popcount(cables);   // слов на ноту
+      uint32_t *words = held[s][ch];
+      uint8_t k = 0;
+      for (; k < 4; k++) {
+        while (words[k] && room >= need) {
+          uint8_t b = __builtin_ctz(words[k]);
+          words[k] &= ~(1u << b);
+          for (uint16_t c = cables; c; c &= c - 1)
+            send_midi(s, midi_word_msg(__builtin_ctz(c), 0x80 | ch, k * 32 + b, 0));
+          room -= need;
+          noteOffs++;
+        }
+        if (words[k]) break;                        // места нет — в следующем проходе
+      }
+      if (k < 4) break;
+      releaseCh[s] &= ~(1u << ch);
+      if (s == 0) usbCables[ch] = 0;
+    }
+    if (!releaseCh[s]) releasing &= ~(1u << s);
+  }
+  midi_out_release();
+}
+
+void notes_release(uint16_t dest, uint16_t channels) {
+  releases++;
+  sched_cancel_notes(dest, channels);   // отложенный NoteOn не должен прозвучать после сброса
+  for (uint16_t m = dest & DEST_ALL; m; m &= m - 1) {
+    uint8_t s = __builtin_ctz(m);
+    uint16_t chs = 0;
+    for (uint8_t ch = 0; ch < 16; ch++) {
+      const uint32_t *words = held[s][ch];
+      if (words[0] | words[1] | words[2] | words[3]) chs |= 1u << ch;
+    }
+    releaseCh[s] |= chs & channels;
+    if (releaseCh[s]) releasing |= 1u << s;
+  }
+  release_step();
+}
+
+void notes_task() {
+  uint16_t dest;
+  while (reqQueue.pop(dest)) notes_release(dest);
+  if (releasing) release_step();
+}
+
+// ======================================================
+// core0
+// ======================================================
+bool notes_post_release(uint16_t dest) {
+  return reqQueue.push(dest);
+}
+
+void notes_get_stats(NotesStats &st) {
+  st.sounding = 0;
+  for (uint8_t s = 0; s < DEST_COUNT; s++) {
+    NotesPortStats p;
+    notes_get_port(s, p);
+    st.sounding += p.sounding;
+  }
+  st.releasing = __builtin_popcount(releasing);
+  st.releases = releases;
+  st.noteOffs = noteOffs;
+}
+
+void notes_get_port(uint8_t sink, NotesPortStats &st) {
+  st = NotesPortStats{};
+  if (sink >= DEST_COUNT) return;
+  for (uint8_t ch = 0; ch < 16; ch++) {
+    uint16_t n = 0;
+    for (uint32_t w : held[sink][ch]) n += __builtin_popcount(w);
+    st.sounding += n;
+    if (n) st.channels |= 1u << ch;
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include "midi_word.h"
+
+// ======================================================
+// Звучащие ноты по выходам и каналам
+// ======================================================
+// На каждый выход (бит DEST_*) и канал — 128 бит, по ноте на бит
+// (12 × 16 × 16 байт = 3 КБ). send_midi и send_midi_packet отмечают
+// каждую ушедшую ноту: NoteOn ставит бит, NoteOff и NoteOn vel 0 —
+// снимают. Так известно, что на самом деле звучит, и сброс шлёт
+// NoteOff только на эти ноты, а не 128 × 16 на выход (на 31250 бод
+// это секунды).
+//
+// Пакеты USB из разных кабелей для хоста — разные потоки: по каналу
+// USB запоминается ещё маска кабелей, NoteOff уходит в каждый.
+//
+// Сброс (notes_release) идёт порциями: за проход core1 в выход уходит
+// не больше, чем есть места в его очереди сверх NOTES_SPARE (USB — в
+// пачке), остальное — в следующих проходах. Бит снимается при отправке
+// NoteOff, так что нота, взятая заново до конца сброса, тоже погаснет.
+// NoteOn, ещё ждущие на колесе планировщика (компенсация задержки, эхо),
+// сброс снимает сразу — они не прозвучат после него.
+//
+// Кто сбрасывает:
+//  - PANIC (WebSerial) и All Notes Off на управляющем канале пресетов
+//  - смена пресета (LOAD_PRESET и Program Change по MIDI)
+//  - выключение thru (NoteOff со входа больше не пройдёт)
+//  - сбой клавиатуры (keymap_all_notes_off) — выходы notesOff канала
+
+#define NOTES_SPARE  8   // мест очереди DIN/TRS, оставляемых живому потоку
+
+/**
+ * @brief Отметить ноту, ушедшую в выход sink (core1, из send_midi)
+ */
+void notes_update(uint8_t sink, MidiWord w);
+
+static inline void notes_track(uint8_t sink, MidiWord w) {
+  if ((midi_word_cin(w) & 0x0E) == 0x08) notes_update(sink, w);   // CIN 8/9
+}
+
+/**
+ * @brief Погасить звучащие ноты (core1)
+ *
+ * Первая порция NoteOff уходит сразу, остаток — из notes_task().
+ * @param dest маска выходов DEST_*
+ * @param channels маска каналов (бит 0 — канал 1)
+ */
+void notes_release(uint16_t dest, uint16_t channels = 0xFFFF);
+
+/**
+ * @brief То же с core0: запрос уходит в core1 очередью
+ * @return false — очередь полна
+ */
+bool notes_post_release(uint16_t dest);
+
+/**
+ * @brief Запросы core0 и остаток сброса (core1, каждый проход)
+ */
+void notes_task();
+
+struct NotesStats {
+  uint16_t sounding;     // звучащих нот по всем выходам
+  uint16_t releasing;    // выходов, где сброс ещё идёт
+  uint32_t releases;     // сбросов
+  uint32_t noteOffs;     // NoteOff, отправленных сбросами
+};
+
+struct NotesPortStats {
+  uint16_t sounding;     // звучащих нот на выходе
+  uint16_t channels;     // каналы с нотами, бит 0 — канал 1
+};
+
+void notes_get_stats(NotesStats &st);
+void notes_get_port(uint8_t sink, NotesPortStats &st);
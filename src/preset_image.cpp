@@ -0,0 +1,106 @@
+#include "preset_image.h"
+#include <string.h>
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint32_t payload_crc(const PresetImage &img) {
+  return crc32_update(0, (const uint8_t *)&img + sizeof(PresetHeader),
+                      sizeof(PresetImage) - sizeof(PresetHeader));
+}
+
+void preset_image_build(const ConfigModel &model, const char *name, PresetImage &img) {
+  memset(&img, 0, sizeof(img));
+  img.model = model;
+  route_table_compile(model, img.routes);
+
+  img.hdr.magic = PRESET_MAGIC;
+  img.hdr.version = PRESET_VERSION;
+  img.hdr.headerSize = sizeof(PresetHeader);
+  img.hdr.payloadSize = sizeof(PresetImage) - sizeof(PresetHeader);
+  if (name) strncpy(img.hdr.name, name, sizeof(img.hdr.name) - 1);
+  img.hdr.crc = payload_crc(img);
+}
+
+// --- Прежние раскладки: заголовок | модель | таблица | выравнивание ---
+// v1: count + keys[256]                 | RouteEntry[256]
+// v2: count + keys[256] + правила thru  | RouteEntry[256] + матрица thru одного входа
+// v3: то же                              | RouteEntry[256] + матрица thru двух входов
+// v4: ConfigModel без кривых             | RouteTable без кривых
+// KeyMapping до v4 — 6 байт, без слоя.
+struct KeyMappingV3 {
+  uint8_t hid, type, value, channel;
+  uint16_t dest;
+};
+#define IMAGE_SIZE(model, routes) \
+  (((sizeof(PresetHeader) + (model) + (routes) + 3) & ~3u) - sizeof(PresetHeader))
+#define V1_KEYS_SIZE    (sizeof(uint16_t) + MAX_MAPPINGS * sizeof(KeyMappingV3))
+#define V3_MODEL_SIZE   (V1_KEYS_SIZE + sizeof(uint16_t) + MAX_THRU_RULES * sizeof(ThruRule))
+#define V3_CELLS_SIZE   (16 * THRU_TYPES * sizeof(ThruCell))
+#define V1_PAYLOAD_SIZE IMAGE_SIZE(V1_KEYS_SIZE, 256 * sizeof(RouteEntry))
+#define V2_PAYLOAD_SIZE IMAGE_SIZE(V3_MODEL_SIZE, 256 * sizeof(RouteEntry) + V3_CELLS_SIZE)
+#define V3_PAYLOAD_SIZE IMAGE_SIZE(V3_MODEL_SIZE, 256 * sizeof(RouteEntry) + 2 * V3_CELLS_SIZE)
+#define V4_MODEL_SIZE   offsetof(ConfigModel, curveCount)
+#define V4_PAYLOAD_SIZE IMAGE_SIZE(V4_MODEL_SIZE, offsetof(RouteTable, thruCurve))
+
+static_assert(sizeof(KeyMappingV3) == 6, "v3 KeyMapping layout");
+
+static bool rebuild(const ConfigModel &model, const PresetHeader &h, PresetImage &img) {
+  char name[sizeof(h.name)];
+  memcpy(name, h.name, sizeof(name));
+  name[sizeof(name) - 1] = '\0';
+  preset_image_build(model, name, img);
+  return true;
+}
+
+bool preset_image_upgrade(const void *old, PresetImage &img) {
+  const PresetHeader &h = *(const PresetHeader *)old;
+  const uint8_t *payload = (const uint8_t *)old + sizeof(PresetHeader);
+  size_t payloadSize = (h.version == 1) ? V1_PAYLOAD_SIZE
+                     : (h.version == 2) ? V2_PAYLOAD_SIZE
+                     : (h.version == 3) ? V3_PAYLOAD_SIZE
+                     : (h.version == 4) ? V4_PAYLOAD_SIZE
+                     : 0;
+  if (h.magic != PRESET_MAGIC || !payloadSize) return false;
+  if (h.headerSize != sizeof(PresetHeader) || h.payloadSize != payloadSize) return false;
+  if (h.crc != crc32_update(0, payload, payloadSize)) return false;
+
+  static ConfigModel model;   // ~2 КБ — не на стеке
+  memset(&model, 0, sizeof(model));
+  if (h.version == 4) {                 // модель та же, только без кривых
+    memcpy(&model, payload, V4_MODEL_SIZE);
+    if (model.count > MAX_MAPPINGS || model.thruCount > MAX_THRU_RULES) return false;
+    return rebuild(model, h, img);
+  }
+
+  memcpy(&model.count, payload, sizeof(model.count));
+  if (model.count > MAX_MAPPINGS) return false;
+  for (uint16_t i = 0; i < model.count; i++) {
+    KeyMappingV3 k;
+    memcpy(&k, payload + sizeof(uint16_t) + i * sizeof(k), sizeof(k));
+    model.keys[i] = {k.hid, k.type, k.value, k.channel, k.dest, LAYER_BASE, 0};
+  }
+  if (h.version >= 2) {
+    memcpy(&model.thruCount, payload + V1_KEYS_SIZE, sizeof(model.thruCount));
+    if (model.thruCount > MAX_THRU_RULES) return false;
+    memcpy(model.thru, payload + V1_KEYS_SIZE + sizeof(uint16_t), sizeof(model.thru));
+  }
+  return rebuild(model, h, img);
+}
+
+bool preset_image_valid(const PresetImage *img) {
+  if (!img) return false;
+  const PresetHeader &h = img->hdr;
+  if (h.magic != PRESET_MAGIC || h.version != PRESET_VERSION) return false;
+  if (h.headerSize != sizeof(PresetHeader)) return false;
+  if (h.payloadSize != sizeof(PresetImage) - sizeof(PresetHeader)) return false;
+  return h.crc == payload_crc(*img);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "config_model.h"
+#include "route_table.h"
+
+// ======================================================
+// Бинарный образ пресета
+// ======================================================
+// Образ кладётся в зарезервированный слот flash и читается через
+// окно XIP как есть: routes сразу годится для ядра MIDI, model — для
+// редактора (экспорт в JSON). Раскладка фиксирована (little-endian,
+// без выравнивающих дыр) — её же читает tools/preset_tool.py.
+
+#define PRESET_MAGIC    0x50524D52u   // "RMRP"
+#define PRESET_VERSION  5   // 2 — матрица thru, 3 — второй вход (USB), 4 — слои, 5 — кривые
+
+struct PresetHeader {
+  uint32_t magic;       // PRESET_MAGIC
+  uint16_t version;     // PRESET_VERSION
+  uint16_t headerSize;  // sizeof(PresetHeader)
+  uint32_t payloadSize; // байт после заголовка
+  uint32_t crc;         // CRC-32 (zlib) полезной нагрузки
+  char name[16];        // имя пресета (с нулём на конце)
+};
+
+struct PresetImage {
+  PresetHeader hdr;
+  ConfigModel model;    // для редактора
+  RouteTable routes;    // для ядра MIDI
+};
+
+static_assert(sizeof(PresetHeader) == 32, "PresetHeader layout");
+static_assert(offsetof(PresetImage, model) == 32, "PresetImage layout");
+static_assert(offsetof(PresetImage, routes) == 32 + sizeof(ConfigModel), "PresetImage layout");
+
+/**
+ * @brief CRC-32 (полином 0xEDB88320, как zlib.crc32)
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Собрать образ: модель + скомпилированная таблица + CRC
+ */
+void preset_image_build(const ConfigModel &model, const char *name, PresetImage &img);
+
+/**
+ * @brief Проверить magic, версию, размер и CRC
+ */
+bool preset_image_valid(const PresetImage *img);
+
+/**
+ * @brief Пересобрать образ предыдущей версии в текущую
+ *
+ * v1: ConfigModel без правил thru — переносятся только назначения
+ * клавиш, матрица получается по умолчанию (всё на все выходы).
+ * v2: модель та же, матрица thru была только для DIN — пересобираем.
+ * v3: KeyMapping без слоя (6 байт) — все назначения в базовый слой.
+ * v4: модель без кривых — добавляется пустой список.
+ * @return false, если old — не целый образ известной старой версии
+ */
+bool preset_image_upgrade(const void *old, PresetImage &img);
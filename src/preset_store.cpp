@@ -0,0 +1,174 @@
+#include "preset_store.h"
+#include <Arduino.h>
+#include <string.h>
+#include "hardware/flash.h"
+
+// Символы компоновщика arduino-pico: начало LittleFS и конец прошивки
+extern uint8_t _FS_start;
+extern uint8_t __flash_binary_end;
+
+#define SLOT_SIZE   (PRESET_SLOT_SECTORS * FLASH_SECTOR_SIZE)
+#define REGION_SIZE (FLASH_SECTOR_SIZE + MAX_PRESETS * SLOT_SIZE)   // индекс + слоты
+#define LEGACY_REGION_SIZE ((1 + MAX_PRESETS) * FLASH_SECTOR_SIZE)  // до v4: слот = сектор
+
+static uintptr_t regionBase = 0;   // XIP-адрес сектора индекса (0 — хранилище недоступно)
+static uintptr_t legacyBase = 0;   // индекс прежней раскладки (слот = сектор)
+static uint32_t validBits[(MAX_PRESETS + 31) / 32];   // бит (id-1) — слот занят
+
+// буфер записи: образ или индекс, дополненный до целых страниц flash
+#define PAGE_ROUND(n) (((n) + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1))
+static uint8_t pageBuf[PAGE_ROUND(sizeof(PresetImage) > sizeof(PresetIndex)
+                                  ? sizeof(PresetImage) : sizeof(PresetIndex))]
+  __attribute__((aligned(4)));
+
+static_assert(sizeof(PresetImage) <= SLOT_SIZE, "preset image must fit its slot");
+static_assert(sizeof(PresetIndex) <= FLASH_SECTOR_SIZE, "preset index must fit one sector");
+
+static inline const PresetIndex *flash_index() {
+  return (const PresetIndex *)regionBase;
+}
+
+static inline uintptr_t slot_addr(uint16_t id) {
+  return regionBase + FLASH_SECTOR_SIZE + (uintptr_t)(id - 1) * SLOT_SIZE;   // id 1 — сразу за индексом
+}
+
+static inline bool bit_get(uint16_t id) {
+  return validBits[(id - 1) >> 5] & (1u << ((id - 1) & 31));
+}
+
+static inline void bit_set(uint16_t id, bool on) {
+  uint32_t m = 1u << ((id - 1) & 31);
+  if (on) validBits[(id - 1) >> 5] |= m;
+  else    validBits[(id - 1) >> 5] &= ~m;
+}
+
+// ======================================================
+// Запись секторов (XIP недоступен: core1 и прерывания стоят)
+// ======================================================
+static void program_sectors(uintptr_t addr, const void *data, size_t len) {
+  if (data != pageBuf) {          // иначе образ уже собран прямо в pageBuf
+    memset(pageBuf, 0xFF, sizeof(pageBuf));
+    memcpy(pageBuf, data, len);
+  }
+  uint32_t offset = (uint32_t)(addr - XIP_BASE);
+
+  noInterrupts();
+  rp2040.idleOtherCore();
+  flash_range_erase(offset, (len + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1));
+  flash_range_program(offset, pageBuf, PAGE_ROUND(len));
+  rp2040.resumeOtherCore();
+  interrupts();
+}
+
+// Образ прежней версии из old → слот id (old может перекрываться со слотом:
+// образ сначала целиком собирается в pageBuf)
+static bool upgrade_slot(uint16_t id, uintptr_t old) {
+  memset(pageBuf, 0xFF, sizeof(pageBuf));
+  PresetImage &img = *(PresetImage *)pageBuf;
+  if (!preset_image_upgrade((const void *)old, img)) return false;
+  program_sectors(slot_addr(id), pageBuf, sizeof(PresetImage));
+  return true;
+}
+
+// Откуда пересобирать слот id: образ v4+ лежит в самом слоте, образ
+// до v4 — в прежнем односекторном слоте. Версия проверяется по месту:
+// на прежнем адресе может оказаться начало нового слота и наоборот
+static bool upgrade_from_old(uint16_t id) {
+  const PresetHeader *h = (const PresetHeader *)slot_addr(id);
+  if (h->magic == PRESET_MAGIC && h->version > PRESET_LEGACY_VERSION)
+    return upgrade_slot(id, slot_addr(id));
+
+  uintptr_t old = legacyBase + (uintptr_t)id * FLASH_SECTOR_SIZE;
+  h = (const PresetHeader *)old;
+  return h->magic == PRESET_MAGIC && h->version <= PRESET_LEGACY_VERSION && upgrade_slot(id, old);
+}
+
+static void write_index() {
+  static PresetIndex idx;
+  idx.magic = PRESET_INDEX_MAGIC;
+  idx.version = PRESET_VERSION;
+  idx.count = MAX_PRESETS;
+  for (uint16_t id = 1; id <= MAX_PRESETS; id++)
+    idx.slots[id - 1].crc = bit_get(id) ? ((const PresetImage *)slot_addr(id))->hdr.crc : 0xFFFFFFFFu;
+  program_sectors(regionBase, &idx, sizeof(idx));
+}
+
+// ======================================================
+// Инициализация
+// ======================================================
+bool preset_store_begin() {
+  uintptr_t fsStart = (uintptr_t)&_FS_start;
+  uintptr_t base = (fsStart - REGION_SIZE) & ~(uintptr_t)(FLASH_SECTOR_SIZE - 1);
+
+  if (base < (uintptr_t)&__flash_binary_end) {
+    Serial.println("[PRESET] ❌ No free flash below LittleFS for presets");
+    regionBase = 0;
+    return false;
+  }
+  regionBase = base;
+  legacyBase = (fsStart - LEGACY_REGION_SIZE) & ~(uintptr_t)(FLASH_SECTOR_SIZE - 1);
+  memset(validBits, 0, sizeof(validBits));
+
+  const PresetIndex *idx = flash_index();
+  bool indexOk = idx->magic == PRESET_INDEX_MAGIC && idx->version == PRESET_VERSION
+              && idx->count == MAX_PRESETS;
+
+  if (indexOk) {
+    // слот считаем живым, если заголовок совпадает с CRC в индексе
+    for (uint16_t id = 1; id <= MAX_PRESETS; id++) {
+      const PresetHeader &h = ((const PresetImage *)slot_addr(id))->hdr;
+      uint32_t crc = idx->slots[id - 1].crc;
+      if (crc != 0xFFFFFFFFu && h.magic == PRESET_MAGIC && h.version == PRESET_VERSION && h.crc == crc)
+        bit_set(id, true);
+    }
+  } else {
+    // индекса нет (первый старт или новая версия) — один раз проверяем
+    // CRC всех слотов; образы прежних версий пересобираем. До v4 слот
+    // занимал один сектор под самой LittleFS: такие образы переносим по
+    // возрастанию номера — слот id не задевает старые слоты с большими
+    // номерами, а свой старый образ к моменту записи уже в pageBuf
+    for (uint16_t id = 1; id <= MAX_PRESETS; id++) {
+      const PresetImage *img = (const PresetImage *)slot_addr(id);
+      if (!preset_image_valid(img) && upgrade_from_old(id))
+        Serial.printf("[PRESET] ⬆️ Slot %u upgraded to v%u\n", id, PRESET_VERSION);
+      if (preset_image_valid(img))
+        bit_set(id, true);
+    }
+    write_index();
+  }
+
+  Serial.printf("[PRESET] %u/%u flash slots used at 0x%08lX\n",
+                preset_store_count(), MAX_PRESETS, (unsigned long)regionBase);
+  return true;
+}
+
+// ======================================================
+// Доступ
+// ======================================================
+const PresetImage *preset_store_get(uint16_t id) {
+  if (!regionBase || id < 1 || id > MAX_PRESETS || !bit_get(id)) return nullptr;
+  return (const PresetImage *)slot_addr(id);
+}
+
+bool preset_store_contains(const void *p) {
+  uintptr_t a = (uintptr_t)p;
+  return regionBase && a >= regionBase && a < regionBase + REGION_SIZE;
+}
+
+uint16_t preset_store_count() {
+  uint16_t n = 0;
+  for (uint32_t w : validBits) n += __builtin_popcount(w);
+  return n;
+}
+
+bool preset_store_write(uint16_t id, const PresetImage &img) {
+  if (!regionBase || id < 1 || id > MAX_PRESETS) return false;
+
+  bit_set(id, false);
+  program_sectors(slot_addr(id), &img, sizeof(img));
+
+  bool ok = preset_image_valid((const PresetImage *)slot_addr(id));
+  bit_set(id, ok);
+  write_index();
+  return ok;
+}
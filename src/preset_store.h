@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include "preset_image.h"
+#include "config_manager.h"
+
+// ======================================================
+// Хранилище бинарных пресетов во flash (окно XIP)
+// ======================================================
+// Область прямо под LittleFS: [индекс][слот 1]...[слот MAX_PRESETS],
+// по PRESET_SLOT_SECTORS секторов (4 КБ) на слот. Индекс хранит CRC каждого слота,
+// так что поиск пресета — O(1): адрес слота вычисляется по номеру,
+// а старт не требует пересчитывать CRC всех образов.
+// Запись стирает сектора, поэтому только с core0 и не во время игры.
+
+#define PRESET_INDEX_MAGIC 0x58445250u   // "PRDX"
+#define PRESET_SLOT_SECTORS 2             // до v4 — 1 (образ без слоёв)
+#define PRESET_LEGACY_VERSION 3           // последняя версия с односекторными слотами
+
+struct PresetIndexEntry {
+  uint32_t crc;        // CRC образа в слоте (0xFFFFFFFF — слот пуст)
+};
+
+struct PresetIndex {
+  uint32_t magic;      // PRESET_INDEX_MAGIC
+  uint16_t version;    // PRESET_VERSION
+  uint16_t count;      // MAX_PRESETS на момент записи
+  PresetIndexEntry slots[MAX_PRESETS];
+};
+
+/**
+ * @brief Найти область и прочитать индекс (один раз при старте)
+ */
+bool preset_store_begin();
+
+/**
+ * @brief Образ пресета в XIP или nullptr, если слот пуст
+ *
+ * O(1): бит наличия в RAM + вычисленный адрес. Безопасно с core1.
+ */
+const PresetImage *preset_store_get(uint16_t id);
+
+/**
+ * @brief Записать образ в слот и обновить индекс
+ */
+bool preset_store_write(uint16_t id, const PresetImage &img);
+
+/**
+ * @brief true, если адрес лежит внутри области пресетов
+ */
+bool preset_store_contains(const void *p);
+
+/**
+ * @brief Число занятых слотов
+ */
+uint16_t preset_store_count();
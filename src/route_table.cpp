@@ -0,0 +1,154 @@
+#include "route_table.h"
+#include <string.h>
+
+// --- простейшая таблица клавиш HID USB Keyboard Set 2 ---
+// (сканкоды клавиатуры, типичные для CH376S HID клавиатуры)
+static const struct {
+  uint8_t hid;
+  uint8_t note;
+} defaultMap[] = {
+  {0x1D, 60}, // Z -> C4
+  {0x1B, 62}, // X -> D4
+  {0x06, 64}, // C -> E4
+  {0x19, 65}, // V -> F4
+  {0x05, 67}, // B -> G4
+  {0x11, 69}, // N -> A4
+  {0x10, 71}, // M -> B4
+  {0x36, 72}, // , -> C5
+  {0x37, 74}, // . -> D5
+  {0x38, 76}  // / -> E5
+};
+
+uint8_t route_default_note(uint8_t hid) {
+  for (auto &m : defaultMap)
+    if (m.hid == hid)
+      return m.note;
+  return 0; // нет соответствия
+}
+
+uint16_t route_port_mask(const char *port) {
+  if (!port) return 0;
+  if (strcmp(port, "USB") == 0) return DEST_USB;
+  if (strcmp(port, "DIN") == 0) return DEST_DIN;
+
+  uint8_t portIndex = (uint8_t)(port[0] - 'A'); // A=0, B=1 ...
+  if (port[0] && port[1] == '\0' && portIndex < 10)
+    return DEST_PIO(portIndex);
+  return 0;
+}
+
+const char *route_sink_name(uint8_t sink) {
+  static const char *names[DEST_COUNT] = {"USB", "DIN", "A", "B", "C", "D", "E", "F", "G", "H", "I", "J"};
+  return (sink < DEST_COUNT) ? names[sink] : "";
+}
+
+const char *route_thru_input_name(uint8_t in) {
+  return (in == THRU_IN_USB) ? "USB" : "DIN";
+}
+
+uint8_t route_thru_input(const char *name) {
+  return (name && strcmp(name, "USB") == 0) ? THRU_IN_USB : THRU_IN_DIN;
+}
+
+const char *route_layer_name(uint8_t layer) {
+  static const char *names[KEY_LAYERS] = {"base", "shift", "ctrl"};
+  return (layer < KEY_LAYERS) ? names[layer] : "";
+}
+
+static const char *thruTypeNames[THRU_TYPES] = {
+  "noteoff", "noteon", "polyat", "cc", "pc", "pressure", "bend", "system"
+};
+
+const char *route_thru_type_name(uint8_t type) {
+  return (type < THRU_TYPES) ? thruTypeNames[type] : "";
+}
+
+uint8_t route_thru_type_mask(const char *name) {
+  if (!name) return 0;
+  if (strcmp(name, "note") == 0) return (1u << THRU_NOTE_OFF) | (1u << THRU_NOTE_ON);
+  for (uint8_t t = 0; t < THRU_TYPES; t++)
+    if (strcmp(name, thruTypeNames[t]) == 0) return (uint8_t)(1u << t);
+  return 0;
+}
+
+// ======================================================
+// Компиляция
+// ======================================================
+// Номер кривой из модели → индекс LUT (+ флаг "скорость из интервала")
+static uint8_t curve_index(const ConfigModel &cfg, uint8_t curve) {
+  if (curve < 1 || curve > cfg.curveCount) return 0;
+  return (cfg.curves[curve - 1].flags & CURVE_FROM_RATE) ? (curve | ROUTE_CURVE_RATE) : curve;
+}
+
+// типы thru, у которых есть значение для кривой
+#define THRU_CURVE_TYPES ((1u << THRU_NOTE_ON) | (1u << THRU_POLY_AT) | \
+                          (1u << THRU_CC) | (1u << THRU_PRESSURE))
+
+void route_table_compile(const ConfigModel &cfg, RouteTable &out) {
+  memset(&out, 0, sizeof(out));
+
+  curve_identity(out.curves[0]);
+  for (uint16_t i = 0; i < cfg.curveCount && i < MAX_CURVES; i++)
+    curve_build(cfg.curves[i], out.curves[i + 1]);
+
+  // сначала дефолтная карта — она же fallback для value == 0
+  for (auto &m : defaultMap) {
+    RouteEntry &e = out.keys[m.hid];
+    e.type = ROUTE_NOTE;
+    e.value = m.note;
+    e.channel = 0;
+    e.dest = DEST_USB;
+  }
+
+  uint8_t pooled = 0;
+  for (uint16_t i = 0; i < cfg.count; i++) {
+    const KeyMapping &k = cfg.keys[i];
+    if (k.value == 0) continue; // если конфиг не задан, остаётся дефолтная карта
+    if (k.layer >= KEY_LAYERS) continue;
+
+    RouteEntry *e = &out.keys[k.hid];
+    if (k.layer != LAYER_BASE) {
+      uint8_t &slot = out.layerSlot[k.layer - 1][k.hid];
+      if (!slot) {
+        if (pooled >= LAYER_POOL) continue;
+        slot = ++pooled;
+      }
+      e = &out.layerKeys[slot - 1];
+    }
+    e->type = k.dest ? k.type : (uint8_t)ROUTE_NONE;
+    e->value = k.value;
+    e->channel = (uint8_t)((k.channel - 1) & 0x0F);
+    e->curve = curve_index(cfg, k.curve);
+    e->dest = k.dest;
+  }
+
+  // куда слать All Notes Off при сбое клавиатуры
+  for (const RouteEntry &e : out.keys)
+    if (e.type == ROUTE_NOTE) out.notesOff[e.channel] |= e.dest;
+  for (uint8_t i = 0; i < pooled; i++)
+    if (out.layerKeys[i].type == ROUTE_NOTE) out.notesOff[out.layerKeys[i].channel] |= out.layerKeys[i].dest;
+
+  // матрица thru: по умолчанию прежнее поведение — всё на все выходы
+  for (uint8_t in = 0; in < THRU_INPUTS; in++) {
+    uint16_t dest = (in == THRU_IN_USB) ? (DEST_ALL & ~DEST_USB) : DEST_ALL;
+    for (uint8_t ch = 0; ch < 16; ch++)
+      for (uint8_t t = 0; t < THRU_TYPES; t++)
+        out.thru[in][ch][t] = THRU_CELL(dest, ch);
+  }
+
+  for (uint16_t i = 0; i < cfg.thruCount; i++) {
+    const ThruRule &r = cfg.thru[i];
+    if (r.in >= THRU_INPUTS) continue;
+
+    for (uint8_t ch = 0; ch < 16; ch++) {
+      if (!(r.channels & (1u << ch))) continue;
+      uint8_t outCh = r.remap ? (uint8_t)((r.remap - 1) & 0x0F) : ch;
+      for (uint8_t t = 0; t < THRU_TYPES; t++) {
+        if (!(r.types & (1u << t))) continue;
+        out.thru[r.in][ch][t] = THRU_CELL(r.dest, outCh);
+        if (THRU_CURVE_TYPES & (1u << t))
+          out.thruCurve[r.in][ch][t] = curve_index(cfg, r.curve) & ROUTE_CURVE_MASK;
+      }
+    }
+  }
+}
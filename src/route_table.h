@@ -0,0 +1,161 @@
+#pragma once
+#include <stdint.h>
+#include "config_model.h"
+#include "curve.h"
+
+// ======================================================
+// Скомпилированная таблица маршрутизации HID → MIDI
+// ======================================================
+// Модель конфигурации компилируется один раз (загрузка, пресет,
+// SAVE_CONFIG) в плоскую таблицу на 256 HID-кодов. На горячем пути остаётся
+// только индексирование массива — без String и без кучи.
+// Слои Shift/Ctrl — разреженные: байт-индекс на HID-код в общий пул
+// записей; клавиша без записи в слое берёт базовую.
+
+// --- Биты маски назначений ---
+#define DEST_USB      (1u << 0)
+#define DEST_DIN      (1u << 1)
+#define DEST_PIO(n)   (1u << (2 + (n)))   // TRS A–J (0–9)
+#define DEST_COUNT    12
+#define DEST_ALL      ((1u << DEST_COUNT) - 1)
+
+enum RouteType : uint8_t {
+  ROUTE_NONE = 0,   // клавиша ничего не отправляет
+  ROUTE_NOTE,       // NoteOn / NoteOff
+  ROUTE_CC          // Control Change
+};
+
+struct RouteEntry {
+  uint8_t type;      // RouteType
+  uint8_t value;     // номер ноты или CC (0–127)
+  uint8_t channel;   // MIDI-канал (0–15, уже без смещения)
+  uint8_t curve;     // индекс LUT в RouteTable.curves | ROUTE_CURVE_RATE
+  uint16_t dest;     // маска назначений DEST_*
+};
+
+#define ROUTE_CURVE_MASK  0x0F
+#define ROUTE_CURVE_RATE  0x80   // скорость — из интервала между нажатиями
+
+// --- Слои клавиатуры: выбираются удерживаемыми модификаторами ---
+enum KeyLayer : uint8_t {
+  LAYER_BASE = 0,
+  LAYER_SHIFT,      // Left/Right Shift
+  LAYER_CTRL        // Left/Right Ctrl (главнее Shift)
+};
+#define KEY_LAYERS   3
+#define LAYER_POOL   128   // записей на все слои, кроме базового
+
+// --- Матрица MIDI IN → выходы (thru) ---
+// Для каждого (вход, канал, тип сообщения) — готовая ячейка: маска
+// назначений и выходной канал. Фильтр на горячем пути — одно чтение.
+#define THRU_INPUTS     2     // MIDI IN: 0 — DIN, 1 — USB (кабель 0)
+#define THRU_IN_DIN     0
+#define THRU_IN_USB     1
+#define THRU_TYPES      8
+
+// Типы сообщений (индекс в матрице): 0x8n–0xEn → 0–6, System → 7
+enum ThruType : uint8_t {
+  THRU_NOTE_OFF = 0,
+  THRU_NOTE_ON,
+  THRU_POLY_AT,
+  THRU_CC,
+  THRU_PROGRAM,
+  THRU_PRESSURE,
+  THRU_BEND,
+  THRU_SYSTEM       // System Common, Realtime, SysEx — без канала, строка канала 1
+};
+
+// Ячейка: биты 0–11 — маска DEST_*, 12–15 — выходной канал (0–15)
+typedef uint16_t ThruCell;
+#define THRU_CELL(dest, ch)   ((ThruCell)(((dest) & DEST_ALL) | ((ch) << 12)))
+#define THRU_DEST(c)          ((uint16_t)((c) & DEST_ALL))
+#define THRU_CHANNEL(c)       ((uint8_t)((c) >> 12))
+
+struct RouteTable {
+  RouteEntry keys[256];                          // базовый слой
+  uint8_t layerSlot[KEY_LAYERS - 1][256];        // 1.. — индекс+1 в layerKeys, 0 — базовая
+  RouteEntry layerKeys[LAYER_POOL];
+  ThruCell thru[THRU_INPUTS][16][THRU_TYPES];
+  uint16_t notesOff[16];                         // канал → выходы, куда клавиши шлют ноты
+  uint8_t thruCurve[THRU_INPUTS][16][THRU_TYPES]; // индекс LUT для значения сообщения
+  uint8_t curves[MAX_CURVES + 1][CURVE_LUT_SIZE]; // 0 — тождественная, 1… — cfg.curves
+};
+
+/**
+ * @brief Запись клавиши в слое (без записи в слое — базовая)
+ */
+static inline const RouteEntry &route_key(const RouteTable &t, uint8_t layer, uint8_t hid) {
+  uint8_t slot = layer ? t.layerSlot[layer - 1][hid] : 0;
+  return slot ? t.layerKeys[slot - 1] : t.keys[hid];
+}
+
+/**
+ * @brief Индекс типа в матрице thru по статус-байту
+ *
+ * NoteOn с нулевой скоростью считается NoteOff.
+ */
+static inline uint8_t route_thru_type(uint8_t status, uint8_t data2) {
+  if (status >= 0xF0) return THRU_SYSTEM;
+  if ((status & 0xF0) == 0x90 && data2 == 0) return THRU_NOTE_OFF;
+  return (uint8_t)((status >> 4) - 8);
+}
+
+/**
+ * @brief Скомпилировать модель конфигурации в таблицу маршрутизации
+ *
+ * Семантика совпадает с прежним handle_hid_code():
+ *  - value == 0 или отсутствие записи → дефолтная карта (USB, канал 1)
+ *  - dest == 0 (порт не распознан) → клавиша молчит
+ *
+ * Записи слоёв с value == 0 не создаются (клавиша в слое ведёт себя
+ * как в базовом); notesOff собирается по всем слоям — это цели
+ * All Notes Off при сбое клавиатуры.
+ *
+ * Кривые cfg.curves компилируются в LUT curves[1…]; thruCurve
+ * заполняется только для типов со значением (NoteOn, PolyAT, CC,
+ * Channel Pressure), у остальных остаётся тождественная LUT 0.
+ *
+ * Матрица thru: по умолчанию всё на все выходы без смены канала
+ * (с USB — кроме самого USB, чтобы хост не получал эхо), затем
+ * правила cfg.thru по порядку (последнее совпавшее побеждает).
+ */
+void route_table_compile(const ConfigModel &cfg, RouteTable &out);
+
+/**
+ * @brief Преобразовать строку порта ("USB", "DIN", "A"…"J") в маску
+ * @return 0, если порт не распознан
+ */
+uint16_t route_port_mask(const char *port);
+
+/**
+ * @brief Имя выхода по индексу бита DEST_* ("USB", "DIN", "A"…"J")
+ */
+const char *route_sink_name(uint8_t sink);
+
+/**
+ * @brief Имя входа матрицы thru ("DIN", "USB") и обратно
+ * @return route_thru_input(): THRU_IN_DIN, если имя не распознано
+ */
+const char *route_thru_input_name(uint8_t in);
+uint8_t route_thru_input(const char *name);
+
+/**
+ * @brief Имя слоя ("base", "shift", "ctrl") — он же ключ в JSON
+ */
+const char *route_layer_name(uint8_t layer);
+
+/**
+ * @brief Имя типа сообщения матрицы thru ("noteoff", "cc", "system"...)
+ */
+const char *route_thru_type_name(uint8_t type);
+
+/**
+ * @brief Имя типа → маска бит THRU_* ("note" — NoteOn и NoteOff)
+ * @return 0, если тип не распознан
+ */
+uint8_t route_thru_type_mask(const char *name);
+
+/**
+ * @brief Нота из дефолтной карты клавиш (0 — нет соответствия)
+ */
+uint8_t route_default_note(uint8_t hid);
@@ -0,0 +1,479 @@
+#include "scheduler.h"
+#include <Arduino.h>
+#include <string.h>
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "midi_output.h"
+#include "route_table.h"
+#include "capture.h"
+#include "spsc_queue.h"
+
+// ======================================================
+// Колесо
+// ======================================================
+// Тик — time_us_64() / SCHED_TICK_US (младшие 32 бита, сравнение — разностью).
+// Слоты — списки индексов пула (голова и хвост: порядок вставки сохраняется).
+// Колесо и список готовых меняют будильник (в IRQ) и поток core1 (с запретом
+// IRQ); свободный список — только поток core1.
+#define TICK_SHIFT  __builtin_ctz(SCHED_TICK_US)
+#define L0_SLOTS    (1u << SCHED_L0_BITS)
+#define L1_SLOTS    (1u << SCHED_L1_BITS)
+#define L2_SLOTS    (1u << SCHED_L2_BITS)
+#define L0_MASK     (L0_SLOTS - 1)
+#define L1_SHIFT    SCHED_L0_BITS
+#define L2_SHIFT    (SCHED_L0_BITS + SCHED_L1_BITS)
+#define NIL         0xFFFF
+
+static_assert((SCHED_TICK_US & (SCHED_TICK_US - 1)) == 0, "SCHED_TICK_US — степень двойки");
+static_assert(SCHED_EVENTS < NIL, "индекс пула — uint16");
+
+// 12 байт
+struct SchedEvent {
+  MidiWord w;
+  uint32_t tick;     // тик отправки
+  uint16_t dest;      // 0 — свободно или снято сбросом
+  uint16_t next;
+};
+
+struct Slot {
+  uint16_t head = NIL;
+  uint16_t tail = NIL;
+};
+
+static SchedEvent pool[SCHED_EVENTS];
+static uint16_t freeHead = NIL;
+static uint16_t freeCount = 0;
+
+static Slot l0[L0_SLOTS];
+static Slot l1[L1_SLOTS];
+static Slot l2[L2_SLOTS];
+static uint32_t l0Bits[L0_SLOTS / 32];   // занятые слоты L0
+static Slot ready;
+static volatile bool hasReady = false;   // единственное, что читает пустой проход
+
+static uint32_t wheelNow = 0;    // последний обработанный тик
+static uint16_t onWheel = 0;     // событий в слотах (без готовых)
+static uint32_t armedTick = 0;
+static bool armed = false;
+static int alarmNum = -1;
+
+// --- Статистика (пишет core1) ---
+static uint16_t peak = 0;
+static uint32_t scheduled = 0;
+static uint32_t dispatched = 0;
+static uint32_t dropped = 0;
+static uint32_t cancelled = 0;
+static StatsHist late;
+
+// --- Выходы: задержка устройства, компенсация, эхо ---
+struct SchedPort {
+  uint32_t latency;
+  uint32_t delay;
+  uint16_t echoMs;
+  uint8_t echoRepeats;
+  uint8_t echoFeedback = 100;
+};
+static SchedPort ports[DEST_COUNT];
+static uint32_t echoHeld[DEST_COUNT][16][4];   // NoteOn с эхом, ждёт NoteOff (3 КБ)
+static uint16_t echoOwed = 0;                   // мест пула под будущие повторы NoteOff
+static uint16_t delayMask = 0;
+static uint16_t echoMask = 0;
+uint16_t schedMask = 0;
+
+// Команды core0 → core1
+enum SchedOp : uint8_t { OP_LATENCY, OP_ECHO, OP_RESET };
+struct SchedCmd {
+  uint8_t op;
+  uint8_t repeats;
+  uint8_t feedback;
+  uint16_t dest;
+  uint32_t v;
+};
+static SpscQueue<SchedCmd, 16> cmdQueue;
+
+static inline uint32_t tick_now() {
+  return (uint32_t)(time_us_64() >> TICK_SHIFT);
+}
+
+static inline void slot_append(Slot &s, uint16_t i) {
+  pool[i].next = NIL;
+  if (s.head == NIL) s.head = i;
+  else pool[s.tail].next = i;
+  s.tail = i;
+}
+
+// Разложить событие по уровням относительно тика base (base — уже наступил)
+static void wheel_put(uint16_t i, uint32_t base) {
+  uint32_t t = pool[i].tick;
+  if ((int32_t)(t - base) <= 0) {
+    slot_append(ready, i);
+    hasReady = true;
+    return;
+  }
+  if (t - base < L0_SLOTS) {
+    uint32_t s = t & L0_MASK;
+    slot_append(l0[s], i);
+    l0Bits[s >> 5] |= 1u << (s & 31);
+  } else if ((t >> L1_SHIFT) - (base >> L1_SHIFT) < L1_SLOTS) {
+    slot_append(l1[(t >> L1_SHIFT) & (L1_SLOTS - 1)], i);
+  } else {
+    slot_append(l2[(t >> L2_SHIFT) & (L2_SLOTS - 1)], i);
+  }
+  onWheel++;
+}
+
+// Слот верхнего уровня → вниз (на границе его блока)
+static void wheel_cascade(Slot &s, uint32_t base) {
+  uint16_t i = s.head;
+  s = Slot{};
+  while (i != NIL) {
+    uint16_t next = pool[i].next;
+    onWheel--;
+    wheel_put(i, base);
+    i = next;
+  }
+}
+
+// Первый занятый слот L0 в [s0, s1] (внутри одного блока), иначе -1
+static int l0_find(uint32_t s0, uint32_t s1) {
+  for (uint32_t w = s0 >> 5; w <= s1 >> 5; w++) {
+    uint32_t bits = l0Bits[w];
+    if (w == s0 >> 5) bits &= ~0u << (s0 & 31);
+    if (w == s1 >> 5 && (s1 & 31) != 31) bits &= (2u << (s1 & 31)) - 1;
+    if (bits) return (int)((w << 5) + __builtin_ctz(bits));
+  }
+  return -1;
+}
+
+// Наступивший слот L0 → в готовые целиком
+static void wheel_expire(uint32_t s) {
+  Slot &sl = l0[s];
+  for (uint16_t i = sl.head; i != NIL; i = pool[i].next) onWheel--;
+  if (ready.head == NIL) ready.head = sl.head;
+  else pool[ready.tail].next = sl.head;
+  ready.tail = sl.tail;
+  sl = Slot{};
+  l0Bits[s >> 5] &= ~(1u << (s & 31));
+  hasReady = true;
+}
+
+// Обработать тики до to включительно; пустые слоты — через битовую карту
+static void wheel_advance(uint32_t to) {
+  while ((int32_t)(to - wheelNow) > 0) {
+    if (!onWheel) {
+      wheelNow = to;
+      return;
+    }
+    uint32_t t = wheelNow + 1;
+    if ((t & L0_MASK) == 0) {
+      if (((t >> L1_SHIFT) & (L1_SLOTS - 1)) == 0) wheel_cascade(l2[(t >> L2_SHIFT) & (L2_SLOTS - 1)], t);
+      wheel_cascade(l1[(t >> L1_SHIFT) & (L1_SLOTS - 1)], t);
+    }
+    uint32_t end = t | L0_MASK;
+    if ((int32_t)(end - to) > 0) end = to;
+    int s = l0_find(t & L0_MASK, end & L0_MASK);
+    if (s < 0) {
+      wheelNow = end;
+    } else {
+      wheel_expire((uint32_t)s);
+      wheelNow = (t & ~L0_MASK) | (uint32_t)s;
+    }
+  }
+}
+
+// Ближайший тик, где колесу есть дело: занятый слот L0 или граница блока
+static uint32_t wheel_next() {
+  uint32_t t = wheelNow + 1;
+  if ((t & L0_MASK) == 0) return t;
+  int s = l0_find(t & L0_MASK, L0_MASK);
+  return (s >= 0) ? (t & ~L0_MASK) | (uint32_t)s : (t | L0_MASK) + 1;
+}
+
+// Сдвинуть колесо к текущему времени и взвести будильник (IRQ запрещены или в IRQ)
+static void wheel_run() {
+  if (alarmNum < 0) return;
+  for (;;) {
+    uint64_t now = time_us_64() >> TICK_SHIFT;
+    wheel_advance((uint32_t)now);
+    if (!onWheel) {
+      hardware_alarm_cancel(alarmNum);
+      armed = false;
+      return;
+    }
+    armedTick = wheel_next();
+    armed = true;
+    uint64_t at = (now + (int32_t)(armedTick - (uint32_t)now)) << TICK_SHIFT;
+    if (!hardware_alarm_set_target(alarmNum, from_us_since_boot(at))) return;
+  }
+}
+
+static void sched_alarm(unsigned int) {
+  wheel_run();
+}
+
+void setup_scheduler() {
+  for (uint16_t i = 0; i < SCHED_EVENTS; i++) pool[i].next = (i + 1 < SCHED_EVENTS) ? i + 1 : NIL;
+  freeHead = 0;
+  freeCount = SCHED_EVENTS;
+  wheelNow = tick_now();
+  alarmNum = hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback(alarmNum, sched_alarm);
+  Serial.printf("[SCHED] Timer wheel ready (%u events, tick %u us)\n", SCHED_EVENTS, SCHED_TICK_US);
+}
+
+// ======================================================
+// Постановка (core1)
+// ======================================================
+static inline bool is_note_off(MidiWord w) {
+  uint8_t cin = midi_word_cin(w);
+  return cin == 0x8 || (cin == 0x9 && midi_word_data2(w) == 0);
+}
+
+// Поставить без проверки резерва (место в пуле проверено)
+static bool sched_put(uint32_t due, uint16_t dest, MidiWord w) {
+  if (!freeCount) {
+    dropped++;
+    return false;
+  }
+
+  uint64_t now = time_us_64();
+  int32_t ahead = (int32_t)(due - (uint32_t)now);
+  uint32_t tick = (ahead <= 0) ? (uint32_t)(now >> TICK_SHIFT)
+                               : (uint32_t)((now + (uint32_t)ahead + SCHED_TICK_US - 1) >> TICK_SHIFT);
+
+  uint32_t irq = save_and_disable_interrupts();
+  if (!onWheel) wheelNow = (uint32_t)(now >> TICK_SHIFT);
+  if ((tick >> L2_SHIFT) - (wheelNow >> L2_SHIFT) >= L2_SLOTS && (int32_t)(tick - wheelNow) > 0) {
+    restore_interrupts(irq);
+    dropped++;
+    return false;
+  }
+  uint16_t i = freeHead;
+  freeHead = pool[i].next;
+  freeCount--;
+  pool[i].w = w;
+  pool[i].tick = tick;
+  pool[i].dest = dest;
+  wheel_put(i, wheelNow);
+  if (onWheel && (!armed || (int32_t)(tick - armedTick) < 0)) wheel_run();
+  restore_interrupts(irq);
+
+  scheduled++;
+  uint16_t pending = SCHED_EVENTS - freeCount;
+  if (pending > peak) peak = pending;
+  return true;
+}
+
+bool sched_at(uint32_t due, uint16_t dest, MidiWord w) {
+  dest &= DEST_ALL;
+  if (!dest) return true;
+  if (freeCount <= (is_note_off(w) ? 0 : echoOwed + SCHED_RESERVE)) {
+    dropped++;
+    return false;
+  }
+  return sched_put(due, dest, w);
+}
+
+bool sched_after(uint32_t delayUs, uint16_t dest, MidiWord w) {
+  return sched_at(time_us_32() + delayUs, dest, w);
+}
+
+// Списки слотов не трогаем: IRQ их двигает, а dest и слово — только поток
+void sched_cancel_notes(uint16_t dest, uint16_t channels) {
+  dest &= DEST_ALL;
+  if (freeCount == SCHED_EVENTS || !dest) return;
+  for (SchedEvent &e : pool) {
+    if (!(e.dest & dest) || midi_word_cin(e.w) != 0x9 || is_note_off(e.w)) continue;
+    if (!((channels >> (midi_word_status(e.w) & 0x0F)) & 1)) continue;
+    cancelled += __builtin_popcount(e.dest & dest);
+    e.dest &= ~dest;
+  }
+}
+
+// ======================================================
+// Компенсация и эхо (из send_midi_mask)
+// ======================================================
+// Эхо парами: повторы NoteOn ставятся, только если в пуле есть место
+// и им, и будущим повторам NoteOff (echoOwed); NoteOff повторяется,
+// только если повторялся его NoteOn (бит echoHeld) — нота не зависнет
+static void echo(uint8_t sink, MidiWord w, uint32_t base) {
+  const SchedPort &p = ports[sink];
+  uint8_t ch = midi_word_status(w) & 0x0F;
+  uint8_t note = midi_word_data1(w) & 0x7F;
+  uint32_t &word = echoHeld[sink][ch][note >> 5];
+  uint32_t bit = 1u << (note & 31);
+  uint8_t n = p.echoRepeats;
+
+  bool on = !is_note_off(w);
+  if (!on) {
+    if (!(word & bit)) return;
+    word &= ~bit;
+    echoOwed -= (n < echoOwed) ? n : echoOwed;
+  } else {
+    if (word & bit) return;   // повтор ещё звучит — без нового эха
+    if (freeCount < echoOwed + 2u * n + SCHED_RESERVE) {
+      dropped += n;
+      return;
+    }
+    word |= bit;
+    echoOwed += n;
+  }
+
+  uint16_t vel = midi_word_data2(w);
+  for (uint8_t k = 1; k <= n; k++) {
+    if (on) {
+      vel = vel * p.echoFeedback / 100;
+      if (vel == 0) vel = 1;   // NoteOn с нулём — это NoteOff
+      w = (w & 0x00FFFFFF) | (MidiWord)vel << 24;
+    }
+    sched_put(base + (uint32_t)k * p.echoMs * 1000, 1u << sink, w);
+  }
+}
+
+// Эхо выхода перенастроили: звучащим повторам — по NoteOff после последнего
+static void echo_release(uint8_t sink) {
+  const SchedPort &p = ports[sink];
+  uint32_t at = time_us_32() + p.delay + (uint32_t)p.echoRepeats * p.echoMs * 1000 + SCHED_TICK_US;
+  for (uint8_t ch = 0; ch < 16; ch++)
+    for (uint8_t i = 0; i < 4; i++)
+      for (uint32_t m = echoHeld[sink][ch][i]; m; m &= m - 1) {
+        uint8_t note = (uint8_t)(i * 32 + __builtin_ctz(m));
+        sched_put(at, 1u << sink, midi_word_msg(USB_CABLE_ROUTER, 0x80 | ch, note, 0));
+        echoOwed -= (p.echoRepeats < echoOwed) ? p.echoRepeats : echoOwed;
+      }
+  memset(echoHeld[sink], 0, sizeof(echoHeld[sink]));
+}
+
+uint16_t sched_output(uint16_t dest, MidiWord w) {
+  uint32_t now = time_us_32();
+  uint16_t sendNow = dest & ~delayMask;
+
+  // выходы с одной задержкой — одно событие
+  for (uint16_t m = dest & delayMask; m;) {
+    uint32_t d = ports[__builtin_ctz(m)].delay;
+    uint16_t group = 0;
+    for (uint16_t k = m; k; k &= k - 1)
+      if (ports[__builtin_ctz(k)].delay == d) group |= k & -k;
+    if (sched_at(now + d, group, w)) {
+      for (uint16_t k = group; k; k &= k - 1) capture_sink(__builtin_ctz(k));
+    } else {
+      sendNow |= group;   // пул полон — лучше без компенсации, чем без сообщения
+    }
+    m &= ~group;
+  }
+
+  uint8_t cin = midi_word_cin(w);
+  if (cin == 0x8 || cin == 0x9)
+    for (uint16_t m = dest & echoMask; m; m &= m - 1) {
+      uint8_t s = __builtin_ctz(m);
+      echo(s, w, now + ports[s].delay);
+    }
+  return sendNow;
+}
+
+// ======================================================
+// Готовые → выходы; команды core0 (core1)
+// ======================================================
+static void update_delays() {
+  uint32_t slowest = 0;
+  for (const SchedPort &p : ports)
+    if (p.latency > slowest) slowest = p.latency;
+  delayMask = echoMask = 0;
+  for (uint8_t s = 0; s < DEST_COUNT; s++) {
+    SchedPort &p = ports[s];
+    p.delay = slowest - p.latency;
+    if (p.delay) delayMask |= 1u << s;
+    if (p.echoRepeats && p.echoMs) echoMask |= 1u << s;
+  }
+  schedMask = delayMask | echoMask;
+}
+
+static void apply(const SchedCmd &c) {
+  for (uint16_t m = c.dest & DEST_ALL; m; m &= m - 1) {
+    SchedPort &p = ports[__builtin_ctz(m)];
+    if (c.op == OP_LATENCY) {
+      p.latency = c.v;
+    } else if (c.op == OP_ECHO) {
+      echo_release(__builtin_ctz(m));
+      p.echoMs = (uint16_t)c.v;
+      p.echoRepeats = c.repeats;
+      p.echoFeedback = c.feedback;
+    }
+  }
+  if (c.op == OP_RESET) {
+    peak = SCHED_EVENTS - freeCount;
+    scheduled = dispatched = dropped = cancelled = 0;
+    late = StatsHist{};
+  }
+  update_delays();
+}
+
+void sched_task() {
+  SchedCmd c;
+  while (cmdQueue.pop(c)) apply(c);
+  if (!hasReady) return;
+
+  for (uint8_t n = 0; n < SCHED_DISPATCH_MAX; n++) {
+    uint32_t irq = save_and_disable_interrupts();
+    uint16_t i = ready.head;
+    if (i != NIL) {
+      ready.head = pool[i].next;
+      if (ready.head == NIL) {
+        ready.tail = NIL;
+        hasReady = false;
+      }
+    }
+    restore_interrupts(irq);
+    if (i == NIL) return;
+
+    SchedEvent &e = pool[i];
+    if (e.dest) {
+      uint32_t due = e.tick << TICK_SHIFT;
+      stats_hist_add(late, time_us_32() - due);
+      send_midi_now(e.dest, e.w, due);
+      dispatched++;
+    }
+
+    e.dest = 0;
+    e.next = freeHead;
+    freeHead = i;
+    freeCount++;
+  }
+}
+
+// ======================================================
+// core0
+// ======================================================
+bool sched_set_latency(uint16_t dest, uint32_t us) {
+  if (!(dest & DEST_ALL) || us > SCHED_LATENCY_MAX) return false;
+  return cmdQueue.push({OP_LATENCY, 0, 0, dest, us});
+}
+
+bool sched_set_echo(uint16_t dest, uint16_t ms, uint8_t repeats, uint8_t feedback) {
+  if (!(dest & DEST_ALL) || ms > SCHED_ECHO_MS_MAX || repeats > SCHED_ECHO_MAX || feedback > 100) return false;
+  return cmdQueue.push({OP_ECHO, repeats, feedback, dest, ms});
+}
+
+void sched_reset_stats() {
+  cmdQueue.push({OP_RESET, 0, 0, 0, 0});
+}
+
+void sched_get_stats(SchedStats &st) {
+  st.pending = SCHED_EVENTS - freeCount;
+  st.peak = peak;
+  st.scheduled = scheduled;
+  st.dispatched = dispatched;
+  st.dropped = dropped;
+  st.cancelled = cancelled;
+  st.late = late;
+}
+
+void sched_get_port(uint8_t sink, SchedPortStats &st) {
+  if (sink >= DEST_COUNT) return;
+  const SchedPort &p = ports[sink];
+  st.latency = p.latency;
+  st.delay = p.delay;
+  st.echoMs = p.echoMs;
+  st.echoRepeats = p.echoRepeats;
+  st.echoFeedback = p.echoFeedback;
+}
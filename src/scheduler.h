@@ -0,0 +1,110 @@
+#pragma once
+#include <stdint.h>
+#include "midi_word.h"
+#include "stats.h"
+
+// ======================================================
+// Планировщик выходов: отложенные события на колесе таймеров
+// ======================================================
+// Событие (слово MidiWord + маска выходов) ждёт своего времени на
+// иерархическом колесе: три уровня слотов по SCHED_TICK_US, 256×SCHED_TICK_US
+// и 64×256×SCHED_TICK_US. Вставка — в хвост списка слота, срабатывание —
+// весь слот разом; верхние уровни спускаются вниз на границе блока.
+// Вставка и срабатывание — O(1), память — пул SCHED_EVENTS событий, без кучи.
+//
+// Колесо двигает аппаратный будильник (IRQ на core1): наступившие события
+// переходят в список готовых. В выходы их отдаёт sched_task() в проходе
+// core1, не больше SCHED_DISPATCH_MAX за проход. Пока ничего не готово,
+// sched_task() — одна проверка.
+//
+// Время события округляется вверх до тика: раньше срока не уходит никогда,
+// позже — на тик плюс проход core1.
+//
+// Что планируется:
+//  - компенсация задержки по выходам (SET_LATENCY): у каждого выхода своя
+//    задержка отклика устройства, выходы быстрее самого медленного получают
+//    сообщения позже на разницу — звук у всех приходит одновременно
+//  - эхо по выходам (SET_ECHO): NoteOn/NoteOff повторяются через интервал
+//    с затуханием скорости; повторы NoteOn ставятся, только если в пуле
+//    есть место и для их NoteOff
+//  - отложенная отправка для прошивки (sched_after, тестовый аккорд)
+//
+// SysEx и часы (midi_clock) идут без компенсации: у часов свой будильник.
+
+#define SCHED_EVENTS        256    // событий в пуле
+#define SCHED_TICK_US       64     // тик колеса, мкс (степень двойки)
+#define SCHED_L0_BITS       8      // 256 тиков  = 16.4 мс
+#define SCHED_L1_BITS       6      // 64 блока   = 1.05 с
+#define SCHED_L2_BITS       6      // 64 × 1.05 с = 67 с — горизонт
+#define SCHED_DISPATCH_MAX  16     // событий в выходы за проход core1
+#define SCHED_RESERVE       32     // последние места пула — только NoteOff
+#define SCHED_LATENCY_MAX   100000 // задержка устройства, мкс
+#define SCHED_ECHO_MAX      8      // повторов эха
+#define SCHED_ECHO_MS_MAX   5000   // интервал эха, мс (8 × 5 с — внутри горизонта)
+
+/**
+ * @brief Инициализация (core1): будильник колеса, IRQ — на core1
+ */
+void setup_scheduler();
+
+/**
+ * @brief Отправить слово в выходы dest в момент due (core1)
+ *
+ * @param due время, мкс (как time_us_32); прошедшее — с ближайшим проходом
+ * @return false — пул полон (NoteOn и прочее — когда остался резерв
+ *         SCHED_RESERVE) или due дальше горизонта
+ */
+bool sched_at(uint32_t due, uint16_t dest, MidiWord w);
+bool sched_after(uint32_t delayUs, uint16_t dest, MidiWord w);
+
+/**
+ * @brief Снять ждущие NoteOn для выходов dest и каналов channels (core1)
+ *
+ * Сброс (notes_release) гасит то, что уже звучит; NoteOn, ждущий на
+ * колесе (компенсация, эхо), прозвучал бы после сброса и повис.
+ * Событие остаётся в слоте без этих выходов и уходит в пул в свой срок.
+ * Проход по пулу — только если на колесе что-то есть.
+ */
+void sched_cancel_notes(uint16_t dest, uint16_t channels = 0xFFFF);
+
+/**
+ * @brief Готовые события → выходы; команды core0 (core1, каждый проход)
+ */
+void sched_task();
+
+/**
+ * @brief Выходы с задержкой или эхом — этих send_midi_mask не шлёт сразу
+ */
+extern uint16_t schedMask;
+
+/**
+ * @brief Отложить сообщение для выходов из schedMask (из send_midi_mask)
+ * @return выходы dest, которым слать сейчас
+ */
+uint16_t sched_output(uint16_t dest, MidiWord w);
+
+// --- core0: настройки уходят в core1 очередью команд ---
+bool sched_set_latency(uint16_t dest, uint32_t us);
+bool sched_set_echo(uint16_t dest, uint16_t ms, uint8_t repeats, uint8_t feedback);
+void sched_reset_stats();
+
+struct SchedStats {
+  uint16_t pending;      // событий на колесе и в готовых
+  uint16_t peak;         // наибольшее pending
+  uint32_t scheduled;
+  uint32_t dispatched;
+  uint32_t dropped;      // пул полон или за горизонтом
+  uint32_t cancelled;    // NoteOn, снятых сбросом (по выходам)
+  StatsHist late;        // опоздание отправки против due, мкс
+};
+
+struct SchedPortStats {
+  uint32_t latency;      // задержка устройства, мкс
+  uint32_t delay;        // компенсация: сколько ждёт этот выход, мкс
+  uint16_t echoMs;
+  uint8_t echoRepeats;
+  uint8_t echoFeedback;  // % скорости на каждом повторе
+};
+
+void sched_get_stats(SchedStats &st);
+void sched_get_port(uint8_t sink, SchedPortStats &st);
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// ======================================================
+// Lock-free SPSC очередь (один писатель, один читатель)
+// ======================================================
+// Подходит для обмена между ядрами RP2040: писатель трогает только
+// head, читатель — только tail. Ни одна сторона не ждёт другую.
+
+template <typename T, size_t N>
+struct SpscQueue {
+  static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+  T buf[N];
+  std::atomic<uint32_t> head{0};   // пишет продюсер
+  std::atomic<uint32_t> tail{0};   // пишет потребитель
+
+  bool push(const T &v) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N) return false;
+    buf[h & (N - 1)] = v;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &out) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    out = buf[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+};
@@ -0,0 +1,31 @@
+#include "stats.h"
+#include <string.h>
+#include <atomic>
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+RouterStats routerStats;
+
+static uint32_t lastMark = 0;   // 0 — отметок ещё не было (или сброс)
+static std::atomic<bool> resetRequest{false};   // ставит core0, снимает core1
+
+void stats_loop_mark() {
+  if (resetRequest.exchange(false)) {
+    uint32_t irq = save_and_disable_interrupts();   // outIrq и fifoPeak пишут IRQ
+    memset(&routerStats, 0, sizeof(routerStats));
+    restore_interrupts(irq);
+    lastMark = 0;
+  }
+  uint32_t now = time_us_32();
+  if (lastMark) stats_hist_add(routerStats.loop, now - lastMark);
+  lastMark = now;
+}
+
+void stats_get(RouterStats &st) {
+  memcpy(&st, &routerStats, sizeof(st));
+  for (uint8_t i = 0; i < DEST_COUNT; i++) st.out[i] += st.outIrq[i];
+}
+
+void stats_reset() {
+  resetRequest.store(true);
+}
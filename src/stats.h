@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include "route_table.h"
+
+// ======================================================
+// Счётчики пропускной способности и гистограммы времени
+// ======================================================
+// Пишет только core1 (поток и его IRQ), core0 читает для STATS:
+// 32-битные чтения на M0+ атомарны, так что блокировки не нужны —
+// в худшем случае снимок чуть "размазан" во времени. Запись — это
+// инкремент и один clz, десяток-другой тактов.
+//
+// Инкремент на M0+ — чтение, сложение, запись: IRQ посреди него
+// потерял бы счёт потока. Поэтому у IRQ свои счётчики (outIrq),
+// stats_get() складывает их с потоковыми. Сброс с core0 тоже только
+// запрос — обнуляет core1 в начале прохода (stats_loop_mark).
+
+#define STATS_BUCKETS 16   // корзина 0 — 0 мкс, n — [2^(n-1), 2^n), 15 — от 16 мс
+
+enum StatsSource : uint8_t {
+  SRC_DIN = 0,   // события с DIN/TRS IN (после парсера)
+  SRC_USB,       // пакеты USB-MIDI от хоста (все кабели)
+  SRC_KEYS,      // нажатия/отпускания клавиатуры
+  SRC_COUNT
+};
+
+struct StatsHist {
+  uint32_t count;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t bucket[STATS_BUCKETS];
+};
+
+static inline void stats_hist_add(StatsHist &h, uint32_t us) {
+  uint32_t b = us ? 32 - __builtin_clz(us) : 0;
+  h.bucket[b < STATS_BUCKETS ? b : STATS_BUCKETS - 1]++;
+  h.count++;
+  h.sum += us;
+  if (us > h.max) h.max = us;
+}
+
+struct RouterStats {
+  uint32_t in[SRC_COUNT];       // событий на входе по источникам
+  uint32_t out[DEST_COUNT];     // сообщений отдано выходу (индекс = бит DEST_*)
+  uint32_t outIrq[DEST_COUNT];  // из них — из IRQ core1 (часы); stats_get() уже сложил
+  StatsHist loop;               // длительность прохода loop1, мкс
+  uint8_t fifoPeak[10];         // наибольшая глубина TX FIFO (столбцов) при записи в TRS A–J
+};
+
+extern RouterStats routerStats;
+
+static inline void stats_in(uint8_t src) {
+  routerStats.in[src]++;
+}
+
+static inline void stats_out(uint8_t sink) {
+  routerStats.out[sink]++;
+}
+
+// то же из IRQ (будильник часов) — свой счётчик, поток его не пишет
+static inline void stats_out_irq(uint8_t sink) {
+  routerStats.outIrq[sink]++;
+}
+
+static inline void stats_fifo(uint8_t port, uint8_t level) {
+  if (level > routerStats.fifoPeak[port]) routerStats.fifoPeak[port] = level;
+}
+
+/**
+ * @brief Отметить начало прохода loop1 (core1): время с прошлой отметки
+ */
+void stats_loop_mark();
+
+void stats_get(RouterStats &st);
+
+/**
+ * @brief Запросить сброс (core0): обнулит core1 в следующем stats_loop_mark()
+ */
+void stats_reset();
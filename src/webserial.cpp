@@ -1,65 +1,573 @@
 #include "webserial.h"
 #include "config_manager.h"
+#include "midi_output.h"
+#include "midi_queue.h"
+#include "midi_input.h"
+#include "preset_store.h"
+#include "ch376s.h"
+#include "stats.h"
+#include "bench.h"
+#include "capture.h"
+#include "midi_clock.h"
+#include "scheduler.h"
+#include "note_state.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <string.h>
+#include <stdlib.h>
 
-String inputBuffer;
+// Команды короткие; JSON-нагрузка SAVE_CONFIG читается прямо из
+// потока в арену config_manager, минуя этот буфер
+#define CMD_BUFFER_SIZE 96
+
+static char inputBuffer[CMD_BUFFER_SIZE];
+static size_t inputLen = 0;
+static bool skipLine = false;   // дочитать хвост строки после JSON
+
+static bool starts_with(const char *s, const char *prefix) {
+  return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+static bool ends_with(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// последнее слово команды как число ("LOAD_PRESET 2" → 2)
+static int last_arg_int(const char *cmd) {
+  const char *sp = strrchr(cmd, ' ');
+  return sp ? atoi(sp + 1) : 0;
+}
 
 void setup_webserial() {
   Serial.println("[WebSerial] Ready");
 }
 
+// --- SAVE_CONFIG {json}: разбор прямо из Serial ---
+static void save_config_from_stream() {
+  DeserializationError err = config_import(Serial);
+  if (!err) {
+    compile_routes();
+    save_current();
+    Serial.println("{\"ok\":\"config_saved\"}");
+  } else {
+    Serial.printf("{\"error\":\"JSON parse fail: %s\"}\n", err.c_str());
+  }
+}
+
 void webserial_task() {
   while (Serial.available()) {
     char c = Serial.read();
     if (c == '\n' || c == '\r') {
-      if (inputBuffer.length() > 0) {
+      skipLine = false;
+      if (inputLen > 0) {
+        inputBuffer[inputLen] = '\0';
         process_web_command(inputBuffer);
-        inputBuffer = "";
+        inputLen = 0;
       }
-    } else {
-      inputBuffer += c;
+    } else if (skipLine) {
+      continue;
+    } else if (c == ' ' && inputLen == 11 && strncmp(inputBuffer, "SAVE_CONFIG", 11) == 0) {
+      inputLen = 0;
+      skipLine = true;
+      save_config_from_stream();
+    } else if (inputLen < CMD_BUFFER_SIZE - 1) {
+      inputBuffer[inputLen++] = c;
     }
   }
 }
 
 void send_json_config() {
-  String json;
-  serializeJson(configDoc, json);
-  Serial.println(json);
+  config_export(Serial);
+  Serial.println();
 }
 
-void process_web_command(String cmd) {
-  cmd.trim();
-  if (cmd.startsWith("GET_CONFIG")) {
-    send_json_config();
+// --- Память: куча и арена JSON ---
+void send_mem_stats() {
+  ConfigMemStats m;
+  config_get_mem(m);
+  Serial.printf("{\"heap_used\":%u,\"heap_peak\":%u,\"heap_total\":%u,"
+                "\"arena_peak\":%u,\"arena_size\":%u}\n",
+                (unsigned)m.heapUsed, (unsigned)m.heapPeak, (unsigned)m.heapTotal,
+                (unsigned)m.arenaPeak, (unsigned)m.arenaSize);
+}
+
+// --- Статистика очередей TRS портов ---
+void send_queue_stats() {
+  Serial.print("{\"queues\":[");
+  for (uint8_t i = 0; i < 10; i++) {
+    MidiQueueStats st;
+    midi_out_get_queue_stats(i, st);
+    Serial.printf("%s{\"port\":\"%c\",\"depth\":%u,\"hwm\":%u,\"drops\":%lu,\"coalesced\":%lu,\"policy\":%u,"
+                  "\"encoding\":%u,\"wire_bytes\":%lu,\"saved_bytes\":%lu}",
+                  i ? "," : "", 'A' + i, st.depth, st.highWater,
+                  (unsigned long)st.drops, (unsigned long)st.coalesced, st.policy,
+                  st.encoding, (unsigned long)st.wireBytes, (unsigned long)st.savedBytes);
   }
-  else if (cmd.startsWith("SAVE_CONFIG")) {
-    int space = cmd.indexOf(' ');
-    if (space > 0) {
-      String json = cmd.substring(space + 1);
-      DynamicJsonDocument doc(8192);
-      DeserializationError err = deserializeJson(doc, json);
-      if (!err) {
-        configDoc = doc;
-        save_current();
-        Serial.println("{\"ok\":\"config_saved\"}");
-      } else {
-        Serial.printf("{\"error\":\"JSON parse fail: %s\"}\n", err.c_str());
-      }
+  Serial.println("]}");
+}
+
+// --- Приём MIDI IN и задержка по выходам ---
+void send_midi_stats() {
+  MidiInStats in;
+  midi_in_get_stats(in);
+
+  Serial.printf("{\"rx\":{\"bytes\":%lu,\"ring_overruns\":%lu,\"uart_overruns\":%lu,"
+                "\"framing\":%lu,\"breaks\":%lu,\"ring_peak\":%u,\"usb_packets\":%lu,\"usb_stalls\":%lu},"
+                "\"latency_us\":[",
+                (unsigned long)in.bytes, (unsigned long)in.ringOverruns,
+                (unsigned long)in.uartOverruns, (unsigned long)in.framingErrors,
+                (unsigned long)in.breaks, in.ringPeak,
+                (unsigned long)in.usbPackets, (unsigned long)in.usbStalls);
+
+  for (uint8_t i = 0; i < DEST_COUNT; i++) {
+    LatencyStats l;
+    midi_out_get_latency(i, l);
+    Serial.printf("%s{\"out\":\"%s\",\"n\":%lu,\"last\":%lu,\"max\":%lu,\"avg\":%lu}",
+                  i ? "," : "", route_sink_name(i), (unsigned long)l.count, (unsigned long)l.last,
+                  (unsigned long)l.max, (unsigned long)(l.count ? l.sum / l.count : 0));
+  }
+
+  // пакеты USB на пачку: до батчинга было ровно 1
+  UsbOutStats u;
+  midi_out_get_usb_stats(u);
+  Serial.printf("],\"usb\":{\"packets\":%lu,\"flushes\":%lu,\"per_flush_x100\":%lu,\"max_batch\":%lu,"
+                "\"full_flushes\":%lu,\"drops\":%lu,\"pending\":%u,\"mode\":\"%s\"}}\n",
+                (unsigned long)u.packets, (unsigned long)u.flushes,
+                (unsigned long)(u.flushes ? u.packets * 100 / u.flushes : 0),
+                (unsigned long)u.maxBatch, (unsigned long)u.fullFlushes, (unsigned long)u.drops,
+                u.pending, u.mode == USB_FLUSH_FRAME ? "frame" : "pass");
+}
+
+// --- Сводка для живого просмотра: один компактный JSON ---
+// in — по источникам (din, usb, keys), out/lat/drops — по выходам
+// (индекс = бит DEST_*), h — гистограмма мкс по степеням двойки
+static void print_hist(const StatsHist &h) {
+  Serial.printf("{\"n\":%lu,\"max\":%lu,\"avg\":%lu,\"h\":[",
+                (unsigned long)h.count, (unsigned long)h.max,
+                (unsigned long)(h.count ? h.sum / h.count : 0));
+  for (uint8_t i = 0; i < STATS_BUCKETS; i++)
+    Serial.printf("%s%lu", i ? "," : "", (unsigned long)h.bucket[i]);
+  Serial.print("]}");
+}
+
+void send_stats() {
+  RouterStats st;
+  stats_get(st);
+  MidiInStats in;
+  midi_in_get_stats(in);
+  Ch376Stats hid;
+  ch376s_get_stats(hid);
+
+  Serial.printf("{\"stats\":{\"uptime_ms\":%lu,\"in\":[%lu,%lu,%lu],\"out\":[",
+                (unsigned long)millis(), (unsigned long)st.in[SRC_DIN],
+                (unsigned long)st.in[SRC_USB], (unsigned long)st.in[SRC_KEYS]);
+  for (uint8_t i = 0; i < DEST_COUNT; i++)
+    Serial.printf("%s%lu", i ? "," : "", (unsigned long)st.out[i]);
+
+  Serial.printf("],\"rx\":{\"ring\":%lu,\"uart\":%lu,\"framing\":%lu,\"usb_stalls\":%lu,"
+                "\"hid\":%lu},\"drops\":[",
+                (unsigned long)in.ringOverruns, (unsigned long)in.uartOverruns,
+                (unsigned long)in.framingErrors, (unsigned long)in.usbStalls,
+                (unsigned long)hid.dropped);
+  for (uint8_t i = 0; i < DEST_COUNT; i++)
+    Serial.printf("%s%lu", i ? "," : "", (unsigned long)midi_out_get_drops(i));
+
+  Serial.print("],\"fifo\":[");
+  for (uint8_t i = 0; i < 10; i++)
+    Serial.printf("%s%u", i ? "," : "", st.fifoPeak[i]);
+
+  Serial.print("],\"loop\":");
+  print_hist(st.loop);
+  Serial.print(",\"lat\":[");
+  for (uint8_t i = 0; i < DEST_COUNT; i++) {
+    LatencyStats l;
+    midi_out_get_latency(i, l);
+    if (i) Serial.print(",");
+    print_hist(l);
+  }
+  Serial.println("]}}");
+}
+
+// --- RESET: сброс применяет core1; очередь команд полна — не сброшено ---
+static void send_reset_busy() {
+  Serial.println("{\"error\":\"reset_busy\"}");
+}
+
+// --- Запись событий: кольцо, лог, повтор ---
+static void send_capture_state() {
+  CaptureStats c;
+  capture_get_stats(c);
+  Serial.printf("{\"capture\":{\"recorded\":%lu,\"logged\":%lu,\"lost\":%lu,\"segment\":%u,"
+                "\"frozen\":%s,\"streaming\":%s,\"replaying\":%s}}\n",
+                (unsigned long)c.recorded, (unsigned long)c.logged, (unsigned long)c.lost, c.segment,
+                c.frozen ? "true" : "false", c.streaming ? "true" : "false",
+                c.replaying ? "true" : "false");
+}
+
+// --- MIDI Clock: режим, темп, делители и джиттер по выходам ---
+static void send_clock_state() {
+  ClockStats c;
+  midi_clock_get_stats(c);
+  Serial.printf("{\"clock\":{\"mode\":\"%s\",\"running\":%s,\"bpm_x10\":%u,\"period_us\":%lu,"
+                "\"in_ticks\":%lu,\"out_ticks\":%lu,\"in_jitter\":",
+                midi_clock_mode_name(c.mode), c.running ? "true" : "false", c.bpm10,
+                (unsigned long)c.periodUs, (unsigned long)c.inTicks, (unsigned long)c.outTicks);
+  print_hist(c.inJitter);
+  Serial.print(",\"ports\":[");
+  for (uint8_t i = 0; i < DEST_COUNT; i++) {
+    ClockPortStats p;
+    midi_clock_get_port(i, p);
+    Serial.printf("%s{\"out\":\"%s\",\"div\":%u,\"mul\":%u,\"ticks\":%lu,\"jitter\":",
+                  i ? "," : "", route_sink_name(i), p.div, p.mul, (unsigned long)p.ticks);
+    print_hist(p.jitter);
+    Serial.print("}");
+  }
+  Serial.println("]}}");
+}
+
+// --- Планировщик: колесо, компенсация и эхо по выходам ---
+static void send_sched_state() {
+  SchedStats st;
+  sched_get_stats(st);
+  Serial.printf("{\"sched\":{\"pending\":%u,\"peak\":%u,\"scheduled\":%lu,\"dispatched\":%lu,"
+                "\"dropped\":%lu,\"cancelled\":%lu,\"late\":",
+                st.pending, st.peak, (unsigned long)st.scheduled, (unsigned long)st.dispatched,
+                (unsigned long)st.dropped, (unsigned long)st.cancelled);
+  print_hist(st.late);
+  Serial.print(",\"ports\":[");
+  for (uint8_t i = 0; i < DEST_COUNT; i++) {
+    SchedPortStats p;
+    sched_get_port(i, p);
+    Serial.printf("%s{\"out\":\"%s\",\"latency_us\":%lu,\"delay_us\":%lu,\"echo\":[%u,%u,%u]}",
+                  i ? "," : "", route_sink_name(i), (unsigned long)p.latency, (unsigned long)p.delay,
+                  p.echoMs, p.echoRepeats, p.echoFeedback);
+  }
+  Serial.println("]}}");
+}
+
+// --- Звучащие ноты по выходам ---
+static void send_notes_state() {
+  NotesStats st;
+  notes_get_stats(st);
+  Serial.printf("{\"notes\":{\"sounding\":%u,\"releasing\":%u,\"releases\":%lu,\"note_offs\":%lu,"
+                "\"ports\":[",
+                st.sounding, st.releasing, (unsigned long)st.releases, (unsigned long)st.noteOffs);
+  for (uint8_t i = 0; i < DEST_COUNT; i++) {
+    NotesPortStats p;
+    notes_get_port(i, p);
+    Serial.printf("%s{\"out\":\"%s\",\"sounding\":%u,\"channels\":%u}",
+                  i ? "," : "", route_sink_name(i), p.sounding, p.channels);
+  }
+  Serial.println("]}}");
+}
+
+// --- MIDI Thru: вкл/выкл и матрицы входов ---
+// "matrix": по входу 16 строк (каналы 1–16) по 8 ячеек (типы THRU_*),
+// ячейка — число: биты 0–11 маска выходов, 12–15 выходной канал
+
+void send_thru_state() {
+  const RouteTable *rt = routes_in_use();
+  Serial.printf("{\"thru_on\":%s,\"rules\":%u,\"matrix\":{",
+                midi_in_get_thru() ? "true" : "false", config.thruCount);
+  for (uint8_t in = 0; in < THRU_INPUTS; in++) {
+    Serial.printf("%s\"%s\":[", in ? "," : "", route_thru_input_name(in));
+    for (uint8_t ch = 0; ch < 16; ch++) {
+      Serial.print(ch ? ",[" : "[");
+      for (uint8_t t = 0; t < THRU_TYPES; t++)
+        Serial.printf("%s%u", t ? "," : "", rt->thru[in][ch][t]);
+      Serial.print("]");
     }
+    Serial.print("]");
+  }
+  Serial.println("}}");
+}
+
+// --- Клавиатура CH376S ---
+void send_hid_stats() {
+  Ch376Stats st;
+  ch376s_get_stats(st);
+  Serial.printf("{\"attached\":%s,\"nkro\":%s,\"boot\":%s,\"reports\":%lu,\"events\":%lu,\"dropped\":%lu,"
+                "\"rollover\":%lu,\"errors\":%lu,\"panics\":%lu,\"connects\":%lu,\"polled\":%lu}\n",
+                st.attached ? "true" : "false", st.nkro ? "true" : "false", st.boot ? "true" : "false",
+                (unsigned long)st.reports, (unsigned long)st.events, (unsigned long)st.dropped,
+                (unsigned long)st.rollover, (unsigned long)st.errors, (unsigned long)st.panics,
+                (unsigned long)st.connects, (unsigned long)st.polled);
+}
+
+// --- Бинарный образ пресета в hex (для tools/preset_tool.py) ---
+void send_preset_dump(int id) {
+  const PresetImage *img = preset_store_get(id);
+  if (!img) {
+    Serial.printf("{\"error\":\"preset_missing\",\"id\":%d}\n", id);
+    return;
   }
-  else if (cmd.startsWith("SAVE_PRESET")) {
-    int id = cmd.substring(cmd.lastIndexOf(' ')+1).toInt();
-    save_preset(id);
-    Serial.printf("{\"ok\":\"preset_saved_%d\"}\n", id);
+  Serial.printf("{\"preset\":%d,\"hex\":\"", id);
+  const uint8_t *p = (const uint8_t *)img;
+  for (size_t i = 0; i < sizeof(PresetImage); i++)
+    Serial.printf("%02x", p[i]);
+  Serial.println("\"}");
+}
+
+// --- Занятые слоты пресетов ---
+void send_preset_list() {
+  Serial.printf("{\"max\":%u,\"control_ch\":%u,\"presets\":[", MAX_PRESETS, preset_get_control_channel());
+  bool first = true;
+  for (uint16_t id = 1; id <= MAX_PRESETS; id++) {
+    const PresetImage *img = preset_store_get(id);
+    if (!img) continue;
+    Serial.printf("%s{\"id\":%u,\"name\":\"%.15s\"}", first ? "" : ",", id, img->hdr.name);
+    first = false;
   }
-  else if (cmd.startsWith("LOAD_PRESET")) {
-    int id = cmd.substring(cmd.lastIndexOf(' ')+1).toInt();
-    load_preset(id);
+  Serial.println("]}");
+}
+
+// --- Вызовы пресетов по MIDI ---
+void send_preset_stats() {
+  PresetRecallStats st;
+  preset_get_recall_stats(st);
+  Serial.printf("{\"recalls\":%lu,\"misses\":%lu,\"last_id\":%u,\"last_us\":%lu,\"max_us\":%lu}\n",
+                (unsigned long)st.count, (unsigned long)st.misses, st.lastId,
+                (unsigned long)st.lastUs, (unsigned long)st.maxUs);
+}
+
+void process_web_command(char *cmd) {
+  // trim
+  while (*cmd == ' ') cmd++;
+  size_t n = strlen(cmd);
+  while (n && cmd[n - 1] == ' ') cmd[--n] = '\0';
+
+  if (starts_with(cmd, "GET_CONFIG")) {
     send_json_config();
   }
+  else if (starts_with(cmd, "SAVE_CONFIG")) {
+    // SAVE_CONFIG без JSON — нагрузка приходит через save_config_from_stream()
+    Serial.println("{\"error\":\"usage: SAVE_CONFIG {json}\"}");
+  }
+  else if (starts_with(cmd, "SAVE_PRESET")) {
+    int id = last_arg_int(cmd);
+    if (save_preset(id)) Serial.printf("{\"ok\":\"preset_saved_%d\"}\n", id);
+    else Serial.printf("{\"error\":\"preset_save_failed\",\"id\":%d}\n", id);
+  }
+  else if (starts_with(cmd, "LOAD_PRESET")) {
+    int id = last_arg_int(cmd);
+    if (load_preset(id)) send_json_config();
+    else Serial.printf("{\"error\":\"preset_missing\",\"id\":%d}\n", id);
+  }
+  else if (starts_with(cmd, "LIST_PRESETS")) {
+    send_preset_list();
+  }
+  else if (starts_with(cmd, "PRESET_STATS")) {
+    send_preset_stats();
+  }
+  else if (starts_with(cmd, "SET_CONTROL_CH")) {
+    preset_set_control_channel((uint8_t)last_arg_int(cmd));
+    Serial.printf("{\"ok\":\"control_ch_set\",\"ch\":%u}\n", preset_get_control_channel());
+  }
+  else if (starts_with(cmd, "SET_THRU")) {
+    // SET_THRU <ON|OFF>; правила — ключ "thru" в SAVE_CONFIG
+    if (ends_with(cmd, " ON") || ends_with(cmd, " OFF")) {
+      midi_in_set_thru(ends_with(cmd, " ON"));
+      send_thru_state();
+    } else {
+      Serial.println("{\"error\":\"usage: SET_THRU <ON|OFF>\"}");
+    }
+  }
+  else if (starts_with(cmd, "GET_THRU")) {
+    send_thru_state();
+  }
+  else if (starts_with(cmd, "DUMP_PRESET")) {
+    send_preset_dump(last_arg_int(cmd));
+  }
+  else if (starts_with(cmd, "HID_STATS")) {
+    send_hid_stats();
+  }
+  else if (starts_with(cmd, "MEM")) {
+    send_mem_stats();
+  }
+  else if (starts_with(cmd, "QUEUE_STATS")) {
+    send_queue_stats();
+    if (ends_with(cmd, "RESET") && !midi_out_reset_queue_stats()) send_reset_busy();
+  }
+  else if (starts_with(cmd, "MIDI_STATS")) {
+    send_midi_stats();
+    if (ends_with(cmd, "RESET")) {
+      midi_in_reset_stats();
+      bool ok = midi_out_reset_latency();
+      if (!(midi_out_reset_usb_stats() && ok)) send_reset_busy();
+    }
+  }
+  else if (starts_with(cmd, "STATS")) {
+    // STATS [RESET] — сводка для живого просмотра в веб-интерфейсе
+    send_stats();
+    if (ends_with(cmd, "RESET")) {
+      stats_reset();
+      midi_in_reset_stats();
+      bool ok = midi_out_reset_latency();
+      ok = midi_out_reset_queue_stats() && ok;
+      if (!(midi_out_reset_usb_stats() && ok)) send_reset_busy();
+    }
+  }
+  else if (starts_with(cmd, "CAPTURE")) {
+    // CAPTURE [FREEZE|RESUME|CLEAR|DUMP|STREAM <ON|OFF>|REPLAY [LOG] [FAST]]
+    bool ok = true;
+    if (strstr(cmd, " REPLAY"))
+      ok = capture_replay(strstr(cmd, " LOG") != nullptr, strstr(cmd, " FAST") != nullptr);
+    else if (ends_with(cmd, " FREEZE")) capture_freeze(true);
+    else if (ends_with(cmd, " RESUME")) capture_freeze(false);
+    else if (ends_with(cmd, " CLEAR")) capture_clear();
+    else if (ends_with(cmd, " STREAM ON")) ok = capture_stream(true);
+    else if (ends_with(cmd, " STREAM OFF")) capture_stream(false);
+
+    if (ends_with(cmd, " DUMP")) capture_dump(Serial);
+    else if (ok) send_capture_state();
+    else Serial.println("{\"error\":\"capture_busy_or_no_log\"}");
+  }
+  else if (strcmp(cmd, "CLOCK") == 0) {
+    send_clock_state();
+  }
+  else if (starts_with(cmd, "CLOCK ")) {
+    // CLOCK MODE <thru|pll|internal> | BPM <темп> | START | STOP | CONTINUE |
+    //       DIV <USB|DIN|A–J|ALL> <div> [mul] | RESET
+    // применяет core1 — состояние отдельным запросом CLOCK
+    char arg[12] = "";
+    unsigned div = 0, mul = 1;
+    bool ok = true;
+    if (sscanf(cmd, "CLOCK MODE %11s", arg) == 1) {
+      int m = (strcmp(arg, "thru") == 0)     ? CLOCK_THRU
+            : (strcmp(arg, "pll") == 0)      ? CLOCK_PLL
+            : (strcmp(arg, "internal") == 0) ? CLOCK_INTERNAL
+            : -1;
+      ok = m >= 0 && midi_clock_set_mode((uint8_t)m);
+    } else if (starts_with(cmd, "CLOCK BPM ")) {
+      ok = midi_clock_set_bpm((uint16_t)(atof(cmd + 10) * 10 + 0.5));
+    } else if (sscanf(cmd, "CLOCK DIV %3s %u %u", arg, &div, &mul) >= 2) {
+      uint16_t dest = (strcmp(arg, "ALL") == 0) ? (uint16_t)DEST_ALL : route_port_mask(arg);
+      ok = div <= 0xFF && mul <= 0xFF && midi_clock_set_ratio(dest, (uint8_t)div, (uint8_t)mul);
+    } else if (strcmp(cmd, "CLOCK START") == 0) {
+      ok = midi_clock_transport(0xFA);
+    } else if (strcmp(cmd, "CLOCK STOP") == 0) {
+      ok = midi_clock_transport(0xFC);
+    } else if (strcmp(cmd, "CLOCK CONTINUE") == 0) {
+      ok = midi_clock_transport(0xFB);
+    } else if (strcmp(cmd, "CLOCK RESET") == 0) {
+      midi_clock_reset_stats();
+    } else {
+      ok = false;
+    }
+
+    if (ok) Serial.println("{\"ok\":\"clock_set\"}");
+    else Serial.println("{\"error\":\"usage: CLOCK [MODE thru|pll|internal|BPM <20-300>|START|STOP|CONTINUE|"
+                        "DIV <USB|DIN|A-J|ALL> <div> [mul]|RESET]\"}");
+  }
+  else if (starts_with(cmd, "SCHED")) {
+    // SCHED [RESET]
+    send_sched_state();
+    if (ends_with(cmd, " RESET")) sched_reset_stats();
+  }
+  else if (starts_with(cmd, "SET_LATENCY")) {
+    // SET_LATENCY <USB|DIN|A–J|ALL> <мкс> — задержка отклика устройства на выходе
+    char port[4] = "";
+    unsigned long us = 0;
+    uint16_t dest = 0;
+    if (sscanf(cmd, "SET_LATENCY %3s %lu", port, &us) == 2)
+      dest = (strcmp(port, "ALL") == 0) ? (uint16_t)DEST_ALL : route_port_mask(port);
+    if (dest && sched_set_latency(dest, (uint32_t)us))
+      Serial.printf("{\"ok\":\"latency_set\",\"latency_us\":%lu}\n", us);
+    else
+      Serial.println("{\"error\":\"usage: SET_LATENCY <USB|DIN|A-J|ALL> <0-100000 us>\"}");
+  }
+  else if (starts_with(cmd, "SET_ECHO")) {
+    // SET_ECHO <USB|DIN|A–J|ALL> <мс> <повторов> [% скорости] — 0 повторов: выкл
+    char port[4] = "";
+    unsigned ms = 0, repeats = 0, feedback = 100;
+    uint16_t dest = 0;
+    if (sscanf(cmd, "SET_ECHO %3s %u %u %u", port, &ms, &repeats, &feedback) >= 3)
+      dest = (strcmp(port, "ALL") == 0) ? (uint16_t)DEST_ALL : route_port_mask(port);
+    if (dest && ms <= 0xFFFF && repeats <= 0xFF && feedback <= 0xFF &&
+        sched_set_echo(dest, (uint16_t)ms, (uint8_t)repeats, (uint8_t)feedback))
+      Serial.println("{\"ok\":\"echo_set\"}");
+    else
+      Serial.println("{\"error\":\"usage: SET_ECHO <USB|DIN|A-J|ALL> <1-5000 ms> <0-8 repeats> [feedback %]\"}");
+  }
+  else if (starts_with(cmd, "NOTES")) {
+    send_notes_state();
+  }
+  else if (starts_with(cmd, "PANIC")) {
+    // PANIC [USB|DIN|A–J|ALL] — NoteOff только звучащим нотам
+    char port[4] = "ALL";
+    sscanf(cmd, "PANIC %3s", port);
+    uint16_t dest = (strcmp(port, "ALL") == 0) ? (uint16_t)DEST_ALL : route_port_mask(port);
+    if (dest && notes_post_release(dest))
+      Serial.println("{\"ok\":\"panic\"}");
+    else
+      Serial.println("{\"error\":\"usage: PANIC [USB|DIN|A-J|ALL]\"}");
+  }
+  else if (starts_with(cmd, "BENCH")) {
+    // BENCH [<нагрузка>|all] [событий] — прогон на core1, ответ по строке на нагрузку
+    char name[16] = "all";
+    unsigned events = 0;
+    sscanf(cmd, "BENCH %15s %u", name, &events);
+    uint8_t w = (strcmp(name, "all") == 0) ? (uint8_t)BENCH_COUNT : bench_find(name);
+    if (w == BENCH_COUNT && strcmp(name, "all") != 0) {
+      Serial.println("{\"error\":\"usage: BENCH [chords|cc|clock|sysex|mixed|keys|slice|all] [events]\"}");
+    } else if (!bench_request(w, (uint16_t)(events < BENCH_MAX_EVENTS ? events : BENCH_MAX_EVENTS))) {
+      Serial.println("{\"error\":\"bench_busy\"}");
+    } else {
+      Serial.println("{\"ok\":\"bench_started\"}");
+    }
+  }
+  else if (starts_with(cmd, "SET_POLICY")) {
+    // SET_POLICY <A–J> <oldest|newest|coalesce>
+    const char *sp1 = strchr(cmd, ' ');
+    const char *sp2 = strrchr(cmd, ' ');
+    uint8_t port = sp1 ? (uint8_t)(sp1[1] - 'A') : 0xFF;
+    const char *name = sp2 ? sp2 + 1 : "";
+    int policy = (strcmp(name, "oldest") == 0)   ? OVERFLOW_DROP_OLDEST
+               : (strcmp(name, "newest") == 0)   ? OVERFLOW_DROP_NEWEST
+               : (strcmp(name, "coalesce") == 0) ? OVERFLOW_COALESCE_CC
+               : -1;
+    if (port < 10 && policy >= 0 && sp2 > sp1 && midi_out_set_policy(port, (uint8_t)policy)) {
+      Serial.printf("{\"ok\":\"policy_set\",\"port\":\"%c\",\"policy\":%d}\n", 'A' + port, policy);
+    } else {
+      Serial.println("{\"error\":\"usage: SET_POLICY <A-J> <oldest|newest|coalesce>\"}");
+    }
+  }
+  else if (starts_with(cmd, "SET_USB_FLUSH")) {
+    // SET_USB_FLUSH <pass|frame>
+    if ((ends_with(cmd, " pass") || ends_with(cmd, " frame")) &&
+        midi_out_set_usb_flush(ends_with(cmd, " frame") ? USB_FLUSH_FRAME : USB_FLUSH_PASS)) {
+      Serial.println("{\"ok\":\"usb_flush_set\"}");
+    } else {
+      Serial.println("{\"error\":\"usage: SET_USB_FLUSH <pass|frame>\"}");
+    }
+  }
+  else if (starts_with(cmd, "SET_ENCODING")) {
+    // SET_ENCODING <DIN|A–J|ALL> <full|running|noteon>
+    const char *sp1 = strchr(cmd, ' ');
+    const char *sp2 = strrchr(cmd, ' ');
+    const char *name = sp2 ? sp2 + 1 : "";
+    int enc = (strcmp(name, "full") == 0)    ? ENCODE_FULL
+            : (strcmp(name, "running") == 0) ? ENCODE_RUNNING
+            : (strcmp(name, "noteon") == 0)  ? ENCODE_RUNNING_NOTEON
+            : -1;
+    uint16_t dest = 0;
+    if (sp1 && sp2 > sp1) {
+      char port[4] = {0};
+      size_t n = (size_t)(sp2 - sp1 - 1);
+      if (n < sizeof(port)) memcpy(port, sp1 + 1, n);
+      dest = (strcmp(port, "ALL") == 0) ? (uint16_t)(DEST_ALL & ~DEST_USB) : route_port_mask(port);
+    }
+    bool ok = enc >= 0 && dest && !(dest & DEST_USB);
+    for (uint16_t m = ok ? dest : 0; m; m &= m - 1)
+      ok = midi_out_set_encoding(__builtin_ctz(m), (uint8_t)enc) && ok;
+    if (ok) {
+      Serial.printf("{\"ok\":\"encoding_set\",\"encoding\":%d}\n", enc);
+    } else {
+      Serial.println("{\"error\":\"usage: SET_ENCODING <DIN|A-J|ALL> <full|running|noteon>\"}");
+    }
+  }
   else {
-    Serial.printf("{\"warn\":\"unknown_command\",\"cmd\":\"%s\"}\n", cmd.c_str());
+    Serial.printf("{\"warn\":\"unknown_command\",\"cmd\":\"%s\"}\n", cmd);
   }
-}
\ No newline at end of file
+}
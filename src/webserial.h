@@ -2,4 +2,5 @@
 #include <Arduino.h>
 
 void setup_webserial();
-void webserial_task();
\ No newline at end of file
+void webserial_task();
+void process_web_command(char *cmd);
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <unity.h>
+#include <vector>
+#include <LittleFS.h>
+#include "sim_hal.h"
+#include "route_table.h"
+
+// ======================================================
+// Общее для тестов: прошивка в симуляторе и запись выходов
+// ======================================================
+// Тест — обычная программа Unity (main в своём каталоге test_*),
+// собранная вместе с прошивкой и sim/ (test_build_src = yes).
+// Выходы пишутся побайтно: DIN и TRS — байт в конце стоп-бита,
+// USB — пакет из 4 байт, когда его забрал хост.
+
+struct WireRec {
+  uint64_t t;
+  uint8_t sink;        // как биты DEST_*: 0 — USB, 1 — DIN, 2–11 — TRS A–J
+  uint8_t len;
+  uint8_t data[4];
+};
+
+static std::vector<WireRec> wire;
+
+static inline void wire_record(uint8_t sink, const uint8_t *data, uint8_t len, uint64_t t) {
+  WireRec r = {t, sink, len, {}};
+  memcpy(r.data, data, len < 4 ? len : 4);
+  wire.push_back(r);
+}
+
+// Байты выхода подряд (USB — пакеты по 4 байта)
+static inline std::vector<uint8_t> wire_bytes(uint8_t sink) {
+  std::vector<uint8_t> out;
+  for (const WireRec &r : wire)
+    if (r.sink == sink) out.insert(out.end(), r.data, r.data + r.len);
+  return out;
+}
+
+static inline void run_for(uint64_t us) {
+  sim_run_until(sim_now() + us);
+}
+
+// Прошивка с чистыми часами, flash и LittleFS в .pio/test_fs
+static inline void sim_test_boot() {
+  sim_fs_set_root(".pio/test_fs");
+  sim_serial_set_echo(false);
+  sim_reset();
+  sim_set_wire(wire_record);
+  sim_firmware_setup();
+  wire.clear();
+}
+
+#define TEST_ASSERT_WIRE(sink, ...)                                        \
+  do {                                                                     \
+    const uint8_t expect_[] = {__VA_ARGS__};                               \
+    std::vector<uint8_t> got_ = wire_bytes(sink);                          \
+    TEST_ASSERT_EQUAL_MESSAGE(sizeof(expect_), got_.size(), "wire length"); \
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expect_, got_.data(), sizeof(expect_));   \
+  } while (0)
@@ -0,0 +1,129 @@
+#include "../sim_test.h"
+#include "bitslice.h"
+#include "midi_output.h"
+
+// ======================================================
+// Бит-слайсинг: транспонирование 8×8, кадр, кадр прошивки в линии
+// ======================================================
+
+// Выводы TRS A–J относительно TRS_PIN_BASE (midi_tx_pins в midi_output.cpp)
+static const uint8_t trsOffsets[10] = {0, 2, 4, 6, 8, 10, 12, 14, 16, 20};
+
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_rand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+// Бит j байта i ↔ бит i байта j — по определению
+static uint64_t transpose_ref(uint64_t x) {
+  uint64_t y = 0;
+  for (uint8_t i = 0; i < 8; i++)
+    for (uint8_t j = 0; j < 8; j++)
+      if ((x >> (8 * i + j)) & 1) y |= 1ull << (8 * j + i);
+  return y;
+}
+
+// Кадр глазами приёмника порта: старт, 8 бит младшим вперёд, стоп;
+// выводы вне портов — 0 во всех столбцах
+static void assert_frame(const uint32_t *cols, const uint8_t *offsets, uint8_t ports,
+                         const uint8_t *bytes, uint16_t active) {
+  uint32_t pins = 0;
+  for (uint8_t p = 0; p < ports; p++) {
+    uint8_t off = offsets[p];
+    pins |= 1u << off;
+    bool on = (active >> p) & 1;
+    TEST_ASSERT_EQUAL_MESSAGE(on ? 0 : 1, (cols[0] >> off) & 1, "start bit");
+    for (uint8_t b = 0; b < 8; b++) {
+      uint32_t want = on ? (bytes[p] >> b) & 1 : 1;
+      TEST_ASSERT_EQUAL_MESSAGE(want, (cols[1 + b] >> off) & 1, "data bit");
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(1, (cols[9] >> off) & 1, "stop bit");
+  }
+  for (uint8_t c = 0; c < BITSLICE_COLS; c++) TEST_ASSERT_EQUAL_HEX32(0, cols[c] & ~pins);
+}
+
+void setUp() {
+  wire.clear();
+}
+
+void tearDown() {}
+
+static void test_transpose8() {
+  static const uint64_t fixed[] = {0, ~0ull, 1, 1ull << 63, 0x8040201008040201ull, 0x0102040810204080ull};
+  for (uint64_t x : fixed) TEST_ASSERT_EQUAL_HEX64(transpose_ref(x), bitslice_transpose8(x));
+  TEST_ASSERT_EQUAL_HEX64(0x8040201008040201ull, bitslice_transpose8(0x8040201008040201ull));   // диагональ на месте
+
+  for (uint16_t n = 0; n < 2000; n++) {
+    uint64_t x = next_rand();
+    uint64_t t = bitslice_transpose8(x);
+    TEST_ASSERT_EQUAL_HEX64(transpose_ref(x), t);
+    TEST_ASSERT_EQUAL_HEX64(x, bitslice_transpose8(t));   // дважды — тождество
+  }
+}
+
+// 16 портов в две группы, выводы вразброс; группа целиком молчит, порт молчит
+static void test_frame_two_groups() {
+  static const uint8_t offsets[16] = {31, 0, 5, 1, 9, 17, 3, 30, 12, 2, 25, 7, 20, 14, 28, 11};
+  static BitSlicer s;
+  bitslice_init(s, offsets, 16);
+  uint8_t bytes[16];
+  uint32_t cols[BITSLICE_COLS];
+
+  static const uint16_t masks[] = {0x0000, 0xFFFF, 0x00FF, 0xFF00, 0x8001, 0x5A5A};
+  for (uint16_t active : masks) {
+    for (uint8_t n = 0; n < 50; n++) {
+      for (uint8_t p = 0; p < 16; p++) bytes[p] = (uint8_t)next_rand();
+      bitslice_frame(s, bytes, active, cols);
+      assert_frame(cols, offsets, 16, bytes, active);
+    }
+  }
+}
+
+// Кадр прошивки (midi_out_frame — тот же путь, что в IRQ выходов)
+static void test_firmware_frame() {
+  uint8_t bytes[10] = {0x90, 0x3C, 0x7F, 0x00, 0xFF, 0xF8, 0x55, 0xAA, 0x01, 0x80};
+  uint32_t cols[BITSLICE_COLS];
+  midi_out_frame(bytes, 0x3FF, cols);
+  assert_frame(cols, trsOffsets, 10, bytes, 0x3FF);
+  midi_out_frame(bytes, 0x204, cols);
+  assert_frame(cols, trsOffsets, 10, bytes, 0x204);
+  midi_out_frame(bytes, 0, cols);
+  for (uint8_t c = 0; c < BITSLICE_COLS; c++) TEST_ASSERT_EQUAL_HEX32(cols[9], cols[c]);   // линия в 1
+}
+
+// Веер на все TRS под hold — один кадр: байт у каждого порта в одно время
+static void test_fanout_is_one_frame() {
+  midi_out_hold();
+  for (uint8_t p = 0; p < 10; p++)
+    send_midi(2 + p, midi_word_msg(USB_CABLE_ROUTER, 0xB0 | p, 7, p));
+  midi_out_release();
+  run_for(5000);
+
+  uint64_t t0 = 0;
+  for (uint8_t p = 0; p < 10; p++) {
+    std::vector<uint8_t> b = wire_bytes(2 + p);
+    TEST_ASSERT_EQUAL(3, b.size());
+    TEST_ASSERT_EQUAL_HEX8(0xB0 | p, b[0]);
+    TEST_ASSERT_EQUAL(p, b[2]);
+    for (const WireRec &r : wire)
+      if (r.sink == 2 + p) {
+        if (!t0) t0 = r.t;
+        TEST_ASSERT_EQUAL(t0, r.t);
+        break;
+      }
+  }
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_transpose8);
+  RUN_TEST(test_frame_two_groups);
+  RUN_TEST(test_firmware_frame);
+  RUN_TEST(test_fanout_is_one_frame);
+  return UNITY_END();
+}
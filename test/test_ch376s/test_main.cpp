@@ -0,0 +1,213 @@
+#include "../sim_test.h"
+#include "ch376s.h"
+
+// ======================================================
+// CH376S: драйвер против модели чипа (sim/sim_ch376s.cpp)
+// ======================================================
+// Клавиатура по умолчанию — boot-раскладка в report protocol, третий
+// интерфейс составного устройства (дескриптор конфигурации > 64 байт);
+// клавиша 0x1D — нота 60 на USB.
+
+static const uint8_t keyDown[8] = {0, 0, 0x1D, 0, 0, 0, 0, 0};
+static const uint8_t keysUp[8] = {};
+
+static Ch376Stats stats() {
+  Ch376Stats st;
+  ch376s_get_stats(st);
+  return st;
+}
+
+void setUp() {
+  wire.clear();
+}
+
+void tearDown() {}
+
+static void test_attached_at_boot() {
+  Ch376Stats st = stats();
+  TEST_ASSERT_TRUE(st.attached);
+  TEST_ASSERT_FALSE(st.nkro);
+  TEST_ASSERT_FALSE(st.boot);
+  TEST_ASSERT_EQUAL(1, st.connects);
+}
+
+// Клавиша нажата ещё при подключении: отчёт готов к первому же IN,
+// INT# падает сразу после токена — IRQ уже должен ждать
+static void test_report_at_attach_reaches_irq() {
+  sim_kbd_plug(false);
+  run_for(3000);
+  TEST_ASSERT_FALSE(stats().attached);
+
+  Ch376Stats before = stats();
+  sim_kbd_plug(true);
+  sim_hid_report(keyDown, sizeof(keyDown));
+  run_for(200000);
+
+  Ch376Stats after = stats();
+  TEST_ASSERT_TRUE(after.attached);
+  TEST_ASSERT_EQUAL(before.connects + 1, after.connects);
+  TEST_ASSERT_EQUAL(before.reports + 1, after.reports);
+  TEST_ASSERT_EQUAL(before.polled, after.polled);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127);
+
+  sim_hid_report(keysUp, sizeof(keysUp));
+  run_for(3000);
+}
+
+// Спад INT# не защёлкнулся: отчёт забирает опрос из ch376s_task()
+static void test_lost_edge_is_polled() {
+  Ch376Stats before = stats();
+  sim_kbd_lose_edge();
+  sim_hid_report(keyDown, sizeof(keyDown));
+  run_for(500);
+  TEST_ASSERT_EQUAL(0, wire_bytes(0).size());
+
+  run_for(3000);
+  Ch376Stats after = stats();
+  TEST_ASSERT_EQUAL(before.polled + 1, after.polled);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127);
+
+  // дальше — снова по IRQ
+  wire.clear();
+  sim_hid_report(keysUp, sizeof(keysUp));
+  run_for(500);
+  TEST_ASSERT_WIRE(0, 0x08, 0x80, 60, 0);
+  TEST_ASSERT_EQUAL(after.polled, stats().polled);
+}
+
+// Отключение с нажатой клавишей — нота отпускается; снова подключили —
+// поток идёт, клавиатура NKRO определяется по maxPacket
+static void test_unplug_releases_and_replug_streams() {
+  sim_hid_report(keyDown, sizeof(keyDown));
+  run_for(3000);
+  wire.clear();
+
+  sim_kbd_plug(false);
+  run_for(3000);
+  TEST_ASSERT_FALSE(stats().attached);
+  TEST_ASSERT_WIRE(0, 0x08, 0x80, 60, 0);
+
+  wire.clear();
+  sim_kbd_plug(true, 16);
+  run_for(200000);
+  TEST_ASSERT_TRUE(stats().attached);
+  TEST_ASSERT_TRUE(stats().nkro);
+
+  uint8_t nkro[16] = {};
+  nkro[1 + 0x1D / 8] = 1 << (0x1D % 8);
+  sim_hid_report(nkro, sizeof(nkro));
+  run_for(3000);
+  memset(nkro, 0, sizeof(nkro));
+  sim_hid_report(nkro, sizeof(nkro));
+  run_for(3000);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127, 0x08, 0x80, 60, 0);
+
+  // другая клавиатура без паузы: DISCONNECT и CONNECT достаются IRQ
+  uint32_t connects = stats().connects;
+  sim_kbd_plug(true);
+  run_for(200000);
+  TEST_ASSERT_TRUE(stats().attached);
+  TEST_ASSERT_FALSE(stats().nkro);
+  TEST_ASSERT_EQUAL(connects + 1, stats().connects);
+}
+
+// ErrorRollOver: нажатое отпускается, All Notes Off — один раз на сбой
+static void test_rollover_report_panics() {
+  static const uint8_t rollover[8] = {0, 0, 1, 1, 1, 1, 1, 1};
+  sim_hid_report(keyDown, sizeof(keyDown));
+  run_for(3000);
+  wire.clear();
+
+  Ch376Stats before = stats();
+  sim_hid_report(rollover, sizeof(rollover));
+  sim_hid_report(rollover, sizeof(rollover));
+  run_for(3000);
+
+  Ch376Stats after = stats();
+  TEST_ASSERT_EQUAL(before.rollover + 2, after.rollover);
+  TEST_ASSERT_EQUAL(before.panics + 1, after.panics);
+  TEST_ASSERT_WIRE(0, 0x08, 0x80, 60, 0, 0x0B, 0xB0, 123, 0);
+
+  wire.clear();
+  sim_hid_report(keyDown, sizeof(keyDown));
+  run_for(3000);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127);
+  sim_hid_report(keysUp, sizeof(keysUp));
+  run_for(3000);
+}
+
+// Раскладка — из дескриптора отчёта: Report ID, чужие отчёты пропускаются
+static void test_report_descriptor_with_report_id() {
+  static const uint8_t desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x19, 0x00, 0x29, 0x77, 0x95, 0x78, 0x81, 0x02,
+    0xC0,
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x02,
+    0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00,
+    0xC0
+  };
+  sim_kbd_report_desc(desc, sizeof(desc));
+  sim_kbd_plug(true, 17);
+  run_for(200000);
+  Ch376Stats before = stats();
+  TEST_ASSERT_TRUE(before.attached);
+  TEST_ASSERT_TRUE(before.nkro);
+  TEST_ASSERT_FALSE(before.boot);
+  TEST_ASSERT_EQUAL(1, sim_kbd_protocol());
+
+  const uint8_t media[3] = {2, 0xE9, 0};
+  sim_hid_report(media, sizeof(media));
+  uint8_t r[17] = {1};
+  r[2 + 0x1D / 8] = 1 << (0x1D % 8);
+  sim_hid_report(r, sizeof(r));
+  run_for(3000);
+  memset(r + 1, 0, sizeof(r) - 1);
+  sim_hid_report(r, sizeof(r));
+  run_for(3000);
+
+  Ch376Stats after = stats();
+  TEST_ASSERT_EQUAL(before.reports + 3, after.reports);
+  TEST_ASSERT_EQUAL(before.rollover, after.rollover);
+  TEST_ASSERT_EQUAL(before.panics, after.panics);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127, 0x08, 0x80, 60, 0);
+}
+
+// Дескриптор без клавиатуры, которую можно разобрать, — boot protocol
+static void test_unparsed_descriptor_falls_back_to_boot() {
+  static const uint8_t desc[] = {   // карта клавиш не с границы байта
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07,
+    0x75, 0x01, 0x95, 0x03, 0x81, 0x01, 0x19, 0x00, 0x95, 0x40, 0x81, 0x02, 0xC0
+  };
+  sim_kbd_report_desc(desc, sizeof(desc));
+  sim_kbd_plug(true);
+  run_for(200000);
+  TEST_ASSERT_TRUE(stats().attached);
+  TEST_ASSERT_TRUE(stats().boot);
+  TEST_ASSERT_FALSE(stats().nkro);
+  TEST_ASSERT_EQUAL(0, sim_kbd_protocol());
+
+  sim_hid_report(keyDown, sizeof(keyDown));
+  run_for(3000);
+  sim_hid_report(keysUp, sizeof(keysUp));
+  run_for(3000);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127, 0x08, 0x80, 60, 0);
+
+  sim_kbd_report_desc(nullptr, 0);
+  sim_kbd_plug(true);
+  run_for(200000);
+  TEST_ASSERT_FALSE(stats().boot);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_attached_at_boot);
+  RUN_TEST(test_report_at_attach_reaches_irq);
+  RUN_TEST(test_lost_edge_is_polled);
+  RUN_TEST(test_unplug_releases_and_replug_streams);
+  RUN_TEST(test_rollover_report_panics);
+  RUN_TEST(test_report_descriptor_with_report_id);
+  RUN_TEST(test_unparsed_descriptor_falls_back_to_boot);
+  return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#include <unity.h>
+#include <string.h>
+#include "curve.h"
+#include "route_table.h"
+
+// ======================================================
+// Кривые: LUT по определению и индексы в таблице маршрутов
+// ======================================================
+
+static uint8_t lut[CURVE_LUT_SIZE];
+
+static CurveDef curve(uint8_t type, uint8_t min, uint8_t max, int8_t shape = 0) {
+  CurveDef c;
+  memset(&c, 0, sizeof(c));
+  c.type = type;
+  c.min = min;
+  c.max = max;
+  c.shape = shape;
+  return c;
+}
+
+void setUp() {
+  memset(lut, 0xAA, sizeof(lut));
+}
+
+void tearDown() {}
+
+static void test_identity_and_linear() {
+  curve_identity(lut);
+  for (uint8_t v = 0; v < CURVE_LUT_SIZE; v++) TEST_ASSERT_EQUAL(v, lut[v]);
+
+  curve_build(curve(CURVE_LINEAR, 0, 127), lut);
+  for (uint8_t v = 0; v < CURVE_LUT_SIZE; v++) TEST_ASSERT_EQUAL(v, lut[v]);
+
+  curve_build(curve(CURVE_LINEAR, 20, 100), lut);
+  TEST_ASSERT_EQUAL(20, lut[0]);
+  TEST_ASSERT_EQUAL(60, lut[64]);     // (20*63 + 100*64 + 63) / 127
+  TEST_ASSERT_EQUAL(100, lut[127]);
+}
+
+static void test_invert_clamp_fixed() {
+  curve_build(curve(CURVE_INVERT, 0, 127), lut);
+  for (uint8_t v = 0; v < CURVE_LUT_SIZE; v++) TEST_ASSERT_EQUAL(127 - v, lut[v]);
+
+  curve_build(curve(CURVE_CLAMP, 30, 90), lut);
+  TEST_ASSERT_EQUAL(30, lut[0]);
+  TEST_ASSERT_EQUAL(30, lut[29]);
+  TEST_ASSERT_EQUAL(64, lut[64]);
+  TEST_ASSERT_EQUAL(90, lut[127]);
+
+  curve_build(curve(CURVE_FIXED, 100, 0), lut);
+  for (uint8_t v = 0; v < CURVE_LUT_SIZE; v++) TEST_ASSERT_EQUAL(100, lut[v]);
+}
+
+// exp: концы — min и max, между ними монотонно; shape > 0 — ниже прямой
+static void test_exp_shape() {
+  curve_build(curve(CURVE_EXP, 0, 127, 6), lut);
+  TEST_ASSERT_EQUAL(0, lut[0]);
+  TEST_ASSERT_EQUAL(127, lut[127]);
+  for (uint8_t v = 1; v < CURVE_LUT_SIZE; v++) TEST_ASSERT_TRUE(lut[v] >= lut[v - 1]);
+  TEST_ASSERT_TRUE(lut[64] < 40);
+
+  curve_build(curve(CURVE_EXP, 0, 127, -6), lut);
+  TEST_ASSERT_TRUE(lut[64] > 87);
+
+  curve_build(curve(CURVE_EXP, 10, 110, 0), lut);   // shape 0 — прямая
+  TEST_ASSERT_EQUAL(10, lut[0]);
+  TEST_ASSERT_EQUAL(110, lut[127]);
+}
+
+// user: точки равномерно по 0…127, между ними — линейно
+static void test_user_points() {
+  CurveDef c = curve(CURVE_USER, 0, 0);
+  c.count = 3;
+  c.points[0] = 0;
+  c.points[1] = 100;
+  c.points[2] = 50;
+  curve_build(c, lut);
+  TEST_ASSERT_EQUAL(0, lut[0]);
+  TEST_ASSERT_EQUAL(50, lut[32]);     // первый отрезок: 0…63.5 → 0…100
+  TEST_ASSERT_EQUAL(100, lut[64]);    // вторая точка
+  TEST_ASSERT_EQUAL(50, lut[127]);
+
+  c.count = 1;                        // меньше двух точек — берутся первые две
+  curve_build(c, lut);
+  TEST_ASSERT_EQUAL(0, lut[0]);
+  TEST_ASSERT_EQUAL(100, lut[127]);
+}
+
+static void test_type_names() {
+  for (uint8_t t = 0; t < CURVE_TYPES; t++) TEST_ASSERT_EQUAL(t, curve_type(curve_type_name(t)));
+  TEST_ASSERT_EQUAL(CURVE_LINEAR, curve_type("spline"));
+  TEST_ASSERT_EQUAL(CURVE_LINEAR, curve_type(nullptr));
+  TEST_ASSERT_EQUAL_STRING("", curve_type_name(CURVE_TYPES));
+}
+
+// Таблица маршрутов: LUT 0 — тождественная, номер кривой → индекс,
+// "rate" — флаг у клавиши; у thru кривая только там, где есть значение
+static void test_route_table_curve_indices() {
+  static ConfigModel cfg;
+  static RouteTable table;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.curves[0] = curve(CURVE_INVERT, 0, 127);
+  cfg.curves[1] = curve(CURVE_FIXED, 90, 0);
+  cfg.curves[1].flags = CURVE_FROM_RATE;
+  cfg.curveCount = 2;
+
+  KeyMapping &k = cfg.keys[cfg.count++];
+  k = {0x1D, ROUTE_NOTE, 60, 1, DEST_USB, LAYER_BASE, 1};
+  KeyMapping &rate = cfg.keys[cfg.count++];
+  rate = {0x1B, ROUTE_NOTE, 62, 1, DEST_USB, LAYER_BASE, 2};
+  KeyMapping &bad = cfg.keys[cfg.count++];
+  bad = {0x06, ROUTE_NOTE, 64, 1, DEST_USB, LAYER_BASE, 9};
+
+  ThruRule &r = cfg.thru[cfg.thruCount++];
+  memset(&r, 0, sizeof(r));
+  r.in = THRU_IN_DIN;
+  r.types = (1u << THRU_NOTE_ON) | (1u << THRU_PROGRAM);
+  r.channels = 1;
+  r.dest = DEST_DIN;
+  r.curve = 1;
+  route_table_compile(cfg, table);
+
+  for (uint8_t v = 0; v < CURVE_LUT_SIZE; v++) TEST_ASSERT_EQUAL(v, table.curves[0][v]);
+  TEST_ASSERT_EQUAL(127, table.curves[1][0]);
+  TEST_ASSERT_EQUAL(90, table.curves[2][5]);
+
+  TEST_ASSERT_EQUAL(1, table.keys[0x1D].curve);
+  TEST_ASSERT_EQUAL(2 | ROUTE_CURVE_RATE, table.keys[0x1B].curve);
+  TEST_ASSERT_EQUAL(0, table.keys[0x06].curve);   // кривой 9 нет
+  TEST_ASSERT_EQUAL(1, table.thruCurve[THRU_IN_DIN][0][THRU_NOTE_ON]);
+  TEST_ASSERT_EQUAL(0, table.thruCurve[THRU_IN_DIN][0][THRU_PROGRAM]);
+  TEST_ASSERT_EQUAL(0, table.thruCurve[THRU_IN_DIN][1][THRU_NOTE_ON]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_identity_and_linear);
+  RUN_TEST(test_invert_clamp_fixed);
+  RUN_TEST(test_exp_shape);
+  RUN_TEST(test_user_points);
+  RUN_TEST(test_type_names);
+  RUN_TEST(test_route_table_curve_indices);
+  return UNITY_END();
+}
@@ -0,0 +1,165 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "hid_report.h"
+
+// ======================================================
+// Отчёты HID: дескриптор → раскладка, отчёт → битсет, разница
+// ======================================================
+
+struct KeyEvent {
+  uint8_t code;
+  bool pressed;
+};
+
+static std::vector<KeyEvent> events;
+
+static void on_key(uint8_t code, bool pressed, void *) {
+  events.push_back({code, pressed});
+}
+
+static bool has(const HidKeyBits &b, uint8_t code) {
+  return (b.w[code >> 5] >> (code & 31)) & 1;
+}
+
+void setUp() {
+  events.clear();
+}
+
+void tearDown() {}
+
+static const uint8_t bootDesc[] = {
+  0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+  0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+  0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+  0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02,
+  0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+  0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+  0xC0
+};
+
+// NKRO с Report ID 1 (модификаторы + карта 0x00–0x77) и мультимедиа с ID 2
+static const uint8_t nkroDesc[] = {
+  0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,
+  0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+  0x19, 0x00, 0x29, 0x77, 0x95, 0x78, 0x81, 0x02,
+  0xC0,
+  0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x02,
+  0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00,
+  0xC0
+};
+
+static void test_boot_descriptor_gives_boot_layout() {
+  HidLayout l, boot;
+  TEST_ASSERT_TRUE(hid_parse_report_desc(bootDesc, sizeof(bootDesc), l));
+  hid_layout_boot(boot);
+  TEST_ASSERT_EQUAL_MEMORY(&boot, &l, sizeof(l));
+  TEST_ASSERT_EQUAL(0, l.reportId);
+  TEST_ASSERT_EQUAL(8, l.size);
+  TEST_ASSERT_EQUAL(HID_NONE, l.mapByte);
+}
+
+static void test_nkro_descriptor_with_report_id() {
+  HidLayout l;
+  TEST_ASSERT_TRUE(hid_parse_report_desc(nkroDesc, sizeof(nkroDesc), l));
+  TEST_ASSERT_EQUAL(1, l.reportId);
+  TEST_ASSERT_EQUAL(16, l.size);
+  TEST_ASSERT_EQUAL(0, l.modByte);
+  TEST_ASSERT_EQUAL(1, l.mapByte);
+  TEST_ASSERT_EQUAL(0, l.mapFirst);
+  TEST_ASSERT_EQUAL(0x78, l.mapCount);
+  TEST_ASSERT_EQUAL(HID_NONE, l.keysByte);
+
+  uint8_t r[17] = {1, 0x02};                  // Left Shift
+  r[2 + 0x1D / 8] |= 1 << (0x1D % 8);
+  r[2 + 0x65 / 8] |= 1 << (0x65 % 8);
+  HidKeyBits b;
+  TEST_ASSERT_EQUAL(HID_REPORT_KEYS, hid_report_bits(l, r, sizeof(r), b));
+  TEST_ASSERT_TRUE(has(b, 0x1D));
+  TEST_ASSERT_TRUE(has(b, 0x65));
+  TEST_ASSERT_TRUE(has(b, 0xE1));
+  TEST_ASSERT_FALSE(has(b, 0xE0));
+
+  const uint8_t media[3] = {2, 0xE9, 0};    // Volume Up — не клавиатура
+  TEST_ASSERT_EQUAL(HID_REPORT_OTHER, hid_report_bits(l, media, sizeof(media), b));
+  TEST_ASSERT_EQUAL(HID_REPORT_ERROR, hid_report_bits(l, r, 10, b));   // короче раскладки
+
+  r[1] = 0;
+  r[2] = 1 << HID_ROLLOVER_ERR;              // карта тоже сообщает ErrorRollOver
+  TEST_ASSERT_EQUAL(HID_REPORT_ERROR, hid_report_bits(l, r, sizeof(r), b));
+}
+
+// Не разобрать — false, драйвер уходит в boot protocol
+static void test_unsupported_descriptors() {
+  HidLayout l;
+  static const uint8_t mouse[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x05, 0x09, 0x19, 0x01, 0x29, 0x03,
+    0x95, 0x03, 0x75, 0x01, 0x81, 0x02, 0xC0
+  };
+  TEST_ASSERT_FALSE(hid_parse_report_desc(mouse, sizeof(mouse), l));
+
+  static const uint8_t unaligned[] = {   // 4 бита модификаторов, карта с бита 4
+    0x05, 0x07, 0x19, 0xE0, 0x75, 0x01, 0x95, 0x04, 0x81, 0x02,
+    0x19, 0x00, 0x95, 0x40, 0x81, 0x02
+  };
+  TEST_ASSERT_FALSE(hid_parse_report_desc(unaligned, sizeof(unaligned), l));
+
+  static const uint8_t pushPop[] = {0x05, 0x07, 0xA4, 0x75, 0x08, 0x95, 0x06, 0x81, 0x00, 0xB4};
+  TEST_ASSERT_FALSE(hid_parse_report_desc(pushPop, sizeof(pushPop), l));
+
+  TEST_ASSERT_FALSE(hid_parse_report_desc(bootDesc, 20, l));   // оборван посреди элемента
+}
+
+static void test_boot_report_errors() {
+  HidLayout l;
+  hid_layout_boot(l);
+  HidKeyBits b;
+  const uint8_t ok[8] = {0x01, 0, 0x04, 0x1D, 0, 0, 0, 0};
+  TEST_ASSERT_EQUAL(HID_REPORT_KEYS, hid_report_bits(l, ok, sizeof(ok), b));
+  TEST_ASSERT_TRUE(has(b, 0x04));
+  TEST_ASSERT_TRUE(has(b, 0x1D));
+  TEST_ASSERT_TRUE(has(b, 0xE0));
+  TEST_ASSERT_FALSE(has(b, 0));
+
+  const uint8_t rollover[8] = {0, 0, 1, 1, 1, 1, 1, 1};
+  const uint8_t postFail[8] = {0, 0, 0x04, 0x02, 0, 0, 0, 0};
+  TEST_ASSERT_EQUAL(HID_REPORT_ERROR, hid_report_bits(l, rollover, sizeof(rollover), b));
+  TEST_ASSERT_EQUAL(HID_REPORT_ERROR, hid_report_bits(l, postFail, sizeof(postFail), b));
+  TEST_ASSERT_EQUAL(HID_REPORT_ERROR, hid_report_bits(l, ok, 6, b));
+}
+
+// Разница: отпускания с младшего слова, нажатия со старшего —
+// модификатор раньше клавиши того же отчёта
+static void test_diff_order() {
+  HidLayout l;
+  hid_layout_boot(l);
+  HidKeyBits prev, cur;
+  const uint8_t a[8] = {0x02, 0, 0x04, 0x28, 0, 0, 0, 0};   // Shift, 0x04, 0x28
+  const uint8_t b[8] = {0x01, 0, 0x05, 0x28, 0x64, 0, 0, 0};   // Ctrl, 0x05, 0x28, 0x64
+  hid_report_bits(l, a, sizeof(a), prev);
+  hid_report_bits(l, b, sizeof(b), cur);
+  hid_bits_diff(prev, cur, on_key, nullptr);
+
+  const KeyEvent expect[] = {
+    {0x04, false}, {0xE1, false}, {0xE0, true}, {0x64, true}, {0x05, true}
+  };
+  TEST_ASSERT_EQUAL(5, events.size());
+  for (uint8_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL_HEX8(expect[i].code, events[i].code);
+    TEST_ASSERT_EQUAL(expect[i].pressed, events[i].pressed);
+  }
+
+  events.clear();
+  hid_bits_diff(cur, cur, on_key, nullptr);   // одинаковые отчёты — ни одного события
+  TEST_ASSERT_EQUAL(0, events.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_descriptor_gives_boot_layout);
+  RUN_TEST(test_nkro_descriptor_with_report_id);
+  RUN_TEST(test_unsupported_descriptors);
+  RUN_TEST(test_boot_report_errors);
+  RUN_TEST(test_diff_order);
+  return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include "../sim_test.h"
+#include "midi_clock.h"
+#include "midi_output.h"
+#include "hardware/timer.h"
+
+// ======================================================
+// MIDI Clock: realtime-полоса, генератор, делители, PLL
+// ======================================================
+// Входные часы подаются прямо в midi_clock_input (как из
+// handle_midi_event на core1) — маска выходов задаётся тестом.
+
+#define SINK_DIN 1
+#define SINK_A   2
+#define SINK_B   3
+#define CLOCK_DEST (DEST_DIN | DEST_PIO(0) | DEST_PIO(1))
+
+static const uint32_t TICK_120 = 20833;   // 120 BPM: 60e6 / (120 * 24) мкс
+
+static void clock_in(uint8_t st) {
+  midi_clock_input(midi_word_msg(USB_CABLE_ROUTER, st, 0, 0), time_us_32(), CLOCK_DEST);
+}
+
+// Время каждого байта b в линии выхода
+static std::vector<uint64_t> wire_times(uint8_t sink, uint8_t b) {
+  std::vector<uint64_t> out;
+  for (const WireRec &r : wire)
+    if (r.sink == sink && r.len == 1 && r.data[0] == b) out.push_back(r.t);
+  return out;
+}
+
+static ClockPortStats port(uint8_t sink) {
+  ClockPortStats st;
+  midi_clock_get_port(sink, st);
+  return st;
+}
+
+void setUp() {
+  midi_clock_set_mode(CLOCK_THRU);
+  midi_clock_set_ratio(DEST_ALL, 1, 1);
+  midi_clock_reset_stats();
+  run_for(30000);   // дать линиям опустеть
+  wire.clear();
+}
+
+void tearDown() {}
+
+// F8 не ждёт очередь выхода: уходит сразу за сообщением, которое уже в линии
+static void test_clock_bypasses_queue() {
+  for (uint8_t n = 60; n < 66; n++)
+    send_midi(SINK_A, midi_word_msg(USB_CABLE_ROUTER, 0x90, n, 100));
+  run_for(400);
+  clock_in(0xF8);
+  run_for(20000);
+
+  std::vector<uint8_t> a = wire_bytes(SINK_A);
+  TEST_ASSERT_EQUAL(1 + 3 + 5 * 2, a.size());   // running status: 90 n v, дальше n v
+  TEST_ASSERT_EQUAL_HEX8(0xF8, a[3]);            // за первым сообщением, впереди пяти в очереди
+  TEST_ASSERT_EQUAL(61, a[4]);
+  TEST_ASSERT_EQUAL(1, wire_times(SINK_DIN, 0xF8).size());
+}
+
+// INTERNAL: сетка 120 BPM идёт и без Start; транспорт — на все выходы
+static void test_internal_generator() {
+  TEST_ASSERT_TRUE(midi_clock_set_bpm(1200));
+  TEST_ASSERT_TRUE(midi_clock_set_mode(CLOCK_INTERNAL));
+  TEST_ASSERT_TRUE(midi_clock_transport(0xFA));
+  run_for(1000000);
+  TEST_ASSERT_TRUE(midi_clock_transport(0xFC));
+  run_for(1000);
+
+  ClockStats st;
+  midi_clock_get_stats(st);
+  TEST_ASSERT_EQUAL(CLOCK_INTERNAL, st.mode);
+  TEST_ASSERT_FALSE(st.running);
+  TEST_ASSERT_EQUAL(TICK_120, st.periodUs);
+
+  std::vector<uint64_t> ticks = wire_times(SINK_DIN, 0xF8);
+  TEST_ASSERT_UINT32_WITHIN(1, 48, ticks.size());
+  for (size_t i = 1; i < ticks.size(); i++)
+    TEST_ASSERT_UINT32_WITHIN(2, TICK_120, (uint32_t)(ticks[i] - ticks[i - 1]));
+  TEST_ASSERT_TRUE(port(SINK_DIN).jitter.max <= 2);
+
+  TEST_ASSERT_EQUAL(1, wire_times(SINK_A, 0xFA).size());
+  TEST_ASSERT_EQUAL(1, wire_times(SINK_B, 0xFA).size());
+  TEST_ASSERT_EQUAL_HEX8(0xFC, wire_bytes(SINK_A).back());
+}
+
+// div/mul по выходу: A — каждый второй тик, B — два тика на один,
+// второй — посередине периода
+static void test_dividers() {
+  TEST_ASSERT_TRUE(midi_clock_set_ratio(DEST_PIO(0), 2, 1));
+  TEST_ASSERT_TRUE(midi_clock_set_ratio(DEST_PIO(1), 1, 2));
+  TEST_ASSERT_FALSE(midi_clock_set_ratio(DEST_PIO(1), 1, 0));
+  TEST_ASSERT_FALSE(midi_clock_set_ratio(DEST_PIO(1), CLOCK_RATIO_MAX + 1, 1));
+  run_for(100);
+
+  clock_in(0xFA);
+  for (uint8_t i = 0; i < 24; i++) {
+    clock_in(0xF8);
+    run_for(TICK_120);
+  }
+  run_for(TICK_120);
+
+  TEST_ASSERT_EQUAL(24, wire_times(SINK_DIN, 0xF8).size());
+  TEST_ASSERT_EQUAL(12, wire_times(SINK_A, 0xF8).size());
+  // у первого тика периода ещё нет — промежуточный только со второго
+  std::vector<uint64_t> b = wire_times(SINK_B, 0xF8);
+  TEST_ASSERT_EQUAL(2 * 24 - 1, b.size());
+  for (size_t i = 2; i < b.size(); i++)
+    TEST_ASSERT_UINT32_WITHIN(2, TICK_120 / 2, (uint32_t)(b[i] - b[i - 1]));
+  TEST_ASSERT_EQUAL(2, port(SINK_A).div);
+  TEST_ASSERT_EQUAL(2, port(SINK_B).mul);
+}
+
+// PLL: тик выхода на каждый тик входа (и один, предсказанный после
+// последнего), а разброс интервалов входа (±300 мкс) сглажен генератором
+static void test_pll_smooths_input() {
+  TEST_ASSERT_TRUE(midi_clock_set_mode(CLOCK_PLL));
+  run_for(100);
+  ClockStats st;
+  midi_clock_get_stats(st);
+  uint32_t outBefore = st.outTicks;
+  static const int16_t wobble[4] = {300, -250, 200, -300};
+  for (uint8_t i = 0; i < 96; i++) {
+    clock_in(0xF8);
+    run_for(TICK_120 + wobble[i & 3]);
+  }
+  run_for(2 * TICK_120);
+
+  midi_clock_get_stats(st);
+  TEST_ASSERT_EQUAL(96, st.inTicks);
+  TEST_ASSERT_EQUAL(97, st.outTicks - outBefore);
+  TEST_ASSERT_EQUAL(97, wire_times(SINK_DIN, 0xF8).size());
+  TEST_ASSERT_UINT32_WITHIN(100, TICK_120, st.periodUs);
+  TEST_ASSERT_TRUE(st.inJitter.max >= 250);
+
+  // после захвата интервалы на выходе ровнее входных
+  std::vector<uint64_t> t = wire_times(SINK_DIN, 0xF8);
+  uint64_t worst = 0;
+  for (size_t i = 48; i < t.size(); i++) {
+    uint64_t d = t[i] - t[i - 1];
+    uint64_t e = d > TICK_120 ? d - TICK_120 : TICK_120 - d;
+    if (e > worst) worst = e;
+  }
+  TEST_ASSERT_TRUE(worst < 200);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_clock_bypasses_queue);
+  RUN_TEST(test_internal_generator);
+  RUN_TEST(test_dividers);
+  RUN_TEST(test_pll_smooths_input);
+  return UNITY_END();
+}
@@ -0,0 +1,233 @@
+#include "../sim_test.h"
+#include "midi_output.h"
+#include "midi_queue.h"
+#include "midi_parser.h"
+
+// ======================================================
+// Выходы: настройки с core0, кодер линии, пачки USB
+// ======================================================
+
+void setUp() {
+  wire.clear();
+}
+
+void tearDown() {}
+
+// Настройку применяет core1 в своём проходе, не core0 при вызове
+static void test_policy_applied_by_core1() {
+  MidiQueueStats st;
+  TEST_ASSERT_TRUE(midi_out_set_policy(2, OVERFLOW_COALESCE_CC));
+  midi_out_get_queue_stats(2, st);
+  TEST_ASSERT_EQUAL(OVERFLOW_DROP_OLDEST, st.policy);
+
+  run_for(100);
+  midi_out_get_queue_stats(2, st);
+  TEST_ASSERT_EQUAL(OVERFLOW_COALESCE_CC, st.policy);
+
+  TEST_ASSERT_FALSE(midi_out_set_policy(10, OVERFLOW_DROP_NEWEST));
+  TEST_ASSERT_FALSE(midi_out_set_policy(0, OVERFLOW_COALESCE_CC + 1));
+}
+
+// Аккорд "test" с core0 играет core1; NoteOff — с колеса через 500 мс
+static void test_chord_request_runs_on_core1() {
+  TEST_ASSERT_TRUE(midi_out_request_test());
+  TEST_ASSERT_EQUAL(0, midi_out_backlog());
+
+  run_for(5000);
+  TEST_ASSERT_WIRE(1, 0x90, 60, 100, 64, 100, 67, 100);   // running status
+
+  wire.clear();
+  run_for(500000);
+  TEST_ASSERT_WIRE(1, 0x80, 60, 0, 64, 0, 67, 0);
+}
+
+// --- Кодер линии: байты на TRS A (как send_midi из core1) ---
+#define SINK_A 2
+
+static void send_a(uint8_t st, uint8_t d1, uint8_t d2) {
+  send_midi(SINK_A, midi_word_msg(USB_CABLE_ROUTER, st, d1, d2));
+}
+
+static void set_encoding(uint8_t enc) {
+  TEST_ASSERT_TRUE(midi_out_set_encoding(SINK_A, enc));
+  run_for(100);
+  TEST_ASSERT_EQUAL(enc, midi_out_get_encoding(SINK_A));
+  wire.clear();
+}
+
+static void test_running_status_byte_counts() {
+  set_encoding(ENCODE_RUNNING);
+  MidiQueueStats before, after;
+  midi_out_get_queue_stats(0, before);
+
+  send_a(0x90, 60, 100);
+  send_a(0x90, 64, 100);
+  run_for(5000);
+  send_a(0xF8, 0, 0);        // realtime (мимо очереди) running status не сбрасывает
+  run_for(1000);
+  send_a(0x90, 67, 100);
+  send_a(0x80, 60, 0);
+  send_a(0x80, 64, 0);
+  run_for(10000);
+
+  TEST_ASSERT_WIRE(SINK_A, 0x90, 60, 100, 64, 100, 0xF8, 67, 100, 0x80, 60, 0, 64, 0);
+  midi_out_get_queue_stats(0, after);
+  TEST_ASSERT_EQUAL(13, after.wireBytes - before.wireBytes);
+  TEST_ASSERT_EQUAL(3, after.savedBytes - before.savedBytes);
+}
+
+static void test_noteoff_as_noteon_zero() {
+  set_encoding(ENCODE_RUNNING_NOTEON);
+  send_a(0x90, 60, 100);
+  send_a(0x80, 60, 64);
+  send_a(0xF3, 1, 0);        // System Common — сброс
+  send_a(0x90, 62, 100);
+  run_for(10000);
+  TEST_ASSERT_WIRE(SINK_A, 0x90, 60, 100, 60, 0, 0xF3, 1, 0x90, 62, 100);
+}
+
+static void test_full_status() {
+  set_encoding(ENCODE_FULL);
+  send_a(0xB0, 7, 1);
+  send_a(0xB0, 7, 2);
+  run_for(10000);
+  TEST_ASSERT_WIRE(SINK_A, 0xB0, 7, 1, 0xB0, 7, 2);
+}
+
+// Смена кодирования: первое сообщение после неё — со статусом
+static void test_encoding_change_resets_running_status() {
+  set_encoding(ENCODE_RUNNING_NOTEON);
+  send_a(0x90, 60, 100);
+  run_for(5000);
+  set_encoding(ENCODE_RUNNING);
+  send_a(0x90, 62, 100);
+  send_a(0x90, 64, 100);
+  run_for(10000);
+  TEST_ASSERT_WIRE(SINK_A, 0x90, 62, 100, 64, 100);
+
+  TEST_ASSERT_FALSE(midi_out_set_encoding(0, ENCODE_FULL));   // USB — пакеты
+  TEST_ASSERT_FALSE(midi_out_set_encoding(SINK_A, ENCODE_RUNNING_NOTEON + 1));
+}
+
+// --- SysEx в переполненную очередь: кусок целиком или никак ---
+// Куски режет парсер, как на входе; политика порта — drop-oldest
+static void sysex_to_a(const MidiWord *words, uint8_t count, uint8_t, uint32_t ts, void *) {
+  send_midi_words(SINK_A, words, count, ts);
+}
+
+static void feed_sysex(uint16_t body) {
+  static MidiParser p;
+  midi_parser_init(p, nullptr, sysex_to_a, nullptr, USB_CABLE_ROUTER);
+  midi_parser_feed(p, 0xF0, 0);
+  for (uint16_t i = 0; i < body; i++) midi_parser_feed(p, i & 0x7F, 0);
+  midi_parser_feed(p, 0xF7, 0);
+}
+
+// Начало не влезло — на линии нет ни F0, ни хвоста; очередь цела
+static void test_sysex_start_dropped_whole() {
+  set_encoding(ENCODE_RUNNING);
+  MidiQueueStats before, after;
+  midi_out_get_queue_stats(0, before);
+  for (uint8_t i = 0; i < MIDI_QUEUE_SIZE - 8; i++) send_a(0x90, i, 100);
+  feed_sysex(100);            // 34 слова: первый кусок в 8 слотов не встаёт
+  send_a(0x80, 0, 0);
+  run_for(100000);
+
+  std::vector<uint8_t> a = wire_bytes(SINK_A);
+  TEST_ASSERT_EQUAL(1 + 2 * (MIDI_QUEUE_SIZE - 8) + 3, a.size());
+  TEST_ASSERT_EQUAL_HEX8(0x90, a[0]);
+  for (uint8_t i = 0; i < MIDI_QUEUE_SIZE - 8; i++) TEST_ASSERT_EQUAL(i, a[1 + 2 * i]);
+  TEST_ASSERT_EQUAL_HEX8(0x80, a[a.size() - 3]);
+  midi_out_get_queue_stats(0, after);
+  TEST_ASSERT_EQUAL(34, after.drops - before.drops);
+}
+
+// Начатый SysEx не влез целиком — закрыт F7; дальше статус идёт заново
+static void test_sysex_cut_closed_with_f7() {
+  set_encoding(ENCODE_RUNNING);
+  send_a(0x90, 60, 100);
+  feed_sysex(300);            // 102 слова при очереди в 64
+  send_a(0x90, 62, 100);
+  run_for(200000);
+
+  std::vector<uint8_t> a = wire_bytes(SINK_A);
+  TEST_ASSERT_EQUAL_HEX8(0xF0, a[3]);
+  size_t f7 = 4;
+  while (f7 < a.size() && a[f7] < 0x80) {
+    TEST_ASSERT_EQUAL((f7 - 4) & 0x7F, a[f7]);   // данные подряд, без дыр
+    f7++;
+  }
+  TEST_ASSERT_TRUE(f7 < a.size());
+  TEST_ASSERT_EQUAL_HEX8(0xF7, a[f7]);
+  TEST_ASSERT_TRUE(f7 - 3 < 1 + 300);                      // хвост выброшен
+  TEST_ASSERT_EQUAL(0, (f7 - 3) % MIDI_SYSEX_CHUNK);       // кусками целиком
+  TEST_ASSERT_EQUAL(f7 + 4, a.size());
+  TEST_ASSERT_EQUAL_HEX8(0x90, a[f7 + 1]);                 // running status не уцелел
+  TEST_ASSERT_EQUAL(62, a[f7 + 2]);
+
+  // следующий SysEx в пустую очередь — целиком
+  wire.clear();
+  feed_sysex(60);
+  run_for(50000);
+  a = wire_bytes(SINK_A);
+  TEST_ASSERT_EQUAL(62, a.size());
+  TEST_ASSERT_EQUAL_HEX8(0xF7, a.back());
+}
+
+// --- Пачки USB: аккорд — один трансфер ---
+static const uint8_t chord[8] = {0, 0, 0x1D, 0x1B, 0x06, 0, 0, 0};
+static const uint8_t keysUp[8] = {};
+
+static void test_usb_chord_is_one_flush() {
+  UsbOutStats before, after;
+  midi_out_get_usb_stats(before);
+  sim_hid_report(chord, sizeof(chord));
+  run_for(3000);
+  midi_out_get_usb_stats(after);
+
+  TEST_ASSERT_EQUAL(3, after.packets - before.packets);
+  TEST_ASSERT_EQUAL(1, after.flushes - before.flushes);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 64, 127, 0x09, 0x90, 62, 127, 0x09, 0x90, 60, 127);   // по HID-кодам
+
+  sim_hid_report(keysUp, sizeof(keysUp));
+  run_for(3000);
+}
+
+// frame: что накопилось за кадр USB (1 мс), уходит одной пачкой
+static void test_usb_flush_per_frame() {
+  TEST_ASSERT_TRUE(midi_out_set_usb_flush(USB_FLUSH_FRAME));
+  run_for(1000);
+  UsbOutStats before, after;
+  midi_out_get_usb_stats(before);
+  TEST_ASSERT_EQUAL(USB_FLUSH_FRAME, before.mode);
+
+  run_for(1000 - sim_now() % 1000 + 100);   // четыре пакета — внутри одного кадра
+  for (uint8_t i = 0; i < 4; i++) {
+    send_midi(0, midi_word_msg(USB_CABLE_ROUTER, 0xB0, 1, i));
+    run_for(100);
+  }
+  run_for(2000);
+  midi_out_get_usb_stats(after);
+  TEST_ASSERT_EQUAL(4, after.packets - before.packets);
+  TEST_ASSERT_TRUE(after.flushes - before.flushes <= 2);
+
+  TEST_ASSERT_TRUE(midi_out_set_usb_flush(USB_FLUSH_PASS));
+  TEST_ASSERT_FALSE(midi_out_set_usb_flush(USB_FLUSH_FRAME + 1));
+  run_for(100);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_policy_applied_by_core1);
+  RUN_TEST(test_chord_request_runs_on_core1);
+  RUN_TEST(test_running_status_byte_counts);
+  RUN_TEST(test_noteoff_as_noteon_zero);
+  RUN_TEST(test_full_status);
+  RUN_TEST(test_encoding_change_resets_running_status);
+  RUN_TEST(test_sysex_start_dropped_whole);
+  RUN_TEST(test_sysex_cut_closed_with_f7);
+  RUN_TEST(test_usb_chord_is_one_flush);
+  RUN_TEST(test_usb_flush_per_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,299 @@
+#include <unity.h>
+#include <vector>
+#include "midi_parser.h"
+
+// ======================================================
+// Потоковый парсер: running status, realtime, SysEx
+// ======================================================
+
+struct Chunk {
+  std::vector<MidiWord> words;
+  uint8_t flags;
+};
+
+static MidiParser parser;
+static std::vector<MidiWord> events;
+static std::vector<Chunk> chunks;
+
+static void on_event(const MidiEvent &ev, void *) {
+  events.push_back(ev.word);
+}
+
+static void on_sysex(const MidiWord *words, uint8_t count, uint8_t flags, uint32_t, void *) {
+  chunks.push_back({std::vector<MidiWord>(words, words + count), flags});
+}
+
+static void feed(std::initializer_list<uint8_t> bytes) {
+  for (uint8_t b : bytes) midi_parser_feed(parser, b, 0);
+}
+
+void setUp() {
+  events.clear();
+  chunks.clear();
+  midi_parser_init(parser, on_event, on_sysex, nullptr, 1);
+}
+
+void tearDown() {}
+
+static void test_running_status() {
+  feed({0x90, 60, 100, 64, 100, 67, 0});
+  TEST_ASSERT_EQUAL(3, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x9, 0x90, 60, 100), events[0]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x9, 0x90, 64, 100), events[1]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x9, 0x90, 67, 0), events[2]);
+
+  // Program Change: один байт данных, тоже с running status
+  events.clear();
+  feed({0xC3, 5, 6});
+  TEST_ASSERT_EQUAL(2, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0xC, 0xC3, 6, 0), events[1]);
+}
+
+static void test_data_without_status_ignored() {
+  feed({60, 100, 0x80, 60});
+  TEST_ASSERT_EQUAL(0, events.size());
+  feed({0});
+  TEST_ASSERT_EQUAL(1, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x8, 0x80, 60, 0), events[0]);
+}
+
+static void test_system_common_cancels_running_status() {
+  feed({0xB0, 7, 100, 0xF3, 2, 7, 50});
+  TEST_ASSERT_EQUAL(2, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x2, 0xF3, 2, 0), events[1]);
+
+  events.clear();
+  feed({0xF2, 0x10, 0x20, 0xF6});
+  TEST_ASSERT_EQUAL(2, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x3, 0xF2, 0x10, 0x20), events[0]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x5, 0xF6, 0, 0), events[1]);
+}
+
+// Realtime посреди сообщения: выходит сразу, сообщение собирается дальше
+static void test_realtime_inside_message() {
+  feed({0x90, 60, 0xF8, 100, 0xFE, 62, 0xFA, 90});
+  TEST_ASSERT_EQUAL(5, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0xF, 0xF8, 0, 0), events[0]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x9, 0x90, 60, 100), events[1]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0xF, 0xFE, 0, 0), events[2]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0xF, 0xFA, 0, 0), events[3]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x9, 0x90, 62, 90), events[4]);
+}
+
+static void test_sysex_words() {
+  feed({0xF0, 0x7E, 0x7F, 0x06, 0xF8, 0x01, 0xF7});
+  TEST_ASSERT_EQUAL(1, events.size());   // clock посреди SysEx
+  TEST_ASSERT_EQUAL(1, chunks.size());
+  TEST_ASSERT_EQUAL(SYSEX_START | SYSEX_END, chunks[0].flags);
+  TEST_ASSERT_EQUAL(2, chunks[0].words.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x4, 0xF0, 0x7E, 0x7F), chunks[0].words[0]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x7, 0x06, 0x01, 0xF7), chunks[0].words[1]);
+}
+
+// Длинный SysEx — кусками по MIDI_SYSEX_CHUNK байт
+static void test_sysex_chunks() {
+  feed({0xF0});
+  for (uint8_t i = 0; i < MIDI_SYSEX_CHUNK; i++) midi_parser_feed(parser, i, 0);
+  feed({0xF7});
+
+  TEST_ASSERT_EQUAL(2, chunks.size());
+  TEST_ASSERT_EQUAL(SYSEX_START, chunks[0].flags);
+  TEST_ASSERT_EQUAL(MIDI_SYSEX_WORDS, chunks[0].words.size());
+  TEST_ASSERT_EQUAL(SYSEX_END, chunks[1].flags);
+  TEST_ASSERT_EQUAL(1, chunks[1].words.size());
+  // F0 + 48 байт: в последнем слове — байт 47 и F7
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x6, 47, 0xF7, 0), chunks[1].words[0]);
+}
+
+// Статус посреди SysEx: парсер закрывает его сам, сообщение не теряется
+static void test_sysex_abort() {
+  feed({0xF0, 0x43, 0x10, 0x90, 60, 100});
+  TEST_ASSERT_EQUAL(1, chunks.size());
+  TEST_ASSERT_EQUAL(SYSEX_START | SYSEX_ABORT, chunks[0].flags);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x4, 0xF0, 0x43, 0x10), chunks[0].words[0]);
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x5, 0xF7, 0, 0), chunks[0].words[1]);
+  TEST_ASSERT_EQUAL(1, events.size());
+  TEST_ASSERT_EQUAL_HEX32(midi_word(1, 0x9, 0x90, 60, 100), events[0]);
+}
+
+static void test_msg_len() {
+  TEST_ASSERT_EQUAL(3, midi_msg_len(0x90));
+  TEST_ASSERT_EQUAL(2, midi_msg_len(0xD5));
+  TEST_ASSERT_EQUAL(3, midi_msg_len(0xF2));
+  TEST_ASSERT_EQUAL(1, midi_msg_len(0xF8));
+  TEST_ASSERT_EQUAL(0, midi_msg_len(0xF0));
+  TEST_ASSERT_EQUAL(0, midi_msg_len(0x40));
+}
+
+// ======================================================
+// Свойство: случайный поток → слова → байты = нормализованный поток
+// ======================================================
+// Генератор (xorshift, фиксированное зерно) склеивает сообщения всех
+// видов и ведёт рядом ожидаемый результат: running status развёрнут,
+// бесхозные байты данных и оборванные сообщения выброшены, оборванный
+// SysEx закрыт F7. Realtime вставляется куда угодно — и в SysEx — и
+// сверяется отдельно: он должен выйти тем же байтом, что подан.
+
+static uint64_t rng = 0x2545F4914F6CDD1Dull;
+
+static uint32_t next_rand(uint32_t n) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (uint32_t)(rng % n);
+}
+
+static uint8_t rand_data() {
+  return (uint8_t)next_rand(0x80);
+}
+
+static std::vector<uint8_t> fuzzOut;   // сообщения и SysEx, байтами
+static std::vector<uint8_t> fuzzRt;    // realtime, как вышел
+static uint8_t fuzzFed;                // байт, который сейчас в парсере
+static uint32_t fuzzAborts;
+
+static void fuzz_event(const MidiEvent &ev, void *) {
+  TEST_ASSERT_EQUAL(1, midi_word_cable(ev.word));
+  uint8_t st = midi_word_status(ev.word);
+  if (st >= 0xF8) {
+    TEST_ASSERT_EQUAL_HEX8(fuzzFed, st);   // realtime — сразу, не позже
+    fuzzRt.push_back(st);
+    return;
+  }
+  uint8_t data[3];
+  fuzzOut.insert(fuzzOut.end(), data, data + midi_word_bytes(ev.word, data));
+}
+
+static void fuzz_sysex(const MidiWord *words, uint8_t count, uint8_t flags, uint32_t, void *) {
+  TEST_ASSERT_TRUE(count > 0 && count <= MIDI_SYSEX_WORDS);
+  size_t from = fuzzOut.size();
+  for (uint8_t i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL(1, midi_word_cable(words[i]));
+    uint8_t data[3];
+    uint8_t n = midi_word_bytes(words[i], data);
+    TEST_ASSERT_TRUE(midi_word_cin(words[i]) == MIDI_CIN_SYSEX || i == count - 1);   // F7 — только в последнем
+    fuzzOut.insert(fuzzOut.end(), data, data + n);
+  }
+  bool end = fuzzOut.back() == 0xF7;
+  TEST_ASSERT_EQUAL(fuzzOut[from] == 0xF0, (flags & SYSEX_START) != 0);
+  TEST_ASSERT_EQUAL(end, (flags & (SYSEX_END | SYSEX_ABORT)) != 0);
+  if (!end) TEST_ASSERT_EQUAL(MIDI_SYSEX_WORDS, count);   // середина — полный кусок
+  if (flags & SYSEX_ABORT) fuzzAborts++;
+}
+
+enum FuzzItem { ITEM_VOICE, ITEM_RUNNING, ITEM_STRAY, ITEM_COMMON, ITEM_SYSEX, ITEM_SYSEX_CUT, ITEM_CUT, ITEM_COUNT };
+
+// Один поток: items элементов; in — что подаём, expect — что должно выйти
+static void fuzz_stream(uint8_t items, std::vector<uint8_t> &in, std::vector<uint8_t> &expect,
+                        std::vector<uint8_t> &rt, uint32_t &aborts) {
+  static const uint8_t realtime[] = {0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF};
+  static const uint8_t common[] = {0xF1, 0xF2, 0xF3, 0xF6};
+  uint8_t rs = 0;            // running status глазами парсера
+  bool needStatus = false;   // предыдущий элемент оборван — дальше статус
+
+  for (uint8_t k = 0; k < items; k++) {
+    uint8_t item = (uint8_t)next_rand(ITEM_COUNT);
+    bool last = k + 1 == items;
+    if (item == ITEM_RUNNING && (!rs || needStatus)) item = ITEM_VOICE;
+    if (item == ITEM_STRAY && (rs || needStatus)) item = ITEM_COMMON;
+    if ((item == ITEM_SYSEX_CUT || item == ITEM_CUT) && last) item = ITEM_SYSEX;
+    needStatus = false;
+
+    std::vector<uint8_t> bytes;
+    switch (item) {
+      case ITEM_VOICE: {
+        rs = (uint8_t)(0x80 + next_rand(0x70));
+        bytes.push_back(rs);
+      }
+      // fallthrough
+      case ITEM_RUNNING: {
+        uint8_t n = midi_msg_len(rs);
+        for (uint8_t i = 1; i < n; i++) bytes.push_back(rand_data());
+        expect.push_back(rs);
+        expect.insert(expect.end(), bytes.end() - (n - 1), bytes.end());
+        break;
+      }
+      case ITEM_STRAY:
+        for (uint8_t i = 0, n = 1 + next_rand(3); i < n; i++) bytes.push_back(rand_data());
+        break;
+      case ITEM_COMMON: {
+        uint8_t st = common[next_rand(sizeof(common))];
+        bytes.push_back(st);
+        for (uint8_t i = 1; i < midi_msg_len(st); i++) bytes.push_back(rand_data());
+        expect.insert(expect.end(), bytes.begin(), bytes.end());
+        rs = 0;
+        break;
+      }
+      case ITEM_SYSEX:
+      case ITEM_SYSEX_CUT: {
+        // длина до трёх кусков: границы куска и слова — с обеих сторон
+        uint16_t body = (uint16_t)(next_rand(4) == 0 ? next_rand(4) : next_rand(3 * MIDI_SYSEX_CHUNK + 4));
+        bytes.push_back(0xF0);
+        for (uint16_t i = 0; i < body; i++) bytes.push_back(rand_data());
+        expect.insert(expect.end(), bytes.begin(), bytes.end());
+        expect.push_back(0xF7);   // у оборванного F7 добавит парсер
+        if (item == ITEM_SYSEX) bytes.push_back(0xF7);
+        else aborts++;
+        needStatus = item == ITEM_SYSEX_CUT;
+        rs = 0;
+        break;
+      }
+      case ITEM_CUT: {
+        uint8_t st = (uint8_t)(0x80 + next_rand(0x70));
+        bytes.push_back(st);
+        for (uint8_t i = 0, n = (uint8_t)next_rand(midi_msg_len(st) - 1); i < n; i++) bytes.push_back(rand_data());
+        needStatus = true;
+        rs = st;   // следующий элемент начнётся со статуса
+        break;
+      }
+    }
+
+    // realtime — перед любым байтом элемента
+    for (size_t i = 0; i < bytes.size(); i++) {
+      while (next_rand(8) == 0) {
+        uint8_t b = realtime[next_rand(sizeof(realtime))];
+        in.push_back(b);
+        rt.push_back(b);
+      }
+      in.push_back(bytes[i]);
+    }
+  }
+}
+
+static void test_fuzz_round_trip() {
+  midi_parser_init(parser, fuzz_event, fuzz_sysex, nullptr, 1);
+  for (uint16_t iter = 0; iter < 5000; iter++) {
+    std::vector<uint8_t> in, expect, rt;
+    uint32_t aborts = 0;
+    fuzz_stream((uint8_t)(1 + next_rand(24)), in, expect, rt, aborts);
+
+    midi_parser_reset(parser);
+    fuzzOut.clear();
+    fuzzRt.clear();
+    fuzzAborts = 0;
+    for (uint8_t b : in) {
+      fuzzFed = b;
+      midi_parser_feed(parser, b, 0);
+    }
+
+    TEST_ASSERT_EQUAL_MESSAGE(expect.size(), fuzzOut.size(), "stream length");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expect.data(), fuzzOut.data(), expect.size());
+    TEST_ASSERT_EQUAL(rt.size(), fuzzRt.size());
+    if (!rt.empty()) TEST_ASSERT_EQUAL_HEX8_ARRAY(rt.data(), fuzzRt.data(), rt.size());
+    TEST_ASSERT_EQUAL(aborts, fuzzAborts);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_running_status);
+  RUN_TEST(test_data_without_status_ignored);
+  RUN_TEST(test_system_common_cancels_running_status);
+  RUN_TEST(test_realtime_inside_message);
+  RUN_TEST(test_sysex_words);
+  RUN_TEST(test_sysex_chunks);
+  RUN_TEST(test_sysex_abort);
+  RUN_TEST(test_msg_len);
+  RUN_TEST(test_fuzz_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,160 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "midi_word.h"
+#include "midi_parser.h"
+
+// ======================================================
+// MidiWord: сообщение → слово → байты и пакет USB-MIDI
+// ======================================================
+
+static MidiParser parser;
+static std::vector<uint8_t> out;     // байты обратно из слов парсера
+static std::vector<MidiWord> words;
+
+static void on_event(const MidiEvent &ev, void *) {
+  uint8_t data[3];
+  out.insert(out.end(), data, data + midi_word_bytes(ev.word, data));
+  words.push_back(ev.word);
+}
+
+static void on_sysex(const MidiWord *w, uint8_t count, uint8_t, uint32_t, void *) {
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t data[3];
+    out.insert(out.end(), data, data + midi_word_bytes(w[i], data));
+    words.push_back(w[i]);
+  }
+}
+
+void setUp() {
+  out.clear();
+  words.clear();
+  midi_parser_init(parser, on_event, on_sysex, nullptr, 3);
+}
+
+void tearDown() {}
+
+// Канальные сообщения на всех кабелях: байты и кабель — обратно те же
+static void test_channel_round_trip() {
+  static const uint8_t len[8] = {3, 3, 3, 3, 2, 2, 3};   // 8x–Ex
+  for (uint8_t cable = 0; cable < 16; cable++) {
+    for (uint8_t st = 0x80; st < 0xF0; st++) {
+      MidiWord w = midi_word_msg(cable, st, 0x12, 0x34);
+      uint8_t n = len[(st >> 4) - 8];
+      uint8_t data[3] = {};
+      TEST_ASSERT_EQUAL(n, midi_word_bytes(w, data));
+      TEST_ASSERT_EQUAL(cable, midi_word_cable(w));
+      TEST_ASSERT_EQUAL(st >> 4, midi_word_cin(w));
+      TEST_ASSERT_EQUAL_HEX8(st, data[0]);
+      TEST_ASSERT_EQUAL_HEX8(0x12, data[1]);
+      if (n == 3) TEST_ASSERT_EQUAL_HEX8(0x34, data[2]);
+      else TEST_ASSERT_EQUAL(0, midi_word_data2(w));   // лишний байт обнулён
+    }
+  }
+}
+
+// System Common и Realtime: длина по статусу, лишние байты — нули
+static void test_system_lengths() {
+  struct { uint8_t st; uint8_t cin; uint8_t len; } sys[] = {
+    {0xF1, 0x2, 2}, {0xF2, 0x3, 3}, {0xF3, 0x2, 2}, {0xF6, 0x5, 1},
+    {0xF8, 0xF, 1}, {0xFA, 0xF, 1}, {0xFC, 0xF, 1}, {0xFF, 0xF, 1},
+  };
+  for (auto &s : sys) {
+    MidiWord w = midi_word_msg(1, s.st, 0x7F, 0x7F);
+    TEST_ASSERT_EQUAL(s.cin, midi_word_cin(w));
+    TEST_ASSERT_EQUAL(s.len, midi_word_len(w));
+    if (s.len < 3) TEST_ASSERT_EQUAL_HEX32(0, w >> (8 * (s.len + 1)));
+    TEST_ASSERT_EQUAL_HEX8(s.st, midi_word_status(w));
+  }
+  TEST_ASSERT_EQUAL(0, midi_word_len(midi_word(0, 0x0, 0x90, 1, 2)));   // CIN 0/1 — резерв
+  TEST_ASSERT_EQUAL(0, midi_word_len(midi_word(0, 0x1, 0x90, 1, 2)));
+}
+
+// Слово в памяти — готовый пакет USB-MIDI; смена кабеля не трогает сообщение
+static void test_word_is_usb_packet() {
+  MidiWord w = midi_word_msg(5, 0x9A, 60, 100);
+  uint8_t pkt[4];
+  memcpy(pkt, &w, sizeof(pkt));
+  TEST_ASSERT_EQUAL_HEX8(0x59, pkt[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x9A, pkt[1]);
+  TEST_ASSERT_EQUAL_HEX8(60, pkt[2]);
+  TEST_ASSERT_EQUAL_HEX8(100, pkt[3]);
+
+  MidiWord moved = midi_word_set_cable(w, 11);
+  TEST_ASSERT_EQUAL(11, midi_word_cable(moved));
+  TEST_ASSERT_EQUAL_HEX32(w & ~0xF0u, moved & ~0xF0u);
+  TEST_ASSERT_EQUAL(60, midi_word_byte(moved, 1));
+}
+
+// Поток → парсер → слова → байты: тот же поток, running status развёрнут
+static void test_parser_round_trip() {
+  const uint8_t in[] = {0x90, 60, 100, 64, 100, 0xF8, 0xC2, 5, 0xE0, 0, 64, 0xF2, 1, 2, 0xF6};
+  for (uint8_t b : in) midi_parser_feed(parser, b, 0);
+  const uint8_t expect[] = {0x90, 60, 100, 0x90, 64, 100, 0xF8, 0xC2, 5, 0xE0, 0, 64, 0xF2, 1, 2, 0xF6};
+  TEST_ASSERT_EQUAL(sizeof(expect), out.size());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, out.data(), sizeof(expect));
+  for (MidiWord w : words) TEST_ASSERT_EQUAL(3, midi_word_cable(w));
+}
+
+// SysEx — цепочка слов CIN 0x4, последнее 0x5/0x6/0x7 по числу байтов с F7
+static void test_sysex_chain_round_trip() {
+  for (uint8_t body = 1; body <= 6; body++) {
+    setUp();
+    std::vector<uint8_t> in = {0xF0};
+    for (uint8_t i = 0; i < body; i++) in.push_back(i + 1);
+    in.push_back(0xF7);
+    for (uint8_t b : in) midi_parser_feed(parser, b, 0);
+
+    TEST_ASSERT_EQUAL(in.size(), out.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(in.data(), out.data(), in.size());
+    TEST_ASSERT_EQUAL((in.size() + 2) / 3, words.size());
+    for (size_t i = 0; i + 1 < words.size(); i++) TEST_ASSERT_EQUAL(MIDI_CIN_SYSEX, midi_word_cin(words[i]));
+    uint8_t tail = (uint8_t)(in.size() - 3 * (words.size() - 1));
+    TEST_ASSERT_EQUAL(MIDI_CIN_SYSEX_END1 + tail - 1, midi_word_cin(words.back()));
+  }
+}
+
+// Случайные сообщения (фиксированное зерно): слово → байты → парсер →
+// слово; пакет USB-MIDI из памяти слова — то же слово
+static uint64_t rng = 0xD1B54A32D192ED03ull;
+
+static uint32_t next_rand(uint32_t n) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (uint32_t)(rng % n);
+}
+
+static void test_random_round_trip() {
+  static const uint8_t system[] = {0xF1, 0xF2, 0xF3, 0xF6, 0xF8, 0xFA, 0xFB, 0xFC, 0xFE, 0xFF};
+  for (uint16_t n = 0; n < 5000; n++) {
+    uint8_t cable = (uint8_t)next_rand(16);
+    uint8_t st = next_rand(4) ? (uint8_t)(0x80 + next_rand(0x70)) : system[next_rand(sizeof(system))];
+    MidiWord w = midi_word_msg(cable, st, (uint8_t)next_rand(0x80), (uint8_t)next_rand(0x80));
+    TEST_ASSERT_EQUAL(midi_msg_len(st), midi_word_len(w));
+
+    uint8_t pkt[4];
+    memcpy(pkt, &w, sizeof(pkt));
+    TEST_ASSERT_EQUAL_HEX32(w, midi_word(pkt[0] >> 4, pkt[0], pkt[1], pkt[2], pkt[3]));
+
+    out.clear();
+    words.clear();
+    midi_parser_init(parser, on_event, on_sysex, nullptr, cable);
+    uint8_t data[3];
+    uint8_t len = midi_word_bytes(w, data);
+    for (uint8_t i = 0; i < len; i++) midi_parser_feed(parser, data[i], 0);
+    TEST_ASSERT_EQUAL(1, words.size());
+    TEST_ASSERT_EQUAL_HEX32(w, words[0]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_channel_round_trip);
+  RUN_TEST(test_system_lengths);
+  RUN_TEST(test_word_is_usb_packet);
+  RUN_TEST(test_parser_round_trip);
+  RUN_TEST(test_sysex_chain_round_trip);
+  RUN_TEST(test_random_round_trip);
+  return UNITY_END();
+}
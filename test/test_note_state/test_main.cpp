@@ -0,0 +1,151 @@
+#include "../sim_test.h"
+#include "note_state.h"
+#include "scheduler.h"
+#include "midi_output.h"
+#include "config_manager.h"
+#include "preset_store.h"
+#include "hardware/timer.h"
+
+// ======================================================
+// Звучащие ноты: сброс гасит только их, и ничего не звучит после
+// ======================================================
+
+#define SINK_DIN 1
+#define SINK_A   2
+
+static void note(uint8_t sink, uint8_t st, uint8_t n, uint8_t v) {
+  send_midi(sink, midi_word_msg(USB_CABLE_ROUTER, st, n, v));
+}
+
+static NotesPortStats port(uint8_t sink) {
+  NotesPortStats st;
+  notes_get_port(sink, st);
+  return st;
+}
+
+static SchedStats sched() {
+  SchedStats st;
+  sched_get_stats(st);
+  return st;
+}
+
+void setUp() {
+  run_for(20000);   // дать линиям опустеть
+  wire.clear();
+}
+
+void tearDown() {}
+
+// PANIC с core0: NoteOff — звучащим нотам, уже отпущенным — нет
+static void test_panic_releases_sounding_only() {
+  note(SINK_DIN, 0x90, 60, 100);
+  note(SINK_DIN, 0x90, 64, 100);
+  note(SINK_DIN, 0x91, 67, 100);
+  note(SINK_DIN, 0x80, 64, 0);
+  note(SINK_DIN, 0x91, 69, 0);   // NoteOn vel 0 — тоже отпускание
+  run_for(10000);
+  TEST_ASSERT_EQUAL(2, port(SINK_DIN).sounding);
+  TEST_ASSERT_EQUAL(0x3, port(SINK_DIN).channels);
+
+  wire.clear();
+  TEST_ASSERT_TRUE(notes_post_release(DEST_DIN));
+  run_for(10000);
+  TEST_ASSERT_WIRE(SINK_DIN, 0x80, 60, 0, 0x81, 67, 0);
+  TEST_ASSERT_EQUAL(0, port(SINK_DIN).sounding);
+
+  wire.clear();
+  TEST_ASSERT_TRUE(notes_post_release(DEST_DIN));   // второй раз гасить нечего
+  run_for(10000);
+  TEST_ASSERT_EQUAL(0, wire_bytes(SINK_DIN).size());
+}
+
+// Маска каналов и выходов: чужое не трогается
+static void test_release_by_channel() {
+  note(SINK_A, 0x90, 60, 100);
+  note(SINK_A, 0x92, 62, 100);
+  note(SINK_DIN, 0x92, 64, 100);
+  run_for(10000);
+  wire.clear();
+
+  notes_release(DEST_PIO(0), 1u << 2);
+  run_for(10000);
+  TEST_ASSERT_WIRE(SINK_A, 0x82, 62, 0);
+  TEST_ASSERT_EQUAL(0, wire_bytes(SINK_DIN).size());
+  TEST_ASSERT_EQUAL(1, port(SINK_A).sounding);
+
+  notes_release(DEST_ALL);
+  run_for(10000);
+  TEST_ASSERT_EQUAL(0, port(SINK_A).sounding);
+  TEST_ASSERT_EQUAL(0, port(SINK_DIN).sounding);
+}
+
+// NoteOn, ждущий компенсации на колесе, после PANIC не звучит;
+// NoteOff и прочее на колесе уходят, как шли
+static void test_panic_cancels_delayed_note_on() {
+  TEST_ASSERT_TRUE(sched_set_latency(DEST_DIN, 5000));   // A ждёт 5 мс
+  run_for(100);
+  uint32_t before = sched().cancelled;
+
+  send_midi_mask(DEST_DIN | DEST_PIO(0), midi_word_msg(USB_CABLE_ROUTER, 0x90, 60, 100));
+  send_midi_mask(DEST_PIO(0), midi_word_msg(USB_CABLE_ROUTER, 0xB0, 7, 90));
+  run_for(1000);
+  TEST_ASSERT_EQUAL(1, port(SINK_DIN).sounding);
+  TEST_ASSERT_EQUAL(0, port(SINK_A).sounding);
+
+  TEST_ASSERT_TRUE(notes_post_release(DEST_ALL));
+  run_for(20000);
+  TEST_ASSERT_WIRE(SINK_DIN, 0x90, 60, 100, 0x80, 60, 0);
+  TEST_ASSERT_WIRE(SINK_A, 0xB0, 7, 90);
+  TEST_ASSERT_EQUAL(0, port(SINK_A).sounding);
+  TEST_ASSERT_EQUAL(before + 1, sched().cancelled);
+  TEST_ASSERT_EQUAL(0, sched().pending);
+
+  TEST_ASSERT_TRUE(sched_set_latency(DEST_DIN, 0));
+  run_for(100);
+}
+
+// Эхо: повторы NoteOn снимаются сбросом, нота гаснет и не возвращается
+static void test_panic_cancels_echo_repeats() {
+  TEST_ASSERT_TRUE(sched_set_echo(DEST_PIO(0), 10, 3, 50));
+  run_for(100);
+
+  send_midi_mask(DEST_PIO(0), midi_word_msg(USB_CABLE_ROUTER, 0x90, 60, 100));
+  run_for(12000);   // первый повтор уже прозвучал
+  TEST_ASSERT_WIRE(SINK_A, 0x90, 60, 100, 60, 50);
+
+  wire.clear();
+  notes_release(DEST_PIO(0));
+  run_for(60000);
+  TEST_ASSERT_WIRE(SINK_A, 0x80, 60, 0);
+  TEST_ASSERT_EQUAL(0, port(SINK_A).sounding);
+
+  TEST_ASSERT_TRUE(sched_set_echo(DEST_PIO(0), 0, 0, 100));
+  run_for(60000);   // смена эха шлёт NoteOff повторам ноты, что ещё ждала своего NoteOff
+}
+
+// Вызов пресета по MIDI (core1) — тот же сброс: ждущие NoteOn снимаются
+static void test_preset_recall_cancels_pending() {
+  TEST_ASSERT_TRUE(save_preset(5));
+  TEST_ASSERT_NOT_NULL(preset_store_get(5));
+  run_for(2000);
+
+  TEST_ASSERT_TRUE(sched_after(5000, DEST_PIO(0), midi_word_msg(USB_CABLE_ROUTER, 0x90, 62, 100)));
+  note(SINK_A, 0x90, 60, 100);
+  run_for(1000);
+  TEST_ASSERT_TRUE(preset_recall(5, time_us_32()));
+  run_for(20000);
+
+  TEST_ASSERT_WIRE(SINK_A, 0x90, 60, 100, 0x80, 60, 0);
+  TEST_ASSERT_EQUAL(0, port(SINK_A).sounding);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_panic_releases_sounding_only);
+  RUN_TEST(test_release_by_channel);
+  RUN_TEST(test_panic_cancels_delayed_note_on);
+  RUN_TEST(test_panic_cancels_echo_repeats);
+  RUN_TEST(test_preset_recall_cancels_pending);
+  return UNITY_END();
+}
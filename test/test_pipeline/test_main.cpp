@@ -0,0 +1,156 @@
+#include "../sim_test.h"
+#include "config_manager.h"
+#include "preset_store.h"
+
+// ======================================================
+// Весь путь: MIDI IN, USB от хоста, клавиатура → выходы
+// ======================================================
+// Конфиг — по умолчанию (config_model_default): клавиши 0x1D/0x1B/0x06 —
+// ноты 60/62/64 на USB, thru без правил — всё на все выходы.
+
+void setUp() {
+  wire.clear();
+}
+
+void tearDown() {}
+
+static void din(const uint8_t *b, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) sim_uart_rx(b[i], sim_now() + (uint64_t)(i + 1) * 320);
+}
+
+static void test_din_thru_reaches_every_output() {
+  const uint8_t msg[] = {0x90, 0x3C, 0x64};
+  din(msg, sizeof(msg));
+  run_for(5000);
+
+  TEST_ASSERT_WIRE(DEST_USB >> 1, 0x19, 0x90, 0x3C, 0x64);   // кабель DIN, CIN 9
+  for (uint8_t s = 1; s < DEST_COUNT; s++) TEST_ASSERT_WIRE(s, 0x90, 0x3C, 0x64);
+}
+
+static void test_usb_cable_goes_to_its_port_only() {
+  const uint8_t pkt[4] = {0x3B, 0xB2, 0x07, 0x50};   // кабель 3 = TRS B, CC 7
+  sim_usb_host_packet(pkt);
+  run_for(5000);
+
+  TEST_ASSERT_WIRE(3, 0xB2, 0x07, 0x50);
+  for (uint8_t s = 0; s < DEST_COUNT; s++)
+    if (s != 3) TEST_ASSERT_EQUAL(0, wire_bytes(s).size());
+}
+
+static void test_key_press_and_release() {
+  const uint8_t down[8] = {0, 0, 0x1D, 0, 0, 0, 0, 0};
+  const uint8_t up[8] = {};
+  sim_hid_report(down, sizeof(down));
+  run_for(3000);
+  sim_hid_report(up, sizeof(up));
+  run_for(3000);
+
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 127, 0x08, 0x80, 60, 0);
+  TEST_ASSERT_EQUAL(0, wire_bytes(1).size());
+}
+
+// Пресет: образ во flash и обратно, таблица маршрутов — вместе с ним
+static void test_preset_round_trip() {
+  ConfigModel saved = config;
+  TEST_ASSERT_TRUE(save_preset(7));
+  TEST_ASSERT_NOT_NULL(preset_store_get(7));
+  TEST_ASSERT_FALSE(save_preset(0));
+  TEST_ASSERT_FALSE(save_preset(MAX_PRESETS + 1));
+
+  config.keys[0].value = 72;
+  compile_routes();
+  TEST_ASSERT_FALSE(load_preset(MAX_PRESETS));   // пустой слот — config не тронут
+  TEST_ASSERT_EQUAL(72, config.keys[0].value);
+  TEST_ASSERT_TRUE(load_preset(7));
+  run_for(2000);
+
+  TEST_ASSERT_EQUAL(saved.count, config.count);
+  TEST_ASSERT_EQUAL_MEMORY(saved.keys, config.keys, sizeof(KeyMapping) * saved.count);
+  TEST_ASSERT_EQUAL(60, routes_in_use()->keys[0x1D].value);
+}
+
+// Вторая компиляция подряд ждёт, пока core1 возьмёт первую, —
+// иначе перепишет буфер, который он читает
+static void test_compile_waits_for_core1() {
+  config.keys[0].value = 48;
+  compile_routes();
+  const RouteTable *first = routes_in_use();
+  compile_routes();
+  TEST_ASSERT_TRUE(routes_in_use() != first);
+  TEST_ASSERT_EQUAL(48, routes_in_use()->keys[0x1D].value);
+
+  load_preset(7);
+  run_for(2000);
+}
+
+// Слой Shift: модификатор и клавиша в одном отчёте — нота из слоя;
+// отпускание — в том слое, где нажали, даже если Shift уже отпущен
+static void test_shift_layer_in_one_report() {
+  ConfigModel saved = config;
+  KeyMapping &k = config.keys[config.count++];
+  k = config.keys[0];
+  k.hid = 0x1D;
+  k.value = 72;
+  k.layer = LAYER_SHIFT;
+  compile_routes();
+  run_for(2000);
+
+  const uint8_t shiftZ[8] = {0x02, 0, 0x1D, 0, 0, 0, 0, 0};
+  const uint8_t zOnly[8] = {0, 0, 0x1D, 0, 0, 0, 0, 0};
+  const uint8_t up[8] = {};
+  sim_hid_report(shiftZ, sizeof(shiftZ));
+  run_for(3000);
+  sim_hid_report(zOnly, sizeof(zOnly));
+  run_for(3000);
+  sim_hid_report(up, sizeof(up));
+  run_for(3000);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 72, 127, 0x08, 0x80, 72, 0);
+
+  config = saved;
+  compile_routes();
+  run_for(2000);
+}
+
+// Кривые на горячем пути: fixed 0 у клавиши даёт NoteOn 1, не NoteOff;
+// invert у правила thru DIN → TRS A переворачивает скорость
+static void test_curves_on_key_and_thru() {
+  ConfigModel saved = config;
+  config.curves[0] = {CURVE_FIXED, 0, 0, 0, 0, 0, {}};
+  config.curves[1] = {CURVE_INVERT, 0, 127, 0, 0, 0, {}};
+  config.curveCount = 2;
+  config.keys[0].curve = 1;
+  ThruRule &r = config.thru[config.thruCount++];
+  r = {THRU_IN_DIN, (uint8_t)(1u << THRU_NOTE_ON), 0x0001, DEST_PIO(0), 0, 2};
+  compile_routes();
+  run_for(2000);
+
+  const uint8_t down[8] = {0, 0, 0x1D, 0, 0, 0, 0, 0};
+  const uint8_t up[8] = {};
+  sim_hid_report(down, sizeof(down));
+  run_for(3000);
+  sim_hid_report(up, sizeof(up));
+  run_for(3000);
+  TEST_ASSERT_WIRE(0, 0x09, 0x90, 60, 1, 0x08, 0x80, 60, 0);
+
+  const uint8_t msg[] = {0x90, 0x3C, 100};
+  din(msg, sizeof(msg));
+  run_for(5000);
+  TEST_ASSERT_WIRE(2, 0x90, 0x3C, 27);
+
+  config = saved;
+  compile_routes();
+  run_for(2000);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_din_thru_reaches_every_output);
+  RUN_TEST(test_usb_cable_goes_to_its_port_only);
+  RUN_TEST(test_key_press_and_release);
+  RUN_TEST(test_preset_round_trip);
+  RUN_TEST(test_compile_waits_for_core1);
+  RUN_TEST(test_shift_layer_in_one_report);
+  RUN_TEST(test_curves_on_key_and_thru);
+  return UNITY_END();
+}
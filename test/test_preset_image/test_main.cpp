@@ -0,0 +1,262 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <ArduinoJson.h>
+#include "preset_image.h"
+
+// ======================================================
+// Образ пресета: сборка, tools/preset_tool.py, перенос v1–v4
+// ======================================================
+// Без симулятора. Утилита запускается как есть (python3 из каталога
+// проекта) и обменивается с тестом файлами в .pio/.
+
+#define TOOL "python3 tools/preset_tool.py "
+
+static const char *CFG_JSON = R"({
+  "0x1D": {"type": "note", "value": 48, "channel": 1, "ports": ["USB", "A"], "curve": 1},
+  "0x1B": {"type": "cc", "value": 7, "channel": 3, "port": "DIN"},
+  "0x06": {"type": "note", "value": 0, "channel": 2, "ports": ["J"]},
+  "0x2C": {"type": "note", "value": 50, "channel": 16, "ports": ["K"]},
+  "shift": {"0x1D": {"type": "note", "value": 72, "channel": 2, "ports": ["B"], "curve": 2}},
+  "ctrl": {"0x1B": {"type": "cc", "value": 20, "channel": 4, "ports": ["C", "D"]}},
+  "curves": [
+    {"type": "exp", "min": 10, "max": 120, "shape": 3},
+    {"type": "linear", "min": 40, "max": 127, "rate": true},
+    {"type": "invert"},
+    {"type": "fixed", "value": 100},
+    {"type": "user", "points": [0, 30, 100, 127]}
+  ],
+  "thru": [
+    {"in": "DIN", "channels": [1, 2], "types": ["note"], "ports": ["B"], "remap": 10, "curve": 3},
+    {"in": "DIN", "types": ["cc"], "ports": []},
+    {"in": "USB", "channels": [16], "ports": ["DIN", "E"], "curve": 5}
+  ]
+})";
+
+static ConfigModel model;
+static PresetImage img, expect;
+
+static void import_json(const char *json, ConfigModel &m) {
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, json));
+  memset(&m, 0, sizeof(m));
+  TEST_ASSERT_TRUE(config_model_import(doc.as<JsonObjectConst>(), m));
+}
+
+static void write_file(const char *path, const void *data, size_t len) {
+  FILE *f = fopen(path, "wb");
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL(len, fwrite(data, 1, len, f));
+  fclose(f);
+}
+
+static std::vector<uint8_t> read_file(const char *path) {
+  std::vector<uint8_t> out;
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL(f);
+  uint8_t buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return out;
+}
+
+// stdout утилиты; код возврата — в rc
+static std::string tool(const char *args, int &rc) {
+  std::string out;
+  FILE *p = popen((std::string(TOOL) + args + " 2>/dev/null").c_str(), "r");
+  TEST_ASSERT_NOT_NULL(p);
+  char buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), p)) > 0;) out.append(buf, n);
+  rc = pclose(p);
+  return out;
+}
+
+// Образ → bin2json → импорт → сборка: то же, что want
+static void assert_tool_reads(const void *image, size_t len, const char *name, const PresetImage &want) {
+  write_file(".pio/preset_test_in.bin", image, len);
+  int rc;
+  std::string json = tool("bin2json .pio/preset_test_in.bin", rc);
+  TEST_ASSERT_EQUAL_MESSAGE(0, rc, "bin2json");
+  import_json(json.c_str(), model);
+  preset_image_build(model, name, img);
+  TEST_ASSERT_EQUAL_MEMORY(&want, &img, sizeof(img));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_build_is_valid() {
+  import_json(CFG_JSON, model);
+  preset_image_build(model, "Live A", img);
+  TEST_ASSERT_TRUE(preset_image_valid(&img));
+  TEST_ASSERT_EQUAL(PRESET_VERSION, img.hdr.version);
+  TEST_ASSERT_EQUAL_STRING("Live A", img.hdr.name);
+
+  img.routes.keys[0x1D].value ^= 1;   // любой байт нагрузки ломает CRC
+  TEST_ASSERT_FALSE(preset_image_valid(&img));
+  img.routes.keys[0x1D].value ^= 1;
+  img.hdr.version = PRESET_VERSION - 1;
+  TEST_ASSERT_FALSE(preset_image_valid(&img));
+  TEST_ASSERT_FALSE(preset_image_valid(nullptr));
+}
+
+// json2bin даёт ровно тот образ, что собирает прошивка из того же JSON
+static void test_tool_json2bin_matches_build() {
+  write_file(".pio/preset_test.json", CFG_JSON, strlen(CFG_JSON));
+  int rc;
+  tool("json2bin .pio/preset_test.json .pio/preset_test.bin --name \"Live A\"", rc);
+  TEST_ASSERT_EQUAL_MESSAGE(0, rc, "json2bin");
+
+  import_json(CFG_JSON, model);
+  preset_image_build(model, "Live A", expect);
+  std::vector<uint8_t> bin = read_file(".pio/preset_test.bin");
+  TEST_ASSERT_EQUAL(sizeof(PresetImage), bin.size());
+  TEST_ASSERT_EQUAL_MEMORY(&expect, bin.data(), sizeof(PresetImage));
+}
+
+// Образ прошивки → bin2json → тот же образ; verify ловит порчу
+static void test_tool_bin2json_round_trip() {
+  import_json(CFG_JSON, model);
+  preset_image_build(model, "Live A", expect);
+  assert_tool_reads(&expect, sizeof(expect), "Live A", expect);
+
+  int rc;
+  tool("verify .pio/preset_test_in.bin", rc);
+  TEST_ASSERT_EQUAL(0, rc);
+  std::vector<uint8_t> bad((const uint8_t *)&expect, (const uint8_t *)&expect + sizeof(expect));
+  bad[sizeof(PresetHeader) + 100] ^= 0x40;
+  write_file(".pio/preset_test_in.bin", bad.data(), bad.size());
+  tool("verify .pio/preset_test_in.bin", rc);
+  TEST_ASSERT_TRUE(rc != 0);
+}
+
+// --- Образы прежних версий, собранные по их раскладке вручную ---
+// заголовок | модель | таблица (её перенос не читает — мусор) | до 4 байт
+struct KeyMappingOld {
+  uint8_t hid, type, value, channel;
+  uint16_t dest;
+};
+
+static const KeyMappingOld oldKeys[] = {
+  {0x1D, ROUTE_NOTE, 48, 1, DEST_USB | DEST_PIO(0)},
+  {0x1B, ROUTE_CC, 7, 3, DEST_DIN},
+  {0x06, ROUTE_NOTE, 0, 2, DEST_PIO(9)},
+};
+static const ThruRule oldThru[] = {
+  {THRU_IN_DIN, 0x03, 0x0003, DEST_PIO(1), 10, 0},
+  {THRU_IN_USB, 0xFF, 0x8000, DEST_DIN, 0, 0},
+};
+
+static std::vector<uint8_t> legacy_image(uint16_t version, const std::vector<uint8_t> &modelBytes,
+                                         size_t routesSize) {
+  size_t total = (sizeof(PresetHeader) + modelBytes.size() + routesSize + 3) & ~(size_t)3;
+  std::vector<uint8_t> buf(total, 0);
+  memcpy(&buf[sizeof(PresetHeader)], modelBytes.data(), modelBytes.size());
+  memset(&buf[sizeof(PresetHeader) + modelBytes.size()], 0xA5, routesSize);
+
+  PresetHeader h = {};
+  h.magic = PRESET_MAGIC;
+  h.version = version;
+  h.headerSize = sizeof(PresetHeader);
+  h.payloadSize = (uint32_t)(total - sizeof(PresetHeader));
+  h.crc = crc32_update(0, &buf[sizeof(PresetHeader)], h.payloadSize);
+  strncpy(h.name, "Old", sizeof(h.name));
+  memcpy(buf.data(), &h, sizeof(h));
+  return buf;
+}
+
+template <typename T>
+static void put(std::vector<uint8_t> &b, const T &v) {
+  b.insert(b.end(), (const uint8_t *)&v, (const uint8_t *)&v + sizeof(v));
+}
+
+// Модель до v4: count + 6-байтовые назначения [+ правила thru]
+static std::vector<uint8_t> legacy_model(bool thru) {
+  std::vector<uint8_t> b;
+  put(b, (uint16_t)(sizeof(oldKeys) / sizeof(oldKeys[0])));
+  for (uint16_t i = 0; i < MAX_MAPPINGS; i++)
+    put(b, i < sizeof(oldKeys) / sizeof(oldKeys[0]) ? oldKeys[i] : KeyMappingOld{});
+  if (thru) {
+    put(b, (uint16_t)(sizeof(oldThru) / sizeof(oldThru[0])));
+    for (uint16_t i = 0; i < MAX_THRU_RULES; i++)
+      put(b, i < sizeof(oldThru) / sizeof(oldThru[0]) ? oldThru[i] : ThruRule{});
+  }
+  return b;
+}
+
+static void expected_model(bool thru) {
+  memset(&model, 0, sizeof(model));
+  for (const KeyMappingOld &k : oldKeys)
+    model.keys[model.count++] = {k.hid, k.type, k.value, k.channel, k.dest, LAYER_BASE, 0};
+  if (thru)
+    for (const ThruRule &r : oldThru) model.thru[model.thruCount++] = r;
+}
+
+static void assert_upgrade(const std::vector<uint8_t> &old) {
+  preset_image_build(model, "Old", expect);
+  memset(&img, 0xEE, sizeof(img));
+  TEST_ASSERT_TRUE(preset_image_upgrade(old.data(), img));
+  TEST_ASSERT_TRUE(preset_image_valid(&img));
+  TEST_ASSERT_EQUAL_MEMORY(&expect, &img, sizeof(img));
+  assert_tool_reads(old.data(), old.size(), "Old", expect);   // утилита читает то же
+
+  std::vector<uint8_t> bad = old;
+  bad.back() ^= 1;                                             // CRC
+  TEST_ASSERT_FALSE(preset_image_upgrade(bad.data(), img));
+  bad = old;
+  ((PresetHeader *)bad.data())->payloadSize += 4;              // чужая раскладка
+  TEST_ASSERT_FALSE(preset_image_upgrade(bad.data(), img));
+}
+
+#define ROUTES_V1 (256 * sizeof(RouteEntry))
+#define CELLS_V2  (16 * THRU_TYPES * sizeof(ThruCell))
+
+static void test_upgrade_v1() {
+  expected_model(false);
+  assert_upgrade(legacy_image(1, legacy_model(false), ROUTES_V1));
+}
+
+static void test_upgrade_v2() {
+  expected_model(true);
+  assert_upgrade(legacy_image(2, legacy_model(true), ROUTES_V1 + CELLS_V2));
+}
+
+static void test_upgrade_v3() {
+  expected_model(true);
+  assert_upgrade(legacy_image(3, legacy_model(true), ROUTES_V1 + 2 * CELLS_V2));
+}
+
+// v4: модель нынешняя, но без кривых — слои переносятся как есть
+static void test_upgrade_v4() {
+  expected_model(true);
+  model.keys[model.count++] = {0x1D, ROUTE_NOTE, 72, 2, DEST_PIO(1), LAYER_SHIFT, 0};
+  model.keys[model.count++] = {0x1B, ROUTE_CC, 20, 4, DEST_PIO(2), LAYER_CTRL, 0};
+  std::vector<uint8_t> b((const uint8_t *)&model, (const uint8_t *)&model + offsetof(ConfigModel, curveCount));
+  assert_upgrade(legacy_image(4, b, offsetof(RouteTable, thruCurve)));
+}
+
+static void test_upgrade_rejects_current_and_unknown() {
+  import_json(CFG_JSON, model);
+  preset_image_build(model, "Live A", expect);
+  TEST_ASSERT_FALSE(preset_image_upgrade(&expect, img));   // v5 не переносится
+  expect.hdr.version = 0;
+  TEST_ASSERT_FALSE(preset_image_upgrade(&expect, img));
+}
+
+int main() {
+  system("mkdir -p .pio");
+  UNITY_BEGIN();
+  RUN_TEST(test_build_is_valid);
+  RUN_TEST(test_tool_json2bin_matches_build);
+  RUN_TEST(test_tool_bin2json_round_trip);
+  RUN_TEST(test_upgrade_v1);
+  RUN_TEST(test_upgrade_v2);
+  RUN_TEST(test_upgrade_v3);
+  RUN_TEST(test_upgrade_v4);
+  RUN_TEST(test_upgrade_rejects_current_and_unknown);
+  return UNITY_END();
+}
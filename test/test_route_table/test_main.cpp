@@ -0,0 +1,214 @@
+#include <unity.h>
+#include <string.h>
+#include <ArduinoJson.h>
+#include "route_table.h"
+
+// ======================================================
+// Компиляция модели в таблицу маршрутов (без симулятора)
+// ======================================================
+
+static ConfigModel cfg;
+static RouteTable table;
+
+void setUp() {
+  memset(&cfg, 0, sizeof(cfg));
+}
+
+void tearDown() {}
+
+static void add_key(uint8_t hid, uint8_t type, uint8_t value, uint8_t ch, uint16_t dest,
+                    uint8_t layer = LAYER_BASE) {
+  KeyMapping &k = cfg.keys[cfg.count++];
+  k.hid = hid;
+  k.type = type;
+  k.value = value;
+  k.channel = ch;
+  k.dest = dest;
+  k.layer = layer;
+}
+
+static void test_empty_config_is_default_map() {
+  route_table_compile(cfg, table);
+
+  const RouteEntry &z = table.keys[0x1D];
+  TEST_ASSERT_EQUAL(ROUTE_NOTE, z.type);
+  TEST_ASSERT_EQUAL(60, z.value);
+  TEST_ASSERT_EQUAL(0, z.channel);
+  TEST_ASSERT_EQUAL(DEST_USB, z.dest);
+  TEST_ASSERT_EQUAL(ROUTE_NONE, table.keys[0x04].type);
+  TEST_ASSERT_EQUAL(DEST_USB, table.notesOff[0]);
+}
+
+static void test_key_overrides_default_and_unknown_port_is_silent() {
+  add_key(0x1D, ROUTE_CC, 7, 3, DEST_DIN | DEST_PIO(0));
+  add_key(0x1B, ROUTE_NOTE, 50, 1, 0);          // порт не распознан
+  add_key(0x06, ROUTE_NOTE, 0, 1, DEST_DIN);    // value 0 — дефолтная карта
+  route_table_compile(cfg, table);
+
+  TEST_ASSERT_EQUAL(ROUTE_CC, table.keys[0x1D].type);
+  TEST_ASSERT_EQUAL(7, table.keys[0x1D].value);
+  TEST_ASSERT_EQUAL(2, table.keys[0x1D].channel);
+  TEST_ASSERT_EQUAL(DEST_DIN | DEST_PIO(0), table.keys[0x1D].dest);
+  TEST_ASSERT_EQUAL(ROUTE_NONE, table.keys[0x1B].type);
+  TEST_ASSERT_EQUAL(64, table.keys[0x06].value);
+  TEST_ASSERT_EQUAL(DEST_USB, table.keys[0x06].dest);
+}
+
+static void test_layers_fall_back_to_base() {
+  add_key(0x1D, ROUTE_NOTE, 72, 2, DEST_DIN, LAYER_SHIFT);
+  add_key(0x1D, ROUTE_NOTE, 84, 3, DEST_PIO(9), LAYER_CTRL);
+  route_table_compile(cfg, table);
+
+  TEST_ASSERT_EQUAL(60, route_key(table, LAYER_BASE, 0x1D).value);
+  TEST_ASSERT_EQUAL(72, route_key(table, LAYER_SHIFT, 0x1D).value);
+  TEST_ASSERT_EQUAL(84, route_key(table, LAYER_CTRL, 0x1D).value);
+  TEST_ASSERT_EQUAL(62, route_key(table, LAYER_SHIFT, 0x1B).value);
+  // All Notes Off — по всем слоям
+  TEST_ASSERT_EQUAL(DEST_DIN, table.notesOff[1]);
+  TEST_ASSERT_EQUAL(DEST_PIO(9), table.notesOff[2]);
+}
+
+static void test_thru_default_and_rules() {
+  ThruRule &r = cfg.thru[cfg.thruCount++];
+  r.in = THRU_IN_DIN;
+  r.types = (1u << THRU_NOTE_ON) | (1u << THRU_NOTE_OFF);
+  r.channels = 1u << 0;
+  r.dest = DEST_PIO(1);
+  r.remap = 10;
+  ThruRule &block = cfg.thru[cfg.thruCount++];
+  block.in = THRU_IN_DIN;
+  block.types = 1u << THRU_CC;
+  block.channels = 0xFFFF;
+  block.dest = 0;
+  route_table_compile(cfg, table);
+
+  ThruCell c = table.thru[THRU_IN_DIN][0][route_thru_type(0x90, 0x40)];
+  TEST_ASSERT_EQUAL(DEST_PIO(1), THRU_DEST(c));
+  TEST_ASSERT_EQUAL(9, THRU_CHANNEL(c));
+  c = table.thru[THRU_IN_DIN][0][route_thru_type(0x90, 0)];   // NoteOn vel 0 = NoteOff
+  TEST_ASSERT_EQUAL(DEST_PIO(1), THRU_DEST(c));
+  TEST_ASSERT_EQUAL(0, THRU_DEST(table.thru[THRU_IN_DIN][5][THRU_CC]));
+  // без правила: DIN — на всё, USB — на всё, кроме самого USB
+  c = table.thru[THRU_IN_DIN][1][THRU_NOTE_ON];
+  TEST_ASSERT_EQUAL(DEST_ALL, THRU_DEST(c));
+  TEST_ASSERT_EQUAL(1, THRU_CHANNEL(c));
+  TEST_ASSERT_EQUAL(DEST_ALL & ~DEST_USB, THRU_DEST(table.thru[THRU_IN_USB][0][THRU_SYSTEM]));
+}
+
+// --- Из JSON (config_model_import) — та же таблица, что из модели ---
+static ConfigModel parsed;
+static RouteTable fromJson;
+
+static void compile_json(const char *json) {
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, json));
+  memset(&parsed, 0, sizeof(parsed));
+  TEST_ASSERT_TRUE(config_model_import(doc.as<JsonObjectConst>(), parsed));
+  route_table_compile(parsed, fromJson);
+  route_table_compile(cfg, table);
+  TEST_ASSERT_EQUAL_MEMORY(&table, &fromJson, sizeof(table));
+}
+
+// Ключи — HID-коды в hex, "port" и "ports"; value 0 и пропущенная
+// клавиша — дефолтная карта; ключ не HID-код — пропускается
+static void test_json_keys() {
+  add_key(0x1D, ROUTE_CC, 7, 3, DEST_DIN | DEST_PIO(0));
+  add_key(0x1B, ROUTE_NOTE, 0, 2, DEST_PIO(1));
+  add_key(0x2C, ROUTE_NOTE, 50, 16, DEST_PIO(9));
+  add_key(0x2D, ROUTE_NOTE, 51, 1, 0);
+  compile_json(R"({
+    "0x1D": {"type": "cc", "value": 7, "channel": 3, "ports": ["DIN", "A"]},
+    "0X1b": {"type": "note", "value": 0, "channel": 2, "port": "B"},
+    "0x2c": {"type": "note", "value": 50, "channel": 16, "port": "J"},
+    "0x2D": {"type": "note", "value": 51, "channel": 1, "ports": ["K"]},
+    "0x100": {"type": "note", "value": 1, "channel": 1, "port": "USB"},
+    "name": "test"
+  })");
+  TEST_ASSERT_EQUAL(4, parsed.count);
+
+  TEST_ASSERT_EQUAL(ROUTE_CC, fromJson.keys[0x1D].type);
+  TEST_ASSERT_EQUAL(DEST_DIN | DEST_PIO(0), fromJson.keys[0x1D].dest);
+  TEST_ASSERT_EQUAL(62, fromJson.keys[0x1B].value);          // value 0
+  TEST_ASSERT_EQUAL(DEST_USB, fromJson.keys[0x1B].dest);
+  TEST_ASSERT_EQUAL(0, fromJson.keys[0x1B].channel);
+  TEST_ASSERT_EQUAL(15, fromJson.keys[0x2C].channel);
+  TEST_ASSERT_EQUAL(DEST_PIO(9), fromJson.keys[0x2C].dest);
+  TEST_ASSERT_EQUAL(ROUTE_NONE, fromJson.keys[0x2D].type);   // порт не распознан
+  TEST_ASSERT_EQUAL(64, fromJson.keys[0x06].value);          // клавиши нет в JSON
+  TEST_ASSERT_EQUAL(DEST_USB, fromJson.keys[0x06].dest);
+  TEST_ASSERT_EQUAL(ROUTE_NONE, fromJson.keys[0x04].type);
+}
+
+// "shift"/"ctrl" — слои поверх базового; value 0 в слое — как в базовом
+static void test_json_layers() {
+  add_key(0x1D, ROUTE_NOTE, 48, 1, DEST_USB);
+  add_key(0x1D, ROUTE_NOTE, 72, 2, DEST_DIN, LAYER_SHIFT);
+  add_key(0x1B, ROUTE_NOTE, 0, 2, DEST_DIN, LAYER_SHIFT);
+  add_key(0x1B, ROUTE_CC, 20, 4, DEST_PIO(2) | DEST_PIO(3), LAYER_CTRL);
+  compile_json(R"({
+    "0x1D": {"type": "note", "value": 48, "channel": 1, "port": "USB"},
+    "shift": {
+      "0x1D": {"type": "note", "value": 72, "channel": 2, "ports": ["DIN"]},
+      "0x1B": {"type": "note", "value": 0, "channel": 2, "port": "DIN"}
+    },
+    "ctrl": {"0x1B": {"type": "cc", "value": 20, "channel": 4, "ports": ["C", "D"]}}
+  })");
+
+  TEST_ASSERT_EQUAL(48, route_key(fromJson, LAYER_BASE, 0x1D).value);
+  TEST_ASSERT_EQUAL(72, route_key(fromJson, LAYER_SHIFT, 0x1D).value);
+  TEST_ASSERT_EQUAL(48, route_key(fromJson, LAYER_CTRL, 0x1D).value);
+  TEST_ASSERT_EQUAL(62, route_key(fromJson, LAYER_SHIFT, 0x1B).value);   // слой с value 0
+  TEST_ASSERT_EQUAL(DEST_USB, route_key(fromJson, LAYER_SHIFT, 0x1B).dest);
+  TEST_ASSERT_EQUAL(ROUTE_CC, route_key(fromJson, LAYER_CTRL, 0x1B).type);
+  TEST_ASSERT_EQUAL(DEST_PIO(2) | DEST_PIO(3), route_key(fromJson, LAYER_CTRL, 0x1B).dest);
+  TEST_ASSERT_EQUAL(DEST_DIN, fromJson.notesOff[1]);
+}
+
+// "thru": пропущенные "channels"/"types" — все, "ports":[] — блок,
+// "remap" — канал, последнее совпавшее правило побеждает
+static void test_json_thru() {
+  ThruRule *r = &cfg.thru[cfg.thruCount++];
+  *r = {THRU_IN_DIN, (1u << THRU_NOTE_ON) | (1u << THRU_NOTE_OFF), 1u << 0, DEST_PIO(1), 10, 0};
+  r = &cfg.thru[cfg.thruCount++];
+  *r = {THRU_IN_DIN, 1u << THRU_CC, 0xFFFF, 0, 0, 0};
+  r = &cfg.thru[cfg.thruCount++];
+  *r = {THRU_IN_USB, 0xFF, (1u << 15) | (1u << 1), DEST_DIN, 0, 0};
+  compile_json(R"({
+    "thru": [
+      {"in": "DIN", "channels": [1], "types": ["note"], "ports": ["B"], "remap": 10},
+      {"in": "DIN", "types": ["cc"], "ports": []},
+      {"in": "USB", "channels": [2, 16, 17], "port": "DIN"}
+    ]
+  })");
+  TEST_ASSERT_EQUAL(3, parsed.thruCount);
+
+  TEST_ASSERT_EQUAL(DEST_PIO(1), THRU_DEST(fromJson.thru[THRU_IN_DIN][0][THRU_NOTE_ON]));
+  TEST_ASSERT_EQUAL(9, THRU_CHANNEL(fromJson.thru[THRU_IN_DIN][0][THRU_NOTE_OFF]));
+  TEST_ASSERT_EQUAL(DEST_ALL, THRU_DEST(fromJson.thru[THRU_IN_DIN][1][THRU_NOTE_ON]));
+  TEST_ASSERT_EQUAL(0, THRU_DEST(fromJson.thru[THRU_IN_DIN][7][THRU_CC]));
+  TEST_ASSERT_EQUAL(DEST_DIN, THRU_DEST(fromJson.thru[THRU_IN_USB][15][THRU_BEND]));
+  TEST_ASSERT_EQUAL(DEST_ALL & ~DEST_USB, THRU_DEST(fromJson.thru[THRU_IN_USB][0][THRU_NOTE_ON]));
+  TEST_ASSERT_EQUAL(64, fromJson.keys[0x06].value);   // без клавиш — дефолтная карта
+}
+
+static void test_port_names() {
+  TEST_ASSERT_EQUAL(DEST_USB, route_port_mask("USB"));
+  TEST_ASSERT_EQUAL(DEST_DIN, route_port_mask("DIN"));
+  TEST_ASSERT_EQUAL(DEST_PIO(9), route_port_mask("J"));
+  TEST_ASSERT_EQUAL(0, route_port_mask("K"));
+  TEST_ASSERT_EQUAL(0, route_port_mask("AB"));
+  TEST_ASSERT_EQUAL_STRING("C", route_sink_name(4));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_config_is_default_map);
+  RUN_TEST(test_key_overrides_default_and_unknown_port_is_silent);
+  RUN_TEST(test_layers_fall_back_to_base);
+  RUN_TEST(test_thru_default_and_rules);
+  RUN_TEST(test_json_keys);
+  RUN_TEST(test_json_layers);
+  RUN_TEST(test_json_thru);
+  RUN_TEST(test_port_names);
+  return UNITY_END();
+}
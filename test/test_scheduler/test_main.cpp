@@ -0,0 +1,149 @@
+#include "../sim_test.h"
+#include "scheduler.h"
+#include "midi_output.h"
+#include "hardware/timer.h"
+
+// ======================================================
+// Колесо таймеров: порядок, спуск уровней, пул, компенсация
+// ======================================================
+// Уровни: L0 — тики по 64 мкс (блок 16384 мкс), L1 — блоки
+// (1048576 мкс), L2 — дальше. События ставятся как из core1.
+
+#define L0_SPAN (256u * SCHED_TICK_US)
+#define L1_SPAN (64u * L0_SPAN)
+
+static SchedStats stats() {
+  SchedStats st;
+  sched_get_stats(st);
+  return st;
+}
+
+// Время первого байта выхода, 0 — ничего не ушло
+static uint64_t first_byte(uint8_t sink) {
+  for (const WireRec &r : wire)
+    if (r.sink == sink) return r.t;
+  return 0;
+}
+
+static MidiWord cc(uint8_t v) {
+  return midi_word_msg(USB_CABLE_ROUTER, 0xB0, 1, v);
+}
+
+void setUp() {
+  sched_reset_stats();
+  run_for(100);
+  wire.clear();
+}
+
+void tearDown() {}
+
+// Каждое событие — на свой TRS: по первым байтам видно, в каком порядке
+// и когда они ушли. Уровни вперемешку, поставлены не по порядку.
+static void test_order_across_levels() {
+  static const uint32_t delays[10] = {
+    L1_SPAN + 5000, 300, 2 * L1_SPAN, 5000, L0_SPAN + 100,
+    40000, 64, 3 * L0_SPAN, L1_SPAN - 64, 12000,
+  };
+  uint32_t now = time_us_32();
+  for (uint8_t k = 0; k < 10; k++)
+    TEST_ASSERT_TRUE(sched_at(now + delays[k], DEST_PIO(k), cc(k)));
+  TEST_ASSERT_EQUAL(10, stats().pending);
+
+  run_for(2 * L1_SPAN + 20000);
+  SchedStats st = stats();
+  TEST_ASSERT_EQUAL(0, st.pending);
+  TEST_ASSERT_EQUAL(10, st.dispatched);
+  TEST_ASSERT_EQUAL(10, st.late.count);
+  TEST_ASSERT_TRUE(st.late.max <= 2 * 10);   // от тика — не дольше прохода core1
+
+  for (uint8_t k = 0; k < 10; k++) {
+    uint64_t t = first_byte(2 + k) - 320;   // начало байта
+    TEST_ASSERT_TRUE(t >= now + delays[k]);                        // раньше срока — никогда
+    TEST_ASSERT_TRUE(t <= now + delays[k] + SCHED_TICK_US + 400);  // тик, проход и кадр TRS
+    for (uint8_t j = 0; j < 10; j++)
+      if (delays[j] < delays[k]) TEST_ASSERT_TRUE(first_byte(2 + j) <= first_byte(2 + k));
+  }
+}
+
+// Один тик — в порядке постановки; пачки разных тиков одного блока
+// и соседнего (после спуска с L1) — по времени
+static void test_same_tick_fifo_and_cascade() {
+  uint32_t now = time_us_32();
+  uint32_t base = now + L0_SPAN - (now % L0_SPAN);   // граница блока L0
+  TEST_ASSERT_TRUE(sched_at(base + 2 * L0_SPAN + 10, DEST_DIN, cc(7)));   // L1
+  TEST_ASSERT_TRUE(sched_at(base - 1, DEST_DIN, cc(1)));
+  TEST_ASSERT_TRUE(sched_at(base - 1, DEST_DIN, cc(2)));
+  TEST_ASSERT_TRUE(sched_at(base + 2 * L0_SPAN, DEST_DIN, cc(5)));        // L1, тик раньше 7
+  TEST_ASSERT_TRUE(sched_at(base + 2 * L0_SPAN, DEST_DIN, cc(6)));
+  TEST_ASSERT_TRUE(sched_at(base, DEST_DIN, cc(3)));                      // первый тик блока
+  TEST_ASSERT_TRUE(sched_at(base, DEST_DIN, cc(4)));
+
+  run_for(base + 3 * L0_SPAN - now);
+  TEST_ASSERT_WIRE(1, 0xB0, 1, 1, 1, 2, 1, 3, 1, 4, 1, 5, 1, 6, 1, 7);
+  TEST_ASSERT_TRUE(stats().late.max <= 2 * 10);
+}
+
+// Много событий в одном тике — в выходы не больше SCHED_DISPATCH_MAX за проход
+static void test_dispatch_is_bounded() {
+  uint32_t due = time_us_32() + 1000;
+  for (uint8_t k = 0; k < 40; k++) TEST_ASSERT_TRUE(sched_at(due, DEST_USB, cc(k)));
+  run_for(1000 + SCHED_TICK_US);
+  uint32_t first = stats().dispatched;
+  TEST_ASSERT_TRUE(first > 0);
+  TEST_ASSERT_TRUE(first <= SCHED_DISPATCH_MAX);
+  run_for(3 * 10);
+  TEST_ASSERT_EQUAL(40, stats().dispatched);
+  TEST_ASSERT_EQUAL(0, stats().pending);
+}
+
+// Пул: NoteOn и прочее — пока не остался резерв, NoteOff — до конца;
+// за горизонтом L2 — отказ
+static void test_pool_reserve_and_horizon() {
+  TEST_ASSERT_FALSE(sched_after(64u * L1_SPAN + L1_SPAN, DEST_USB, cc(0)));
+
+  uint16_t ons = 0, offs = 0;
+  while (sched_after(L0_SPAN, DEST_USB, midi_word_msg(USB_CABLE_ROUTER, 0x90, 60, 100))) ons++;
+  TEST_ASSERT_EQUAL(SCHED_EVENTS - SCHED_RESERVE, ons);
+  while (sched_after(L0_SPAN, DEST_USB, midi_word_msg(USB_CABLE_ROUTER, 0x80, 60, 0))) offs++;
+  TEST_ASSERT_EQUAL(SCHED_RESERVE, offs);
+  TEST_ASSERT_EQUAL(SCHED_EVENTS, stats().peak);
+  TEST_ASSERT_EQUAL(3, stats().dropped);   // горизонт, NoteOn и NoteOff сверх пула
+
+  run_for(L0_SPAN + 100000);
+  TEST_ASSERT_EQUAL(0, stats().pending);
+  TEST_ASSERT_TRUE(sched_after(100, DEST_USB, cc(1)));
+  run_for(1000);
+}
+
+// Компенсация: самый медленный выход — сразу, остальные ждут разницу
+static void test_latency_compensation() {
+  TEST_ASSERT_TRUE(sched_set_latency(DEST_PIO(0), 8000));
+  TEST_ASSERT_TRUE(sched_set_latency(DEST_PIO(1), 3000));
+  TEST_ASSERT_FALSE(sched_set_latency(DEST_PIO(1), SCHED_LATENCY_MAX + 1));
+  run_for(100);
+  SchedPortStats p;
+  sched_get_port(3, p);
+  TEST_ASSERT_EQUAL(5000, p.delay);
+
+  uint64_t now = sim_now();
+  send_midi_mask(DEST_PIO(0) | DEST_PIO(1) | DEST_PIO(2), cc(9));
+  run_for(20000);
+  uint64_t a = first_byte(2) - now, b = first_byte(3) - now, c = first_byte(4) - now;
+  TEST_ASSERT_TRUE(a < 1000);
+  TEST_ASSERT_TRUE(b >= 5000 && b < 5000 + 1000);
+  TEST_ASSERT_TRUE(c >= 8000 && c < 8000 + 1000);
+
+  TEST_ASSERT_TRUE(sched_set_latency(DEST_ALL, 0));
+  run_for(100);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_order_across_levels);
+  RUN_TEST(test_same_tick_fifo_and_cascade);
+  RUN_TEST(test_dispatch_is_bounded);
+  RUN_TEST(test_pool_reserve_and_horizon);
+  RUN_TEST(test_latency_compensation);
+  return UNITY_END();
+}
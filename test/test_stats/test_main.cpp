@@ -0,0 +1,116 @@
+#include "../sim_test.h"
+#include "stats.h"
+#include "midi_input.h"
+#include "midi_output.h"
+#include "midi_queue.h"
+
+// ======================================================
+// Счётчики: что считается и кто их обнуляет
+// ======================================================
+// Сброс с core0 — только запрос: счётчики пишет core1 и его IRQ,
+// обнуляет их core1 в своём проходе.
+
+#define SINK_A 2
+
+static RouterStats stats() {
+  RouterStats st;
+  stats_get(st);
+  return st;
+}
+
+void setUp() {
+  wire.clear();
+}
+
+void tearDown() {}
+
+// SysEx кусками — одно сообщение выхода, сколько бы кусков ни было
+static void test_sysex_counted_once() {
+  const MidiWord head[2] = {
+    midi_word(USB_CABLE_ROUTER, 0x04, 0xF0, 0x7E, 0x7F),
+    midi_word(USB_CABLE_ROUTER, 0x04, 0x09, 0x01, 0x02),
+  };
+  const MidiWord tail[1] = {midi_word(USB_CABLE_ROUTER, 0x06, 0x03, 0xF7, 0)};
+  uint32_t before = stats().out[SINK_A];
+  send_midi_words(SINK_A, head, 2);
+  send_midi_words(SINK_A, tail, 1);
+  run_for(10000);
+
+  TEST_ASSERT_EQUAL(before + 1, stats().out[SINK_A]);
+  TEST_ASSERT_WIRE(SINK_A, 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0x02, 0x03, 0xF7);
+}
+
+// Счётчики IRQ (часы) — отдельно, в снимке уже сложены с потоковыми
+static void test_irq_counts_summed() {
+  uint32_t before = stats().out[1];
+  stats_out(1);
+  stats_out_irq(1);
+  RouterStats st = stats();
+  TEST_ASSERT_EQUAL(before + 2, st.out[1]);
+  TEST_ASSERT_TRUE(st.outIrq[1] >= 1);
+}
+
+static void test_router_reset_applied_by_core1() {
+  send_midi(SINK_A, midi_word_msg(USB_CABLE_ROUTER, 0x90, 60, 100));
+  run_for(2000);
+  TEST_ASSERT_TRUE(stats().out[SINK_A] > 0);
+
+  stats_reset();
+  TEST_ASSERT_TRUE(stats().out[SINK_A] > 0);   // core0 сам не обнуляет
+  run_for(100);
+  RouterStats st = stats();
+  TEST_ASSERT_EQUAL(0, st.out[SINK_A]);
+  TEST_ASSERT_EQUAL(0, st.outIrq[1]);
+}
+
+static void test_input_reset_applied_by_core1() {
+  uint64_t t = sim_now();
+  sim_uart_rx(0xFE, t + 320);
+  sim_uart_rx(0xFE, t + 640);
+  run_for(2000);
+  MidiInStats st;
+  midi_in_get_stats(st);
+  TEST_ASSERT_TRUE(st.bytes >= 2);
+
+  midi_in_reset_stats();
+  midi_in_get_stats(st);
+  TEST_ASSERT_TRUE(st.bytes >= 2);
+  run_for(100);
+  midi_in_get_stats(st);
+  TEST_ASSERT_EQUAL(0, st.bytes);
+}
+
+static void test_output_resets_applied_by_core1() {
+  send_midi(SINK_A, midi_word_msg(USB_CABLE_ROUTER, 0xB0, 7, 1));
+  run_for(5000);
+  MidiQueueStats q;
+  midi_out_get_queue_stats(0, q);
+  TEST_ASSERT_TRUE(q.wireBytes > 0);
+
+  TEST_ASSERT_TRUE(midi_out_reset_queue_stats());
+  TEST_ASSERT_TRUE(midi_out_reset_latency());
+  TEST_ASSERT_TRUE(midi_out_reset_usb_stats());
+  midi_out_get_queue_stats(0, q);
+  TEST_ASSERT_TRUE(q.wireBytes > 0);
+
+  run_for(100);
+  midi_out_get_queue_stats(0, q);
+  TEST_ASSERT_EQUAL(0, q.wireBytes);
+  LatencyStats l;
+  midi_out_get_latency(SINK_A, l);
+  TEST_ASSERT_EQUAL(0, l.count);
+  UsbOutStats u;
+  midi_out_get_usb_stats(u);
+  TEST_ASSERT_EQUAL(0, u.packets);
+}
+
+int main() {
+  sim_test_boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_sysex_counted_once);
+  RUN_TEST(test_irq_counts_summed);
+  RUN_TEST(test_router_reset_applied_by_core1);
+  RUN_TEST(test_input_reset_applied_by_core1);
+  RUN_TEST(test_output_resets_applied_by_core1);
+  return UNITY_END();
+}
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Сравнение результатов BENCH (src/bench.h): базовый прогон против нового.
+
+Вход — текст с ответами BENCH (по строке JSON на нагрузку), как его
+печатает WebSerial или симулятор; прочие строки пропускаются.
+
+Байты в линии, события и потери детерминированы и обязаны совпасть
+точно. Стоимость события (p50/p99) сравнивается с допуском: на хосте
+она шумит, на плате — почти нет.
+
+Примеры:
+  .pio/build/native/program -b all > base.txt
+  .pio/build/native/program -b all > new.txt
+  bench_compare.py base.txt new.txt --tolerance 25
+"""
+import argparse
+import json
+import sys
+
+EXACT = ["events", "bytes_in", "wire", "drops"]
+COST = ["p50", "p99"]
+
+
+def load(path):
+    runs = {}
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith('{"bench"'):
+                continue
+            r = json.loads(line)
+            runs[r["bench"]] = r
+    return runs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("base")
+    ap.add_argument("new")
+    ap.add_argument("--tolerance", type=float, default=20.0, help="допуск роста p50/p99, %% (20)")
+    args = ap.parse_args()
+
+    base, new = load(args.base), load(args.new)
+    failed = False
+    for name, b in base.items():
+        n = new.get(name)
+        if n is None:
+            print(f"{name:8} missing in {args.new}")
+            failed = True
+            continue
+        for key in EXACT:
+            if b[key] != n[key]:
+                print(f"{name:8} {key}: {b[key]} -> {n[key]}")
+                failed = True
+        for key in COST:
+            was, now = b["ns"][key], n["ns"][key]
+            delta = (now - was) * 100.0 / was if was else 0.0
+            mark = "REGRESSION" if delta > args.tolerance else "ok"
+            failed |= delta > args.tolerance
+            print(f"{name:8} {key}: {was:>8} -> {now:>8} ns ({delta:+.1f}%) {mark}")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Записи событий RP2040 MIDI Router (src/capture.h) → текст или сценарий симулятора.
+
+Вход — ответ CAPTURE DUMP (строка JSON) или файл лога /capture0.bin,
+/capture1.bin (записи по 16 байт, little-endian):
+  uint32 ts | uint16 dest | uint8 src | uint8 len | 8 байт данных
+
+Сценарий для .pio/build/native/program воспроизводит запись на хосте
+с исходными интервалами: DIN → din, USB → usb, клавиши → отчёты hid
+(boot, до 6 клавиш; модификаторы E0–E7 — биты первого байта).
+
+Примеры:
+  capture_tool.py text capture0.bin
+  capture_tool.py scenario dump.txt > bug.txt
+  capture_tool.py scenario capture1.bin capture0.bin > bug.txt
+"""
+import argparse
+import json
+import struct
+import sys
+
+SRC_NAMES = ["din", "usb", "keys"]
+CAPTURE_CONT = 0x80
+CAPTURE_SEGMENT = 0xFF
+ENTRY = struct.Struct("<IHBB8s")
+MIDI_BYTE_US = 320                             # 10 бит при 31250 бод (как в sim/sim_main.cpp)
+
+
+def read_log(path):
+    """События из файла лога: продолжения SysEx склеены с началом."""
+    events = []
+    with open(path, "rb") as f:
+        data = f.read()
+    for off in range(0, len(data) - ENTRY.size + 1, ENTRY.size):
+        ts, dest, src, n, raw = ENTRY.unpack_from(data, off)
+        if n == 0 or src == CAPTURE_SEGMENT:
+            continue
+        if src & CAPTURE_CONT and events:
+            events[-1][3] += raw[:n]
+            continue
+        events.append([ts, SRC_NAMES[src & 0x7F], dest, bytearray(raw[:n])])
+    return events
+
+
+def read_dump(path):
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            if '"events"' in line:
+                return [[t, s, d, bytearray.fromhex(h)] for t, s, d, h in json.loads(line)["capture"]["events"]]
+    return []
+
+
+def load(paths):
+    events = []
+    for p in paths:
+        events += read_log(p) if p.endswith(".bin") else read_dump(p)
+    return events
+
+
+def hex_bytes(b):
+    return " ".join(f"{x:02x}" for x in b)
+
+
+def to_text(events):
+    for ts, src, dest, b in events:
+        print(f"{ts:>10}  {src:<4}  dest=0x{dest:03x}  {hex_bytes(b)}")
+
+
+def to_scenario(events):
+    held, mods = [], 0
+    last = None
+    for ts, src, _, b in events:
+        if src == "din":                       # ts — конец последнего байта в линии
+            ts -= MIDI_BYTE_US * len(b)
+        at = "0" if last is None else f"+{max(0, (ts - last + 2**31) % 2**32 - 2**31)}"
+        last = ts
+        if src == "din":
+            print(f"{at} din {hex_bytes(b)}")
+        elif src == "usb":
+            print(f"{at} usb {hex_bytes(b)}")
+        else:
+            code, pressed = b[0], b[1]
+            if code == 0:                      # сбой клавиатуры: всё отпущено
+                held, mods = [], 0
+            elif 0xE0 <= code <= 0xE7:
+                bit = 1 << (code - 0xE0)
+                mods = (mods | bit) if pressed else (mods & ~bit)
+            elif pressed and code not in held:
+                held.append(code)
+            elif not pressed and code in held:
+                held.remove(code)
+            keys = (held + [0] * 6)[:6]
+            print(f"{at} hid {hex_bytes([mods, 0] + keys)}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("mode", choices=["text", "scenario"])
+    ap.add_argument("inputs", nargs="+", help="ответ CAPTURE DUMP или файлы лога по порядку")
+    args = ap.parse_args()
+    events = load(args.inputs)
+    if args.mode == "text":
+        to_text(events)
+    else:
+        to_scenario(events)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,394 @@
+#!/usr/bin/env python3
+"""Конвертер пресетов RP2040 MIDI Router: JSON <-> бинарный образ.
+
+Раскладка образа совпадает с src/preset_image.h (little-endian):
+  PresetHeader (32 байта) | ConfigModel | RouteTable | выравнивание
+Образы v1 (без матрицы thru), v2 (thru только с DIN), v3 (без слоёв)
+и v4 (без кривых) тоже читаются.
+
+Примеры:
+  preset_tool.py json2bin config.json preset1.bin --name "Live A"
+  preset_tool.py bin2json preset1.bin
+  preset_tool.py bin2json dump.txt      # строка ответа DUMP_PRESET
+  preset_tool.py verify preset1.bin
+"""
+import argparse
+import json
+import math
+import re
+import struct
+import sys
+import zlib
+
+PRESET_MAGIC = 0x50524D52
+PRESET_VERSION = 5
+
+MAX_MAPPINGS = 256
+MAX_THRU_RULES = 32
+LAYER_POOL = 128                             # записей слоёв Shift/Ctrl (src/route_table.h)
+LAYER_NAMES = ["base", "shift", "ctrl"]
+MAX_CURVES, CURVE_POINTS = 7, 16             # кривые (src/config_model.h, src/curve.h)
+CURVE_NAMES = ["linear", "exp", "invert", "clamp", "fixed", "user"]
+CURVE_LINEAR, CURVE_EXP, CURVE_INVERT, CURVE_CLAMP, CURVE_FIXED, CURVE_USER = range(6)
+CURVE_FROM_RATE, ROUTE_CURVE_RATE = 0x01, 0x80
+ROUTE_NONE, ROUTE_NOTE, ROUTE_CC = 0, 1, 2
+DEST_USB, DEST_DIN = 1 << 0, 1 << 1
+DEST_ALL = (1 << 12) - 1
+
+# матрица thru (src/route_table.h): [вход][канал][тип] → uint16
+THRU_INPUTS, THRU_TYPES = 2, 8
+THRU_INPUT_NAMES = ["DIN", "USB"]
+THRU_TYPE_NAMES = ["noteoff", "noteon", "polyat", "cc", "pc", "pressure", "bend", "system"]
+
+HEADER = struct.Struct("<IHHII16s")
+ENTRY = struct.Struct("<BBBBH")              # RouteEntry и KeyMapping до v4: по 6 байт
+KEYMAP = struct.Struct("<BBBBHBB")           # KeyMapping v4: + слой, кривая
+RULE = struct.Struct("<BBHHBB")              # ThruRule: 8 байт
+CURVE = struct.Struct("<BBBbBB%ds" % CURVE_POINTS)   # CurveDef: 22 байта
+KEYS_SIZE = 2 + MAX_MAPPINGS * KEYMAP.size   # count + keys[]
+V4_MODEL_SIZE = KEYS_SIZE + 2 + MAX_THRU_RULES * RULE.size
+MODEL_SIZE = V4_MODEL_SIZE + 2 + MAX_CURVES * CURVE.size
+CELLS = THRU_INPUTS * 16 * THRU_TYPES
+V4_ROUTES_SIZE = (256 * ENTRY.size + 2 * 256 + LAYER_POOL * ENTRY.size   # keys, layerSlot, layerKeys
+                  + CELLS * 2 + 16 * 2)                                  # thru, notesOff
+ROUTES_SIZE = V4_ROUTES_SIZE + CELLS + (MAX_CURVES + 1) * 128            # thruCurve, curves
+IMAGE_SIZE = (HEADER.size + MODEL_SIZE + ROUTES_SIZE + 3) & ~3   # sizeof(PresetImage)
+V4_IMAGE_SIZE = (HEADER.size + V4_MODEL_SIZE + V4_ROUTES_SIZE + 3) & ~3
+V1_KEYS_SIZE = 2 + MAX_MAPPINGS * ENTRY.size
+V3_MODEL_SIZE = V1_KEYS_SIZE + 2 + MAX_THRU_RULES * RULE.size
+V1_IMAGE_SIZE = (HEADER.size + V1_KEYS_SIZE + 256 * ENTRY.size + 3) & ~3
+V2_IMAGE_SIZE = (HEADER.size + V3_MODEL_SIZE + 256 * ENTRY.size + 16 * THRU_TYPES * 2 + 3) & ~3
+V3_IMAGE_SIZE = (HEADER.size + V3_MODEL_SIZE + 256 * ENTRY.size + CELLS * 2 + 3) & ~3
+
+# дефолтная карта клавиш (src/route_table.cpp)
+DEFAULT_MAP = {0x1D: 60, 0x1B: 62, 0x06: 64, 0x19: 65, 0x05: 67,
+               0x11: 69, 0x10: 71, 0x36: 72, 0x37: 74, 0x38: 76}
+
+
+def port_mask(port):
+    if port == "USB":
+        return DEST_USB
+    if port == "DIN":
+        return DEST_DIN
+    if isinstance(port, str) and len(port) == 1 and "A" <= port <= "J":
+        return 1 << (2 + ord(port) - ord("A"))
+    return 0
+
+
+SINK_NAMES = ["USB", "DIN"] + [chr(ord("A") + i) for i in range(10)]
+
+
+def dest_mask(o):
+    """"ports":[...] или старое одиночное "port"."""
+    ports = o.get("ports")
+    if not isinstance(ports, list):
+        return port_mask(o.get("port"))
+    mask = 0
+    for p in ports:
+        mask |= port_mask(p)
+    return mask
+
+
+def port_names(dest):
+    return [n for i, n in enumerate(SINK_NAMES) if dest & (1 << i)]
+
+
+def type_mask(name):
+    if name == "note":
+        return 0b11
+    return 1 << THRU_TYPE_NAMES.index(name) if name in THRU_TYPE_NAMES else 0
+
+
+def import_rule(o):
+    """ThruRule: пропущенные "channels"/"types" — все."""
+    channels = 0xFFFF
+    if isinstance(o.get("channels"), list):
+        channels = 0
+        for ch in o["channels"]:
+            if isinstance(ch, int) and 1 <= ch <= 16:
+                channels |= 1 << (ch - 1)
+    types = 0xFF
+    if isinstance(o.get("types"), list):
+        types = 0
+        for t in o["types"]:
+            types |= type_mask(t)
+    remap = o.get("remap", 0)
+    remap = remap if isinstance(remap, int) and 1 <= remap <= 16 else 0
+    inp = 1 if o.get("in") == "USB" else 0
+    return (inp, types, channels, dest_mask(o), remap, curve_ref(o))
+
+
+def curve_ref(o):
+    c = o.get("curve", 0)
+    return c if isinstance(c, int) and 1 <= c <= MAX_CURVES else 0
+
+
+def clamp7(v):
+    return max(0, min(127, int(v)))
+
+
+def import_curve(o):
+    """CurveDef: пропущенные поля — полный диапазон 0–127."""
+    typ = CURVE_NAMES.index(o["type"]) if o.get("type") in CURVE_NAMES else CURVE_LINEAR
+    lo, hi = clamp7(o.get("min", 0)), clamp7(o.get("max", 127))
+    if typ == CURVE_FIXED:
+        lo = hi = clamp7(o.get("value", 127))
+    shape = max(-8, min(8, int(o.get("shape", 3))))
+    points = [clamp7(p) for p in o.get("points", [])][:CURVE_POINTS]
+    return (typ, lo, hi, shape, CURVE_FROM_RATE if o.get("rate") else 0,
+            len(points), bytes(points).ljust(CURVE_POINTS, b"\0"))
+
+
+def export_curve(c):
+    typ, lo, hi, shape, flags, count, points = c
+    o = {"type": CURVE_NAMES[typ] if typ < len(CURVE_NAMES) else "linear"}
+    if typ == CURVE_FIXED:
+        o["value"] = lo
+    elif typ == CURVE_USER:
+        o["points"] = list(points[:count])
+    else:
+        if typ == CURVE_EXP:
+            o["shape"] = shape
+        o["min"], o["max"] = lo, hi
+    if flags & CURVE_FROM_RATE:
+        o["rate"] = True
+    return o
+
+
+def lerp(a, b, x):
+    return (a * (127 - x) + b * x + 63) // 127
+
+
+def curve_lut(c):
+    """curve_build(): CurveDef → 128 байт."""
+    typ, lo, hi, shape, _, count, points = c
+    lo, hi = lo & 0x7F, hi & 0x7F
+    lut = []
+    for x in range(128):
+        if typ == CURVE_EXP and shape:
+            k = shape / 2.0
+            f = (math.exp(k * x / 127.0) - 1.0) / (math.exp(k) - 1.0)
+            y = int(lo * (1.0 - f) + hi * f + 0.5)
+        elif typ == CURVE_INVERT:
+            y = lerp(hi, lo, x)
+        elif typ == CURVE_CLAMP:
+            y = lo if x < lo else hi if x > hi else x
+        elif typ == CURVE_FIXED:
+            y = lo
+        elif typ == CURVE_USER:
+            n = count if 2 <= count <= CURVE_POINTS else 2
+            pos = x * (n - 1)
+            i = pos // 127
+            y = points[n - 1] & 0x7F if i >= n - 1 else lerp(points[i] & 0x7F, points[i + 1] & 0x7F, pos - i * 127)
+        else:
+            y = lerp(lo, hi, x)
+        lut.append(y)
+    return bytes(lut)
+
+
+def export_rule(rule):
+    inp, types, channels, dest, remap, curve = rule
+    o = {"in": THRU_INPUT_NAMES[inp] if inp < THRU_INPUTS else "DIN"}
+    if channels != 0xFFFF:
+        o["channels"] = [ch + 1 for ch in range(16) if channels & (1 << ch)]
+    if types != 0xFF:
+        o["types"] = [n for t, n in enumerate(THRU_TYPE_NAMES) if types & (1 << t)]
+    o["ports"] = port_names(dest)
+    if remap:
+        o["remap"] = remap
+    if curve:
+        o["curve"] = curve
+    return o
+
+
+def import_model(cfg):
+    """config_model_import(): JSON → (KeyMapping, ThruRule, CurveDef)."""
+    rules = [import_rule(o) for o in cfg.get("thru", [])]
+    if len(rules) > MAX_THRU_RULES:
+        raise ValueError("too many thru rules")
+    curves = [import_curve(o) for o in cfg.get("curves", [])]
+    if len(curves) > MAX_CURVES:
+        raise ValueError("too many curves")
+    keys = []
+    for layer, name in enumerate(LAYER_NAMES):
+        obj = cfg if layer == 0 else cfg.get(name, {})
+        for key, o in obj.items():
+            m = re.fullmatch(r"0[xX]([0-9a-fA-F]+)", key)
+            if not m or int(m.group(1), 16) > 0xFF:
+                continue
+            if len(keys) >= MAX_MAPPINGS:
+                raise ValueError("too many mappings")
+            if layer and sum(k[5] != 0 for k in keys) >= LAYER_POOL:
+                raise ValueError("too many layer mappings")
+            keys.append((int(m.group(1), 16),
+                         ROUTE_NOTE if o.get("type") == "note" else ROUTE_CC,
+                         int(o.get("value", 0)) & 0x7F,
+                         int(o.get("channel", 0)) & 0xFF,
+                         dest_mask(o), layer, curve_ref(o)))
+    return keys, rules, curves
+
+
+def curve_index(curves, c):
+    """Номер кривой → индекс LUT | ROUTE_CURVE_RATE."""
+    if not 1 <= c <= len(curves):
+        return 0
+    return c | ROUTE_CURVE_RATE if curves[c - 1][4] & CURVE_FROM_RATE else c
+
+
+THRU_CURVE_TYPES = (1 << 1) | (1 << 2) | (1 << 3) | (1 << 5)   # NoteOn, PolyAT, CC, Pressure
+
+
+def compile_thru(rules, curves):
+    """Матрица thru: по умолчанию всё на все выходы (с USB — кроме USB), правила по порядку."""
+    cells = [(DEST_ALL & ~DEST_USB if inp == 1 else DEST_ALL) | (ch << 12)
+             for inp in range(THRU_INPUTS) for ch in range(16) for _ in range(THRU_TYPES)]
+    lut_index = [0] * CELLS
+    for inp, types, channels, dest, remap, curve in rules:
+        if inp >= THRU_INPUTS:
+            continue
+        for ch in range(16):
+            if not channels & (1 << ch):
+                continue
+            out = ((remap - 1) & 0x0F) if remap else ch
+            for t in range(THRU_TYPES):
+                if types & (1 << t):
+                    cells[(inp * 16 + ch) * THRU_TYPES + t] = (dest & DEST_ALL) | (out << 12)
+                    if THRU_CURVE_TYPES & (1 << t):
+                        lut_index[(inp * 16 + ch) * THRU_TYPES + t] = curve_index(curves, curve) & 0x0F
+    return cells, lut_index
+
+
+def compile_routes(keys, curves):
+    """route_table_compile(): модель → RouteEntry[256], layerSlot, layerKeys, notesOff."""
+    table = [(ROUTE_NONE, 0, 0, 0, 0)] * 256
+    slots = [[0] * 256 for _ in LAYER_NAMES[1:]]
+    pool = []
+    for hid, note in DEFAULT_MAP.items():
+        table[hid] = (ROUTE_NOTE, note, 0, 0, DEST_USB)
+    for hid, typ, value, channel, dest, layer, curve in keys:
+        if value == 0 or layer >= len(LAYER_NAMES):
+            continue
+        e = (typ if dest else ROUTE_NONE, value, (channel - 1) & 0x0F, curve_index(curves, curve), dest)
+        if layer == 0:
+            table[hid] = e
+        elif slots[layer - 1][hid]:
+            pool[slots[layer - 1][hid] - 1] = e
+        elif len(pool) < LAYER_POOL:
+            pool.append(e)
+            slots[layer - 1][hid] = len(pool)
+    notes_off = [0] * 16
+    for typ, _, channel, _, dest in table + pool:
+        if typ == ROUTE_NOTE:
+            notes_off[channel] |= dest
+    pool += [(ROUTE_NONE, 0, 0, 0, 0)] * (LAYER_POOL - len(pool))
+    return table, slots, pool, notes_off
+
+
+def build_image(cfg, name=""):
+    keys, rules, curves = import_model(cfg)
+    model = struct.pack("<H", len(keys))
+    model += b"".join(KEYMAP.pack(*k) for k in keys)
+    model += b"\0" * (KEYS_SIZE - len(model))
+    model += struct.pack("<H", len(rules)) + b"".join(RULE.pack(*r) for r in rules)
+    model += b"\0" * (V4_MODEL_SIZE - len(model))
+    model += struct.pack("<H", len(curves)) + b"".join(CURVE.pack(*c) for c in curves)
+    model += b"\0" * (MODEL_SIZE - len(model))
+    table, slots, pool, notes_off = compile_routes(keys, curves)
+    cells, lut_index = compile_thru(rules, curves)
+    routes = b"".join(ENTRY.pack(*e) for e in table)
+    routes += b"".join(bytes(s) for s in slots)
+    routes += b"".join(ENTRY.pack(*e) for e in pool)
+    routes += struct.pack("<%dH" % CELLS, *cells)
+    routes += struct.pack("<16H", *notes_off)
+    routes += bytes(lut_index)
+    routes += bytes(range(128)) + b"".join(curve_lut(c) for c in curves)
+    routes += b"\0" * (ROUTES_SIZE - len(routes))
+    payload = model + routes
+    payload += b"\0" * (IMAGE_SIZE - HEADER.size - len(payload))
+    header = HEADER.pack(PRESET_MAGIC, PRESET_VERSION, HEADER.size, len(payload),
+                         zlib.crc32(payload), name.encode()[:15])
+    return header + payload
+
+
+def parse_image(data):
+    if len(data) < HEADER.size:
+        raise ValueError("image too short: %d bytes" % len(data))
+    magic, version, hsize, psize, crc, name = HEADER.unpack_from(data)
+    if magic != PRESET_MAGIC:
+        raise ValueError("bad magic 0x%08X" % magic)
+    size = {1: V1_IMAGE_SIZE, 2: V2_IMAGE_SIZE, 3: V3_IMAGE_SIZE, 4: V4_IMAGE_SIZE,
+            PRESET_VERSION: IMAGE_SIZE}.get(version)
+    if size is None or hsize != HEADER.size or psize != size - HEADER.size:
+        raise ValueError("unsupported version/layout (v%d)" % version)
+    if len(data) < size:
+        raise ValueError("image too short: %d < %d" % (len(data), size))
+    payload = data[HEADER.size:size]
+    if zlib.crc32(payload) != crc:
+        raise ValueError("CRC mismatch")
+
+    # до v4 KeyMapping без слоя — всё в базовом
+    keymap, keys_size = (KEYMAP, KEYS_SIZE) if version >= 4 else (ENTRY, V1_KEYS_SIZE)
+    (count,) = struct.unpack_from("<H", payload)
+    cfg = {}
+    for i in range(count):
+        hid, typ, value, channel, dest, *rest = keymap.unpack_from(payload, 2 + i * keymap.size)
+        layer = rest[0] if rest and rest[0] < len(LAYER_NAMES) else 0
+        obj = cfg if layer == 0 else cfg.setdefault(LAYER_NAMES[layer], {})
+        obj["0x%02X" % hid] = {"type": "note" if typ == ROUTE_NOTE else "cc",
+                               "value": value, "ports": port_names(dest), "channel": channel}
+        if len(rest) > 1 and rest[1]:
+            obj["0x%02X" % hid]["curve"] = rest[1]
+    if version >= 5:
+        (ncurves,) = struct.unpack_from("<H", payload, V4_MODEL_SIZE)
+        curves = [CURVE.unpack_from(payload, V4_MODEL_SIZE + 2 + i * CURVE.size) for i in range(ncurves)]
+        if curves:
+            cfg["curves"] = [export_curve(c) for c in curves]
+    if version >= 2:
+        (nrules,) = struct.unpack_from("<H", payload, keys_size)
+        rules = [RULE.unpack_from(payload, keys_size + 2 + i * RULE.size) for i in range(nrules)]
+        if rules:
+            cfg["thru"] = [export_rule(r) for r in rules]
+    return name.rstrip(b"\0").decode(errors="replace"), cfg
+
+
+def read_image(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    # ответ DUMP_PRESET: {"preset":1,"hex":"..."}
+    m = re.search(rb'"hex"\s*:\s*"([0-9a-fA-F]+)"', data)
+    return bytes.fromhex(m.group(1).decode()) if m else data
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("json2bin")
+    p.add_argument("json")
+    p.add_argument("out")
+    p.add_argument("--name", default="")
+    p = sub.add_parser("bin2json")
+    p.add_argument("image")
+    p = sub.add_parser("verify")
+    p.add_argument("image")
+    args = ap.parse_args()
+
+    try:
+        if args.cmd == "json2bin":
+            with open(args.json) as f:
+                image = build_image(json.load(f), args.name)
+            with open(args.out, "wb") as f:
+                f.write(image)
+        elif args.cmd == "bin2json":
+            _, cfg = parse_image(read_image(args.image))
+            json.dump(cfg, sys.stdout, separators=(",", ":"))
+            print()
+        else:
+            name, cfg = parse_image(read_image(args.image))
+            mappings = sum(k.startswith("0x") for k in cfg) + sum(len(cfg.get(l, {})) for l in LAYER_NAMES[1:])
+            print("OK: '%s', %d mappings, %d thru rules" % (name, mappings, len(cfg.get("thru", []))))
+    except (OSError, ValueError) as e:
+        sys.exit("error: %s" % e)
+
+
+if __name__ == "__main__":
+    main()